@@ -23,6 +23,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include <math.h>
 #include <vector>
 #include <map>
+#include <list>
 #include "ConfusionMatrix.h"
 #include "base/Vector2d.h"
 
@@ -47,6 +48,15 @@ public:
   void setNcTest(const std::vector<unsigned int> nctest){m_nctest=nctest;};
   //getCost needs to be implemented case by case (e.g., SVM, ANN)
   virtual double getCost(const std::vector<Vector2d<float> > &trainingFeatures)=0;
+  //cost for a subset of the feature columns (default selects a copy of the columns)
+  virtual double getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::list<int>& cols){
+    std::vector<Vector2d<float> > tmp(trainingFeatures.size());
+    for(int iclass=0;iclass<trainingFeatures.size();++iclass)
+      trainingFeatures[iclass].selectCols(cols,tmp[iclass]);
+    return(getCost(tmp));
+  };
+  //copy for one of nworker concurrent workers, which share the memory budget (NULL if getCost can not be evaluated concurrently)
+  virtual CostFactory* clone(int) const{return NULL;};
   
 protected:
   confusionmatrix::ConfusionMatrix m_cm;
@@ -33,6 +33,22 @@ CostFactorySVM::CostFactorySVM(std::string svm_type, std::string kernel_type, un
     : CostFactory(cv,verbose), m_svm_type(svm_type), m_kernel_type(kernel_type), m_kernel_degree(kernel_degree), m_gamma(gamma), m_coef0(coef0), m_ccost(ccost), m_nu(nu),  m_epsilon_loss(epsilon_loss), m_cache(cache), m_epsilon_tol(epsilon_tol), m_shrinking(shrinking), m_prob_est(prob_est){};
 
 double CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeatures){
+  return(getCost(trainingFeatures,std::vector<float>(1,m_ccost))[0]);
+}
+
+double CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::list<int>& cols){
+  std::vector<int> col(cols.begin(),cols.end());
+  return(getCost(trainingFeatures,col,std::vector<float>(1,m_ccost))[0]);
+}
+
+std::vector<double> CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::vector<float>& ccost){
+  std::vector<int> col(trainingFeatures[0][0].size());
+  for(int ifeature=0;ifeature<col.size();++ifeature)
+    col[ifeature]=ifeature;
+  return(getCost(trainingFeatures,col,ccost));
+}
+
+std::vector<double> CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::vector<int>& col, const std::vector<float>& ccost){
   std::map<std::string, svm::SVM_TYPE> svmMap;
 
   svmMap["C_SVC"]=svm::C_SVC;
@@ -59,7 +75,7 @@ double CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeat
     assert(!m_cv);
   if(!m_cv)
     assert(ntest);
-  unsigned short nFeatures=trainingFeatures[0][0].size();
+  unsigned short nFeatures=col.size();
 
   struct svm_parameter param;
   param.svm_type = svmMap[m_svm_type];
@@ -94,7 +110,7 @@ double CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeat
       prob.x[lIndex]=&(x_space[spaceIndex]);
       for(int ifeature=0;ifeature<nFeatures;++ifeature){
         x_space[spaceIndex].index=ifeature+1;
-        x_space[spaceIndex].value=trainingFeatures[iclass][isample][ifeature];
+        x_space[spaceIndex].value=trainingFeatures[iclass][isample][col[ifeature]];
         ++spaceIndex;
       }
       x_space[spaceIndex++].index=-1;
@@ -107,55 +123,71 @@ double CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeat
   if(m_verbose>2)
     std::cout << "checking parameters" << std::endl;
   svm_check_parameter(&prob,&param);
-  if(m_verbose>2)
-    std::cout << "parameters ok, training" << std::endl;
-  svm=svm_train(&prob,&param);
-  if(m_verbose>2)
-    std::cout << "SVM is now trained" << std::endl;
 
-  m_cm.clearResults();
+  std::vector<double> cost(ccost.size());
+  std::vector<double> target;
   if(m_cv>1){
-    double *target = Malloc(double,prob.l);
-    svm_cross_validation(&prob,&param,m_cv,target);
-    assert(param.svm_type != EPSILON_SVR&&param.svm_type != NU_SVR);//only for regression
-    for(int i=0;i<prob.l;i++){
-      std::string refClassName=m_nameVector[prob.y[i]];
-      std::string className=m_nameVector[target[i]];
-      if(m_classValueMap.size())
-	m_cm.incrementResult(type2string<short>(m_classValueMap[refClassName]),type2string<short>(m_classValueMap[className]),1.0);
-      else
-	m_cm.incrementResult(m_cm.getClass(prob.y[i]),m_cm.getClass(target[i]),1.0);
-    }
-    free(target);
+    //all values of ccost in a single cross validation path
+    std::vector<double> C(ccost.begin(),ccost.end());
+    target.resize(C.size()*prob.l);
+    svm_cross_validation_path(&prob,&param,m_cv,C.size(),&(C[0]),&(target[0]));
   }
-  else{
-    struct svm_node *x_test;
-    std::vector<double> result(nclass);
-    x_test = Malloc(struct svm_node,(nFeatures+1));
-    for(int iclass=0;iclass<nclass;++iclass){
-      for(int isample=0;isample<m_nctest[iclass];++isample){
-	for(int ifeature=0;ifeature<nFeatures;++ifeature){
-	  x_test[ifeature].index=ifeature+1;
-	  x_test[ifeature].value=trainingFeatures[iclass][m_nctraining[iclass]+isample][ifeature];
-	}
-	x_test[nFeatures].index=-1;
-	double predict_label=0;
-	assert(svm_check_probability_model(svm));
-	predict_label = svm_predict_probability(svm,x_test,&(result[0]));
-	// predict_label = svm_predict(svm,x_test);
-	std::string refClassName=m_nameVector[iclass];
-	std::string className=m_nameVector[static_cast<short>(predict_label)];
-	if(m_classValueMap.size())
+  for(int icost=0;icost<ccost.size();++icost){
+    param.C=ccost[icost];
+    m_cm.clearResults();
+    if(m_cv>1){
+      assert(param.svm_type != EPSILON_SVR&&param.svm_type != NU_SVR);//only for regression
+      for(int i=0;i<prob.l;i++){
+        std::string refClassName=m_nameVector[prob.y[i]];
+        std::string className=m_nameVector[target[icost*prob.l+i]];
+        if(m_classValueMap.size())
 	  m_cm.incrementResult(type2string<short>(m_classValueMap[refClassName]),type2string<short>(m_classValueMap[className]),1.0);
-	else
-	  m_cm.incrementResult(refClassName,className,1.0);
+        else
+	  m_cm.incrementResult(m_cm.getClass(prob.y[i]),m_cm.getClass(target[icost*prob.l+i]),1.0);
+      }
+    }
+    else{
+      if(m_verbose>2)
+        std::cout << "parameters ok, training" << std::endl;
+      svm=svm_train(&prob,&param);
+      if(m_verbose>2)
+        std::cout << "SVM is now trained" << std::endl;
+      assert(svm_check_probability_model(svm));
+      //predict all test samples in a single batch
+      struct svm_dense_model* svmDense=svm_create_dense_model(svm,nFeatures);
+      std::vector<double> x_test(ntest*nFeatures);
+      std::vector<double> labels(ntest);
+      std::vector<double> result(ntest*nclass);
+      std::vector<double> work(svm_predict_batch_work_size(svmDense));
+      unsigned int itest=0;
+      for(int iclass=0;iclass<nclass;++iclass){
+        for(int isample=0;isample<m_nctest[iclass];++isample){
+	  for(int ifeature=0;ifeature<nFeatures;++ifeature)
+	    x_test[itest*nFeatures+ifeature]=trainingFeatures[iclass][m_nctraining[iclass]+isample][col[ifeature]];
+	  ++itest;
+        }
+      }
+      svm_predict_batch(svmDense,&(x_test[0]),ntest,&(labels[0]),&(result[0]),&(work[0]));
+      itest=0;
+      for(int iclass=0;iclass<nclass;++iclass){
+        for(int isample=0;isample<m_nctest[iclass];++isample){
+	  double predict_label=labels[itest++];
+	  std::string refClassName=m_nameVector[iclass];
+	  std::string className=m_nameVector[static_cast<short>(predict_label)];
+	  if(m_classValueMap.size())
+	    m_cm.incrementResult(type2string<short>(m_classValueMap[refClassName]),type2string<short>(m_classValueMap[className]),1.0);
+	  else
+	    m_cm.incrementResult(refClassName,className,1.0);
+        }
       }
+      svm_free_dense_model(&svmDense);
+      svm_free_and_destroy_model(&(svm));
     }
-    free(x_test);
+    if(m_verbose>1)
+      std::cout << m_cm << std::endl;
+    assert(m_cm.nReference());
+    cost[icost]=m_cm.kappa();
   }
-  if(m_verbose>1)
-    std::cout << m_cm << std::endl;
-  assert(m_cm.nReference());
   // if(m_verbose)
 
   // std::cout << m_cm << std::endl;
@@ -172,7 +204,6 @@ double CostFactorySVM::getCost(const std::vector<Vector2d<float> > &trainingFeat
   free(prob.y);
   free(prob.x);
   free(x_space);
-  svm_free_and_destroy_model(&(svm));
 
-  return(m_cm.kappa());
+  return(cost);
 }
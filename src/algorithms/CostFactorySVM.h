@@ -38,8 +38,20 @@ CostFactorySVM();
 CostFactorySVM(std::string svm_type, std::string kernel_type, unsigned short kernel_degree, float gamma, float coef0, float ccost, float nu,  float epsilon_loss, int cache, float epsilon_tol, bool shrinking, bool prob_est, unsigned short cv, short verbose);
 ~CostFactorySVM();
 double getCost(const std::vector<Vector2d<float> > &trainingFeatures);
+//cost for a subset of the feature columns, read in place
+double getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::list<int>& cols);
+//cost for each value of ccost (in increasing order, warm started along the path)
+std::vector<double> getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::vector<float>& ccost);
+//the kernel cache is divided among the workers
+CostFactory* clone(int nworker) const{
+  CostFactorySVM* worker=new CostFactorySVM(*this);
+  if(nworker>1)
+    worker->m_cache=(m_cache/nworker>1)? m_cache/nworker : 1;
+  return worker;
+};
   
 private:
+std::vector<double> getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::vector<int>& cols, const std::vector<float>& ccost);
 std::string m_svm_type;
 std::string m_kernel_type;
 unsigned short m_kernel_degree;
@@ -0,0 +1,258 @@
+/**********************************************************************
+CostFactorySeparability.cc: cost for feature selection based on class separability
+Copyright (C) 2008-2016 Pieter Kempeneers
+
+This file is part of pktools
+
+pktools is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+pktools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with pktools.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+#include "CostFactorySeparability.h"
+
+CostFactorySeparability::CostFactorySeparability()
+  : CostFactory(0,0), m_measure("jm"){
+}
+
+CostFactorySeparability::CostFactorySeparability(const std::string& measure, short verbose)
+  : CostFactory(0,verbose), m_measure(measure){
+  if(m_measure!="jm"&&m_measure!="bhattacharyya"&&m_measure!="mahalanobis"){
+    std::string errorString="Error: separability measure not supported (use jm, bhattacharyya or mahalanobis): ";
+    errorString+=m_measure;
+    throw(errorString);
+  }
+}
+
+CostFactorySeparability::~CostFactorySeparability(){
+}
+
+void CostFactorySeparability::setStatistics(const std::vector<Vector2d<float> > &trainingFeatures){
+  int nfeature=trainingFeatures[0][0].size();
+  unsigned short nclass=trainingFeatures.size();
+  std::shared_ptr<Statistics> statistics(new Statistics);
+  statistics->nfeature=nfeature;
+  statistics->mean.assign(nclass,std::vector<double>(nfeature,0));
+  statistics->cov.assign(nclass,std::vector<double>(nfeature*nfeature,0));
+  for(int iclass=0;iclass<nclass;++iclass){
+    //only the training samples (test samples follow in trainingFeatures)
+    int nsample=(static_cast<int>(m_nctraining.size())>iclass)? m_nctraining[iclass] : trainingFeatures[iclass].size();
+    if(nsample<2){
+      std::string errorString="Error: separability needs at least two training samples for each class";
+      throw(errorString);
+    }
+    std::vector<double>& mean=statistics->mean[iclass];
+    std::vector<double>& cov=statistics->cov[iclass];
+    for(int isample=0;isample<nsample;++isample)
+      for(int ifeature=0;ifeature<nfeature;++ifeature)
+        mean[ifeature]+=trainingFeatures[iclass][isample][ifeature];
+    for(int ifeature=0;ifeature<nfeature;++ifeature)
+      mean[ifeature]/=nsample;
+    std::vector<double> centered(nfeature);
+    for(int isample=0;isample<nsample;++isample){
+      for(int ifeature=0;ifeature<nfeature;++ifeature)
+        centered[ifeature]=trainingFeatures[iclass][isample][ifeature]-mean[ifeature];
+      for(int ifeature=0;ifeature<nfeature;++ifeature)
+        for(int jfeature=ifeature;jfeature<nfeature;++jfeature)
+          cov[ifeature*nfeature+jfeature]+=centered[ifeature]*centered[jfeature];
+    }
+    for(int ifeature=0;ifeature<nfeature;++ifeature){
+      for(int jfeature=ifeature;jfeature<nfeature;++jfeature){
+        cov[ifeature*nfeature+jfeature]/=nsample-1;
+        cov[jfeature*nfeature+ifeature]=cov[ifeature*nfeature+jfeature];
+      }
+    }
+  }
+  for(int iclass=0;iclass<nclass;++iclass){
+    statistics->first.push_back(iclass);
+    statistics->second.push_back(iclass);
+  }
+  for(int iclass=0;iclass<nclass;++iclass){
+    for(int jclass=iclass+1;jclass<nclass;++jclass){
+      statistics->first.push_back(iclass);
+      statistics->second.push_back(jclass);
+    }
+  }
+  m_statistics=statistics;
+  m_base.clear();
+  m_chol.assign(statistics->first.size(),std::vector<double>());
+}
+
+double CostFactorySeparability::covariance(int imatrix, int ifeature, int jfeature) const{
+  const Statistics& statistics=*m_statistics;
+  int index=ifeature*statistics.nfeature+jfeature;
+  return(0.5*(statistics.cov[statistics.first[imatrix]][index]+statistics.cov[statistics.second[imatrix]][index]));
+}
+
+//append the row of a new feature to the factor of features
+void CostFactorySeparability::addFeature(std::vector<double>& chol, const std::vector<int>& features, int imatrix, int ifeature) const{
+  int nfeature=features.size();
+  std::vector<double> row(nfeature+1);
+  double diagonal=covariance(imatrix,ifeature,ifeature);
+  double pivot=diagonal;
+  for(int i=0;i<nfeature;++i){
+    const double* li=&(chol[i*(i+1)/2]);
+    double sum=covariance(imatrix,features[i],ifeature);
+    for(int j=0;j<i;++j)
+      sum-=li[j]*row[j];
+    row[i]=sum/li[i];
+    pivot-=row[i]*row[i];
+  }
+  if(pivot<=1e-10*diagonal||pivot<=0){
+    std::string errorString="Error: singular covariance matrix";
+    throw(errorString);
+  }
+  row[nfeature]=sqrt(pivot);
+  chol.insert(chol.end(),row.begin(),row.end());
+}
+
+//remove row and column iremove from the factor: the part of the column below the diagonal is a rank-one update of the trailing block
+void CostFactorySeparability::removeFeature(std::vector<double>& chol, int nfeature, int iremove) const{
+  std::vector<double> reduced;
+  std::vector<double> x;
+  reduced.reserve(nfeature*(nfeature-1)/2);
+  for(int i=0;i<nfeature;++i){
+    if(i==iremove)
+      continue;
+    const double* li=&(chol[i*(i+1)/2]);
+    for(int j=0;j<=i;++j){
+      if(j!=iremove)
+        reduced.push_back(li[j]);
+    }
+    if(i>iremove)
+      x.push_back(li[iremove]);
+  }
+  for(int r=0;r<x.size();++r){
+    int ir=iremove+r;
+    double& lrr=reduced[ir*(ir+1)/2+ir];
+    double rr=sqrt(lrr*lrr+x[r]*x[r]);
+    double c=rr/lrr;
+    double s=x[r]/lrr;
+    lrr=rr;
+    for(int i=r+1;i<x.size();++i){
+      int ii=iremove+i;
+      double& lir=reduced[ii*(ii+1)/2+ir];
+      lir=(lir+s*x[i])/c;
+      x[i]=c*x[i]-s*lir;
+    }
+  }
+  chol.swap(reduced);
+}
+
+double CostFactorySeparability::getCost(const std::vector<Vector2d<float> > &trainingFeatures){
+  std::list<int> cols;
+  for(int ifeature=0;ifeature<trainingFeatures[0][0].size();++ifeature)
+    cols.push_back(ifeature);
+  return(getCost(trainingFeatures,cols));
+}
+
+double CostFactorySeparability::getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::list<int>& cols){
+  if(cols.empty()){
+    std::string errorString="Error: no features selected";
+    throw(errorString);
+  }
+  if(!m_statistics)
+    setStatistics(trainingFeatures);
+  const Statistics& statistics=*m_statistics;
+  if(statistics.nfeature!=trainingFeatures[0][0].size()||statistics.mean.size()!=trainingFeatures.size()){
+    std::string errorString="Error: training features do not match the separability statistics";
+    throw(errorString);
+  }
+  int nclass=statistics.mean.size();
+  int nmatrix=statistics.first.size();
+  std::vector<int> removed;
+  std::vector<int> added;
+  for(int i=0;i<m_base.size();++i){
+    if(find(cols.begin(),cols.end(),m_base[i])==cols.end())
+      removed.push_back(m_base[i]);
+  }
+  for(std::list<int>::const_iterator lit=cols.begin();lit!=cols.end();++lit){
+    if(find(m_base.begin(),m_base.end(),*lit)==m_base.end())
+      added.push_back(*lit);
+  }
+  std::vector<int> features;
+  std::vector< std::vector<double> > updated;
+  const std::vector< std::vector<double> >* chol=&m_chol;
+  if(m_base.empty()||removed.size()+added.size()>2){
+    //factorize for this subset, which becomes the base for the next subsets
+    m_base.clear();
+    for(int imatrix=0;imatrix<nmatrix;++imatrix)
+      m_chol[imatrix].clear();
+    try{
+      for(std::list<int>::const_iterator lit=cols.begin();lit!=cols.end();++lit){
+        for(int imatrix=0;imatrix<nmatrix;++imatrix)
+          addFeature(m_chol[imatrix],m_base,imatrix,*lit);
+        m_base.push_back(*lit);
+      }
+    }
+    catch(std::string errorString){
+      m_base.clear();
+      for(int imatrix=0;imatrix<nmatrix;++imatrix)
+        m_chol[imatrix].clear();
+      throw(errorString);
+    }
+    features=m_base;
+  }
+  else{
+    //update the factors of the base
+    updated=m_chol;
+    features=m_base;
+    for(int i=0;i<removed.size();++i){
+      int iremove=find(features.begin(),features.end(),removed[i])-features.begin();
+      for(int imatrix=0;imatrix<nmatrix;++imatrix)
+        removeFeature(updated[imatrix],features.size(),iremove);
+      features.erase(features.begin()+iremove);
+    }
+    for(int i=0;i<added.size();++i){
+      for(int imatrix=0;imatrix<nmatrix;++imatrix)
+        addFeature(updated[imatrix],features,imatrix,added[i]);
+      features.push_back(added[i]);
+    }
+    chol=&updated;
+  }
+
+  int nfeature=features.size();
+  std::vector<double> logdet(nmatrix,0);
+  for(int imatrix=0;imatrix<nmatrix;++imatrix)
+    for(int i=0;i<nfeature;++i)
+      logdet[imatrix]+=2*log((*chol)[imatrix][i*(i+1)/2+i]);
+  double cost=0;
+  std::vector<double> y(nfeature);
+  for(int imatrix=nclass;imatrix<nmatrix;++imatrix){
+    int iclass=statistics.first[imatrix];
+    int jclass=statistics.second[imatrix];
+    //squared Mahalanobis distance between the class means (forward substitution)
+    double mahalanobis=0;
+    for(int i=0;i<nfeature;++i){
+      const double* li=&((*chol)[imatrix][i*(i+1)/2]);
+      double sum=statistics.mean[iclass][features[i]]-statistics.mean[jclass][features[i]];
+      for(int j=0;j<i;++j)
+        sum-=li[j]*y[j];
+      y[i]=sum/li[i];
+      mahalanobis+=y[i]*y[i];
+    }
+    double bhattacharyya=mahalanobis/8.0+0.5*(logdet[imatrix]-0.5*(logdet[iclass]+logdet[jclass]));
+    if(m_measure=="mahalanobis")
+      cost+=mahalanobis;
+    else if(m_measure=="bhattacharyya")
+      cost+=bhattacharyya;
+    else
+      cost+=2*(1-exp(-bhattacharyya));
+  }
+  if(nmatrix>nclass)
+    cost/=nmatrix-nclass;
+  if(m_verbose>2)
+    std::cout << m_measure << " separability of " << nfeature << " features: " << cost << std::endl;
+  return(cost);
+}
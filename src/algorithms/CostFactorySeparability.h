@@ -0,0 +1,65 @@
+/**********************************************************************
+CostFactorySeparability.h: cost for feature selection based on class separability
+Copyright (C) 2008-2016 Pieter Kempeneers
+
+This file is part of pktools
+
+pktools is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+pktools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with pktools.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#ifndef _COSTFACTORYSEPARABILITY_H_
+#define _COSTFACTORYSEPARABILITY_H_
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include "base/Vector2d.h"
+#include "CostFactory.h"
+
+//Average separability over all class pairs, based on class means and covariances of the training samples
+//(jm: Jeffries-Matusita, bhattacharyya: Bhattacharyya distance, mahalanobis: squared Mahalanobis distance with the average covariance of the pair).
+//The Cholesky factors of the covariance matrices are kept for the last subset of features and updated for the features
+//that are added (new row) or removed (rank-one update), such that candidates in a selection step are evaluated in O(k^2).
+class CostFactorySeparability : public CostFactory
+{
+public:
+CostFactorySeparability();
+CostFactorySeparability(const std::string& measure, short verbose);
+~CostFactorySeparability();
+//class means and covariances of all features, computed once and shared with the clones (set before the selection starts)
+void setStatistics(const std::vector<Vector2d<float> > &trainingFeatures);
+double getCost(const std::vector<Vector2d<float> > &trainingFeatures);
+double getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::list<int>& cols);
+CostFactory* clone(int) const{return new CostFactorySeparability(*this);};
+
+private:
+struct Statistics{
+  int nfeature;
+  std::vector< std::vector<double> > mean;//[iclass][ifeature]
+  std::vector< std::vector<double> > cov;//[iclass][ifeature*nfeature+jfeature]
+  //covariance matrices: each class, followed by the average of each class pair
+  std::vector<int> first;
+  std::vector<int> second;
+};
+double covariance(int imatrix, int ifeature, int jfeature) const;
+void addFeature(std::vector<double>& chol, const std::vector<int>& features, int imatrix, int ifeature) const;
+void removeFeature(std::vector<double>& chol, int nfeature, int iremove) const;
+std::string m_measure;
+//immutable, shared by the clones
+std::shared_ptr<const Statistics> m_statistics;
+//lower triangular Cholesky factors (packed by row) for the features in m_base, kept by each clone
+std::vector<int> m_base;
+std::vector< std::vector<double> > m_chol;
+};
+#endif
@@ -31,12 +31,15 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include "base/Vector2d.h"
 #include "gsl/gsl_combination.h"
 #include "CostFactory.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 class FeatureSelector
 {
  public:
-  FeatureSelector(){};
-  ~FeatureSelector(){};
+  FeatureSelector() : m_prototype(0){};
+  ~FeatureSelector(){clearWorkers();};
   template<class T> double forward(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int maxFeatures=0, short verbose=0);
   template<class T> double backward(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int minFeatures, short verbose=0);
   template<class T> double floating(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int maxFeatures=0, double epsilon=0.001, short verbose=0);
@@ -46,8 +49,64 @@ class FeatureSelector
     template<class T> double addFeature(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, short verbose=0);
   template<class T> double removeFeature(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int& r, short verbose=0);  
   template<class T> double forwardUnivariate(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int maxFeatures=0, short verbose=0);
+  template<class T> void getCosts(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, const std::vector< std::list<int> >& candidates, std::vector<double>& cost, std::vector<char>& failed);
+  bool getWorkers(const CostFactory& theCostFactory, int nworker);
+  void clearWorkers(void){
+    for(unsigned int iworker=0;iworker<m_workers.size();++iworker)
+      delete m_workers[iworker];
+    m_workers.clear();
+    m_prototype=0;
+  };
+  //the workers own their clone
+  FeatureSelector(const FeatureSelector&);
+  FeatureSelector& operator=(const FeatureSelector&);
+  //clones of the cost factory of the last call, kept across selection steps (with their cached state)
+  const CostFactory* m_prototype;
+  std::vector<CostFactory*> m_workers;
 };
 
+//one clone of the cost factory per worker (false if the cost factory can not be cloned)
+inline bool FeatureSelector::getWorkers(const CostFactory& theCostFactory, int nworker){
+  if(m_prototype!=&theCostFactory)
+    clearWorkers();
+  m_prototype=&theCostFactory;
+  while(static_cast<int>(m_workers.size())<nworker){
+    CostFactory* worker=theCostFactory.clone(nworker);
+    if(!worker)
+      return false;
+    m_workers.push_back(worker);
+  }
+  return true;
+}
+
+//cost of each candidate subset (failed is set if getCost throws), candidates are evaluated concurrently by clones of the cost factory
+template<class T> void FeatureSelector::getCosts(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, const std::vector< std::list<int> >& candidates, std::vector<double>& cost, std::vector<char>& failed){
+  cost.assign(candidates.size(),0);
+  failed.assign(candidates.size(),0);
+  bool concurrent=false;
+#ifdef _OPENMP
+  if(candidates.size()>1&&omp_get_max_threads()>1&&!omp_in_parallel())
+    concurrent=getWorkers(theCostFactory,omp_get_max_threads());
+#endif
+#pragma omp parallel if(concurrent)
+  {
+    CostFactory* workerFactory=&theCostFactory;
+#ifdef _OPENMP
+    if(concurrent)
+      workerFactory=m_workers[omp_get_thread_num()];
+#endif
+#pragma omp for schedule(dynamic)
+    for(int icandidate=0;icandidate<candidates.size();++icandidate){
+      try{
+        cost[icandidate]=workerFactory->getCost(v,candidates[icandidate]);
+      }
+      catch(...){
+        failed[icandidate]=1;
+      }
+    }
+  }
+}
+
 //sequential forward selection Univariate (N single best features)
 template<class T> double FeatureSelector::forwardUnivariate(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int maxFeatures, short verbose){
   int maxLevels=v[0][0].size();
@@ -57,30 +116,24 @@ template<class T> double FeatureSelector::forwardUnivariate(std::vector< Vector2
   if(k>=maxFeatures)
     return -1;
   std::vector<IndexValue> cost(maxLevels);
-  std::list<int> tmpset=subset;//temporary set of selected features (levels)
-  std::vector< Vector2d<T> > tmp(v.size());
+  std::vector< std::list<int> > candidates;
+  std::vector<int> candidateLevel;
   for(int ilevel=0;ilevel<maxLevels;++ilevel){
-    if(find(tmpset.begin(),tmpset.end(),ilevel)==tmpset.end()){
-      tmpset.push_back(ilevel);
-      for(int iclass=0;iclass<v.size();++iclass){
-// 	tmp[iclass].resize(v[iclass].size());
-	v[iclass].selectCols(tmpset,tmp[iclass]);
-      }
-      try{
-	IndexValue pv;
-	pv.position=ilevel;
-	pv.value=theCostFactory.getCost(tmp);
-	cost[ilevel]=pv;
-      }
-      catch(...){
-	IndexValue pv;
-	pv.position=ilevel;
-	pv.value=-1;
-	cost[ilevel]=pv;
-      }
-      tmpset.pop_back();
+    if(find(subset.begin(),subset.end(),ilevel)==subset.end()){
+      candidates.push_back(subset);
+      candidates.back().push_back(ilevel);
+      candidateLevel.push_back(ilevel);
     }
   }
+  std::vector<double> candidateCost;
+  std::vector<char> failed;
+  getCosts(v,theCostFactory,candidates,candidateCost,failed);
+  for(int icandidate=0;icandidate<candidates.size();++icandidate){
+    IndexValue pv;
+    pv.position=candidateLevel[icandidate];
+    pv.value=(failed[icandidate])? -1 : candidateCost[icandidate];
+    cost[pv.position]=pv;
+  }
   sort(cost.begin(),cost.end(),Compare_IndexValue());//decreasing order
   int ilevel=0;
   while((subset.size()<maxFeatures)&&(ilevel<maxLevels)){
@@ -92,12 +145,8 @@ template<class T> double FeatureSelector::forwardUnivariate(std::vector< Vector2
   }
   double maxCost=-1;
   while(subset.size()){
-    for(int iclass=0;iclass<v.size();++iclass){
-//       tmp[iclass].resize(v[iclass].size());
-      v[iclass].selectCols(subset,tmp[iclass]);
-    }
     try{
-      maxCost=theCostFactory.getCost(tmp);
+      maxCost=theCostFactory.getCost(v,subset);
     }
     catch(...){
       subset.pop_back();
@@ -220,39 +269,45 @@ template<class T> double FeatureSelector::bruteForce(std::vector< Vector2d<T> >&
   gsl_combination *c;
   c=gsl_combination_calloc(v[0][0].size(),maxFeatures);
   
-  std::list<int> tmpset;//temporary set of selected features (levels)
-  std::vector< Vector2d<T> > tmpv(v.size());
   std::list<int> catchset;//restore set in case of catch all the way to last level (no better cost)
   //initialize maxCost with actual cost for current subset (-1 if empty subset) 
   double maxCost=-1;
-  double cost;
   if(subset.size()>=maxLevels)
     return maxCost;
+  //combinations are evaluated in blocks
+  const int combinationBlockSize=1024;
+  std::vector< std::list<int> > candidates;
+  std::vector<double> cost;
+  std::vector<char> failed;
   gsl_combination_next(c);
-  do{
-    for(int ifeature=0;ifeature<maxFeatures;++ifeature)
-      tmpset.push_back(c->data[ifeature]);
-    for(int iclass=0;iclass<v.size();++iclass)
-      v[iclass].selectCols(tmpset,tmpv[iclass]);
-    try{
-      cost=theCostFactory.getCost(tmpv);
-    }
-    catch(...){ //singular matrix encountered
-      catchset=tmpset;//this tmpset resulted in failure of getCost
-      if(verbose){
-        std::cout << "Could not get cost from set: " << std::endl;
-	gsl_combination_fprintf(stdout,c," %u");
-	printf("\n");
-      }      
-      tmpset.clear();
-      continue;
-    }
-    if(maxCost<cost){ //set with better cost is found
-      maxCost=cost;
-      subset=tmpset;
+  bool more=true;
+  while(more){
+    candidates.clear();
+    do{
+      std::list<int> tmpset;//temporary set of selected features (levels)
+      for(int ifeature=0;ifeature<maxFeatures;++ifeature)
+        tmpset.push_back(c->data[ifeature]);
+      candidates.push_back(tmpset);
+      more=(gsl_combination_next(c)==GSL_SUCCESS);
+    }while(more&&candidates.size()<combinationBlockSize);
+    getCosts(v,theCostFactory,candidates,cost,failed);
+    for(int icandidate=0;icandidate<candidates.size();++icandidate){
+      if(failed[icandidate]){ //singular matrix encountered
+        catchset=candidates[icandidate];//this tmpset resulted in failure of getCost
+        if(verbose){
+          std::cout << "Could not get cost from set: " << std::endl;
+          for(std::list<int>::const_iterator lit=catchset.begin();lit!=catchset.end();++lit)
+            std::cout << " " << *lit;
+          std::cout << std::endl;
+        }
+        continue;
+      }
+      if(maxCost<cost[icandidate]){ //set with better cost is found
+        maxCost=cost[icandidate];
+        subset=candidates[icandidate];
+      }
     }
-    tmpset.clear();
-  }while(gsl_combination_next(c)==GSL_SUCCESS);
+  }
   gsl_combination_free(c);
 //   }while(c.next());  
   if(maxCost<0) //no level added to better maxCost than current subset (catchset)
@@ -267,38 +322,33 @@ template<class T> double FeatureSelector::bruteForce(std::vector< Vector2d<T> >&
 
 template<class T> double FeatureSelector::addFeature(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, short verbose){
   //select feature with the best value (get maximal cost for 1 feature)
-  std::list<int> tmpset=subset;//temporary set of selected features (levels)
-  std::vector< Vector2d<T> > tmp(v.size());
   std::list<int> catchset;//restore set in case of catch all the way to last level (no better cost)
   //initialize maxCost with actual cost for current subset (-1 if empty subset) 
   double maxCost=-1;
-  double cost;
   int maxLevels=v[0][0].size();
   if(subset.size()>=maxLevels)
     return maxCost;
+  std::vector< std::list<int> > candidates;
   for(int ilevel=0;ilevel<maxLevels;++ilevel){
-    if(find(tmpset.begin(),tmpset.end(),ilevel)!=tmpset.end())
+    if(find(subset.begin(),subset.end(),ilevel)!=subset.end())
       continue;
-    tmpset.push_back(ilevel);
-    for(int iclass=0;iclass<v.size();++iclass){
-//       tmp[iclass].resize(v[iclass].size());
-      v[iclass].selectCols(tmpset,tmp[iclass]);
-    }
-    try{
-      cost=theCostFactory.getCost(tmp);
-    }
-    catch(...){
-      catchset=tmpset;//this tmpset resulted in singular matrix
+    candidates.push_back(subset);//temporary set of selected features (levels)
+    candidates.back().push_back(ilevel);
+  }
+  std::vector<double> cost;
+  std::vector<char> failed;
+  getCosts(v,theCostFactory,candidates,cost,failed);
+  for(int icandidate=0;icandidate<candidates.size();++icandidate){
+    if(failed[icandidate]){
+      catchset=candidates[icandidate];//this tmpset resulted in singular matrix
       if(verbose)
-        std::cout << "Could not add feature " << tmpset.back() << std::endl;
-      tmpset.pop_back();
+        std::cout << "Could not add feature " << catchset.back() << std::endl;
       continue;
     }
-    if(maxCost<cost){ //level with better cost is found
-      maxCost=cost;
-      subset=tmpset;
+    if(maxCost<cost[icandidate]){ //level with better cost is found
+      maxCost=cost[icandidate];
+      subset=candidates[icandidate];
     }
-    tmpset.pop_back();
   }
   if(maxCost<0) //no level added to better maxCost than current subset (catchset)
     subset=catchset;
@@ -313,41 +363,37 @@ template<class T> double FeatureSelector::addFeature(std::vector< Vector2d<T> >&
 template<class T> double FeatureSelector::removeFeature(std::vector< Vector2d<T> >& v, CostFactory& theCostFactory, std::list<int>& subset, int& r, short verbose){
   //find the feature that has the least effect on the cost when it is removed from subset
   std::list<int> tmpset=subset;//temporary set of selected features (levels)
-  std::vector< Vector2d<T> > tmp(v.size());
   int nFeatures=subset.size();
   std::list<int> catchset;//restore set in case of catch all the way to last level (no better cost)
   //initialize maxCost with actual cost for current subset (-1 if empty subset) 
   double maxCost=-1;
-  int last;
-  double cost;
   int maxLevels=v[0][0].size();
   if(subset.size()>maxLevels||subset.empty()){
     return maxCost;
   }
-  std::list<int>::const_iterator it;
+  std::vector< std::list<int> > candidates(nFeatures);
+  std::vector<int> last(nFeatures);
   for(int i=0;i<nFeatures;++i){
-    last=tmpset.back();
+    last[i]=tmpset.back();
     tmpset.pop_back();
-    for(int iclass=0;iclass<v.size();++iclass){
-//       tmp[iclass].resize(v[iclass].size());
-      v[iclass].selectCols(tmpset,tmp[iclass]);
-    }
-    try{
-      cost=theCostFactory.getCost(tmp);
-    }
-    catch(...){
-      catchset=tmpset;//this tmpset resulted in singular matrix
+    candidates[i]=tmpset;
+    tmpset.push_front(last[i]);
+  }
+  std::vector<double> cost;
+  std::vector<char> failed;
+  getCosts(v,theCostFactory,candidates,cost,failed);
+  for(int i=0;i<nFeatures;++i){
+    if(failed[i]){
+      catchset=candidates[i];//this tmpset resulted in singular matrix
       if(verbose)
-        std::cout << "Could not remove feature " << last << std::endl;
-      tmpset.push_front(last);
+        std::cout << "Could not remove feature " << last[i] << std::endl;
       continue;
     }
-    if(maxCost<cost){ //level with better cost is found
-      maxCost=cost;
-      subset=tmpset;
-      r=last;
+    if(maxCost<cost[i]){ //level with better cost is found
+      maxCost=cost[i];
+      subset=candidates[i];
+      r=last[i];
     }
-    tmpset.push_front(last);
   }
   if(maxCost<0){//all levels removed were caught
     subset=catchset;
@@ -63,196 +63,174 @@ unsigned int filter::Filter::setNoDataValues(std::vector<double> vnodata){
 };
 
 void filter::Filter::dwtForward(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family){
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-  Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
-  Vector2d<double> lineOutput(input.nrOfBand(),input.nrOfCol());
-  for(unsigned int y=0;y<input.nrOfRow();++y){
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-      input.readData(lineInput[iband],y,iband);
-    vector<double> pixelInput(input.nrOfBand());
-    for(unsigned int x=0;x<input.nrOfCol();++x){
-      pixelInput=lineInput.selectCol(x);
-      dwtForward(pixelInput,wavelet_type,family);
-      for(int iband=0;iband<input.nrOfBand();++iband)
-        lineOutput[iband][x]=pixelInput[iband];
-    }
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband){
-      try{
-        output.writeData(lineOutput[iband],y,iband);
-      }
-      catch(string errorstring){
-        cerr << errorstring << "in band " << iband << ", line " << y << endl;
-      }
-    }
-    progress=(1.0+y)/output.nrOfRow();
-    pfnProgress(progress,pszMessage,pProgressArg);
-  }
+  dwt(input,output,wavelet_type,family,filter::dwt);
 }
 
 void filter::Filter::dwtInverse(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family){
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-  Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
-  Vector2d<double> lineOutput(input.nrOfBand(),input.nrOfCol());
-  for(unsigned int y=0;y<input.nrOfRow();++y){
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-      input.readData(lineInput[iband],y,iband);
-    vector<double> pixelInput(input.nrOfBand());
-    for(unsigned int x=0;x<input.nrOfCol();++x){
-      pixelInput=lineInput.selectCol(x);
-      dwtInverse(pixelInput,wavelet_type,family);
-      for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-        lineOutput[iband][x]=pixelInput[iband];
-    }
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband){
-      try{
-        output.writeData(lineOutput[iband],y,iband);
-      }
-      catch(string errorstring){
-        cerr << errorstring << "in band " << iband << ", line " << y << endl;
-      }
-    }
-    progress=(1.0+y)/output.nrOfRow();
-    pfnProgress(progress,pszMessage,pProgressArg);
-  }
+  dwt(input,output,wavelet_type,family,filter::dwti);
 }
 
 void filter::Filter::dwtCut(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family, double cut){
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-  Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
-  Vector2d<double> lineOutput(input.nrOfBand(),input.nrOfCol());
-  for(unsigned int y=0;y<input.nrOfRow();++y){
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-      input.readData(lineInput[iband],y,iband);
-    vector<double> pixelInput(input.nrOfBand());
-    for(unsigned int x=0;x<input.nrOfCol();++x){
-      pixelInput=lineInput.selectCol(x);
-      dwtCut(pixelInput,wavelet_type,family,cut);
-      for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-        lineOutput[iband][x]=pixelInput[iband];
-    }
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband){
-      try{
-        output.writeData(lineOutput[iband],y,iband);
-      }
-      catch(string errorstring){
-        cerr << errorstring << "in band " << iband << ", line " << y << endl;
-      }
-    }
-    progress=(1.0+y)/output.nrOfRow();
-    pfnProgress(progress,pszMessage,pProgressArg);
-  }
+  dwt(input,output,wavelet_type,family,filter::dwt_cut,cut);
 }
 
 void filter::Filter::dwtCutFrom(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family, int band){
+  dwt(input,output,wavelet_type,family,filter::dwt_cut_from,0,band);
+}
+
+//batched DWT along the band axis: the profiles of all pixels in a line are stored contiguously (padded to a power of 2)
+//and transformed in parallel, wavelet and workspace are allocated once per thread for the whole image
+void filter::Filter::dwt(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family, FILTER_TYPE method, double cut, int band){
   const char* pszMessage;
   void* pProgressArg=NULL;
   GDALProgressFunc pfnProgress=GDALTermProgress;
   double progress=0;
   pfnProgress(progress,pszMessage,pProgressArg);
-  Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
-  Vector2d<double> lineOutput(input.nrOfBand(),input.nrOfCol());
-  for(unsigned int y=0;y<input.nrOfRow();++y){
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-      input.readData(lineInput[iband],y,iband);
-    vector<double> pixelInput(input.nrOfBand());
-    for(unsigned int x=0;x<input.nrOfCol();++x){
-      pixelInput=lineInput.selectCol(x);
-      dwtForward(pixelInput,wavelet_type,family);
-      for(unsigned int iband=0;iband<input.nrOfBand();++iband){
-	if(iband>=band)
-	  pixelInput[iband]=0;
-      }
-      dwtInverse(pixelInput,wavelet_type,family);
-      for(unsigned int iband=0;iband<input.nrOfBand();++iband)
-	lineOutput[iband][x]=pixelInput[iband];
-    }
-    for(unsigned int iband=0;iband<input.nrOfBand();++iband){
-      try{
-        output.writeData(lineOutput[iband],y,iband);
+  int nband=input.nrOfBand();
+  int ncol=input.nrOfCol();
+  int nsize=1;
+  while(nsize<nband)
+    nsize*=2;
+  Vector2d<double> lineInput(nband,ncol);
+  Vector2d<double> lineOutput(nband,ncol);
+  std::vector<double> profiles(ncol*nsize);
+  switch(method){
+  case(filter::dwt):
+  case(filter::dwti):
+  case(filter::dwt_cut):
+  case(filter::dwt_cut_from):
+    break;
+  default:{
+    //check here: an exception can not leave the parallel region
+    std::string errorString="method not supported";
+    throw(errorString);
+  }
+  }
+  //read errors are caught inside the parallel region and thrown after it
+  bool readFailed=false;
+  std::string readError;
+#pragma omp parallel
+  {
+    gsl_wavelet* w=gsl_wavelet_alloc(getWaveletType(wavelet_type),family);
+    gsl_wavelet_workspace* work=gsl_wavelet_workspace_alloc(nsize);
+    std::vector<double> abscoeff;
+    std::vector<size_t> index;
+    for(unsigned int y=0;y<input.nrOfRow();++y){
+#pragma omp single
+      {
+        try{
+          for(unsigned int iband=0;iband<nband;++iband)
+            input.readData(lineInput[iband],y,iband);
+        }
+        catch(string errorstring){
+          readError=errorstring;
+          readFailed=true;
+        }
+        for(int x=0;x<ncol;++x){
+          double* data=&(profiles[x*nsize]);
+          for(int iband=0;iband<nband;++iband)
+            data[iband]=lineInput[iband][x];
+          //pad with last value
+          for(int iband=nband;iband<nsize;++iband)
+            data[iband]=data[nband-1];
+        }
       }
-      catch(string errorstring){
-        cerr << errorstring << "in band " << iband << ", line " << y << endl;
+      //all threads see the flag after the barrier of the single construct
+      if(readFailed)
+        break;
+#pragma omp for
+      for(int x=0;x<ncol;++x)
+        dwt(&(profiles[x*nsize]),nsize,w,work,method,cut,band,abscoeff,index);
+#pragma omp single
+      {
+        for(int x=0;x<ncol;++x){
+          const double* data=&(profiles[x*nsize]);
+          for(int iband=0;iband<nband;++iband)
+            lineOutput[iband][x]=data[iband];
+        }
+        for(unsigned int iband=0;iband<nband;++iband){
+          try{
+            output.writeData(lineOutput[iband],y,iband);
+          }
+          catch(string errorstring){
+            cerr << errorstring << "in band " << iband << ", line " << y << endl;
+          }
+        }
+        progress=(1.0+y)/output.nrOfRow();
+        pfnProgress(progress,pszMessage,pProgressArg);
       }
     }
-    progress=(1.0+y)/output.nrOfRow();
-    pfnProgress(progress,pszMessage,pProgressArg);
+    gsl_wavelet_free(w);
+    gsl_wavelet_workspace_free(work);
+  }
+  if(readFailed)
+    throw(readError);
+}
+
+//transform a single (padded) profile of size nsize (power of 2), using allocated wavelet and workspace
+//abscoeff and index are scratch buffers for dwt_cut
+void filter::Filter::dwt(double* data, int nsize, gsl_wavelet* w, gsl_wavelet_workspace* work, FILTER_TYPE method, double cut, int band, std::vector<double>& abscoeff, std::vector<size_t>& index) const{
+  switch(method){
+  case(filter::dwt):
+    gsl_wavelet_transform_forward(w,data,1,nsize,work);
+    break;
+  case(filter::dwti):
+    gsl_wavelet_transform_inverse(w,data,1,nsize,work);
+    break;
+  case(filter::dwt_cut):{
+    gsl_wavelet_transform_forward(w,data,1,nsize,work);
+    abscoeff.resize(nsize);
+    index.resize(nsize);
+    for(int i=0;i<nsize;++i)
+      abscoeff[i]=fabs(data[i]);
+    int nc=(100-cut)/100.0*nsize;
+    gsl_sort_index(&(index[0]),&(abscoeff[0]),1,nsize);
+    for(int i=0;(i+nc)<nsize;i++)
+      data[index[i]]=0;
+    gsl_wavelet_transform_inverse(w,data,1,nsize,work);
+    break;
+  }
+  case(filter::dwt_cut_from):
+    gsl_wavelet_transform_forward(w,data,1,nsize,work);
+    for(int i=band;i<nsize;++i)
+      data[i]=0;
+    gsl_wavelet_transform_inverse(w,data,1,nsize,work);
+    break;
+  default:
+    std::string errorString="method not supported";
+    throw(errorString);
+    break;
   }
 }
 
 //todo: support different padding strategies
 void filter::Filter::dwtForward(std::vector<double>& data, const std::string& wavelet_type, int family){
-  int origsize=data.size();
-  //make sure data size if power of 2
-  while(data.size()&(data.size()-1))
-    data.push_back(data.back());
-      
-  int nsize=data.size();
-  gsl_wavelet *w;
-  gsl_wavelet_workspace *work;
-  assert(nsize);
-  w=gsl_wavelet_alloc(getWaveletType(wavelet_type),family);
-  work=gsl_wavelet_workspace_alloc(nsize);
-  gsl_wavelet_transform_forward(w,&(data[0]),1,nsize,work);
-  data.erase(data.begin()+origsize,data.end());
-  gsl_wavelet_free (w);
-  gsl_wavelet_workspace_free (work);
+  dwt(data,wavelet_type,family,filter::dwt);
 }
 
 //todo: support different padding strategies
 void filter::Filter::dwtInverse(std::vector<double>& data, const std::string& wavelet_type, int family){
-  int origsize=data.size();
-  //make sure data size if power of 2
-  while(data.size()&(data.size()-1))
-    data.push_back(data.back());
-  int nsize=data.size();
-  gsl_wavelet *w;
-  gsl_wavelet_workspace *work;
-  assert(nsize);
-  w=gsl_wavelet_alloc(getWaveletType(wavelet_type),family);
-  work=gsl_wavelet_workspace_alloc(nsize);
-  gsl_wavelet_transform_inverse(w,&(data[0]),1,nsize,work);
-  data.erase(data.begin()+origsize,data.end());
-  gsl_wavelet_free (w);
-  gsl_wavelet_workspace_free (work);
+  dwt(data,wavelet_type,family,filter::dwti);
 }
 
 //todo: support different padding strategies
 void filter::Filter::dwtCut(std::vector<double>& data, const std::string& wavelet_type, int family, double cut){
+  dwt(data,wavelet_type,family,filter::dwt_cut,cut);
+}
+
+void filter::Filter::dwt(std::vector<double>& data, const std::string& wavelet_type, int family, FILTER_TYPE method, double cut, int band){
   int origsize=data.size();
   //make sure data size if power of 2
   while(data.size()&(data.size()-1))
     data.push_back(data.back());
   int nsize=data.size();
-  gsl_wavelet *w;
-  gsl_wavelet_workspace *work;
   assert(nsize);
-  w=gsl_wavelet_alloc(getWaveletType(wavelet_type),family);
-  work=gsl_wavelet_workspace_alloc(nsize);
-  gsl_wavelet_transform_forward(w,&(data[0]),1,nsize,work);
-  std::vector<double> abscoeff(data.size());
-  size_t* p=new size_t[data.size()];
-  for(int index=0;index<data.size();++index){
-    abscoeff[index]=fabs(data[index]);
-  }
-  int nc=(100-cut)/100.0*nsize;
-  gsl_sort_index(p,&(abscoeff[0]),1,nsize);
-  for(int i=0;(i+nc)<nsize;i++)
-    data[p[i]]=0;
-  gsl_wavelet_transform_inverse(w,&(data[0]),1,nsize,work);
+  gsl_wavelet* w=gsl_wavelet_alloc(getWaveletType(wavelet_type),family);
+  gsl_wavelet_workspace* work=gsl_wavelet_workspace_alloc(nsize);
+  std::vector<double> abscoeff;
+  std::vector<size_t> index;
+  dwt(&(data[0]),nsize,w,work,method,cut,band,abscoeff,index);
   data.erase(data.begin()+origsize,data.end());
-  delete[] p;
   gsl_wavelet_free (w);
   gsl_wavelet_workspace_free (work);
 }
@@ -395,11 +373,12 @@ void filter::Filter::stat(ImgRasterGdal& input, ImgRasterGdal& output, const std
     for(unsigned int iband=0;iband<input.nrOfBand();++iband)
       input.readData(lineInput[iband],y,iband);
     vector<double> pixelInput(input.nrOfBand());
+    vector<double> scratch;//reused by the order statistics
     for(unsigned int x=0;x<input.nrOfCol();++x){
       pixelInput=lineInput.selectCol(x);
       switch(getFilterType(method)){
       case(filter::median):
-	lineOutput[x]=stat.median(pixelInput);
+	lineOutput[x]=stat.median(pixelInput,scratch);
 	break;
       case(filter::min):
 	lineOutput[x]=stat.mymin(pixelInput);
@@ -421,7 +400,7 @@ void filter::Filter::stat(ImgRasterGdal& input, ImgRasterGdal& output, const std
 	break;
       case(filter::percentile):
 	assert(m_threshold.size());
-	lineOutput[x]=stat.percentile(pixelInput,pixelInput.begin(),pixelInput.end(),m_threshold[0]);
+	lineOutput[x]=stat.percentile(pixelInput,m_threshold[0],scratch);
 	break;
       default:
 	std::string errorString="method not supported";
@@ -446,59 +425,26 @@ void filter::Filter::stats(ImgRasterGdal& input, ImgRasterGdal& output, const ve
   Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
   assert(output.nrOfCol()==input.nrOfCol());
   Vector2d<double> lineOutput(methods.size(),output.nrOfCol());
-  statfactory::StatFactory stat;
-  stat.setNoDataValues(m_noDataValues);
+  vector<FILTER_TYPE> methodTypes(methods.size());
+  for(int imethod=0;imethod<methods.size();++imethod)
+    methodTypes[imethod]=getFilterType(methods[imethod]);
   const char* pszMessage;
   void* pProgressArg=NULL;
   GDALProgressFunc pfnProgress=GDALTermProgress;
   double progress=0;
   pfnProgress(progress,pszMessage,pProgressArg);
+  vector<double> pixelInput(input.nrOfBand());
+  vector<double> pixelOutput(methods.size());
+  vector<double> buffer;
   for(unsigned int y=0;y<input.nrOfRow();++y){
     for(unsigned int iband=0;iband<input.nrOfBand();++iband)
       input.readData(lineInput[iband],y,iband);
-    vector<double> pixelInput(input.nrOfBand());
     for(unsigned int x=0;x<input.nrOfCol();++x){
-      pixelInput=lineInput.selectCol(x);
-      int ithreshold=0;//threshold to use for percentiles
-      for(int imethod=0;imethod<methods.size();++imethod){
-	switch(getFilterType(methods[imethod])){
-	case(filter::nvalid):
-	  lineOutput[imethod][x]=stat.nvalid(pixelInput);
-	  break;
-	case(filter::median):
-	  lineOutput[imethod][x]=stat.median(pixelInput);
-	  break;
-	case(filter::min):
-	  lineOutput[imethod][x]=stat.mymin(pixelInput);
-	  break;
-	case(filter::max):
-	  lineOutput[imethod][x]=stat.mymax(pixelInput);
-	  break;
-	case(filter::sum):
-	  lineOutput[imethod][x]=stat.sum(pixelInput);
-	  break;
-	case(filter::var):
-	  lineOutput[imethod][x]=stat.var(pixelInput);
-	  break;
-	case(filter::stdev):
-	  lineOutput[imethod][x]=sqrt(stat.var(pixelInput));
-	  break;
-	case(filter::mean):
-	  lineOutput[imethod][x]=stat.mean(pixelInput);
-	  break;
-	case(filter::percentile):{
-	  assert(m_threshold.size());
-	  double threshold=(ithreshold<m_threshold.size())? m_threshold[ithreshold] : m_threshold[0];
-	  lineOutput[imethod][x]=stat.percentile(pixelInput,pixelInput.begin(),pixelInput.end(),threshold);
-	  ++ithreshold;
-	  break;
-	}
-	default:
-	  std::string errorString="method not supported";
-	  throw(errorString);
-	  break;
-	}
-      }
+      for(unsigned int iband=0;iband<input.nrOfBand();++iband)
+        pixelInput[iband]=lineInput[iband][x];
+      stats(pixelInput,methodTypes,pixelOutput,buffer);
+      for(int imethod=0;imethod<methods.size();++imethod)
+        lineOutput[imethod][x]=pixelOutput[imethod];
     }
     for(int imethod=0;imethod<methods.size();++imethod){
       try{
@@ -513,6 +459,138 @@ void filter::Filter::stats(ImgRasterGdal& input, ImgRasterGdal& output, const ve
   }
 }
 
+//evaluate all methods on a single profile (e.g., temporal or spectral profile of a pixel)
+//no data values are removed once into buffer (reused between calls), moments are obtained in a single (Welford) pass
+//and all order statistics (median and percentiles, using m_threshold in order) share one nth_element cascade
+void filter::Filter::stats(const vector<double>& input, const vector<FILTER_TYPE>& methods, vector<double>& output, vector<double>& buffer) const
+{
+  output.resize(methods.size());
+  buffer.clear();
+  double minValue=0;
+  double maxValue=0;
+  double sumValue=0;
+  double meanValue=0;
+  double m2=0;
+  for(int index=0;index<input.size();++index){
+    double value=input[index];
+    if(isNoData(value))
+      continue;
+    if(buffer.empty()){
+      minValue=value;
+      maxValue=value;
+    }
+    else if(value<minValue)
+      minValue=value;
+    else if(value>maxValue)
+      maxValue=value;
+    buffer.push_back(value);
+    sumValue+=value;
+    double delta=value-meanValue;
+    meanValue+=delta/buffer.size();
+    m2+=delta*(value-meanValue);
+  }
+  int nvalid=buffer.size();
+  //ranks needed for order statistics (interpolation as in gsl_stats_quantile_from_sorted_data)
+  vector<int> ranks;
+  int ithreshold=0;
+  for(int imethod=0;imethod<methods.size()&&nvalid;++imethod){
+    if(methods[imethod]==filter::median){
+      ranks.push_back((nvalid-1)/2);
+      ranks.push_back(nvalid/2);
+    }
+    else if(methods[imethod]==filter::percentile){
+      assert(m_threshold.size());
+      double threshold=(ithreshold<m_threshold.size())? m_threshold[ithreshold] : m_threshold[0];
+      ++ithreshold;
+      int lhs=static_cast<int>(threshold/100.0*(nvalid-1));
+      ranks.push_back(lhs);
+      if(lhs+1<nvalid)
+        ranks.push_back(lhs+1);
+    }
+  }
+  if(ranks.size()){
+    sort(ranks.begin(),ranks.end());
+    ranks.erase(unique(ranks.begin(),ranks.end()),ranks.end());
+    vector<double>::iterator first=buffer.begin();
+    for(int irank=0;irank<ranks.size();++irank){
+      nth_element(first,buffer.begin()+ranks[irank],buffer.end());
+      first=buffer.begin()+ranks[irank]+1;
+    }
+  }
+  ithreshold=0;
+  for(int imethod=0;imethod<methods.size();++imethod){
+    switch(methods[imethod]){
+    case(filter::first):
+      output[imethod]=input.front();
+      continue;
+    case(filter::last):
+      output[imethod]=input.back();
+      continue;
+    case(filter::nvalid):
+      output[imethod]=nvalid;
+      continue;
+    case(filter::median):
+    case(filter::min):
+    case(filter::max):
+    case(filter::sum):
+    case(filter::var):
+    case(filter::stdev):
+    case(filter::mean):
+    case(filter::percentile):
+      break;
+    default:
+      std::string errorString="method not supported";
+      throw(errorString);
+      break;
+    }
+    if(!nvalid){
+      if(m_noDataValues.size()){
+        output[imethod]=m_noDataValues[0];
+        continue;
+      }
+      std::string errorString="Error: no valid data found";
+      throw(errorString);
+    }
+    switch(methods[imethod]){
+    case(filter::median):
+      output[imethod]=(nvalid%2)? buffer[nvalid/2] : 0.5*(buffer[nvalid/2-1]+buffer[nvalid/2]);
+      break;
+    case(filter::min):
+      output[imethod]=minValue;
+      break;
+    case(filter::max):
+      output[imethod]=maxValue;
+      break;
+    case(filter::sum):
+      output[imethod]=sumValue;
+      break;
+    case(filter::var):
+      output[imethod]=m2/nvalid;
+      break;
+    case(filter::stdev):
+      output[imethod]=sqrt(m2/nvalid);
+      break;
+    case(filter::mean):
+      output[imethod]=meanValue;
+      break;
+    case(filter::percentile):{
+      double threshold=(ithreshold<m_threshold.size())? m_threshold[ithreshold] : m_threshold[0];
+      ++ithreshold;
+      double index=threshold/100.0*(nvalid-1);
+      int lhs=static_cast<int>(index);
+      double delta=index-lhs;
+      if(lhs==nvalid-1)
+        output[imethod]=buffer[lhs];
+      else
+        output[imethod]=(1-delta)*buffer[lhs]+delta*buffer[lhs+1];
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
 void filter::Filter::filter(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& method, int dim)
 {
   Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
@@ -743,6 +821,61 @@ double filter::Filter::getCentreWavelength(const std::vector<double> &wavelength
   return(centreWavelength);
 }
 
+//applySrf is linear in the input for all but akima interpolation: probe it once per input band
+//to obtain the weights, so the convolution can be applied to each pixel as a sparse product
+bool filter::Filter::getSrfMatrix(const std::vector<double> &wavelengthIn, const std::vector< Vector2d<double> >& srf, const std::string& interpolationType, ResampleMatrix& matrix, double delta, bool normalize, bool verbose)
+{
+  if(!statfactory::StatFactory::isLinearInterpolation(interpolationType))
+    return false;
+  unsigned int nbandIn=wavelengthIn.size();
+  matrix.index.assign(srf.size(),std::vector<unsigned int>());
+  matrix.weight.assign(srf.size(),std::vector<double>());
+  std::vector<double> unit(nbandIn,0);
+  for(unsigned int isrf=0;isrf<srf.size();++isrf){
+    for(unsigned int iband=0;iband<nbandIn;++iband){
+      double value=0;
+      unit[iband]=1;
+      applySrf<double>(wavelengthIn,unit,srf[isrf],interpolationType,value,delta,normalize);
+      unit[iband]=0;
+      if(value!=0){
+        matrix.index[isrf].push_back(iband);
+        matrix.weight[isrf].push_back(value);
+      }
+    }
+    if(verbose)
+      std::cout << "srf " << isrf << " depends on " << matrix.index[isrf].size() << " input bands" << std::endl;
+  }
+  return true;
+}
+
+bool filter::Filter::getFwhmMatrix(const std::vector<double> &wavelengthIn, const std::vector<double> &wavelengthOut, const std::vector<double> &fwhm, const std::string& interpolationType, ResampleMatrix& matrix, bool verbose)
+{
+  if(!statfactory::StatFactory::isLinearInterpolation(interpolationType))
+    return false;
+  unsigned int nbandIn=wavelengthIn.size();
+  unsigned int nbandOut=wavelengthOut.size();
+  matrix.index.assign(nbandOut,std::vector<unsigned int>());
+  matrix.weight.assign(nbandOut,std::vector<double>());
+  std::vector<double> unit(nbandIn,0);
+  std::vector<double> response;
+  for(unsigned int iband=0;iband<nbandIn;++iband){
+    unit[iband]=1;
+    applyFwhm<double>(wavelengthIn,unit,wavelengthOut,fwhm,interpolationType,response);
+    unit[iband]=0;
+    for(unsigned int indexOut=0;indexOut<nbandOut;++indexOut){
+      if(response[indexOut]!=0){
+        matrix.index[indexOut].push_back(iband);
+        matrix.weight[indexOut].push_back(response[indexOut]);
+      }
+    }
+  }
+  if(verbose){
+    for(unsigned int indexOut=0;indexOut<nbandOut;++indexOut)
+      std::cout << "output band " << indexOut << " depends on " << matrix.index[indexOut].size() << " input bands" << std::endl;
+  }
+  return true;
+}
+
 // void filter::Filter::applyFwhm(const vector<double> &wavelengthIn, const ImgRasterGdal& input, const vector<double> &wavelengthOut, const vector<double> &fwhm, const std::string& interpolationType, ImgRasterGdal& output, bool verbose){
 //   Vector2d<double> lineInput(input.nrOfBand(),input.nrOfCol());
 //   Vector2d<double> lineOutput(wavelengthOut.size(),input.nrOfCol());
@@ -36,6 +36,12 @@ namespace filter
 
   enum PADDING { symmetric=0, replicate=1, circular=2, zero=3};
 
+  //sparse spectral resampling matrix, one row per output band: output[i]=sum_k weight[i][k]*input[index[i][k]]
+  struct ResampleMatrix{
+    std::vector< std::vector<unsigned int> > index;
+    std::vector< std::vector<double> > weight;
+  };
+
   class Filter
   {
   public:
@@ -79,6 +85,7 @@ namespace filter
     void filter(ImgRasterGdal& input, ImgRasterGdal& output);
     void stat(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& method);
     void stats(ImgRasterGdal& input, ImgRasterGdal& output, const std::vector<std::string >& methods);
+    void stats(const std::vector<double>& input, const std::vector<FILTER_TYPE>& methods, std::vector<double>& output, std::vector<double>& buffer) const;
     void filter(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& method, int dim);
     void getSavGolayCoefficients(std::vector<double> &c, int np, int nl, int nr, int ld, int m);
     void ludcmp(std::vector<double> &a, std::vector<int> &indx, double &d);
@@ -92,6 +99,9 @@ namespace filter
 
     template<class T> void applyFwhm(const std::vector<double> &wavelengthIn, const std::vector<T>& input, const std::vector<double> &wavelengthOut, const std::vector<double> &fwhm, const std::string& interpolationType, std::vector<T>& output, bool verbose=false);
     template<class T> void applyFwhm(const std::vector<double> &wavelengthIn, const Vector2d<T>& input, const std::vector<double> &wavelengthOut, const std::vector<double> &fwhm, const std::string& interpolationType, Vector2d<T>& output, int down=1, bool verbose=false);
+    bool getSrfMatrix(const std::vector<double> &wavelengthIn, const std::vector< Vector2d<double> >& srf, const std::string& interpolationType, ResampleMatrix& matrix, double delta=1.0, bool normalize=false, bool verbose=false);
+    bool getFwhmMatrix(const std::vector<double> &wavelengthIn, const std::vector<double> &wavelengthOut, const std::vector<double> &fwhm, const std::string& interpolationType, ResampleMatrix& matrix, bool verbose=false);
+    template<class T> void resample(const ResampleMatrix& matrix, const Vector2d<T>& input, Vector2d<T>& output, int down=1) const;
     void dwtForward(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family);
     void dwtInverse(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family);
     void dwtCut(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family, double cut);
@@ -99,8 +109,14 @@ namespace filter
     void dwtInverse(std::vector<double>& data, const std::string& wavelet_type, int family);
     void dwtCut(std::vector<double>& data, const std::string& wavelet_type, int family, double cut);
     void dwtCutFrom(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family, int band);
+    void dwt(std::vector<double>& data, const std::string& wavelet_type, int family, FILTER_TYPE method, double cut=0, int band=0);
 
   private:
+    void dwt(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family, FILTER_TYPE method, double cut=0, int band=0);
+    void dwt(double* data, int nsize, gsl_wavelet* w, gsl_wavelet_workspace* work, FILTER_TYPE method, double cut, int band, std::vector<double>& abscoeff, std::vector<size_t>& index) const;
+    bool isNoData(double value) const{
+      return find(m_noDataValues.begin(),m_noDataValues.end(),value)!=m_noDataValues.end();
+    };
 
     static void initFilterMap(std::map<std::string, FILTER_TYPE>& m_filterMap){
       //initialize Map
@@ -283,6 +299,13 @@ namespace filter
       stat.getSpline(interpolationType,wavelength_fine.size(),splineOut);
       assert(splineOut);
 
+      //spline for the input values, allocated once for all samples
+      gsl_interp_accel *accIn;
+      stat.allocAcc(accIn);
+      gsl_spline *splineIn;
+      stat.getSpline(interpolationType,wavelengthIn.size(),splineIn);
+      assert(splineIn);
+
       std::vector<double> wavelengthOut;
       double centreWavelength=0;
       for(int isample=0;isample<nsample;++isample){
@@ -296,7 +319,7 @@ namespace filter
         assert(wavelengthIn.size()==inputValues.size());
         std::vector<double> input_fine;
         std::vector<double> product(wavelength_fine.size());
-        stat.interpolateUp(wavelengthIn,inputValues,wavelength_fine,interpolationType,input_fine,verbose);
+        stat.interpolateUp(wavelengthIn,inputValues,wavelength_fine,splineIn,accIn,input_fine);
 
         for(int iband=0;iband<input_fine.size();++iband){
           product[iband]=input_fine[iband]*srf_fine[iband];
@@ -317,6 +340,8 @@ namespace filter
         else
           centreWavelength=gsl_spline_eval_integ(splineOut,start,end,accOut)/norm;
       }
+      gsl_spline_free(splineIn);
+      gsl_interp_accel_free(accIn);
       gsl_spline_free(splineOut);
       gsl_interp_accel_free(accOut);
 
@@ -408,21 +433,48 @@ namespace filter
       }
     }
 
+    //spline for the input values, allocated once for all samples
+    gsl_interp_accel *acc;
+    stat.allocAcc(acc);
+    gsl_spline *spline;
+    stat.getSpline(interpolationType,wavelengthIn.size(),spline);
+    assert(spline);
+    std::vector<T> inputValues;
+    std::vector<double> input_fine;
     for(int isample=0;isample<input[0].size();++isample){
       if((isample+1+down/2)%down)
         continue;
-      std::vector<T> inputValues;
       input.selectCol(isample,inputValues);
       assert(wavelengthIn.size()==inputValues.size());
+      stat.interpolateUp(wavelengthIn,inputValues,wavelength_fine,spline,acc,input_fine);
       for(int indexOut=0;indexOut<nbandOut;++indexOut){
-        std::vector<double> input_fine;
-        stat.interpolateUp(wavelengthIn,inputValues,wavelength_fine,interpolationType,input_fine,verbose);
-        output[indexOut][(isample+down-1)/down]=0;
+        output[indexOut][isample/down]=0;
         for(int indexIn=0;indexIn<nbandIn;++indexIn){
-          output[indexOut][(isample+down-1)/down]+=input_fine[indexIn]*tf[indexIn][indexOut]/norm[indexOut];
+          output[indexOut][isample/down]+=input_fine[indexIn]*tf[indexIn][indexOut]/norm[indexOut];
         }
       }
     }
+    gsl_spline_free(spline);
+    gsl_interp_accel_free(acc);
+  }
+
+  //input[inBand][sample], output[outBand][sample]
+  template<class T> void Filter::resample(const ResampleMatrix& matrix, const Vector2d<T>& input, Vector2d<T>& output, int down) const{
+    int nsample=input[0].size();
+    int nbandOut=matrix.index.size();
+    output.resize(nbandOut,(nsample+down-1)/down);
+    for(int indexOut=0;indexOut<nbandOut;++indexOut){
+      const std::vector<unsigned int>& index=matrix.index[indexOut];
+      const std::vector<double>& weight=matrix.weight[indexOut];
+      for(int isample=0;isample<nsample;++isample){
+        if((isample+1+down/2)%down)
+          continue;
+        double value=0;
+        for(int k=0;k<index.size();++k)
+          value+=weight[k]*input[index[k]][isample];
+        output[indexOut][isample/down]=value;
+      }
+    }
   }
 
   template<class T> void Filter::smooth(const std::vector<T>& input, std::vector<T>& output, short dim)
@@ -523,8 +575,10 @@ namespace filter
       output.resize(input.size());
       int i=0;
       statfactory::StatFactory stat;
+      std::vector<unsigned char> mask;//reused by the nodata mask of the reductions
       stat.setNoDataValues(m_noDataValues);
       std::vector<T> statBuffer;
+      std::vector<double> scratch;//reused by the order statistics
       short binValue=0;
       //start: extend input by padding
       for(i=0;i<dim/2;++i){
@@ -593,34 +647,34 @@ namespace filter
           output[i]=statBuffer.back();
           break;
         case(filter::nvalid):
-          output[i]=stat.nvalid(statBuffer);
+          output[i]=stat.nvalid(statBuffer,mask);
           break;
         case(filter::median):
-          output[i]=stat.median(statBuffer);
+          output[i]=stat.median(statBuffer,scratch);
           break;
         case(filter::min):
         case(filter::erode):
-          output[i]=stat.mymin(statBuffer);
+          output[i]=stat.mymin(statBuffer,mask);
           break;
         case(filter::max):
         case(filter::dilate):
-          output[i]=stat.mymax(statBuffer);
+          output[i]=stat.mymax(statBuffer,mask);
           break;
         case(filter::sum):
-          output[i]=sqrt(stat.sum(statBuffer));
+          output[i]=sqrt(stat.sum(statBuffer,mask));
           break;
         case(filter::var):
-          output[i]=stat.var(statBuffer);
+          output[i]=stat.var(statBuffer,mask);
           break;
         case(filter::stdev):
-          output[i]=sqrt(stat.var(statBuffer));
+          output[i]=sqrt(stat.var(statBuffer,mask));
           break;
         case(filter::mean):
-          output[i]=stat.mean(statBuffer);
+          output[i]=stat.mean(statBuffer,mask);
           break;
         case(filter::percentile):
           assert(m_threshold.size());
-          output[i]=stat.percentile(statBuffer,statBuffer.begin(),statBuffer.end(),m_threshold[0]);
+          output[i]=stat.percentile(statBuffer,m_threshold[0],scratch);
           break;
         default:{
           std::ostringstream ess;
@@ -654,31 +708,31 @@ namespace filter
           output[i]=statBuffer.back();
           break;
         case(filter::nvalid):
-          output[i]=stat.nvalid(statBuffer);
+          output[i]=stat.nvalid(statBuffer,mask);
           break;
         case(filter::median):
-          output[i]=stat.median(statBuffer);
+          output[i]=stat.median(statBuffer,scratch);
           break;
         case(filter::min):
         case(filter::erode):
-          output[i]=stat.mymin(statBuffer);
+          output[i]=stat.mymin(statBuffer,mask);
           break;
         case(filter::max):
         case(filter::dilate):
-          output[i]=stat.mymax(statBuffer);
+          output[i]=stat.mymax(statBuffer,mask);
           break;
         case(filter::sum):
-          output[i]=sqrt(stat.sum(statBuffer));
+          output[i]=sqrt(stat.sum(statBuffer,mask));
           break;
         case(filter::var):
-          output[i]=stat.var(statBuffer);
+          output[i]=stat.var(statBuffer,mask);
           break;
         case(filter::mean):
-          output[i]=stat.mean(statBuffer);
+          output[i]=stat.mean(statBuffer,mask);
           break;
         case(filter::percentile):
           assert(m_threshold.size());
-          output[i]=stat.percentile(statBuffer,statBuffer.begin(),statBuffer.end(),m_threshold[0]);
+          output[i]=stat.percentile(statBuffer,m_threshold[0],scratch);
           break;
         default:
           std::string errorString="method not supported";
@@ -754,7 +808,7 @@ namespace filter
           output[i]=stat.nvalid(statBuffer);
           break;
         case(filter::median):
-          output[i]=stat.median(statBuffer);
+          output[i]=stat.median(statBuffer,scratch);
           break;
         case(filter::min):
         case(filter::erode):
@@ -775,7 +829,7 @@ namespace filter
           break;
         case(filter::percentile):
           assert(m_threshold.size());
-          output[i]=stat.percentile(statBuffer,statBuffer.begin(),statBuffer.end(),m_threshold[0]);
+          output[i]=stat.percentile(statBuffer,m_threshold[0],scratch);
           break;
         default:
           std::string errorString="method not supported";
@@ -87,6 +87,19 @@ void filter2d::Filter2d::filter(ImgRasterGdal& input, ImgRasterGdal& output, boo
 
   int dimX=m_taps[0].size();//horizontal!!!
   int dimY=m_taps.size();//vertical!!!
+  //large (odd sized) taps are convolved in the frequency domain if this is expected to be cheaper
+  if(dimX%2&&dimY%2&&dimX<=input.nrOfCol()&&dimY<=input.nrOfRow()){
+    int fftX=getFFTSize(dimX);
+    int fftY=getFFTSize(dimY);
+    double fftSize=fftX*fftY;
+    //two complex transforms and a complex product per tile, spread over the valid output pixels of that tile
+    double fftCost=(10.0*fftSize*log(fftSize)/log(2.0)+6.0*fftSize)/((fftX-dimX+1)*(fftY-dimY+1));
+    double directCost=2.0*dimX*dimY*(1+m_noDataValues.size());
+    if(fftCost<directCost){
+      filterFFT(input,output,absolute,normalize,noData);
+      return;
+    }
+  }
   //  byte* tmpbuf=new byte[input.rowSize()];
   const char* pszMessage;
   void* pProgressArg=NULL;
@@ -200,6 +213,189 @@ void filter2d::Filter2d::filter(ImgRasterGdal& input, ImgRasterGdal& output, boo
   }
 }
 
+//smallest power of two that is at least four times the dimension of the taps
+int filter2d::Filter2d::getFFTSize(int dim)
+{
+  int fftSize=16;
+  while(fftSize<4*dim)
+    fftSize*=2;
+  return(fftSize);
+}
+
+//in place 2D complex FFT of data (packed real/imaginary, row major), inverse is normalized
+void filter2d::Filter2d::fft2d(std::vector<double>& data, int ncol, int nrow, bool forward)
+{
+  assert(data.size()==2*ncol*nrow);
+  for(int irow=0;irow<nrow;++irow){
+    if(forward)
+      gsl_fft_complex_radix2_forward(&(data[2*irow*ncol]),1,ncol);
+    else
+      gsl_fft_complex_radix2_inverse(&(data[2*irow*ncol]),1,ncol);
+  }
+  for(int icol=0;icol<ncol;++icol){
+    if(forward)
+      gsl_fft_complex_radix2_forward(&(data[2*icol]),ncol,nrow);
+    else
+      gsl_fft_complex_radix2_inverse(&(data[2*icol]),ncol,nrow);
+  }
+}
+
+//spatial convolution of a single pixel, identical to filter (used for border pixels in filterFFT)
+double filter2d::Filter2d::filterPixel(const Vector2d<double>& inBuffer, int minRow, int x, int y, int nrow, int ncol, bool absolute, bool normalize) const
+{
+  int dimX=m_taps[0].size();
+  int dimY=m_taps.size();
+  double value=0;
+  double norm=0;
+  for(int j=-(dimY-1)/2;j<=dimY/2;++j){
+    for(int i=-(dimX-1)/2;i<=dimX/2;++i){
+      int indexI=x+i;
+      int indexJ=y+j;
+      //check if out of bounds
+      if(x<(dimX-1)/2)
+        indexI=x+abs(i);
+      else if(x>=ncol-(dimX-1)/2)
+        indexI=x-abs(i);
+      if(y<(dimY-1)/2)
+        indexJ=y+abs(j);
+      else if(y>=nrow-(dimY-1)/2)
+        indexJ=y-abs(j);
+      double inValue=inBuffer[indexJ-minRow][indexI];
+      //do not take masked values into account
+      if(!isNoData(inValue)){
+        value+=m_taps[(dimY-1)/2+j][(dimX-1)/2+i]*inValue;
+        norm+=m_taps[(dimY-1)/2+j][(dimX-1)/2+i];
+      }
+    }
+  }
+  if(absolute)
+    value=(normalize&&norm)? fabs(value)/norm : fabs(value);
+  else if(normalize&&norm!=0)
+    value=value/norm;
+  return(value);
+}
+
+//same result as filter, but convolution is performed in the frequency domain on tiles (overlap-save)
+//values are stored in the real part and the validity mask in the imaginary part, such that a single transform
+//provides both the filtered value and the normalization in case of no data values
+void filter2d::Filter2d::filterFFT(ImgRasterGdal& input, ImgRasterGdal& output, bool absolute, bool normalize, bool noData)
+{
+  int dimX=m_taps[0].size();//horizontal!!!
+  int dimY=m_taps.size();//vertical!!!
+  assert(dimX%2);
+  assert(dimY%2);
+  int ncol=input.nrOfCol();
+  int nrow=input.nrOfRow();
+  int fftX=getFFTSize(dimX);
+  int fftY=getFFTSize(dimY);
+  //number of valid output pixels per tile
+  int tileX=fftX-dimX+1;
+  int tileY=fftY-dimY+1;
+
+  //spectrum of the (flipped) taps
+  std::vector<double> kernel(2*fftX*fftY,0);
+  double tapSum=0;
+  double tapAbsSum=0;
+  for(int j=0;j<dimY;++j){
+    for(int i=0;i<dimX;++i){
+      kernel[2*(j*fftX+i)]=m_taps[dimY-1-j][dimX-1-i];
+      tapSum+=m_taps[j][i];
+      tapAbsSum+=fabs(m_taps[j][i]);
+    }
+  }
+  fft2d(kernel,fftX,fftY,true);
+
+  const char* pszMessage;
+  void* pProgressArg=NULL;
+  GDALProgressFunc pfnProgress=GDALTermProgress;
+  double progress=0;
+  pfnProgress(progress,pszMessage,pProgressArg);
+  std::vector<double> tile(2*fftX*fftY);
+  for(unsigned int iband=0;iband<input.nrOfBand();++iband){
+    for(int y0=0;y0<nrow;y0+=tileY){
+      int nrowOut=(y0+tileY<nrow)? tileY : nrow-y0;
+      int minRow=(y0-dimY/2>0)? y0-dimY/2 : 0;
+      int maxRow=(y0+nrowOut-1+dimY/2<nrow)? y0+nrowOut-1+dimY/2 : nrow-1;
+      Vector2d<double> inBuffer;
+      try{
+        input.readDataBlock(inBuffer,0,ncol-1,minRow,maxRow,iband);
+      }
+      catch(std::string errorstring){
+        std::cerr << errorstring << " in band " << iband << ", line " << y0 << std::endl;
+        exit(1);
+      }
+      Vector2d<double> outBuffer(nrowOut,ncol);
+      for(int x0=0;x0<ncol;x0+=tileX){
+        int ncolOut=(x0+tileX<ncol)? tileX : ncol-x0;
+        for(int p=0;p<fftY;++p){
+          int row=y0-dimY/2+p;
+          for(int q=0;q<fftX;++q){
+            int col=x0-dimX/2+q;
+            double value=0;
+            double valid=0;
+            if(row>=minRow&&row<=maxRow&&col>=0&&col<ncol){
+              value=inBuffer[row-minRow][col];
+              if(isNoData(value))
+                value=0;
+              else
+                valid=1;
+            }
+            tile[2*(p*fftX+q)]=value;
+            tile[2*(p*fftX+q)+1]=valid;
+          }
+        }
+        fft2d(tile,fftX,fftY,true);
+        for(int index=0;index<fftX*fftY;++index){
+          double re=tile[2*index]*kernel[2*index]-tile[2*index+1]*kernel[2*index+1];
+          double im=tile[2*index]*kernel[2*index+1]+tile[2*index+1]*kernel[2*index];
+          tile[2*index]=re;
+          tile[2*index+1]=im;
+        }
+        fft2d(tile,fftX,fftY,false);
+        for(int r=0;r<nrowOut;++r){
+          int y=y0+r;
+          for(int s=0;s<ncolOut;++s){
+            int x=x0+s;
+            double centre=inBuffer[y-minRow][x];
+            if(noData&&!isNoData(centre)){//only filter noData values
+              outBuffer[r][x]=centre;
+              continue;
+            }
+            if(x<dimX/2||x>=ncol-dimX/2||y<dimY/2||y>=nrow-dimY/2){
+              outBuffer[r][x]=filterPixel(inBuffer,minRow,x,y,nrow,ncol,absolute,normalize);
+              continue;
+            }
+            int index=2*((r+dimY-1)*fftX+s+dimX-1);
+            double value=tile[index];
+            double norm=(m_noDataValues.empty())? tapSum : tile[index+1];
+            //remove round off errors of the transform
+            if(fabs(norm)<1e-10*tapAbsSum)
+              norm=0;
+            if(absolute)
+              value=(normalize&&norm)? fabs(value)/norm : fabs(value);
+            else if(normalize&&norm!=0)
+              value=value/norm;
+            outBuffer[r][x]=value;
+          }
+        }
+      }
+      //write outBuffer to file
+      for(int r=0;r<nrowOut;++r){
+        try{
+          output.writeData(outBuffer[r],y0+r,iband);
+        }
+        catch(std::string errorstring){
+          std::cerr << errorstring << " in band " << iband << ", line " << y0+r << std::endl;
+          exit(1);
+        }
+      }
+      progress=(y0+nrowOut);
+      progress+=(output.nrOfRow()*iband);
+      progress/=output.nrOfBand()*output.nrOfRow();
+      pfnProgress(progress,pszMessage,pProgressArg);
+    }
+  }
+}
 
 void filter2d::Filter2d::majorVoting(ImgRasterGdal& input, ImgRasterGdal& output, int dim, const std::vector<int> &prior)
 {
@@ -372,6 +568,8 @@ void filter2d::Filter2d::doit(ImgRasterGdal& input, ImgRasterGdal& output, const
   assert(dimY);
 
   statfactory::StatFactory stat;
+  std::vector<unsigned char> mask;//reused by the nodata mask of the reductions
+  std::vector<double> scratch;//reused by the order statistics
   for(unsigned int iband=0;iband<input.nrOfBand();++iband){
     Vector2d<double> inBuffer(dimY,input.nrOfCol());
     std::vector<double> outBuffer((input.nrOfCol()+down-1)/down);
@@ -461,47 +659,47 @@ void filter2d::Filter2d::doit(ImgRasterGdal& input, ImgRasterGdal& output, const
         }
         switch(getFilterType(method)){
         case(filter2d::nvalid):
-	  outBuffer[x/down]=stat.nvalid(windowBuffer);
+	  outBuffer[x/down]=stat.nvalid(windowBuffer,mask);
           break;
         case(filter2d::median):
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=stat.median(windowBuffer);
+            outBuffer[x/down]=stat.median(windowBuffer,scratch);
           break;
         case(filter2d::var):{
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=stat.var(windowBuffer);
+            outBuffer[x/down]=stat.var(windowBuffer,mask);
           break;
         }
         case(filter2d::stdev):{
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=sqrt(stat.var(windowBuffer));
+            outBuffer[x/down]=sqrt(stat.var(windowBuffer,mask));
           break;
         }
         case(filter2d::mean):{
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=stat.mean(windowBuffer);
+            outBuffer[x/down]=stat.mean(windowBuffer,mask);
           break;
         }
         case(filter2d::min):{
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-           outBuffer[x/down]=stat.mymin(windowBuffer);
+           outBuffer[x/down]=stat.mymin(windowBuffer,mask);
           break;
         }
         case(filter2d::ismin):{
            if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=(stat.mymin(windowBuffer)==windowBuffer[centre])? 1:0;
+            outBuffer[x/down]=(stat.mymin(windowBuffer,mask)==windowBuffer[centre])? 1:0;
           break;
         }
         case(filter2d::minmax):{//is the same as homog?
@@ -510,7 +708,7 @@ void filter2d::Filter2d::doit(ImgRasterGdal& input, ImgRasterGdal& output, const
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else{
-            stat.minmax(windowBuffer,windowBuffer.begin(),windowBuffer.end(),min,max);
+            stat.minmax(windowBuffer,windowBuffer.begin(),windowBuffer.end(),min,max,mask);
             if(min!=max)
               outBuffer[x/down]=0;
             else
@@ -522,14 +720,14 @@ void filter2d::Filter2d::doit(ImgRasterGdal& input, ImgRasterGdal& output, const
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=stat.mymax(windowBuffer);
+            outBuffer[x/down]=stat.mymax(windowBuffer,mask);
           break;
         }
         case(filter2d::ismax):{
           if(windowBuffer.empty())
             outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
           else
-            outBuffer[x/down]=(stat.mymax(windowBuffer)==windowBuffer[centre])? 1:0;
+            outBuffer[x/down]=(stat.mymax(windowBuffer,mask)==windowBuffer[centre])? 1:0;
           break;
         }
         case(filter2d::order):{
@@ -538,27 +736,27 @@ void filter2d::Filter2d::doit(ImgRasterGdal& input, ImgRasterGdal& output, const
           else{
             double lbound=0;
             double ubound=dimX*dimY;
-            double theMin=stat.mymin(windowBuffer);
-            double theMax=stat.mymax(windowBuffer);
+            double theMin=stat.mymin(windowBuffer,mask);
+            double theMax=stat.mymax(windowBuffer,mask);
             double scale=(ubound-lbound)/(theMax-theMin);
             outBuffer[x/down]=static_cast<short>(scale*(windowBuffer[centre]-theMin)+lbound);
           }
           break;
         }
         case(filter2d::sum):{
-          outBuffer[x/down]=stat.sum(windowBuffer);
+          outBuffer[x/down]=stat.sum(windowBuffer,mask);
           break;
         }
 	case(filter2d::percentile):{
 	  assert(m_threshold.size());
-	  outBuffer[x/down]=stat.percentile(windowBuffer,windowBuffer.begin(),windowBuffer.end(),m_threshold[0]);
+	  outBuffer[x/down]=stat.percentile(windowBuffer,m_threshold[0],scratch);
 	  break;
 	}
         case(filter2d::proportion):{
 	  if(windowBuffer.size()){
-	    double sum=stat.sum(windowBuffer);
+	    double sum=stat.sum(windowBuffer,mask);
 	    if(sum)
-	      outBuffer[x/down]=100.0*windowBuffer[centre]/stat.sum(windowBuffer);
+	      outBuffer[x/down]=100.0*windowBuffer[centre]/stat.sum(windowBuffer,mask);
 	    else
 	      outBuffer[x/down]=(m_noDataValues.size())? m_noDataValues[0] : 0;
 	  }
@@ -707,17 +905,91 @@ void filter2d::Filter2d::doit(ImgRasterGdal& input, ImgRasterGdal& output, const
   pfnProgress(1.0,pszMessage,pProgressArg);
 }
 
-void filter2d::Filter2d::mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, double beta, bool eightConnectivity, short down, bool verbose){
+//fused four directional passes on tiles (tileSize x tileSize), extended with overlap pixels on each side
+//tiles of a strip are filtered in parallel, only the current strip is kept in memory
+//output: mask with 1 for surface and 0 for terrain, returns the number of terrain pixels
+unsigned long int filter2d::Filter2d::dsm2dtm(ImgRasterGdal& input, ImgRasterGdal& output, const std::vector<double>& hThreshold, const std::vector<int>& nlimit, int dim, int tileSize, int overlap)
+{
+  if(!output.isInit())
+    output.open(input);
+  output.setNoData(m_noDataValues);
+  assert(nlimit.size()>=hThreshold.size());
+  assert(tileSize>0);
+
+  const char* pszMessage;
+  void* pProgressArg=NULL;
+  GDALProgressFunc pfnProgress=GDALTermProgress;
+  double progress=0;
+  pfnProgress(progress,pszMessage,pProgressArg);
+
+  int nrow=input.nrOfRow();
+  int ncol=input.nrOfCol();
+  int ntile=(ncol+tileSize-1)/tileSize;
+  unsigned long int nchange=0;
+  for(int startRow=0;startRow<nrow;startRow+=tileSize){
+    int endRow=(startRow+tileSize<nrow)? startRow+tileSize-1 : nrow-1;
+    int minRow=(startRow-overlap>0)? startRow-overlap : 0;
+    int maxRow=(endRow+overlap<nrow)? endRow+overlap : nrow-1;
+    Vector2d<double> stripDSM;
+    try{
+      input.readDataBlock(stripDSM,0,ncol-1,minRow,maxRow,0);
+    }
+    catch(std::string errorstring){
+      std::cerr << errorstring << " in line " << minRow << std::endl;
+      exit(1);
+    }
+    Vector2d<double> stripMask(endRow-startRow+1,ncol);
+#pragma omp parallel for reduction(+:nchange)
+    for(int itile=0;itile<ntile;++itile){
+      int startCol=itile*tileSize;
+      int endCol=(startCol+tileSize<ncol)? startCol+tileSize-1 : ncol-1;
+      int minCol=(startCol-overlap>0)? startCol-overlap : 0;
+      int maxCol=(endCol+overlap<ncol)? endCol+overlap : ncol-1;
+      Vector2d<double> tileDSM(maxRow-minRow+1,maxCol-minCol+1);
+      for(int irow=0;irow<tileDSM.nRows();++irow)
+        for(int icol=0;icol<tileDSM.nCols();++icol)
+          tileDSM[irow][icol]=stripDSM[irow][minCol+icol];
+      Vector2d<double> tileMask(tileDSM.nRows(),tileDSM.nCols(),1);
+      for(unsigned int iheight=0;iheight<hThreshold.size();++iheight)
+        dsm2dtm(tileDSM,tileMask,hThreshold[iheight],nlimit[iheight],dim);
+      //count the terrain pixels of the tile without its overlap (each pixel once)
+      for(int irow=startRow;irow<=endRow;++irow){
+        for(int icol=startCol;icol<=endCol;++icol){
+          stripMask[irow-startRow][icol]=tileMask[irow-minRow][icol-minCol];
+          if(!stripMask[irow-startRow][icol])
+            ++nchange;
+        }
+      }
+    }
+    for(int irow=startRow;irow<=endRow;++irow){
+      try{
+        output.writeData(stripMask[irow-startRow],irow,0);
+      }
+      catch(std::string errorstring){
+        std::cerr << errorstring << " in line " << irow << std::endl;
+        exit(1);
+      }
+    }
+    progress=(1.0+endRow)/nrow;
+    pfnProgress(progress,pszMessage,pProgressArg);
+  }
+  return nchange;
+}
+
+void filter2d::Filter2d::mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, double beta, bool eightConnectivity, short down, bool verbose, unsigned short nIter, double minChange){
   assert(m_class.size()>1);
   Vector2d<double> fullBeta(m_class.size(),m_class.size());
   for(int iclass1=0;iclass1<m_class.size();++iclass1)
     for(int iclass2=0;iclass2<m_class.size();++iclass2)
       fullBeta[iclass1][iclass2]=beta;
-  mrf(input,output,dimX,dimY,fullBeta,eightConnectivity,down,verbose);
+  mrf(input,output,dimX,dimY,fullBeta,eightConnectivity,down,verbose,nIter,minChange);
 }
 
 //beta[classTo][classFrom]
-void filter2d::Filter2d::mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, Vector2d<double> beta, bool eightConnectivity, short down, bool verbose)
+//nIter: maximum number of iterated conditional modes (ICM) updates (0: no update)
+//minChange: stop updating when the proportion of changed pixels drops below this value (evaluated per strip)
+//The image is processed in strips of rows, extended with a halo of the rows that can influence the strip within nIter updates
+void filter2d::Filter2d::mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, Vector2d<double> beta, bool eightConnectivity, short down, bool verbose, unsigned short nIter, double minChange)
 {
   if(!output.isInit())
     output.open(input);
@@ -732,122 +1004,214 @@ void filter2d::Filter2d::mrf(ImgRasterGdal& input, ImgRasterGdal& output, int di
   assert(dimX);
   assert(dimY);
 
-  Vector2d<short> inBuffer(dimY,input.nrOfCol());
-  Vector2d<double> outBuffer(m_class.size(),(input.nrOfCol()+down-1)/down);
+  int ncol=input.nrOfCol();
+  int nrow=input.nrOfRow();
+  int nclass=m_class.size();
   assert(input.nrOfBand()==1);
   assert(output.nrOfBand()==m_class.size());
   assert(m_class.size()>1);
   assert(beta.size()==m_class.size());
-  int indexI=0;
-  int indexJ=0;
-  //initialize last half of inBuffer
+  for(int iclass=0;iclass<nclass;++iclass)
+    assert(beta[iclass].size()==m_class.size());
+
+  //neighbourhood (without centre pixel)
+  std::vector<int> offsetI;
+  std::vector<int> offsetJ;
   for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-    try{
-      input.readData(inBuffer[indexJ],static_cast<unsigned int>(abs(j)));
-    }
-    catch(std::string errorstring){
-      std::cerr << errorstring << "in line " << indexJ << std::endl;
+    for(int i=-(dimX-1)/2;i<=dimX/2;++i){
+      if(i!=0&&j!=0&&!eightConnectivity)
+        continue;
+      if(i==0&&j==0)
+        continue;
+      offsetI.push_back(i);
+      offsetJ.push_back(j);
     }
-    ++indexJ;
   }
-  for(unsigned int y=0;y<input.nrOfRow();++y){
-    if(y){//inBuffer already initialized for y=0
-      //erase first line from inBuffer
-      if(dimY>1)
-	inBuffer.erase(inBuffer.begin());
-      //read extra line and push back to inBuffer if not out of bounds
-      if(y+dimY/2<input.nrOfRow()){
-        //allocate buffer
-	if(dimY>1)
-	  inBuffer.push_back(inBuffer.back());
-        try{
-          input.readData(inBuffer[inBuffer.size()-1],y+dimY/2);
-        }
-        catch(std::string errorstring){
-          std::cerr << errorstring << "in line " << y << std::endl;
-        }
+  int nneighbour=offsetI.size();
+  int radiusX=dimX/2;
+  int radiusY=dimY/2;
+
+  //colouring of the pixels such that no two pixels of the same colour are neighbours: pixels of one colour are updated in parallel
+  //red/black checkerboard for 4-connectivity in a 3x3 window, else (radiusX+1)x(radiusY+1) colours
+  bool checkerboard=(!eightConnectivity&&dimX<=3&&dimY<=3);
+  int ncolour=checkerboard? 2 : (radiusX+1)*(radiusY+1);
+  int strideX=checkerboard? 2 : radiusX+1;
+
+  std::map<short,short> classIndex;
+  for(int iclass=0;iclass<nclass;++iclass)
+    classIndex[m_class[iclass]]=iclass;
+
+  int stripSize=1024;
+  //an update can change the neighbour counts radiusY rows away, for each colour in each iteration
+  int halo=nIter*ncolour*radiusY;
+  std::vector<short> lineBuffer(ncol);
+  std::vector<short> label;
+  std::vector<short> update;
+  std::vector<unsigned short> count;
+  Vector2d<double> outBuffer(nclass,(ncol+down-1)/down);
+  for(int startRow=0;startRow<nrow;startRow+=stripSize){
+    int endRow=(startRow+stripSize<nrow)? startRow+stripSize : nrow;
+    //rows that are updated (and have a neighbour count)
+    int countStart=(startRow-halo>0)? startRow-halo : 0;
+    int countEnd=(endRow+halo<nrow)? endRow+halo : nrow;
+    //rows that are read (neighbours of the updated rows)
+    int readStart=(countStart-radiusY>0)? countStart-radiusY : 0;
+    int readEnd=(countEnd+radiusY<nrow)? countEnd+radiusY : nrow;
+
+    //class index for each pixel (-1 for no data and values not in class list)
+    label.assign((readEnd-readStart)*ncol,-1);
+    for(int y=readStart;y<readEnd;++y){
+      try{
+        input.readData(lineBuffer,y);
       }
-      else{
-        int over=y+dimY/2-input.nrOfRow();
-        int index=(inBuffer.size()-1)-over;
-        assert(index>=0);
-        assert(index<inBuffer.size());
-        inBuffer.push_back(inBuffer[index]);
+      catch(std::string errorstring){
+        std::cerr << errorstring << "in line " << y << std::endl;
+      }
+      for(int x=0;x<ncol;++x){
+        if(isNoData(lineBuffer[x]))
+          continue;
+        std::map<short,short>::const_iterator mit=classIndex.find(lineBuffer[x]);
+        if(mit!=classIndex.end())
+          label[(y-readStart)*ncol+x]=mit->second;
       }
     }
-    if((y+1+down/2)%down)
-      continue;
-    for(unsigned int x=0;x<input.nrOfCol();++x){
-      if((x+1+down/2)%down)
-        continue;
-      std::vector<short> potential(m_class.size());
-      for(int iclass=0;iclass<m_class.size();++iclass){
-        potential[iclass]=0;
-        outBuffer[iclass][x/down]=0;
+
+    //neighbour count table: number of neighbours for each class and pixel
+    count.assign((countEnd-countStart)*ncol*nclass,0);
+#pragma omp parallel for
+    for(int y=countStart;y<countEnd;++y){
+      for(int x=0;x<ncol;++x){
+        unsigned short* pixelCount=&(count[((y-countStart)*ncol+x)*nclass]);
+        for(int ineighbour=0;ineighbour<nneighbour;++ineighbour){
+          int indexI=mirrorIndex(x+offsetI[ineighbour],ncol);
+          int indexJ=mirrorIndex(y+offsetJ[ineighbour],nrow);
+          short theLabel=label[(indexJ-readStart)*ncol+indexI];
+          if(theLabel>=0)
+            ++pixelCount[theLabel];
+        }
       }
-      std::vector<double> windowBuffer;
-      // int centre=dimX*(dimY-1)/2+(dimX-1)/2;
-      for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-        for(int i=-(dimX-1)/2;i<=dimX/2;++i){
-          if(i!=0&&j!=0&&!eightConnectivity)
-            continue;
-          if(i==0&&j==0)
+    }
+
+    //iterated conditional modes: pixels of the same colour are updated in parallel
+    update=label;
+    unsigned long nvalid=0;
+    for(int y=countStart;y<countEnd;++y)
+      for(int x=0;x<ncol;++x)
+        if(label[(y-readStart)*ncol+x]>=0)
+          ++nvalid;
+    for(unsigned short iter=0;iter<nIter;++iter){
+      unsigned long nchange=0;
+      for(int colour=0;colour<ncolour;++colour){
+#pragma omp parallel for
+        for(int y=countStart;y<countEnd;++y){
+          if(!checkerboard&&y%(radiusY+1)!=colour/(radiusX+1))
             continue;
-          indexI=x+i;
-          //check if out of bounds
-          if(indexI<0)
-            indexI=-indexI;
-          else if(indexI>=input.nrOfCol())
-            indexI=input.nrOfCol()-i;
-          if(y+j<0)
-            indexJ=-j;
-          else if(y+j>=input.nrOfRow())
-            indexJ=(dimY>2) ? (dimY-1)/2-j : 0;
-          else
-            indexJ=(dimY-1)/2+j;
-          bool masked=false;
-          for(int imask=0;imask<m_noDataValues.size();++imask){
-            if(inBuffer[indexJ][indexI]==m_noDataValues[imask]){
-              masked=true;
-              break;
+          int firstX=checkerboard? (y+colour)%2 : colour%(radiusX+1);
+          for(int x=firstX;x<ncol;x+=strideX){
+            int index=(y-readStart)*ncol+x;
+            if(label[index]<0)
+              continue;
+            const unsigned short* pixelCount=&(count[((y-countStart)*ncol+x)*nclass]);
+            //keep current class unless another class has a strictly lower potential
+            int minClass=label[index];
+            double minPot=0;
+            for(int iclass2=0;iclass2<nclass;++iclass2)
+              if(iclass2!=minClass)
+                minPot+=pixelCount[iclass2]*beta[minClass][iclass2];
+            for(int iclass1=0;iclass1<nclass;++iclass1){
+              if(iclass1==label[index])
+                continue;
+              double pot=0;
+              for(int iclass2=0;iclass2<nclass;++iclass2)
+                if(iclass2!=iclass1)
+                  pot+=pixelCount[iclass2]*beta[iclass1][iclass2];
+              if(pot<minPot){
+                minPot=pot;
+                minClass=iclass1;
+              }
             }
+            update[index]=minClass;
           }
-          if(!masked){
-            for(int iclass=0;iclass<m_class.size();++iclass){
-              if(inBuffer[indexJ][indexI]==m_class[iclass])
-                potential[iclass]+=1;
+        }
+        //commit changes and update neighbour counts of all pixels that have a changed pixel as neighbour
+        for(int y=countStart;y<countEnd;++y){
+          if(!checkerboard&&y%(radiusY+1)!=colour/(radiusX+1))
+            continue;
+          int firstX=checkerboard? (y+colour)%2 : colour%(radiusX+1);
+          for(int x=firstX;x<ncol;x+=strideX){
+            int index=(y-readStart)*ncol+x;
+            if(update[index]==label[index])
+              continue;
+            ++nchange;
+            for(int ineighbour=0;ineighbour<nneighbour;++ineighbour){
+              //candidate pixels referring to (x,y) via this offset, including mirrored references at the border
+              int candidateI[3]={x-offsetI[ineighbour],-x-offsetI[ineighbour],2*(ncol-1)-x-offsetI[ineighbour]};
+              int candidateJ[3]={y-offsetJ[ineighbour],-y-offsetJ[ineighbour],2*(nrow-1)-y-offsetJ[ineighbour]};
+              for(int ij=0;ij<3;++ij){
+                int indexJ=candidateJ[ij];
+                if(indexJ<countStart||indexJ>=countEnd||mirrorIndex(indexJ+offsetJ[ineighbour],nrow)!=y)
+                  continue;
+                if((ij>0&&indexJ==candidateJ[0])||(ij>1&&indexJ==candidateJ[1]))
+                  continue;
+                for(int ii=0;ii<3;++ii){
+                  int indexI=candidateI[ii];
+                  if(indexI<0||indexI>=ncol||mirrorIndex(indexI+offsetI[ineighbour],ncol)!=x)
+                    continue;
+                  if((ii>0&&indexI==candidateI[0])||(ii>1&&indexI==candidateI[1]))
+                    continue;
+                  unsigned short* pixelCount=&(count[((indexJ-countStart)*ncol+indexI)*nclass]);
+                  --pixelCount[label[index]];
+                  ++pixelCount[update[index]];
+                }
+              }
             }
+            label[index]=update[index];
           }
         }
       }
-      double norm=0;
-      for(int iclass1=0;iclass1<m_class.size();++iclass1){
-	assert(beta[iclass1].size()==m_class.size());
-        double pot=0;
-        for(int iclass2=0;iclass2<m_class.size();++iclass2)
-	  if(iclass2!=iclass1)
-	    pot+=potential[iclass2]*beta[iclass1][iclass2];
-        double prior=exp(-pot);
-        outBuffer[iclass1][x/down]=prior;
-        norm+=prior;
-      }
-      if(norm){
-        for(int iclass1=0;iclass1<m_class.size();++iclass1)
-          outBuffer[iclass1][x/down]/=norm;
-      }
+      if(verbose)
+        std::cout << "rows " << startRow << "-" << endRow-1 << ", iteration " << iter << ": " << nchange << " pixels changed" << std::endl;
+      if(!nvalid||nchange<=minChange*nvalid)
+        break;
     }
-    progress=(1.0+y/down)/output.nrOfRow();
-    pfnProgress(progress,pszMessage,pProgressArg);
-    //write outBuffer to file
-    assert(outBuffer.size()==m_class.size());
-    assert(y<output.nrOfRow());
-    for(int iclass=0;iclass<m_class.size();++iclass){
-      assert(outBuffer[iclass].size()==output.nrOfCol());
-      try{
-        output.writeData(outBuffer[iclass],y/down,iclass);
+
+    //prior probabilities for each class
+    for(int y=startRow;y<endRow;++y){
+      if((y+1+down/2)%down)
+        continue;
+#pragma omp parallel for
+      for(int x=0;x<ncol;++x){
+        if((x+1+down/2)%down)
+          continue;
+        const unsigned short* pixelCount=&(count[((y-countStart)*ncol+x)*nclass]);
+        double norm=0;
+        for(int iclass1=0;iclass1<nclass;++iclass1){
+          double pot=0;
+          for(int iclass2=0;iclass2<nclass;++iclass2)
+            if(iclass2!=iclass1)
+              pot+=pixelCount[iclass2]*beta[iclass1][iclass2];
+          double prior=exp(-pot);
+          outBuffer[iclass1][x/down]=prior;
+          norm+=prior;
+        }
+        if(norm){
+          for(int iclass1=0;iclass1<nclass;++iclass1)
+            outBuffer[iclass1][x/down]/=norm;
+        }
       }
-      catch(std::string errorstring){
-        std::cerr << errorstring << "in class " << iclass << ", line " << y << std::endl;
+      progress=(1.0+y/down)/output.nrOfRow();
+      pfnProgress(progress,pszMessage,pProgressArg);
+      //write outBuffer to file
+      assert(outBuffer.size()==m_class.size());
+      assert(y/down<output.nrOfRow());
+      for(int iclass=0;iclass<nclass;++iclass){
+        assert(outBuffer[iclass].size()==output.nrOfCol());
+        try{
+          output.writeData(outBuffer[iclass],y/down,iclass);
+        }
+        catch(std::string errorstring){
+          std::cerr << errorstring << "in class " << iclass << ", line " << y << std::endl;
+        }
       }
     }
   }
@@ -1001,6 +1365,7 @@ void filter2d::Filter2d::morphology(ImgRasterGdal& input, ImgRasterGdal& output,
   assert(dimY);
 
   statfactory::StatFactory stat;
+  std::vector<unsigned char> mask;//reused by the nodata mask of the reductions
   for(unsigned int iband=0;iband<input.nrOfBand();++iband){
     Vector2d<double> inBuffer(dimY,input.nrOfCol());
     std::vector<double> outBuffer(input.nrOfCol());
@@ -1137,10 +1502,10 @@ void filter2d::Filter2d::morphology(ImgRasterGdal& input, ImgRasterGdal& output,
 	  if(statBuffer.size()){
             switch(getFilterType(method)){
             case(filter2d::dilate):
-              outBuffer[x]=stat.mymax(statBuffer);
+              outBuffer[x]=stat.mymax(statBuffer,mask);
               break;
             case(filter2d::erode):
-              outBuffer[x]=stat.mymin(statBuffer);
+              outBuffer[x]=stat.mymin(statBuffer,mask);
               break;
             default:
               std::ostringstream ess;
@@ -1168,17 +1533,37 @@ void filter2d::Filter2d::morphology(ImgRasterGdal& input, ImgRasterGdal& output,
   }
 }
 
-//todo: perform on ImgRasterGdal directly instead of copying into Vector2d
+//process in strips of rows, extended towards the sun with the maximum shadow length
 void filter2d::Filter2d::shadowDsm(ImgRasterGdal& input, ImgRasterGdal& output, double sza, double saa, double pixelSize, short shadowFlag){
   if(!output.isInit())
     output.open(input);
   output.setNoData(m_noDataValues);
 
+  int nrow=input.nrOfRow();
+  int ncol=input.nrOfCol();
+  double minValue=0;
+  double maxValue=0;
+  input.getMinMax(minValue,maxValue,0);
+  //maximum shadow length in rows
+  double dirY=sin(DEG2RAD(saa)+PI/2.0);
+  int halo=static_cast<int>(ceil((maxValue-minValue)*tan(DEG2RAD(sza))/pixelSize*fabs(dirY)))+1;
+  int stripSize=1024;
   Vector2d<float> inputBuffer;
   Vector2d<float> outputBuffer;
-  input.readDataBlock(inputBuffer,  0, input.nrOfCol()-1, 0, input.nrOfRow()-1, 0);
-  shadowDsm(inputBuffer, outputBuffer, sza, saa, pixelSize, shadowFlag);
-  output.writeDataBlock(outputBuffer,0,output.nrOfCol()-1,0,output.nrOfRow()-1,0);
+  for(int startRow=0;startRow<nrow;startRow+=stripSize){
+    int endRow=(startRow+stripSize<nrow)? startRow+stripSize-1 : nrow-1;
+    int minRow=startRow;
+    int maxRow=endRow;
+    //shadows are cast in direction of dirY (image rows increase southwards)
+    if(dirY>0)
+      minRow=(startRow-halo>0)? startRow-halo : 0;
+    else if(dirY<0)
+      maxRow=(endRow+halo<nrow)? endRow+halo : nrow-1;
+    input.readDataBlock(inputBuffer, 0, ncol-1, minRow, maxRow, 0);
+    shadowDsm(inputBuffer, outputBuffer, sza, saa, pixelSize, shadowFlag);
+    for(int irow=startRow;irow<=endRow;++irow)
+      output.writeData(outputBuffer[irow-minRow],irow,0);
+  }
 }
 
 void filter2d::Filter2d::dwtForward(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& wavelet_type, int family){
@@ -1255,104 +1640,93 @@ void filter2d::Filter2d::linearFeature(const Vector2d<float>& input, std::vector
     output[iband].resize(input.nRows(),input.nCols());
   if(maxDistance<=0)
     maxDistance=sqrt(static_cast<float>(input.nRows()*input.nCols()));
-  int indexI=0;
-  int indexJ=0;
   const char* pszMessage;
   void* pProgressArg=NULL;
   GDALProgressFunc pfnProgress=GDALTermProgress;
   double progress=0;
   pfnProgress(progress,pszMessage,pProgressArg);
-  for(unsigned int y=0;y<input.nRows();++y){
-    for(unsigned int x=0;x<input.nCols();++x){
+  //precompute integer ray offsets for each angle and side (offsetI[iangle][side][ray-1])
+  std::vector<float> northAngles;
+  for(float northAngle=0;northAngle<180;northAngle+=angleStep){
+    if(angle<=360&&angle>=0&&angle!=northAngle)
+      continue;
+    northAngles.push_back(northAngle);
+  }
+  int nray=0;
+  for(float currentRay=1;currentRay<maxDistance;++currentRay)
+    ++nray;
+  std::vector< Vector2d<int> > offsetI(northAngles.size());
+  std::vector< Vector2d<int> > offsetJ(northAngles.size());
+  for(int iangle=0;iangle<northAngles.size();++iangle){
+    offsetI[iangle].resize(2,nray);
+    offsetJ[iangle].resize(2,nray);
+    for(short side=0;side<=1;side+=1){
+      double theDir=PI/2.0-DEG2RAD(static_cast<double>(northAngles[iangle]))+side*PI;//in radians
+      if(theDir<0)
+        theDir+=2*PI;
+      if(verbose)
+        std::cout << "northAngle: " << northAngles[iangle] << ", theDir in deg: " << RAD2DEG(theDir) << std::endl;
+      //round to the nearest pixel, such that rounding errors in cos and sin (e.g., cos(PI/2)) do not shift the ray
+      for(int iray=0;iray<nray;++iray){
+        offsetI[iangle][side][iray]=static_cast<int>(lround((iray+1)*cos(theDir)));
+        offsetJ[iangle][side][iray]=static_cast<int>(lround(-(iray+1)*sin(theDir)));
+      }
+    }
+  }
+  int nrow=input.nRows();
+  int ncol=input.nCols();
+#pragma omp parallel for if(!verbose)
+  for(int y=0;y<nrow;++y){
+    for(int x=0;x<ncol;++x){
       float currentValue=input[y][x];
       //find values equal to current value with some error margin
-      //todo: add distance for two opposite directions
       float lineDistance1=0;//longest line of object
       float lineDistance2=maxDistance;//shortest line of object
       float lineAngle1=0;//angle to longest line (North=0)
       float lineAngle2=0;//angle to shortest line (North=0)
-      float northAngle=0;//rotating angle
-      for(northAngle=0;northAngle<180;northAngle+=angleStep){
-	if(angle<=360&&angle>=0&&angle!=northAngle)
-	  continue;
-	//test
-	if(verbose)
-	  std::cout << "northAngle: " << northAngle << std::endl;
-	float currentDistance=0;
-	float theDir=0;
-	for(short side=0;side<=1;side+=1){
-	  theDir=PI/2.0-DEG2RAD(northAngle)+side*PI;//in radians
-	  //test
-	  if(verbose)
-	    std::cout << "theDir in deg: " << RAD2DEG(theDir) << std::endl;
-	  if(theDir<0)
-	    theDir+=2*PI;
-	  //test
-	  if(verbose)
-	    std::cout << "theDir in deg: " << RAD2DEG(theDir) << std::endl;
-	  float nextValue=currentValue;
-	  for(float currentRay=1;currentRay<maxDistance;++currentRay){
-	    indexI=x+currentRay*cos(theDir);
-	    indexJ=y-currentRay*sin(theDir);
-	    if(indexJ<0||indexJ>=input.size())
-	      break;
-	    if(indexI<0||indexI>=input[indexJ].size())
-	      break;
-	    nextValue=input[indexJ][indexI];
-	    if(verbose){
-	      std::cout << "x: " << x << std::endl;
-	      std::cout << "y: " << y << std::endl;
-	      std::cout << "currentValue: " << currentValue << std::endl;
-	      std::cout << "theDir in degrees: " << RAD2DEG(theDir) << std::endl;
-	      std::cout << "cos(theDir): " << cos(theDir) << std::endl;
-	      std::cout << "sin(theDir): " << sin(theDir) << std::endl;
-	      std::cout << "currentRay: " << currentRay << std::endl;
-	      std::cout << "currentDistance: " << currentDistance << std::endl;
-	      std::cout << "indexI: " << indexI << std::endl;
-	      std::cout << "indexJ: " << indexJ << std::endl;
-	      std::cout << "nextValue: " << nextValue << std::endl;
-	    }
-	    if(fabs(currentValue-nextValue)<=eps){
-	      ++currentDistance;
-	      //test
-	      if(verbose)
-		std::cout << "currentDistance: " << currentDistance << ", continue" << std::endl;
-	    }
-	    else{
-	      if(verbose)
-		std::cout << "currentDistance: " << currentDistance << ", break" << std::endl;
-	      break;
-	    }
-	  }
-	}
-	if(lineDistance1<currentDistance){
-	  lineDistance1=currentDistance;
-	  lineAngle1=northAngle;
-	}
-	if(lineDistance2>currentDistance){
-	  lineDistance2=currentDistance;
-	  lineAngle2=northAngle;
-	}
-	if(verbose){
-	  std::cout << "lineDistance1: " << lineDistance1 << std::endl;
-	  std::cout << "lineAngle1: " << lineAngle1 << std::endl;
-	  std::cout << "lineDistance2: " << lineDistance2 << std::endl;
-	  std::cout << "lineAngle2: " << lineAngle2 << std::endl;
-	}
+      for(int iangle=0;iangle<northAngles.size();++iangle){
+        float currentDistance=0;
+        for(short side=0;side<=1;side+=1){
+          const std::vector<int>& rayI=offsetI[iangle][side];
+          const std::vector<int>& rayJ=offsetJ[iangle][side];
+          for(int iray=0;iray<nray;++iray){
+            int indexI=x+rayI[iray];
+            int indexJ=y+rayJ[iray];
+            if(indexJ<0||indexJ>=nrow||indexI<0||indexI>=ncol)
+              break;
+            //stop as soon as the value changes
+            if(fabs(currentValue-input[indexJ][indexI])>eps)
+              break;
+            ++currentDistance;
+          }
+        }
+        if(lineDistance1<currentDistance){
+          lineDistance1=currentDistance;
+          lineAngle1=northAngles[iangle];
+        }
+        if(lineDistance2>currentDistance){
+          lineDistance2=currentDistance;
+          lineAngle2=northAngles[iangle];
+        }
+      }
+      if(verbose){
+        std::cout << "x: " << x << ", y: " << y << std::endl;
+        std::cout << "lineDistance1: " << lineDistance1 << std::endl;
+        std::cout << "lineAngle1: " << lineAngle1 << std::endl;
+        std::cout << "lineDistance2: " << lineDistance2 << std::endl;
+        std::cout << "lineAngle2: " << lineAngle2 << std::endl;
       }
       int iband=0;
       if(l1)
-	output[iband++][y][x]=lineDistance1;
+        output[iband++][y][x]=lineDistance1;
       if(a1)
-	output[iband++][y][x]=lineAngle1;
+        output[iband++][y][x]=lineAngle1;
       if(l2)
-	output[iband++][y][x]=lineDistance2;
+        output[iband++][y][x]=lineDistance2;
       if(a2)
-	output[iband++][y][x]=lineAngle2;
+        output[iband++][y][x]=lineAngle2;
       assert(iband==nband);
     }
-    progress=(1.0+y);
-    progress/=input.nRows();
-    pfnProgress(progress,pszMessage,pProgressArg);
   }
+  pfnProgress(1.0,pszMessage,pProgressArg);
 }
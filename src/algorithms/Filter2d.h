@@ -49,6 +49,7 @@ extern "C" {
 #include <gsl/gsl_wavelet2d.h>
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
+#include <gsl/gsl_fft_complex.h>
 }
 #include "base/Vector2d.h"
 #include "Filter.h"
@@ -107,8 +108,8 @@ public:
   /* void homogeneousSpatial(const std::string& inputFilename, const std::string& outputFilename, int dim, bool disc=false, int noValue=0); */
   void doit(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& method, int dim, short down=1, bool disc=false);
   void doit(ImgRasterGdal& input, ImgRasterGdal& output, const std::string& method, int dimX, int dimY, short down=1, bool disc=false);
-  void mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, double beta, bool eightConnectivity=true, short down=1, bool verbose=false);
-  void mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, Vector2d<double> beta, bool eightConnectivity=true, short down=1, bool verbose=false);
+  void mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, double beta, bool eightConnectivity=true, short down=1, bool verbose=false, unsigned short nIter=0, double minChange=0);
+  void mrf(ImgRasterGdal& input, ImgRasterGdal& output, int dimX, int dimY, Vector2d<double> beta, bool eightConnectivity=true, short down=1, bool verbose=false, unsigned short nIter=0, double minChange=0);
   template<class T1, class T2> void doit(const Vector2d<T1>& inputVector, Vector2d<T2>& outputVector, const std::string& method, int dimX, int dimY, short down=1, bool disc=false);
   void median(ImgRasterGdal& input, ImgRasterGdal& output, int dim, bool disc=false);
   void var(ImgRasterGdal& input, ImgRasterGdal& output, int dim, bool disc=false);
@@ -118,6 +119,8 @@ public:
   template<class T> unsigned long int dsm2dtm_nesw(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim=3);
   template<class T> unsigned long int dsm2dtm_senw(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim=3);
   template<class T> unsigned long int dsm2dtm_swne(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim=3);
+  template<class T> unsigned long int dsm2dtm(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim=3);
+  unsigned long int dsm2dtm(ImgRasterGdal& input, ImgRasterGdal& output, const std::vector<double>& hThreshold, const std::vector<int>& nlimit, int dim=3, int tileSize=1024, int overlap=64);
   template<class T> void shadowDsm(const Vector2d<T>& input, Vector2d<T>& output, double sza, double saa, double pixelSize, short shadowFlag=1);
   void shadowDsm(ImgRasterGdal& input, ImgRasterGdal& output, double sza, double saa, double pixelSize, short shadowFlag=1);
   //  void dwt_texture(ImgRasterGdal& input, ImgRasterGdal& output, int dim, int scale, int down=1, int iband=0, bool verbose=false);
@@ -172,6 +175,28 @@ private:
     m_filterMap["proportion"]=filter2d::proportion;
   }
 
+  //convolution with user defined taps in the frequency domain (overlap-save)
+  void filterFFT(ImgRasterGdal& input, ImgRasterGdal& output, bool absolute, bool normalize, bool noData);
+  double filterPixel(const Vector2d<double>& inBuffer, int minRow, int x, int y, int nrow, int ncol, bool absolute, bool normalize) const;
+  template<class T> unsigned long int dsm2dtmPass(Vector2d<T>& tmpDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim, bool reverseX, bool reverseY);
+  static int getFFTSize(int dim);
+  //mirror index at the image border
+  static int mirrorIndex(int index, int size){
+    if(index<0)
+      index=-index;
+    else if(index>=size)
+      index=2*(size-1)-index;
+    if(index<0)
+      return(0);
+    else if(index>=size)
+      return(size-1);
+    return(index);
+  };
+  static void fft2d(std::vector<double>& data, int ncol, int nrow, bool forward);
+  bool isNoData(double value) const{
+    return find(m_noDataValues.begin(),m_noDataValues.end(),value)!=m_noDataValues.end();
+  };
+
   Vector2d<double> m_taps;
   /* double m_noValue; */
   std::vector<short> m_class;
@@ -263,6 +288,8 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
   pfnProgress(progress,pszMessage,pProgressArg);
 
   statfactory::StatFactory stat;
+  std::vector<unsigned char> mask;//reused by the nodata mask of the reductions
+  std::vector<double> scratch;//reused by the order statistics
   double noDataValue=0;
   if(m_noDataValues.size()){
     stat.setNoDataValues(m_noDataValues);
@@ -339,17 +366,17 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
       }
       switch(getFilterType(method)){
       case(filter2d::nvalid):
-	outBuffer[x/down]=stat.nvalid(windowBuffer);
+	outBuffer[x/down]=stat.nvalid(windowBuffer,mask);
         break;
       case(filter2d::median):
-        outBuffer[x/down]=stat.median(windowBuffer);
+        outBuffer[x/down]=stat.median(windowBuffer,scratch);
         break;
       case(filter2d::var):{
-        outBuffer[x/down]=stat.var(windowBuffer);
+        outBuffer[x/down]=stat.var(windowBuffer,mask);
         break;
       }
       case(filter2d::stdev):{
-        T2 varValue=stat.var(windowBuffer);
+        T2 varValue=stat.var(windowBuffer,mask);
         if(stat.isNoData(varValue))
           outBuffer[x/down]=noDataValue;
         else          
@@ -360,15 +387,15 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
         if(windowBuffer.empty())
           outBuffer[x/down]=noDataValue;
         else
-          outBuffer[x/down]=stat.mean(windowBuffer);
+          outBuffer[x/down]=stat.mean(windowBuffer,mask);
         break;
       }
       case(filter2d::min):{
-        outBuffer[x/down]=stat.mymin(windowBuffer);
+        outBuffer[x/down]=stat.mymin(windowBuffer,mask);
         break;
       }
       case(filter2d::ismin):{
-        T1 minValue=stat.mymin(windowBuffer);
+        T1 minValue=stat.mymin(windowBuffer,mask);
         if(stat.isNoData(minValue))
           outBuffer[x/down]=noDataValue;
         else
@@ -378,7 +405,7 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
       case(filter2d::minmax):{
         T1 min=0;
         T1 max=0;
-        stat.minmax(windowBuffer,windowBuffer.begin(),windowBuffer.end(),min,max);
+        stat.minmax(windowBuffer,windowBuffer.begin(),windowBuffer.end(),min,max,mask);
         if(min!=max)
           outBuffer[x/down]=0;
         else
@@ -386,11 +413,11 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
         break;
       }
       case(filter2d::max):{
-        outBuffer[x/down]=stat.mymax(windowBuffer);
+        outBuffer[x/down]=stat.mymax(windowBuffer,mask);
         break;
       }
       case(filter2d::ismax):{
-        T1 maxValue=stat.mymax(windowBuffer);
+        T1 maxValue=stat.mymax(windowBuffer,mask);
         if(stat.isNoData(maxValue))
           outBuffer[x/down]=noDataValue;
         else
@@ -398,31 +425,31 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
         break;
       }
       case(filter2d::order):{
-        stat.eraseNoData(windowBuffer);
+        stat.eraseNoData(windowBuffer,mask);
         if(windowBuffer.empty())
           outBuffer[x/down]=noDataValue;
         else{
           double lbound=0;
           double ubound=dimX*dimY;
-          double theMin=stat.mymin(windowBuffer);
-          double theMax=stat.mymax(windowBuffer);
+          double theMin=stat.mymin(windowBuffer,mask);
+          double theMax=stat.mymax(windowBuffer,mask);
           double scale=(ubound-lbound)/(theMax-theMin);
           outBuffer[x/down]=static_cast<short>(scale*(windowBuffer[centre]-theMin)+lbound);
         }
         break;
       }
       case(filter2d::sum):{
-        outBuffer[x/down]=stat.sum(windowBuffer);
+        outBuffer[x/down]=stat.sum(windowBuffer,mask);
         break;
       }
       case(filter2d::percentile):{
 	assert(m_threshold.size());
-        outBuffer[x/down]=stat.percentile(windowBuffer,windowBuffer.begin(),windowBuffer.end(),m_threshold[0]);
+        outBuffer[x/down]=stat.percentile(windowBuffer,m_threshold[0],scratch);
         break;
       }
       case(filter2d::proportion):{
-        stat.eraseNoData(windowBuffer);
-	T2 sum=stat.sum(windowBuffer);
+        stat.eraseNoData(windowBuffer,mask);
+	T2 sum=stat.sum(windowBuffer,mask);
 	if(sum)
 	  outBuffer[x/down]=windowBuffer[centre]/sum;
 	else
@@ -432,7 +459,7 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
       case(filter2d::homog):{
         T1 centreValue=inBuffer[(dimY-1)/2][x];
         bool isHomog=true;
-        stat.eraseNoData(windowBuffer);
+        stat.eraseNoData(windowBuffer,mask);
         typename std::vector<T1>::const_iterator wit;
         for(wit=windowBuffer.begin();wit!=windowBuffer.end();++wit){
           if(*wit==centreValue)
@@ -451,7 +478,7 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
       case(filter2d::heterog):{
         T1 centreValue=inBuffer[(dimY-1)/2][x];
         bool isHeterog=true;
-        stat.eraseNoData(windowBuffer);
+        stat.eraseNoData(windowBuffer,mask);
         typename std::vector<T1>::const_iterator wit;
         for(wit=windowBuffer.begin();wit!=windowBuffer.end();++wit){
           if(*wit!=centreValue)
@@ -477,7 +504,7 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
             invalid=true;
             throw(invalid);
           }
-          stat.meanVar(windowBuffer,theMean,theStdev);
+          stat.meanVar(windowBuffer,theMean,theStdev,mask);
           theStdev=sqrt(theStdev);
           double kValue=0.5;
           double rValue=128;
@@ -497,7 +524,7 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
         break;
       }
       case(filter2d::density):{
-        int nvalid=stat.nvalid(windowBuffer);
+        int nvalid=stat.nvalid(windowBuffer,mask);
         if(nvalid){
           std::vector<short>::const_iterator vit=m_class.begin();
           while(vit!=m_class.end())
@@ -532,7 +559,7 @@ template<class T1, class T2> void Filter2d::doit(const Vector2d<T1>& inputVector
       }
       case(filter2d::threshold):{
         assert(m_class.size()==m_threshold.size());
-        int nvalid=stat.nvalid(windowBuffer);
+        int nvalid=stat.nvalid(windowBuffer,mask);
         if(nvalid>0){
           outBuffer[x/down]=inBuffer[(dimY-1)/2][x];//initialize with original value (in case thresholds not met)
           for(int iclass=0;iclass<m_class.size();++iclass){
@@ -703,6 +730,7 @@ template<class T> unsigned long int Filter2d::morphology(const Vector2d<T>& inpu
   assert(dimX);
   assert(dimY);
   statfactory::StatFactory stat;
+  std::vector<unsigned char> mask;//reused by the nodata mask of the reductions
   Vector2d<T> inBuffer(dimY,input.nCols());
   output.clear();
   output.resize(input.nRows(),input.nCols());
@@ -793,14 +821,14 @@ template<class T> unsigned long int Filter2d::morphology(const Vector2d<T>& inpu
         if(statBuffer.size()){
           switch(getFilterType(method)){
           case(filter2d::dilate):
-            if(output[y][x]<stat.mymax(statBuffer)-hThreshold){
-              output[y][x]=stat.mymax(statBuffer);
+            if(output[y][x]<stat.mymax(statBuffer,mask)-hThreshold){
+              output[y][x]=stat.mymax(statBuffer,mask);
               ++nchange;
             }
             break;
           case(filter2d::erode):
-            if(output[y][x]>stat.mymin(statBuffer)+hThreshold){
-              output[y][x]=stat.mymin(statBuffer);
+            if(output[y][x]>stat.mymin(statBuffer,mask)+hThreshold){
+              output[y][x]=stat.mymin(statBuffer,mask);
               ++nchange;
             }
             break;
@@ -828,413 +856,145 @@ template<class T> unsigned long int Filter2d::morphology(const Vector2d<T>& inpu
   return nchange;
 }
 
- template<class T> unsigned long int Filter2d::dsm2dtm_nwse(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
+//single directional pass: pixels are visited in scan order (reverseX: east to west, reverseY: south to north)
+//and surface pixels are reset in tmpDSM to the second lowest neighbor, which propagates along the scan direction
+template<class T> unsigned long int Filter2d::dsm2dtmPass(Vector2d<T>& tmpDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim, bool reverseX, bool reverseY)
 {
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-
-  Vector2d<T> tmpDSM(inputDSM);
-  double noDataValue=0;
-  if(m_noDataValues.size())
-    noDataValue=m_noDataValues[0];
-
+  int nrow=tmpDSM.nRows();
+  int ncol=tmpDSM.nCols();
+  assert(dim>1);
+  //initialize outputMask as surface (1) if not provided
+  if(outputMask.nRows()!=nrow||outputMask.nCols()!=ncol)
+    outputMask=Vector2d<T>(nrow,ncol,1);
   unsigned long int nchange=0;
-  int dimX=dim;
-  int dimY=dim;
-  assert(dimX);
-  assert(dimY);
-  statfactory::StatFactory stat;
-  Vector2d<T> inBuffer(dimY,inputDSM.nCols());
-  if(outputMask.size()!=inputDSM.nRows())
-    outputMask.resize(inputDSM.nRows());
-  int indexI=0;
-  int indexJ=0;
-  //initialize last half of inBuffer
-  for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-    for(int i=0;i<inputDSM.nCols();++i)
-      inBuffer[indexJ][i]=tmpDSM[abs(j)][i];
-    ++indexJ;
-  }
-  for(int y=0;y<tmpDSM.nRows();++y){
-    if(y){//inBuffer already initialized for y=0
-      //erase first line from inBuffer
-      inBuffer.erase(inBuffer.begin());
-      //read extra line and push back to inBuffer if not out of bounds
-      if(y+dimY/2<tmpDSM.nRows()){
-        //allocate buffer
-        inBuffer.push_back(inBuffer.back());
-        for(int i=0;i<tmpDSM.nCols();++i)
-          inBuffer[inBuffer.size()-1][i]=tmpDSM[y+dimY/2][i];
-      }
-      else{
-        int over=y+dimY/2-tmpDSM.nRows();
-        int index=(inBuffer.size()-1)-over;
-        assert(index>=0);
-        assert(index<inBuffer.size());
-        inBuffer.push_back(inBuffer[index]);
-      }
-    }
-    for(int x=0;x<tmpDSM.nCols();++x){
-      double centerValue=inBuffer[(dimY-1)/2][x];
+  std::vector<T> neighbors(dim*dim-1);
+  for(int iy=0;iy<nrow;++iy){
+    int y=reverseY? nrow-1-iy : iy;
+    for(int ix=0;ix<ncol;++ix){
+      int x=reverseX? ncol-1-ix : ix;
+      double centerValue=tmpDSM[y][x];
       short nmasked=0;
-      std::vector<T> neighbors;
-      for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-	for(int i=-(dimX-1)/2;i<=dimX/2;++i){
-	  indexI=x+i;
-	  //check if out of bounds
-	  if(indexI<0)
-	    indexI=-indexI;
-	  else if(indexI>=tmpDSM.nCols())
-	    indexI=tmpDSM.nCols()-i;
-	  if(y+j<0)
-	    indexJ=-j;
-	  else if(y+j>=tmpDSM.nRows())
-	    indexJ=(dimY>2) ? (dimY-1)/2-j : 0;
-	  else
-	    indexJ=(dimY-1)/2+j;
-	  double difference=(centerValue-inBuffer[indexJ][indexI]);
-	  if(i||j)//skip centerValue
-	    neighbors.push_back(inBuffer[indexJ][indexI]);
-	  if(difference>hThreshold)
-	    ++nmasked;
-	}
+      int ineighbor=0;
+      for(int j=-(dim-1)/2;j<=dim/2;++j){
+        int indexJ=mirrorIndex(y+j,nrow);
+        for(int i=-(dim-1)/2;i<=dim/2;++i){
+          int indexI=mirrorIndex(x+i,ncol);
+          if(centerValue-tmpDSM[indexJ][indexI]>hThreshold)
+            ++nmasked;
+          if(i||j)//skip centerValue
+            neighbors[ineighbor++]=tmpDSM[indexJ][indexI];
+        }
       }
       if(nmasked<=nlimit){
-	++nchange;
-	//reset pixel in outputMask
-	outputMask[y][x]=0;
+        ++nchange;
+        //reset pixel in outputMask
+        outputMask[y][x]=0;
       }
       else{
-	//reset pixel height in tmpDSM
-	sort(neighbors.begin(),neighbors.end());
-	assert(neighbors.size()>1);
-	inBuffer[(dimY-1)/2][x]=neighbors[1];
-	/* inBuffer[(dimY-1)/2][x]=stat.mymin(neighbors); */
+        //reset pixel height in tmpDSM to second lowest neighbor
+        std::nth_element(neighbors.begin(),neighbors.begin()+1,neighbors.end());
+        tmpDSM[y][x]=neighbors[1];
       }
     }
-    progress=(1.0+y);
-    progress/=outputMask.nRows();
-    pfnProgress(progress,pszMessage,pProgressArg);
   }
   return nchange;
 }
 
- template<class T> unsigned long int Filter2d::dsm2dtm_nesw(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
+ template<class T> unsigned long int Filter2d::dsm2dtm_nwse(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
 {
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-
   Vector2d<T> tmpDSM(inputDSM);
-  double noDataValue=0;
-  if(m_noDataValues.size())
-    noDataValue=m_noDataValues[0];
+  return dsm2dtmPass(tmpDSM,outputMask,hThreshold,nlimit,dim,false,false);
+}
 
-  unsigned long int nchange=0;
-  int dimX=dim;
-  int dimY=dim;
-  assert(dimX);
-  assert(dimY);
-  statfactory::StatFactory stat;
-  Vector2d<T> inBuffer(dimY,inputDSM.nCols());
-  if(outputMask.size()!=inputDSM.nRows())
-    outputMask.resize(inputDSM.nRows());
-  int indexI=0;
-  int indexJ=0;
-  //initialize last half of inBuffer
-  for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-    for(int i=0;i<inputDSM.nCols();++i)
-      inBuffer[indexJ][i]=tmpDSM[abs(j)][i];
-    ++indexJ;
-  }
-  for(int y=0;y<tmpDSM.nRows();++y){
-    if(y){//inBuffer already initialized for y=0
-      //erase first line from inBuffer
-      inBuffer.erase(inBuffer.begin());
-      //read extra line and push back to inBuffer if not out of bounds
-      if(y+dimY/2<tmpDSM.nRows()){
-        //allocate buffer
-        inBuffer.push_back(inBuffer.back());
-        for(int i=0;i<tmpDSM.nCols();++i)
-          inBuffer[inBuffer.size()-1][i]=tmpDSM[y+dimY/2][i];
-      }
-      else{
-        int over=y+dimY/2-tmpDSM.nRows();
-        int index=(inBuffer.size()-1)-over;
-        assert(index>=0);
-        assert(index<inBuffer.size());
-        inBuffer.push_back(inBuffer[index]);
-      }
-    }
-    for(int x=tmpDSM.nCols()-1;x>=0;--x){
-      double centerValue=inBuffer[(dimY-1)/2][x];
-      short nmasked=0;
-      std::vector<T> neighbors;
-      for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-	for(int i=-(dimX-1)/2;i<=dimX/2;++i){
-	  indexI=x+i;
-	  //check if out of bounds
-	  if(indexI<0)
-	    indexI=-indexI;
-	  else if(indexI>=tmpDSM.nCols())
-	    indexI=tmpDSM.nCols()-i;
-	  if(y+j<0)
-	    indexJ=-j;
-	  else if(y+j>=tmpDSM.nRows())
-	    indexJ=(dimY>2) ? (dimY-1)/2-j : 0;
-	  else
-	    indexJ=(dimY-1)/2+j;
-	  double difference=(centerValue-inBuffer[indexJ][indexI]);
-	  if(i||j)//skip centerValue
-	    neighbors.push_back(inBuffer[indexJ][indexI]);
-	  if(difference>hThreshold)
-	    ++nmasked;
-	}
-      }
-      if(nmasked<=nlimit){
-	++nchange;
-	//reset pixel in outputMask
-	outputMask[y][x]=0;
-      }
-      else{
-	//reset pixel height in tmpDSM
-	sort(neighbors.begin(),neighbors.end());
-	assert(neighbors.size()>1);
-	inBuffer[(dimY-1)/2][x]=neighbors[1];
-	/* inBuffer[(dimY-1)/2][x]=stat.mymin(neighbors); */
-      }
-    }
-    progress=(1.0+y);
-    progress/=outputMask.nRows();
-    pfnProgress(progress,pszMessage,pProgressArg);
-  }
-  return nchange;
+ template<class T> unsigned long int Filter2d::dsm2dtm_nesw(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
+{
+  Vector2d<T> tmpDSM(inputDSM);
+  return dsm2dtmPass(tmpDSM,outputMask,hThreshold,nlimit,dim,true,false);
 }
 
  template<class T> unsigned long int Filter2d::dsm2dtm_senw(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
 {
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-
   Vector2d<T> tmpDSM(inputDSM);
-  double noDataValue=0;
-  if(m_noDataValues.size())
-    noDataValue=m_noDataValues[0];
-
-  unsigned long int nchange=0;
-  int dimX=dim;
-  int dimY=dim;
-  assert(dimX);
-  assert(dimY);
-  statfactory::StatFactory stat;
-  Vector2d<T> inBuffer(dimY,inputDSM.nCols());
-  if(outputMask.size()!=inputDSM.nRows())
-    outputMask.resize(inputDSM.nRows());
-  int indexI=0;
-  int indexJ=inputDSM.nRows()-1;
-  //initialize first half of inBuffer
-  for(int j=inputDSM.nRows()-dimY/2;j<inputDSM.nRows();--j){
-    for(int i=0;i<inputDSM.nCols();++i)
-      inBuffer[indexJ][i]=tmpDSM[abs(j)][i];
-    ++indexJ;
-  }
-  for(int y=tmpDSM.nRows()-1;y>=0;--y){
-    if(y<tmpDSM.nRows()-1){//inBuffer already initialized for y=tmpDSM.nRows()-1
-      //erase last line from inBuffer
-      inBuffer.erase(inBuffer.end()-1);
-      //read extra line and insert to inBuffer if not out of bounds
-      if(y-dimY/2>0){
-        //allocate buffer
-        inBuffer.insert(inBuffer.begin(),inBuffer.back());
-        for(int i=0;i<tmpDSM.nCols();++i)
-          inBuffer[0][i]=tmpDSM[y-dimY/2][i];
-      }
-      else{
-        inBuffer.insert(inBuffer.begin(),inBuffer[abs(y-dimY/2)]);
-      }
-    }
-    for(int x=tmpDSM.nCols()-1;x>=0;--x){
-      double centerValue=inBuffer[(dimY-1)/2][x];
-      short nmasked=0;
-      std::vector<T> neighbors;
-      for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-	for(int i=-(dimX-1)/2;i<=dimX/2;++i){
-	  indexI=x+i;
-	  //check if out of bounds
-	  if(indexI<0)
-	    indexI=-indexI;
-	  else if(indexI>=tmpDSM.nCols())
-	    indexI=tmpDSM.nCols()-i;
-	  if(y+j<0)
-	    indexJ=-j;
-	  else if(y+j>=tmpDSM.nRows())
-	    indexJ=(dimY>2) ? (dimY-1)/2-j : 0;
-	  else
-	    indexJ=(dimY-1)/2+j;
-	  double difference=(centerValue-inBuffer[indexJ][indexI]);
-	  if(i||j)//skip centerValue
-	    neighbors.push_back(inBuffer[indexJ][indexI]);
-	  if(difference>hThreshold)
-	    ++nmasked;
-	}
-      }
-      if(nmasked<=nlimit){
-	++nchange;
-	//reset pixel in outputMask
-	outputMask[y][x]=0;
-      }
-      else{
-	//reset pixel height in tmpDSM
-	sort(neighbors.begin(),neighbors.end());
-	assert(neighbors.size()>1);
-	inBuffer[(dimY-1)/2][x]=neighbors[1];
-	/* inBuffer[(dimY-1)/2][x]=stat.mymin(neighbors); */
-      }
-    }
-    progress=(1.0+y);
-    progress/=outputMask.nRows();
-    pfnProgress(progress,pszMessage,pProgressArg);
-  }
-  return nchange;
+  return dsm2dtmPass(tmpDSM,outputMask,hThreshold,nlimit,dim,true,true);
 }
 
  template<class T> unsigned long int Filter2d::dsm2dtm_swne(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
 {
-  const char* pszMessage;
-  void* pProgressArg=NULL;
-  GDALProgressFunc pfnProgress=GDALTermProgress;
-  double progress=0;
-  pfnProgress(progress,pszMessage,pProgressArg);
-
   Vector2d<T> tmpDSM(inputDSM);
-  double noDataValue=0;
-  if(m_noDataValues.size())
-    noDataValue=m_noDataValues[0];
+  return dsm2dtmPass(tmpDSM,outputMask,hThreshold,nlimit,dim,false,true);
+}
 
+//all four directional passes (NWSE, NESW, SENW, SWNE), each starting from inputDSM
+ template<class T> unsigned long int Filter2d::dsm2dtm(const Vector2d<T>& inputDSM, Vector2d<T>& outputMask, double hThreshold, int nlimit, int dim)
+{
   unsigned long int nchange=0;
-  int dimX=dim;
-  int dimY=dim;
-  assert(dimX);
-  assert(dimY);
-  statfactory::StatFactory stat;
-  Vector2d<T> inBuffer(dimY,inputDSM.nCols());
-  if(outputMask.size()!=inputDSM.nRows())
-    outputMask.resize(inputDSM.nRows());
-  int indexI=0;
-  int indexJ=0;
-  //initialize first half of inBuffer
-  for(int j=inputDSM.nRows()-dimY/2;j<inputDSM.nRows();--j){
-    for(int i=0;i<inputDSM.nCols();++i)
-      inBuffer[indexJ][i]=tmpDSM[abs(j)][i];
-    ++indexJ;
-  }
-  for(int y=tmpDSM.nRows()-1;y>=0;--y){
-    if(y<tmpDSM.nRows()-1){//inBuffer already initialized for y=0
-      //erase last line from inBuffer
-      inBuffer.erase(inBuffer.end()-1);
-      //read extra line and insert to inBuffer if not out of bounds
-      if(y-dimY/2>0){
-        //allocate buffer
-        inBuffer.insert(inBuffer.begin(),inBuffer.back());
-        for(int i=0;i<tmpDSM.nCols();++i)
-          inBuffer[0][i]=tmpDSM[y-dimY/2][i];
-      }
-      else{
-        inBuffer.insert(inBuffer.begin(),inBuffer[abs(y-dimY/2)]);
-      }
-    }
-    for(int x=0;x<tmpDSM.nCols();++x){
-      double centerValue=inBuffer[(dimY-1)/2][x];
-      short nmasked=0;
-      std::vector<T> neighbors;
-      for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-	for(int i=-(dimX-1)/2;i<=dimX/2;++i){
-	  indexI=x+i;
-	  //check if out of bounds
-	  if(indexI<0)
-	    indexI=-indexI;
-	  else if(indexI>=tmpDSM.nCols())
-	    indexI=tmpDSM.nCols()-i;
-	  if(y+j<0)
-	    indexJ=-j;
-	  else if(y+j>=tmpDSM.nRows())
-	    indexJ=(dimY>2) ? (dimY-1)/2-j : 0;
-	  else
-	    indexJ=(dimY-1)/2+j;
-	  double difference=(centerValue-inBuffer[indexJ][indexI]);
-	  if(i||j)//skip centerValue
-	    neighbors.push_back(inBuffer[indexJ][indexI]);
-	  if(difference>hThreshold)
-	    ++nmasked;
-	}
-      }
-      if(nmasked<=nlimit){
-	++nchange;
-	//reset pixel in outputMask
-	outputMask[y][x]=0;
-      }
-      else{
-	//reset pixel height in tmpDSM
-	sort(neighbors.begin(),neighbors.end());
-	assert(neighbors.size()>1);
-	inBuffer[(dimY-1)/2][x]=neighbors[1];
-	/* inBuffer[(dimY-1)/2][x]=stat.mymin(neighbors); */
-      }
-    }
-    progress=(1.0+y);
-    progress/=outputMask.nRows();
-    pfnProgress(progress,pszMessage,pProgressArg);
+  Vector2d<T> tmpDSM;
+  for(int direction=0;direction<4;++direction){
+    tmpDSM=inputDSM;
+    nchange+=dsm2dtmPass(tmpDSM,outputMask,hThreshold,nlimit,dim,direction==1||direction==2,direction>1);
   }
   return nchange;
 }
 
+  //horizon sweep: pixels are visited along lines parallel to the solar azimuth (from the sun towards the shadow),
+  //carrying the running maximum of the shadow plane (height - distance/tan(sza)). Lines are independent.
   template<class T> void Filter2d::shadowDsm(const Vector2d<T>& input, Vector2d<T>& output, double sza, double saa, double pixelSize, short shadowFlag)
 {
-  unsigned int ncols=input.nCols();
+  int nrows=input.nRows();
+  int ncols=input.nCols();
   output.clear();
-  output.resize(input.nRows(),ncols);
-  //do we need to initialize output?
-  // for(int y=0;y<output.nRows();++y)
-  //   for(int x=0;x<output.nCols();++x)
-  //     output[y][x]=0;
-  int indexI=0;
-  int indexJ=0;
+  output.resize(nrows,ncols);
+  if(!nrows||!ncols)
+    return;
   const char* pszMessage;
   void* pProgressArg=NULL;
   GDALProgressFunc pfnProgress=GDALTermProgress;
   double progress=0;
   pfnProgress(progress,pszMessage,pProgressArg);
-  for(int y=0;y<input.nRows();++y){
-    for(int x=0;x<input.nCols();++x){
-      double currentValue=input[y][x];
-      int theDist=static_cast<int>(sqrt((currentValue*tan(DEG2RAD(sza))/pixelSize)*(currentValue*tan(DEG2RAD(sza))/pixelSize)));//in pixels
-      double theDir=DEG2RAD(saa)+PI/2.0;
-      if(theDir<0)
-        theDir+=2*PI;
-      for(int d=0;d<theDist;++d){//d in pixels
-        indexI=x+d*cos(theDir);//in pixels
-        indexJ=y+d*sin(theDir);//in pixels
-        if(indexJ<0||indexJ>=input.size())
-          continue;
-        if(indexI<0||indexI>=input[indexJ].size())
-          continue;
-        if(input[indexJ][indexI]<currentValue-d*pixelSize/tan(DEG2RAD(sza))){//in m
-          output[indexJ][indexI]=shadowFlag;
-        }
+  double theDir=DEG2RAD(saa)+PI/2.0;
+  double dirX=cos(theDir);
+  double dirY=sin(theDir);
+  //lines are traversed pixel by pixel along the major axis
+  bool xMajor=fabs(dirX)>=fabs(dirY);
+  int nmajor=xMajor? ncols : nrows;
+  int nminor=xMajor? nrows : ncols;
+  bool reverse=xMajor? dirX<0 : dirY<0;
+  //displacement along minor axis and drop of the shadow plane (in m) for each step along major axis
+  double slope=xMajor? dirY/fabs(dirX) : dirX/fabs(dirY);
+  double drop=sqrt(1+slope*slope)*pixelSize/tan(DEG2RAD(sza));
+  //line k covers minor=k+floor(m*slope+0.5) for m=0..nmajor-1, such that each pixel belongs to a single line
+  int shift=static_cast<int>(floor((nmajor-1)*slope+0.5));
+  int minLine=(shift>0)? -shift : 0;
+  int maxLine=(shift>0)? nminor-1 : nminor-1-shift;
+#pragma omp parallel for
+  for(int k=minLine;k<=maxLine;++k){
+    bool started=false;
+    double plane=0;
+    for(int m=0;m<nmajor;++m){
+      int minor=k+static_cast<int>(floor(m*slope+0.5));
+      if(minor<0||minor>=nminor){
+        if(started)
+          break;
+        continue;
+      }
+      int major=reverse? nmajor-1-m : m;
+      int x=xMajor? major : minor;
+      int y=xMajor? minor : major;
+      double value=input[y][x];
+      if(started){
+        plane-=drop;
+        if(value<plane)
+          output[y][x]=shadowFlag;
+        else
+          plane=value;
+      }
+      else{
+        plane=value;
+        started=true;
       }
     }
-    progress=(1.0+y);
-    progress/=output.nRows();
-    pfnProgress(progress,pszMessage,pProgressArg);
   }
+  pfnProgress(1.0,pszMessage,pProgressArg);
 }
 
 template<class T> void Filter2d::dwtForward(Vector2d<T>& theBuffer, const std::string& wavelet_type, int family){
@@ -29,366 +29,189 @@ ImgRegression::ImgRegression(void)
 ImgRegression::~ImgRegression(void)
 {}
 
-double ImgRegression::getRMSE(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose) const{
-  c0=0;
-  c1=1;
-  unsigned int icol1=0,irow1=0;
-  std::vector<double> rowBuffer1(imgReader1.nrOfCol());
-  std::vector<double> rowBuffer2(imgReader2.nrOfCol());
-  std::vector<double> buffer1;
-  std::vector<double> buffer2;
-
-  srand(time(NULL));
-  for(irow1=0;irow1<imgReader1.nrOfRow();++irow1){
-    if(irow1%m_down)
+unsigned long int ImgRegression::getMoments(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, statfactory::Bivariate& moments, unsigned int band1, unsigned int band2, statfactory::Histogram2d* histogram, short verbose) const{
+  const int nblock=256;//number of (selected) rows read at once
+  int ncol1=imgReader1.nrOfCol();
+  int nrow1=imgReader1.nrOfRow();
+  int ncol2=imgReader2.nrOfCol();
+  int nrow2=imgReader2.nrOfRow();
+  int down=(m_down>1)? m_down : 1;
+  //pixels correspond one to one on the same grid: no need to go through geo coordinates
+  bool sameGrid=(&imgReader1==&imgReader2);
+  if(!sameGrid&&ncol1==ncol2&&nrow1==nrow2){
+    double gt1[6];
+    double gt2[6];
+    imgReader1.getGeoTransform(gt1);
+    imgReader2.getGeoTransform(gt2);
+    sameGrid=true;
+    for(int i=0;i<6;++i)
+      sameGrid=sameGrid&&(gt1[i]==gt2[i]);
+  }
+  //column in imgReader2 for each column in imgReader1 (-1 if outside), the same for all rows
+  std::vector<int> col2(ncol1,-1);
+  for(int icol1=0;icol1<ncol1;icol1+=down){
+    if(sameGrid){
+      col2[icol1]=icol1;
       continue;
-    icol1=0;
-    double icol2=0,irow2=0;
+    }
     double geox=0,geoy=0;
-    imgReader1.readData(rowBuffer1,GDT_Float64,irow1,band1);
-    imgReader1.image2geo(icol1,irow1,geox,geoy);
+    double icol2=0,irow2=0;
+    imgReader1.image2geo(icol1,0,geox,geoy);
     imgReader2.geo2image(geox,geoy,icol2,irow2);
-    icol2=static_cast<int>(icol2);
-    irow2=static_cast<int>(irow2);
-    if(irow2<0||irow2>=imgReader2.nrOfRow())
-      continue;
-    imgReader2.readData(rowBuffer2,GDT_Float64,irow2,band2);
-    for(icol1=0;icol1<imgReader1.nrOfCol();++icol1){
-      if(icol1%m_down)
-	continue;
-      if(m_threshold>0){//percentual value
-	double p=static_cast<double>(rand())/(RAND_MAX);
-	p*=100.0;
-	if(p>m_threshold)
-	  continue;//do not select for now, go to next column
-      }
-      imgReader1.image2geo(icol1,irow1,geox,geoy);
-      imgReader2.geo2image(geox,geoy,icol2,irow2);
-      if(icol2<0||icol2>=imgReader2.nrOfCol())
-	continue;
-      icol2=static_cast<int>(icol2);
-      irow2=static_cast<int>(irow2);
-      //check for nodata
-      double value1=rowBuffer1[icol1];
-      double value2=rowBuffer2[icol2];
-      if(imgReader1.isNoData(value1)||imgReader2.isNoData(value2))
-	continue;
-
-      buffer1.push_back(value1);
-      buffer2.push_back(value2);
-      if(verbose>1)
-	std::cout << geox << " " << geoy << " " << icol1 << " " << irow1 << " " << icol2 << " " << irow2 << " " << buffer1.back() << " " << buffer2.back() << std::endl;
-    }
+    if(icol2>=0&&icol2<ncol2)
+      col2[icol1]=static_cast<int>(icol2);
   }
-  double err=0;
-  if(buffer1.size()&&buffer2.size()){
-    statfactory::StatFactory stat;
-    err=stat.linear_regression_err(buffer1,buffer2,c0,c1);
-  }
-  if(verbose)
-    std::cout << "linear regression based on " << buffer1.size() << " points: " << c0 << "+" << c1 << " * x " << " with rmse: " << err << std::endl;
-  return err;
-}
-
-double ImgRegression::getR2(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose) const{
-  c0=0;
-  c1=1;
-  int icol1=0,irow1=0;
-  std::vector<double> rowBuffer1(imgReader1.nrOfCol());
-  std::vector<double> rowBuffer2(imgReader2.nrOfCol());
-  std::vector<double> buffer1;
-  std::vector<double> buffer2;
 
   srand(time(NULL));
-  for(irow1=0;irow1<imgReader1.nrOfRow();++irow1){
-    if(irow1%m_down)
-      continue;
-    icol1=0;
-    double icol2=0,irow2=0;
-    double geox=0,geoy=0;
-    imgReader1.readData(rowBuffer1,GDT_Float64,irow1,band1);
-    imgReader1.image2geo(icol1,irow1,geox,geoy);
-    imgReader2.geo2image(geox,geoy,icol2,irow2);
-    icol2=static_cast<int>(icol2);
-    irow2=static_cast<int>(irow2);
-    if(irow2<0||irow2>=imgReader2.nrOfRow())
-      continue;
-    imgReader2.readData(rowBuffer2,GDT_Float64,irow2,band2);
-    for(icol1=0;icol1<imgReader1.nrOfCol();++icol1){
-      if(icol1%m_down)
-	continue;
-      if(m_threshold>0){//percentual value
-	double p=static_cast<double>(rand())/(RAND_MAX);
-	p*=100.0;
-	if(p>m_threshold)
-	  continue;//do not select for now, go to next column
+  moments.reset();
+  std::vector<int> rows1;
+  std::vector<int> rows2;
+  Vector2d<double> buffer1;
+  Vector2d<double> buffer2;
+  std::vector< std::vector<unsigned char> > selected;
+  for(int irow=0;irow<nrow1;){
+    //read a block of rows (GDAL is not thread safe)
+    rows1.clear();
+    rows2.clear();
+    for(;irow<nrow1&&static_cast<int>(rows1.size())<nblock;irow+=down){
+      int irow2=irow;
+      if(!sameGrid){
+        double geox=0,geoy=0;
+        double dcol2=0,drow2=0;
+        imgReader1.image2geo(0,irow,geox,geoy);
+        imgReader2.geo2image(geox,geoy,dcol2,drow2);
+        if(drow2<0||drow2>=nrow2)
+          continue;
+        irow2=static_cast<int>(drow2);
+      }
+      rows1.push_back(irow);
+      rows2.push_back(irow2);
+    }
+    int nrow=rows1.size();
+    buffer1.resize(nrow);
+    buffer2.resize(nrow);
+    for(int iblock=0;iblock<nrow;++iblock){
+      imgReader1.readData(buffer1[iblock],rows1[iblock],band1);
+      imgReader2.readData(buffer2[iblock],rows2[iblock],band2);
+    }
+    //random selection is drawn sequentially, in the same order as a row by row pass
+    if(m_threshold>0){
+      selected.resize(nrow);
+      for(int iblock=0;iblock<nrow;++iblock){
+        selected[iblock].assign(ncol1,0);
+        for(int icol1=0;icol1<ncol1;icol1+=down){
+          double p=static_cast<double>(rand())/(RAND_MAX);
+          p*=100.0;
+          selected[iblock][icol1]=(p<=m_threshold);
+        }
+      }
+    }
+    //one accumulator per row, merged in row order so the result does not depend on the number of threads
+    std::vector<statfactory::Bivariate> rowMoments(nrow);
+    //valid pairs of the block, binned in the shared histogram after the parallel pass (memory bounded by the block)
+    std::vector< std::vector<double> > rowPairs((histogram)? nrow : 0);
+#pragma omp parallel for schedule(dynamic) if(verbose<2)
+    for(int iblock=0;iblock<nrow;++iblock){
+      const std::vector<double>& rowBuffer1=buffer1[iblock];
+      const std::vector<double>& rowBuffer2=buffer2[iblock];
+      for(int icol1=0;icol1<ncol1;icol1+=down){
+        if(m_threshold>0&&!selected[iblock][icol1])
+          continue;
+        int icol2=col2[icol1];
+        if(icol2<0)
+          continue;
+        //check for nodata
+        double value1=rowBuffer1[icol1];
+        double value2=rowBuffer2[icol2];
+        if(imgReader1.isNoData(value1)||imgReader2.isNoData(value2))
+          continue;
+        rowMoments[iblock].push(value1,value2);
+        if(histogram){
+          rowPairs[iblock].push_back(value1);
+          rowPairs[iblock].push_back(value2);
+        }
+        if(verbose>1)
+          std::cout << icol1 << " " << rows1[iblock] << " " << icol2 << " " << rows2[iblock] << " " << value1 << " " << value2 << std::endl;
+      }
+    }
+    for(int iblock=0;iblock<nrow;++iblock){
+      moments.merge(rowMoments[iblock]);
+      if(histogram){
+        for(int ipair=0;ipair+1<rowPairs[iblock].size();ipair+=2)
+          histogram->push(rowPairs[iblock][ipair],rowPairs[iblock][ipair+1]);
       }
-      imgReader1.image2geo(icol1,irow1,geox,geoy);
-      imgReader2.geo2image(geox,geoy,icol2,irow2);
-      if(icol2<0||icol2>=imgReader2.nrOfCol())
-	continue;
-      icol2=static_cast<int>(icol2);
-      irow2=static_cast<int>(irow2);
-      //check for nodata
-      double value1=rowBuffer1[icol1];
-      double value2=rowBuffer2[icol2];
-      if(imgReader1.isNoData(value1)||imgReader2.isNoData(value2))
-	continue;
-
-      buffer1.push_back(value1);
-      buffer2.push_back(value2);
-      if(verbose>1)
-	std::cout << geox << " " << geoy << " " << icol1 << " " << irow1 << " " << icol2 << " " << irow2 << " " << buffer1.back() << " " << buffer2.back() << std::endl;
     }
   }
-  double r2=0;
-  if(buffer1.size()&&buffer2.size()){
-    statfactory::StatFactory stat;
-    r2=stat.linear_regression(buffer1,buffer2,c0,c1);
-  }
-  if(verbose)
-    std::cout << "linear regression based on " << buffer1.size() << " points: " << c0 << "+" << c1 << " * x " << " with r^2: " << r2 << std::endl;
-  return r2;
+  return moments.size();
 }
 
-double ImgRegression::pgetR2(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose) const{
+unsigned long int ImgRegression::getMoments(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, statfactory::Bivariate& moments, short verbose) const{
+  assert(band1<imgReader.nrOfBand());
+  assert(band2<imgReader.nrOfBand());
+  return getMoments(imgReader,imgReader,moments,band1,band2,0,verbose);
+}
+
+double ImgRegression::pgetR2(const statfactory::Bivariate& moments, double& c0, double& c1){
   c0=0;
   c1=1;
-  int icol1=0,irow1=0;
-  std::vector<double> rowBuffer1(imgReader1.nrOfCol());
-  std::vector<double> rowBuffer2(imgReader2.nrOfCol());
-  std::vector<double> buffer1;
-  std::vector<double> buffer2;
-
-  srand(time(NULL));
-  for(irow1=0;irow1<imgReader1.nrOfRow();++irow1){
-    if(irow1%m_down)
-      continue;
-    icol1=0;
-    double icol2=0,irow2=0;
-    double geox=0,geoy=0;
-    imgReader1.readData(rowBuffer1,GDT_Float64,irow1,band1);
-    imgReader1.image2geo(icol1,irow1,geox,geoy);
-    imgReader2.geo2image(geox,geoy,icol2,irow2);
-    icol2=static_cast<int>(icol2);
-    irow2=static_cast<int>(irow2);
-    if(irow2<0||irow2>=imgReader2.nrOfRow())
-      continue;
-    imgReader2.readData(rowBuffer2,GDT_Float64,irow2,band2);
-    for(icol1=0;icol1<imgReader1.nrOfCol();++icol1){
-      if(icol1%m_down)
-	continue;
-      if(m_threshold>0){//percentual value
-	double p=static_cast<double>(rand())/(RAND_MAX);
-	p*=100.0;
-	if(p>m_threshold)
-	  continue;//do not select for now, go to next column
-      }
-      imgReader1.image2geo(icol1,irow1,geox,geoy);
-      imgReader2.geo2image(geox,geoy,icol2,irow2);
-      if(icol2<0||icol2>=imgReader2.nrOfCol())
-	continue;
-      icol2=static_cast<int>(icol2);
-      irow2=static_cast<int>(irow2);
-      //check for nodata
-      double value1=rowBuffer1[icol1];
-      double value2=rowBuffer2[icol2];
-      if(imgReader1.isNoData(value1)||imgReader2.isNoData(value2))
-	continue;
-
-      buffer1.push_back(value1);
-      buffer2.push_back(value2);
-      if(verbose>1)
-	std::cout << geox << " " << geoy << " " << icol1 << " " << irow1 << " " << icol2 << " " << irow2 << " " << buffer1.back() << " " << buffer2.back() << std::endl;
-    }
-  }
-  double r=0;
-  if(buffer1.size()&&buffer2.size()){
-    statfactory::StatFactory stat;
-    r=stat.correlation(buffer1,buffer2);
-    // r=stat.gsl_correlation(buffer1,buffer2);
-    double m1=0;
-    double v1=0;
-    double m2=0;
-    double v2=0;
-    stat.meanVar(buffer1,m1,v1);
-    stat.meanVar(buffer2,m2,v2);
-    if(v1>0){
-      if(r>=0)
-	c1=v2/v1;
-      else
-	c1=-v2/v1;
-    }
-    c0=m2-c1*m1;
+  if(!moments.size())
+    return 0;
+  double r=moments.correlation();
+  double v1=moments.varX();
+  double v2=moments.varY();
+  if(v1>0){
+    if(r>=0)
+      c1=v2/v1;
+    else
+      c1=-v2/v1;
   }
-  if(verbose)
-    std::cout << "orthogonal regression based on " << buffer1.size() << " points: " << c0 << "+" << c1 << " * x " << " with r^2: " << r*r << std::endl;
+  c0=moments.meanY()-c1*moments.meanX();
   return r*r;
 }
 
-double ImgRegression::getRMSE(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose) const{
+double ImgRegression::getRMSE(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose) const{
   c0=0;
   c1=1;
-  int icol=0,irow=0;
-  std::vector<double> rowBuffer1(imgReader.nrOfCol());
-  std::vector<double> rowBuffer2(imgReader.nrOfCol());
-  std::vector<double> buffer1;
-  std::vector<double> buffer2;
-
-  srand(time(NULL));
-  assert(band1>=0);
-  assert(band1<imgReader.nrOfBand());
-  assert(band2>=0);
-  assert(band2<imgReader.nrOfBand());
-  for(irow=0;irow<imgReader.nrOfRow();++irow){
-    if(irow%m_down)
-      continue;
-    icol=0;
-    imgReader.readData(rowBuffer1,GDT_Float64,irow,band1);
-    imgReader.readData(rowBuffer2,GDT_Float64,irow,band2);
-    for(icol=0;icol<imgReader.nrOfCol();++icol){
-      if(icol%m_down)
-	continue;
-      if(m_threshold>0){//percentual value
-	double p=static_cast<double>(rand())/(RAND_MAX);
-	p*=100.0;
-	if(p>m_threshold)
-	  continue;//do not select for now, go to next column
-      }
-      //check for nodata
-      double value1=rowBuffer1[icol];
-      double value2=rowBuffer2[icol];
-      if(imgReader.isNoData(value1)||imgReader.isNoData(value2))
-	continue;
-
-      buffer1.push_back(value1);
-      buffer2.push_back(value2);
-      if(verbose>1)
-	std::cout << icol << " " << irow << " " << buffer1.back() << " " << buffer2.back() << std::endl;
-    }
-  }
+  statfactory::Bivariate moments;
+  getMoments(imgReader1,imgReader2,moments,band1,band2,0,verbose);
   double err=0;
-  if(buffer1.size()&&buffer2.size()){
-    statfactory::StatFactory stat;
-    err=stat.linear_regression_err(buffer1,buffer2,c0,c1);
-  }
+  if(moments.size())
+    err=moments.regressionError(c0,c1);
   if(verbose)
-    std::cout << "linear regression based on " << buffer1.size() << " points: " << c0 << "+" << c1 << " * x " << " with rmse: " << err << std::endl;
+    std::cout << "linear regression based on " << moments.size() << " points: " << c0 << "+" << c1 << " * x " << " with rmse: " << err << std::endl;
   return err;
 }
 
-double ImgRegression::getR2(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose) const{
+double ImgRegression::getR2(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose) const{
   c0=0;
   c1=1;
-  int icol=0,irow=0;
-  std::vector<double> rowBuffer1(imgReader.nrOfCol());
-  std::vector<double> rowBuffer2(imgReader.nrOfCol());
-  std::vector<double> buffer1;
-  std::vector<double> buffer2;
-
-  srand(time(NULL));
-  assert(band1>=0);
-  assert(band1<imgReader.nrOfBand());
-  assert(band2>=0);
-  assert(band2<imgReader.nrOfBand());
-  for(irow=0;irow<imgReader.nrOfRow();++irow){
-    if(irow%m_down)
-      continue;
-    icol=0;
-    imgReader.readData(rowBuffer1,GDT_Float64,irow,band1);
-    imgReader.readData(rowBuffer2,GDT_Float64,irow,band2);
-    for(icol=0;icol<imgReader.nrOfCol();++icol){
-      if(icol%m_down)
-	continue;
-      if(m_threshold>0){//percentual value
-	double p=static_cast<double>(rand())/(RAND_MAX);
-	p*=100.0;
-	if(p>m_threshold)
-	  continue;//do not select for now, go to next column
-      }
-      //check for nodata
-      double value1=rowBuffer1[icol];
-      double value2=rowBuffer2[icol];
-      if(imgReader.isNoData(value1)||imgReader.isNoData(value2))
-	continue;
-
-      buffer1.push_back(value1);
-      buffer2.push_back(value2);
-      if(verbose>1)
-	std::cout << icol << " " << irow << " " << buffer1.back() << " " << buffer2.back() << std::endl;
-    }
-  }
+  statfactory::Bivariate moments;
+  getMoments(imgReader1,imgReader2,moments,band1,band2,0,verbose);
   double r2=0;
-  if(buffer1.size()&&buffer2.size()){
-    statfactory::StatFactory stat;
-    r2=stat.linear_regression(buffer1,buffer2,c0,c1);
-  }
+  if(moments.size())
+    r2=moments.linearRegression(c0,c1);
   if(verbose)
-    std::cout << "linear regression based on " << buffer1.size() << " points: " << c0 << "+" << c1 << " * x " << " with r^2: " << r2 << std::endl;
+    std::cout << "linear regression based on " << moments.size() << " points: " << c0 << "+" << c1 << " * x " << " with r^2: " << r2 << std::endl;
   return r2;
 }
 
-double ImgRegression::pgetR2(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose) const{
-  c0=0;
-  c1=1;
-  int icol=0,irow=0;
-  std::vector<double> rowBuffer1(imgReader.nrOfCol());
-  std::vector<double> rowBuffer2(imgReader.nrOfCol());
-  std::vector<double> buffer1;
-  std::vector<double> buffer2;
+double ImgRegression::pgetR2(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose) const{
+  statfactory::Bivariate moments;
+  getMoments(imgReader1,imgReader2,moments,band1,band2,0,verbose);
+  double r2=pgetR2(moments,c0,c1);
+  if(verbose)
+    std::cout << "orthogonal regression based on " << moments.size() << " points: " << c0 << "+" << c1 << " * x " << " with r^2: " << r2 << std::endl;
+  return r2;
+}
 
-  srand(time(NULL));
-  assert(band1>=0);
-  assert(band1<imgReader.nrOfBand());
-  assert(band2>=0);
-  assert(band2<imgReader.nrOfBand());
-  for(irow=0;irow<imgReader.nrOfRow();++irow){
-    if(irow%m_down)
-      continue;
-    icol=0;
-    imgReader.readData(rowBuffer1,GDT_Float64,irow,band1);
-    imgReader.readData(rowBuffer2,GDT_Float64,irow,band2);
-    for(icol=0;icol<imgReader.nrOfCol();++icol){
-      if(icol%m_down)
-	continue;
-      if(m_threshold>0){//percentual value
-	double p=static_cast<double>(rand())/(RAND_MAX);
-	p*=100.0;
-	if(p>m_threshold)
-	  continue;//do not select for now, go to next column
-      }
-      //check for nodata
-      double value1=rowBuffer1[icol];
-      double value2=rowBuffer2[icol];
-      if(imgReader.isNoData(value1)||imgReader.isNoData(value2))
-	continue;
+double ImgRegression::getRMSE(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose) const{
+  return getRMSE(imgReader,imgReader,c0,c1,band1,band2,verbose);
+}
 
-      buffer1.push_back(value1);
-      buffer2.push_back(value2);
-      if(verbose>1)
-	std::cout << icol << " " << irow << " " << buffer1.back() << " " << buffer2.back() << std::endl;
-    }
-  }
-  double r=0;
-  if(buffer1.size()&&buffer2.size()){
-    statfactory::StatFactory stat;
-    r=stat.correlation(buffer1,buffer2);
-    // r=stat.gsl_correlation(buffer1,buffer2);
-    double m1=0;
-    double v1=0;
-    double m2=0;
-    double v2=0;
-    stat.meanVar(buffer1,m1,v1);
-    stat.meanVar(buffer2,m2,v2);
-    if(v1>0){
-      if(r>=0)
-	c1=v2/v1;
-      else
-	c1=-v2/v1;
-    }
-    c0=m2-c1*m1;
-  }
-  if(verbose)
-    std::cout << "orthogonal regression based on " << buffer1.size() << " points: " << c0 << "+" << c1 << " * x " << " with r^2: " << r*r << std::endl;
-  return r*r;
+double ImgRegression::getR2(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose) const{
+  return getR2(imgReader,imgReader,c0,c1,band1,band2,verbose);
+}
+
+double ImgRegression::pgetR2(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose) const{
+  return pgetR2(imgReader,imgReader,c0,c1,band1,band2,verbose);
 }
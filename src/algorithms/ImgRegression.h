@@ -36,6 +36,11 @@ namespace imgregression
     double pgetR2(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, double& c0, double& c1, unsigned int band1, unsigned int band2, short verbose=0) const;
     double getR2(ImgRasterGdal& imgReader, unsigned int b1, unsigned int b2, double& c0, double& c1, short verbose=0) const;
     double pgetR2(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, double& c0, double& c1, short verbose=0) const;
+    //single (parallel) pass over both images: joint moments and optionally the 2d histogram of the valid pixel pairs
+    unsigned long int getMoments(ImgRasterGdal& imgReader1, ImgRasterGdal& imgReader2, statfactory::Bivariate& moments, unsigned int band1=0, unsigned int band2=0, statfactory::Histogram2d* histogram=0, short verbose=0) const;
+    unsigned long int getMoments(ImgRasterGdal& imgReader, unsigned int band1, unsigned int band2, statfactory::Bivariate& moments, short verbose=0) const;
+    //perpendicular regression from the joint moments
+    static double pgetR2(const statfactory::Bivariate& moments, double& c0, double& c1);
 
     void setThreshold(double theThreshold){m_threshold=theThreshold;};
     void setDown(int theDown){m_down=theDown;};
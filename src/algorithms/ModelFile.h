@@ -0,0 +1,241 @@
+/**********************************************************************
+ModelFile.h: binary file for trained classifier models (mapped in memory for reading)
+Copyright (C) 2008-2016 Pieter Kempeneers
+
+This file is part of pktools
+
+pktools is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+pktools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with pktools.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#ifndef _MODELFILE_H_
+#define _MODELFILE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//A model file is a sequence of records: a 64 bit element count followed by the elements,
+//padded with zeros to a multiple of 8 bytes. Files are written and read on the same architecture.
+namespace modelfile
+{
+  static const char MAGIC[8]={'P','K','M','O','D','E','L','1'};
+
+  class ModelWriter{
+  public:
+    ModelWriter(void) : m_file(0){};
+    ModelWriter(const std::string& filename, const std::string& type) : m_file(0){open(filename,type);};
+    //errors are only reported by an explicit close
+    ~ModelWriter(void){if(m_file) fclose(m_file);};
+    void open(const std::string& filename, const std::string& type){
+      close();
+      m_file=fopen(filename.c_str(),"wb");
+      if(!m_file){
+        std::string errorString="Error: could not open model file ";
+        errorString+=filename;
+        throw(errorString);
+      }
+      check(fwrite(MAGIC,1,sizeof(MAGIC),m_file),sizeof(MAGIC));
+      write(type);
+    };
+    void close(void){
+      if(!m_file)
+        return;
+      //also catches errors of blocks written through getFile
+      bool failed=ferror(m_file);
+      if(fclose(m_file))
+        failed=true;
+      m_file=0;
+      if(failed){
+        std::string errorString="Error: could not write model file";
+        throw(errorString);
+      }
+    };
+    template<class T> void write(const T* data, uint64_t n){
+      check(fwrite(&n,sizeof(uint64_t),1,m_file),1);
+      if(n)
+        check(fwrite(data,sizeof(T),n,m_file),n);
+      align();
+    };
+    template<class T> void write(const std::vector<T>& data){write(data.empty()? 0 : &(data[0]),data.size());};
+    void write(const std::string& data){write(data.c_str(),data.size());};
+    void write(const std::vector<std::string>& data){
+      writeValue<uint64_t>(data.size());
+      for(unsigned int i=0;i<data.size();++i)
+        write(data[i]);
+    };
+    void write(const std::map<std::string,short>& data){
+      writeValue<uint64_t>(data.size());
+      for(std::map<std::string,short>::const_iterator mit=data.begin();mit!=data.end();++mit){
+        write(mit->first);
+        writeValue<short>(mit->second);
+      }
+    };
+    template<class T> void writeValue(T value){write(&value,1);};
+    //pad to a multiple of 8 bytes, so that arrays keep their alignment when the file is mapped
+    void align(void){
+      long pos=ftell(m_file);
+      if(pos<0)
+        check(0,1);
+      while(pos++%8)
+        check((fputc(0,m_file)==EOF)? 0 : 1,1);
+    };
+    //for blocks written by an external serializer (e.g., svm_save_model_binary)
+    FILE* getFile(void){return m_file;};
+  private:
+    void check(size_t nwritten, size_t n){
+      if(nwritten!=n){
+        std::string errorString="Error: could not write model file";
+        throw(errorString);
+      }
+    };
+    FILE* m_file;
+  };
+
+  class ModelReader{
+  public:
+    ModelReader(void) : m_data(0), m_size(0), m_offset(0){};
+    ModelReader(const std::string& filename, const std::string& type) : m_data(0), m_size(0), m_offset(0){open(filename,type);};
+    ~ModelReader(void){close();};
+    void open(const std::string& filename, const std::string& type){
+      close();
+#if defined(_WIN32)
+      std::ifstream modelStream(filename.c_str(),std::ios::binary);
+      if(modelStream)
+        m_buffer.assign(std::istreambuf_iterator<char>(modelStream),std::istreambuf_iterator<char>());
+      m_data=m_buffer.empty()? 0 : &(m_buffer[0]);
+      m_size=m_buffer.size();
+#else
+      int fd=::open(filename.c_str(),O_RDONLY);
+      struct stat fileStat;
+      if(fd>=0&&!fstat(fd,&fileStat)&&fileStat.st_size>0){
+        void* mapped=mmap(0,fileStat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if(mapped!=MAP_FAILED){
+          m_data=static_cast<const char*>(mapped);
+          m_size=fileStat.st_size;
+        }
+      }
+      if(fd>=0)
+        ::close(fd);
+#endif
+      if(!m_data){
+        std::string errorString="Error: could not open model file ";
+        errorString+=filename;
+        throw(errorString);
+      }
+      std::string theType;
+      if(m_size<sizeof(MAGIC)||memcmp(m_data,MAGIC,sizeof(MAGIC))||(m_offset=sizeof(MAGIC),read(theType),theType!=type)){
+        close();
+        std::string errorString="Error: ";
+        errorString+=filename;
+        errorString+=" is not a ";
+        errorString+=type;
+        errorString+=" model file";
+        throw(errorString);
+      }
+    };
+    void close(void){
+#if defined(_WIN32)
+      m_buffer.clear();
+#else
+      if(m_data)
+        munmap(const_cast<char*>(m_data),m_size);
+#endif
+      m_data=0;
+      m_size=0;
+      m_offset=0;
+    };
+    bool isOpen(void) const{return m_data!=0;};
+    //returns pointer into the mapped file, valid until the reader is closed
+    template<class T> const T* read(uint64_t& n){
+      n=*reinterpret_cast<const uint64_t*>(current(sizeof(uint64_t)));
+      skip(sizeof(uint64_t));
+      //n comes from the file: check it before n*sizeof(T) can overflow
+      if(n>remaining()/sizeof(T)){
+        std::string errorString="Error: unexpected end of model file";
+        throw(errorString);
+      }
+      const T* data=reinterpret_cast<const T*>(current(n*sizeof(T)));
+      skip(n*sizeof(T));
+      return data;
+    };
+    template<class T> void read(std::vector<T>& data){
+      uint64_t n=0;
+      const T* first=read<T>(n);
+      data.assign(first,first+n);
+    };
+    void read(std::string& data){
+      uint64_t n=0;
+      const char* first=read<char>(n);
+      data.assign(first,n);
+    };
+    void read(std::vector<std::string>& data){
+      data.resize(readValue<uint64_t>());
+      for(unsigned int i=0;i<data.size();++i)
+        read(data[i]);
+    };
+    void read(std::map<std::string,short>& data){
+      data.clear();
+      uint64_t n=readValue<uint64_t>();
+      for(uint64_t i=0;i<n;++i){
+        std::string key;
+        read(key);
+        data[key]=readValue<short>();
+      }
+    };
+    template<class T> T readValue(void){
+      uint64_t n=0;
+      const T* value=read<T>(n);
+      if(n!=1){
+        std::string errorString="Error: corrupt model file";
+        throw(errorString);
+      }
+      return(*value);
+    };
+    //for blocks read by an external deserializer (e.g., svm_load_model_binary)
+    const char* getData(void) const{return m_data+m_offset;};
+    size_t remaining(void) const{return m_size-m_offset;};
+    void skip(size_t nbyte){
+      current(nbyte);
+      m_offset+=(nbyte+7)/8*8;
+      if(m_offset>m_size)
+        m_offset=m_size;
+    };
+  private:
+    const char* current(size_t nbyte) const{
+      if(nbyte>m_size-m_offset){
+        std::string errorString="Error: unexpected end of model file";
+        throw(errorString);
+      }
+      return(m_data+m_offset);
+    };
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset;
+#if defined(_WIN32)
+    std::vector<char> m_buffer;
+#endif
+  };
+}
+#endif /* _MODELFILE_H_ */
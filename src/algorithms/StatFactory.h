@@ -29,6 +29,8 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <limits>
+#include <stdint.h>
 #include <gsl/gsl_fit.h>
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_spline.h>
@@ -36,10 +38,637 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_cdf.h>
 #include <gsl/gsl_statistics.h>
+#include <gsl/gsl_fft_complex.h>
 
 namespace statfactory
 {
 
+//streaming statistics: samples are pushed one at a time or per buffer without storing them.
+//Partial results (e.g., per thread or per tile) are combined with merge.
+//Unlike StatFactory, the accumulators do not check for nodata values: skip them before pushing.
+
+//count, sum, mean and (population) variance, updated with Welford's algorithm
+class Moments{
+public:
+  Moments(void) : m_n(0), m_mean(0), m_m2(0), m_sum(0){};
+  void reset(void){m_n=0;m_mean=0;m_m2=0;m_sum=0;};
+  void push(double value){
+    ++m_n;
+    double delta=value-m_mean;
+    m_mean+=delta/m_n;
+    m_m2+=delta*(value-m_mean);
+    m_sum+=value;
+  };
+  template<class T> void push(const std::vector<T>& v){
+    for(typename std::vector<T>::const_iterator it=v.begin();it!=v.end();++it)
+      push(static_cast<double>(*it));
+  };
+  void merge(const Moments& other){
+    if(!other.m_n)
+      return;
+    if(!m_n){
+      *this=other;
+      return;
+    }
+    double n=m_n+other.m_n;
+    double delta=other.m_mean-m_mean;
+    m_mean+=delta*other.m_n/n;
+    m_m2+=other.m_m2+delta*delta*m_n*other.m_n/n;
+    m_sum+=other.m_sum;
+    m_n+=other.m_n;
+  };
+  unsigned long int size(void) const{return m_n;};
+  double sum(void) const{return m_sum;};
+  double mean(void) const{return m_mean;};
+  double var(void) const{return (m_n)? m_m2/m_n : 0;};
+  double stdev(void) const{return sqrt(var());};
+private:
+  unsigned long int m_n;
+  double m_mean;
+  double m_m2;
+  double m_sum;
+};
+
+//joint moments of paired samples (x,y): means, (co)variances and the mean squared difference (Welford)
+class Bivariate{
+public:
+  Bivariate(void) : m_n(0), m_meanX(0), m_meanY(0), m_m2X(0), m_m2Y(0), m_cXY(0), m_sse(0){};
+  void reset(void){m_n=0;m_meanX=0;m_meanY=0;m_m2X=0;m_m2Y=0;m_cXY=0;m_sse=0;};
+  void push(double x, double y){
+    ++m_n;
+    double dx=x-m_meanX;
+    double dy=y-m_meanY;
+    m_meanX+=dx/m_n;
+    m_meanY+=dy/m_n;
+    m_m2X+=dx*(x-m_meanX);
+    m_m2Y+=dy*(y-m_meanY);
+    m_cXY+=dx*(y-m_meanY);
+    m_sse+=(x-y)*(x-y);
+  };
+  void merge(const Bivariate& other){
+    if(!other.m_n)
+      return;
+    if(!m_n){
+      *this=other;
+      return;
+    }
+    double n=m_n+other.m_n;
+    double weight=static_cast<double>(m_n)*other.m_n/n;
+    double dx=other.m_meanX-m_meanX;
+    double dy=other.m_meanY-m_meanY;
+    m_meanX+=dx*other.m_n/n;
+    m_meanY+=dy*other.m_n/n;
+    m_m2X+=other.m_m2X+dx*dx*weight;
+    m_m2Y+=other.m_m2Y+dy*dy*weight;
+    m_cXY+=other.m_cXY+dx*dy*weight;
+    m_sse+=other.m_sse;
+    m_n+=other.m_n;
+  };
+  unsigned long int size(void) const{return m_n;};
+  double meanX(void) const{return m_meanX;};
+  double meanY(void) const{return m_meanY;};
+  double varX(void) const{return (m_n)? m_m2X/m_n : 0;};
+  double varY(void) const{return (m_n)? m_m2Y/m_n : 0;};
+  double covariance(void) const{return (m_n)? m_cXY/m_n : 0;};
+  double correlation(void) const{return (m_m2X>0&&m_m2Y>0)? m_cXY/sqrt(m_m2X*m_m2Y) : 0;};
+  //root mean square of x-y
+  double rmse(void) const{return (m_n)? sqrt(m_sse/m_n) : 0;};
+  //least squares fit y=c0+c1*x, returns r^2
+  double linearRegression(double& c0, double& c1) const{
+    c1=(m_m2X>0)? m_cXY/m_m2X : 0;
+    c0=m_meanY-c1*m_meanX;
+    return (m_m2X>0&&m_m2Y>0)? m_cXY*m_cXY/m_m2X/m_m2Y : 0;
+  };
+  //least squares fit y=c0+c1*x, returns the root mean square of the residuals
+  double regressionError(double& c0, double& c1) const{
+    linearRegression(c0,c1);
+    double sumsq=m_m2Y-c1*m_cXY;
+    return (m_n&&sumsq>0)? sqrt(sumsq/m_n) : 0;
+  };
+private:
+  unsigned long int m_n;
+  double m_meanX;
+  double m_meanY;
+  double m_m2X;
+  double m_m2Y;
+  double m_cXY;
+  double m_sse;
+};
+
+//minimum and maximum with the (zero based) position in the stream where they first occurred
+class MinMax{
+public:
+  MinMax(void) : m_n(0), m_min(0), m_max(0), m_argmin(0), m_argmax(0){};
+  void reset(void){m_n=0;m_min=0;m_max=0;m_argmin=0;m_argmax=0;};
+  void push(double value){push(value,m_n);};
+  //position is provided by the caller, e.g., the pixel index in case of skipped nodata values
+  void push(double value, unsigned long int position){
+    if(!m_n||value<m_min){
+      m_min=value;
+      m_argmin=position;
+    }
+    if(!m_n||value>m_max){
+      m_max=value;
+      m_argmax=position;
+    }
+    ++m_n;
+  };
+  template<class T> void push(const std::vector<T>& v){
+    for(typename std::vector<T>::const_iterator it=v.begin();it!=v.end();++it)
+      push(static_cast<double>(*it));
+  };
+  //positions of other are kept: they must refer to the same stream
+  void merge(const MinMax& other){
+    if(!other.m_n)
+      return;
+    if(!m_n||other.m_min<m_min||(other.m_min==m_min&&other.m_argmin<m_argmin)){
+      m_min=other.m_min;
+      m_argmin=other.m_argmin;
+    }
+    if(!m_n||other.m_max>m_max||(other.m_max==m_max&&other.m_argmax<m_argmax)){
+      m_max=other.m_max;
+      m_argmax=other.m_argmax;
+    }
+    m_n+=other.m_n;
+  };
+  unsigned long int size(void) const{return m_n;};
+  double min(void) const{return m_min;};
+  double max(void) const{return m_max;};
+  unsigned long int argmin(void) const{return m_argmin;};
+  unsigned long int argmax(void) const{return m_argmax;};
+private:
+  unsigned long int m_n;
+  double m_min;
+  double m_max;
+  unsigned long int m_argmin;
+  unsigned long int m_argmax;
+};
+
+//histogram with nbin bins of equal width in [minimum,maximum], values outside are not counted
+class Histogram{
+public:
+  Histogram(double minimum, double maximum, int nbin) : m_min(minimum), m_max(maximum), m_n(0), m_count(nbin,0){
+    if(nbin<1){
+      std::string errorString="Error: nbin not defined";
+      throw(errorString);
+    }
+    if(maximum<=minimum){
+      std::string errorString="Error: could not calculate distribution (min>=max)";
+      throw(errorString);
+    }
+  };
+  void reset(void){m_n=0;m_count.assign(m_count.size(),0);};
+  void push(double value){
+    if(value<m_min||value>m_max)
+      return;
+    int theBin=(value==m_max)? m_count.size()-1 : static_cast<int>((value-m_min)/(m_max-m_min)*m_count.size());
+    ++m_count[theBin];
+    ++m_n;
+  };
+  template<class T> void push(const std::vector<T>& v){
+    for(typename std::vector<T>::const_iterator it=v.begin();it!=v.end();++it)
+      push(static_cast<double>(*it));
+  };
+  void merge(const Histogram& other){
+    if(other.m_min!=m_min||other.m_max!=m_max||other.m_count.size()!=m_count.size()){
+      std::string errorString="Error: can not merge histograms with different bins";
+      throw(errorString);
+    }
+    for(unsigned int ibin=0;ibin<m_count.size();++ibin)
+      m_count[ibin]+=other.m_count[ibin];
+    m_n+=other.m_n;
+  };
+  unsigned long int size(void) const{return m_n;};
+  int nbin(void) const{return m_count.size();};
+  unsigned long int count(int ibin) const{return m_count[ibin];};
+  double binCenter(int ibin) const{return m_min+(m_max-m_min)*(ibin+0.5)/m_count.size();};
+  //percentile (0-100), interpolated within the bin: the error is less than the bin width
+  double percentile(double percent) const{
+    if(!m_n){
+      std::string errorString="Error: no valid data found";
+      throw(errorString);
+    }
+    double target=percent/100.0*m_n;
+    double cumul=0;
+    double binWidth=(m_max-m_min)/m_count.size();
+    for(unsigned int ibin=0;ibin<m_count.size();++ibin){
+      if(m_count[ibin]&&cumul+m_count[ibin]>=target)
+        return m_min+binWidth*(ibin+(target-cumul)/m_count[ibin]);
+      cumul+=m_count[ibin];
+    }
+    return m_max;
+  };
+private:
+  double m_min;
+  double m_max;
+  unsigned long int m_n;
+  std::vector<unsigned long int> m_count;
+};
+
+//approximate quantiles in bounded memory (deterministic compactor sketch, as in Manku et al. and KLL).
+//Level h holds at most k samples of weight 2^h: when full, it is sorted and every other sample
+//(alternating between odd and even positions) is promoted to level h+1.
+//Memory is O(k*log2(n/k)). Percentiles are exact (as gsl_stats_quantile_from_sorted_data) for n<k,
+//otherwise the rank error is bounded by n*log2(n/k)/k (in practice much smaller as errors cancel).
+class QuantileSketch{
+public:
+  QuantileSketch(unsigned int k=4096) : m_k((k<2)? 2 : k), m_n(0){};
+  void reset(void){m_n=0;m_levels.clear();m_parity.clear();};
+  void push(double value){
+    if(m_levels.empty()){
+      m_levels.resize(1);
+      m_parity.resize(1,0);
+    }
+    m_levels[0].push_back(value);
+    ++m_n;
+    if(m_levels[0].size()>=m_k)
+      compress();
+  };
+  template<class T> void push(const std::vector<T>& v){
+    for(typename std::vector<T>::const_iterator it=v.begin();it!=v.end();++it)
+      push(static_cast<double>(*it));
+  };
+  void merge(const QuantileSketch& other){
+    if(other.m_levels.size()>m_levels.size()){
+      m_levels.resize(other.m_levels.size());
+      m_parity.resize(other.m_levels.size(),0);
+    }
+    for(unsigned int ilevel=0;ilevel<other.m_levels.size();++ilevel)
+      m_levels[ilevel].insert(m_levels[ilevel].end(),other.m_levels[ilevel].begin(),other.m_levels[ilevel].end());
+    m_n+=other.m_n;
+    compress();
+  };
+  unsigned long int size(void) const{return m_n;};
+  double median(void) const{return percentile(50);};
+  //percentile (0-100)
+  double percentile(double percent) const{
+    if(!m_n){
+      std::string errorString="Error: no valid data found";
+      throw(errorString);
+    }
+    std::vector< std::pair<double,double> > weighted;//value, weight
+    for(unsigned int ilevel=0;ilevel<m_levels.size();++ilevel){
+      double weight=ldexp(1.0,ilevel);
+      for(unsigned int index=0;index<m_levels[ilevel].size();++index)
+        weighted.push_back(std::make_pair(m_levels[ilevel][index],weight));
+    }
+    std::sort(weighted.begin(),weighted.end());
+    //a sample of weight w represents ranks [cumul,cumul+w-1], take the centre and interpolate
+    double target=percent/100.0*(m_n-1);
+    double cumul=0;
+    double previousRank=0;
+    for(unsigned int index=0;index<weighted.size();++index){
+      double rank=cumul+(weighted[index].second-1)/2.0;
+      if(rank>=target){
+        if(!index)
+          return weighted[0].first;
+        double delta=(target-previousRank)/(rank-previousRank);
+        return (1-delta)*weighted[index-1].first+delta*weighted[index].first;
+      }
+      previousRank=rank;
+      cumul+=weighted[index].second;
+    }
+    return weighted.back().first;
+  };
+private:
+  void compress(void){
+    for(unsigned int ilevel=0;ilevel<m_levels.size();++ilevel){
+      if(m_levels[ilevel].size()<m_k)
+        continue;
+      if(ilevel+1==m_levels.size()){
+        m_levels.resize(ilevel+2);
+        m_parity.resize(ilevel+2,0);
+      }
+      std::vector<double>& level=m_levels[ilevel];
+      std::sort(level.begin(),level.end());
+      //keep the largest sample here if the number of samples is odd
+      int npair=level.size()/2;
+      for(int ipair=0;ipair<npair;++ipair)
+        m_levels[ilevel+1].push_back(level[2*ipair+m_parity[ilevel]]);
+      m_parity[ilevel]=1-m_parity[ilevel];
+      level.erase(level.begin(),level.begin()+2*npair);
+    }
+  };
+  unsigned int m_k;
+  unsigned long int m_n;
+  std::vector< std::vector<double> > m_levels;
+  std::vector<unsigned char> m_parity;
+};
+
+//Gaussian kernel density estimate at the centres of nbin bins in [minimum,maximum].
+//Values are linearly binned on a grid that is refine (odd) times finer than the output bins and the
+//binned counts are convolved with the kernel truncated at 5 sigma: the cost no longer depends on the
+//number of values. The binning error is small if sigma spans at least two fine cells (see isAccurate).
+class KernelDensity{
+public:
+  KernelDensity(double minimum, double maximum, int nbin, int refine=9) : m_min(minimum), m_max(maximum), m_nbin(nbin), m_refine(refine|1), m_n(0){
+    if(nbin<1){
+      std::string errorString="Error: nbin not defined";
+      throw(errorString);
+    }
+    if(maximum<=minimum){
+      std::string errorString="Error: could not calculate distribution (min>=max)";
+      throw(errorString);
+    }
+    m_fine.assign(m_nbin*m_refine,0);
+  };
+  void push(double value){
+    if(value<m_min||value>m_max)
+      return;
+    double t=(value-m_min)/spacing()-0.5;
+    int nfine=m_fine.size();
+    if(t<=0)
+      m_fine[0]+=1;
+    else if(t>=nfine-1)
+      m_fine[nfine-1]+=1;
+    else{
+      int index=static_cast<int>(t);
+      double delta=t-index;
+      m_fine[index]+=1-delta;
+      m_fine[index+1]+=delta;
+    }
+    ++m_n;
+  };
+  template<class T> void push(const std::vector<T>& v){
+    for(typename std::vector<T>::const_iterator it=v.begin();it!=v.end();++it)
+      push(static_cast<double>(*it));
+  };
+  void merge(const KernelDensity& other){
+    if(other.m_min!=m_min||other.m_max!=m_max||other.m_fine.size()!=m_fine.size()){
+      std::string errorString="Error: can not merge kernel densities with different bins";
+      throw(errorString);
+    }
+    for(int index=0;index<m_fine.size();++index)
+      m_fine[index]+=other.m_fine[index];
+    m_n+=other.m_n;
+  };
+  unsigned long int size(void) const{return m_n;};
+  double spacing(void) const{return (m_max-m_min)/m_fine.size();};
+  bool isAccurate(double sigma) const{return sigma>=2*spacing();};
+  //output[ibin] approximates the sum of gsl_ran_gaussian_pdf(value-centre,sigma) over all pushed values
+  void density(double sigma, std::vector<double>& output) const{
+    output.assign(m_nbin,0);
+    if(sigma<=0)
+      return;
+    double step=spacing();
+    int nfine=m_fine.size();
+    int window=static_cast<int>(ceil(5*sigma/step));
+    if(window>nfine)
+      window=nfine;
+    std::vector<double> kernel(window+1);
+    for(int d=0;d<=window;++d)
+      kernel[d]=gsl_ran_gaussian_pdf(d*step,sigma);
+    for(int ibin=0;ibin<m_nbin;++ibin){
+      int centre=ibin*m_refine+m_refine/2;
+      int first=(centre-window<0)? 0 : centre-window;
+      int last=(centre+window>=nfine)? nfine-1 : centre+window;
+      double value=0;
+      for(int index=first;index<=last;++index)
+        value+=m_fine[index]*kernel[(index<centre)? centre-index : index-centre];
+      output[ibin]=value;
+    }
+  };
+private:
+  double m_min;
+  double m_max;
+  int m_nbin;
+  int m_refine;
+  unsigned long int m_n;
+  std::vector<double> m_fine;
+};
+
+//two dimensional histogram with nbin x nbin bins of equal width in [minX,maxX] x [minY,maxY],
+//values outside the range are counted in the first or last bin.
+//If refine>0, values are also linearly binned on a grid that is refine (odd) times finer than the bins
+//for a (separable) Gaussian kernel density estimate, see density() and KernelDensity.
+class Histogram2d{
+public:
+  Histogram2d(double minX, double maxX, double minY, double maxY, int nbin, int refine=0) : m_minX(minX), m_maxX(maxX), m_minY(minY), m_maxY(maxY), m_nbin(nbin), m_refine((refine>0)? refine|1 : 0), m_n(0){
+    if(nbin<1){
+      std::string errorString="Error: nbin not defined";
+      throw(errorString);
+    }
+    if(maxX<=minX){
+      std::string errorString="Error: could not calculate distribution (minX>=maxX)";
+      throw(errorString);
+    }
+    if(maxY<=minY){
+      std::string errorString="Error: could not calculate distribution (minY>=maxY)";
+      throw(errorString);
+    }
+    m_count.assign(m_nbin*m_nbin,0);
+    m_fine.assign(m_nbin*m_refine*m_nbin*m_refine,0);
+  };
+  void reset(void){m_n=0;m_count.assign(m_count.size(),0);m_fine.assign(m_fine.size(),0);};
+  void push(double x, double y){
+    int binX=bin(x,m_minX,m_maxX,m_nbin);
+    int binY=bin(y,m_minY,m_maxY,m_nbin);
+    ++m_count[binX*m_nbin+binY];
+    ++m_n;
+    if(!m_refine)
+      return;
+    int nfine=m_nbin*m_refine;
+    double tX=0;
+    double tY=0;
+    int indexX=fine(x,m_minX,m_maxX,nfine,tX);
+    int indexY=fine(y,m_minY,m_maxY,nfine,tY);
+    int nextX=(indexX+1<nfine)? indexX+1 : indexX;
+    int nextY=(indexY+1<nfine)? indexY+1 : indexY;
+    m_fine[indexX*nfine+indexY]+=(1-tX)*(1-tY);
+    m_fine[indexX*nfine+nextY]+=(1-tX)*tY;
+    m_fine[nextX*nfine+indexY]+=tX*(1-tY);
+    m_fine[nextX*nfine+nextY]+=tX*tY;
+  };
+  void merge(const Histogram2d& other){
+    if(other.m_minX!=m_minX||other.m_maxX!=m_maxX||other.m_minY!=m_minY||other.m_maxY!=m_maxY||other.m_nbin!=m_nbin||other.m_refine!=m_refine){
+      std::string errorString="Error: can not merge histograms with different bins";
+      throw(errorString);
+    }
+    for(int index=0;index<m_count.size();++index)
+      m_count[index]+=other.m_count[index];
+    for(int index=0;index<m_fine.size();++index)
+      m_fine[index]+=other.m_fine[index];
+    m_n+=other.m_n;
+  };
+  unsigned long int size(void) const{return m_n;};
+  int nbin(void) const{return m_nbin;};
+  unsigned long int count(int binX, int binY) const{return m_count[binX*m_nbin+binY];};
+  double binCenterX(int ibin) const{return m_minX+(m_maxX-m_minX)*(ibin+0.5)/m_nbin;};
+  double binCenterY(int ibin) const{return m_minY+(m_maxY-m_minY)*(ibin+0.5)/m_nbin;};
+  bool isAccurate(double sigma) const{
+    if(!m_refine)
+      return false;
+    double spacingX=(m_maxX-m_minX)/m_nbin/m_refine;
+    double spacingY=(m_maxY-m_minY)/m_nbin/m_refine;
+    return sigma>=2*spacingX&&sigma>=2*spacingY;
+  };
+  //output[binX][binY] approximates the sum of gsl_ran_gaussian_pdf(x-centreX,sigma)*gsl_ran_gaussian_pdf(y-centreY,sigma) over all pushed values
+  void density(double sigma, std::vector< std::vector<double> >& output) const{
+    output.assign(m_nbin,std::vector<double>(m_nbin,0));
+    if(sigma<=0||!m_refine)
+      return;
+    int nfine=m_nbin*m_refine;
+    std::vector<double> kernelX;
+    std::vector<double> kernelY;
+    int windowX=kernel(sigma,(m_maxX-m_minX)/nfine,nfine,kernelX);
+    int windowY=kernel(sigma,(m_maxY-m_minY)/nfine,nfine,kernelY);
+    //the kernel is separable: convolve along y (only at the output bin centres), then along x
+    std::vector<double> partial(nfine*m_nbin,0);
+    for(int indexX=0;indexX<nfine;++indexX){
+      const double* row=&(m_fine[indexX*nfine]);
+      for(int binY=0;binY<m_nbin;++binY){
+        int centre=binY*m_refine+m_refine/2;
+        int first=(centre-windowY<0)? 0 : centre-windowY;
+        int last=(centre+windowY>=nfine)? nfine-1 : centre+windowY;
+        double value=0;
+        for(int indexY=first;indexY<=last;++indexY)
+          value+=row[indexY]*kernelY[(indexY<centre)? centre-indexY : indexY-centre];
+        partial[indexX*m_nbin+binY]=value;
+      }
+    }
+    for(int binX=0;binX<m_nbin;++binX){
+      int centre=binX*m_refine+m_refine/2;
+      int first=(centre-windowX<0)? 0 : centre-windowX;
+      int last=(centre+windowX>=nfine)? nfine-1 : centre+windowX;
+      for(int indexX=first;indexX<=last;++indexX){
+        double weight=kernelX[(indexX<centre)? centre-indexX : indexX-centre];
+        const double* row=&(partial[indexX*m_nbin]);
+        for(int binY=0;binY<m_nbin;++binY)
+          output[binX][binY]+=weight*row[binY];
+      }
+    }
+  };
+private:
+  static int bin(double value, double minimum, double maximum, int nbin){
+    if(value>=maximum)
+      return nbin-1;
+    if(value<=minimum)
+      return 0;
+    int theBin=static_cast<int>((value-minimum)/(maximum-minimum)*nbin);
+    return (theBin<nbin)? theBin : nbin-1;
+  };
+  //index of the fine cell centre left of value and the fractional distance to the next one
+  static int fine(double value, double minimum, double maximum, int nfine, double& delta){
+    double t=(value-minimum)/(maximum-minimum)*nfine-0.5;
+    delta=0;
+    if(t<=0)
+      return 0;
+    if(t>=nfine-1)
+      return nfine-1;
+    int index=static_cast<int>(t);
+    delta=t-index;
+    return index;
+  };
+  static int kernel(double sigma, double step, int nfine, std::vector<double>& weights){
+    int window=static_cast<int>(ceil(5*sigma/step));
+    if(window>nfine)
+      window=nfine;
+    weights.resize(window+1);
+    for(int d=0;d<=window;++d)
+      weights[d]=gsl_ran_gaussian_pdf(d*step,sigma);
+    return window;
+  };
+  double m_minX;
+  double m_maxX;
+  double m_minY;
+  double m_maxY;
+  int m_nbin;
+  int m_refine;
+  unsigned long int m_n;
+  std::vector<unsigned long int> m_count;
+  std::vector<double> m_fine;
+};
+
+//counter based random numbers (Philox4x32-10, Salmon et al., 2011): the index-th value of a stream is a
+//function of (seed, stream, index) only. Rows, tiles or bags can thus be generated in any order and in
+//parallel, with a result that does not depend on the number of threads.
+class RandomStream{
+public:
+  RandomStream(unsigned long int seed=0, unsigned long int stream=0) : m_seed(seed), m_stream(stream){};
+  void setStream(unsigned long int stream){m_stream=stream;};
+  //uniform in ]0,1[
+  double uniform(unsigned long int index) const{
+    uint32_t block[4];
+    generate(index/2,block);
+    return toUniform(block+2*(index%2));
+  };
+  //n values of the stream, starting from index first
+  void uniform(double* output, unsigned long int n, double a=0, double b=1, unsigned long int first=0) const{
+    uint32_t block[4];
+    for(unsigned long int i=0;i<n;++i){
+      unsigned long int index=first+i;
+      if(!i||!(index%2))
+        generate(index/2,block);
+      output[i]=a+(b-a)*toUniform(block+2*(index%2));
+    }
+  };
+  //normal variates (Box-Muller on the two uniforms of a block)
+  void gaussian(double* output, unsigned long int n, double mean=0, double sigma=1, unsigned long int first=0) const{
+    uint32_t block[4];
+    double radius=0;
+    double angle=0;
+    for(unsigned long int i=0;i<n;++i){
+      unsigned long int index=first+i;
+      if(!i||!(index%2)){
+        generate(index/2,block);
+        radius=sqrt(-2*log(toUniform(block)));
+        angle=2*M_PI*toUniform(block+2);
+      }
+      output[i]=mean+sigma*radius*((index%2)? sin(angle) : cos(angle));
+    }
+  };
+  double gaussian(unsigned long int index, double mean=0, double sigma=1) const{
+    double value=0;
+    gaussian(&value,1,mean,sigma,index);
+    return value;
+  };
+  //uniform integer in [0,n[
+  unsigned long int integer(unsigned long int index, unsigned long int n) const{
+    unsigned long int value=static_cast<unsigned long int>(uniform(index)*n);
+    return (value<n)? value : n-1;
+  };
+  //raw Philox4x32-10 block: counter in words 0-1, stream in words 2-3, seed as key
+  void block(unsigned long int counter, uint32_t output[4]) const{generate(counter,output);};
+  //Fisher-Yates shuffle
+  template<class RandomIt> void shuffle(RandomIt first, RandomIt last) const{
+    unsigned long int n=last-first;
+    for(unsigned long int i=n;i>1;--i)
+      std::swap(first[i-1],first[integer(n-i,i)]);
+  };
+private:
+  static double toUniform(const uint32_t* words){
+    uint64_t bits=((static_cast<uint64_t>(words[0])<<32)|words[1])>>11;
+    return (bits+0.5)/9007199254740992.0;//2^53
+  };
+  void generate(unsigned long int counter, uint32_t block[4]) const{
+    uint64_t counter64=counter;
+    uint64_t stream64=m_stream;
+    uint64_t seed64=m_seed;
+    block[0]=static_cast<uint32_t>(counter64);
+    block[1]=static_cast<uint32_t>(counter64>>32);
+    block[2]=static_cast<uint32_t>(stream64);
+    block[3]=static_cast<uint32_t>(stream64>>32);
+    uint32_t key[2]={static_cast<uint32_t>(seed64),static_cast<uint32_t>(seed64>>32)};
+    for(int round=0;round<10;++round){
+      if(round){
+        key[0]+=0x9E3779B9;
+        key[1]+=0xBB67AE85;
+      }
+      uint64_t product0=static_cast<uint64_t>(0xD2511F53)*block[0];
+      uint64_t product1=static_cast<uint64_t>(0xCD9E8D57)*block[2];
+      uint32_t next[4];
+      next[0]=static_cast<uint32_t>(product1>>32)^block[1]^key[0];
+      next[1]=static_cast<uint32_t>(product1);
+      next[2]=static_cast<uint32_t>(product0>>32)^block[3]^key[1];
+      next[3]=static_cast<uint32_t>(product0);
+      for(int iword=0;iword<4;++iword)
+        block[iword]=next[iword];
+    }
+  };
+  unsigned long int m_seed;
+  unsigned long int m_stream;
+};
+
 class StatFactory{
 
 public:
@@ -89,6 +718,23 @@ public:
     }
     assert(spline);
   };
+  //interpolated values are a linear combination of the data values (not so for akima, false for unknown types)
+  static bool isLinearInterpolation(const std::string type){
+    std::map<std::string, INTERPOLATION_TYPE> m_interpMap;
+    initMap(m_interpMap);
+    std::map<std::string, INTERPOLATION_TYPE>::const_iterator mit=m_interpMap.find(type);
+    if(mit==m_interpMap.end())
+      return false;
+    switch(mit->second){
+    case(linear):
+    case(polynomial):
+    case(cspline):
+    case(cspline_periodic):
+      return true;
+    default:
+      return false;
+    }
+  };
   static int initSpline(gsl_spline *spline, const double *x, const double *y, int size){
     return gsl_spline_init (spline, x, y, size);
   };
@@ -161,12 +807,27 @@ public:
   template<class T> void eraseNoData(std::vector<T>& v) const;
   template<class T> unsigned int nvalid(const std::vector<T>& v) const;
   template<class T> T median(const std::vector<T>& v) const;
+  //order statistics of the valid values (no nodata, within [minimum,maximum] if maximum>minimum),
+  //the caller owns the scratch buffer so that it can be reused (e.g., for every pixel in a filter)
+  template<class T> T median(const std::vector<T>& v, std::vector<double>& scratch) const;
+  template<class T> double percentile(const std::vector<T>& input, double percent, std::vector<double>& scratch, double minimum=0, double maximum=0) const;
+  template<class T> void percentiles(const std::vector<T>& input, const std::vector<double>& percent, std::vector<double>& output, std::vector<double>& scratch, double minimum=0, double maximum=0) const;
   template<class T> double var(const std::vector<T>& v) const;
   template<class T> double moment(const std::vector<T>& v, int n) const;
   template<class T> double cmoment(const std::vector<T>& v, int n) const;
   template<class T> double skewness(const std::vector<T>& v) const;
   template<class T> double kurtosis(const std::vector<T>& v) const;
   template<class T> void meanVar(const std::vector<T>& v, double& m1, double& v1) const;
+  //same reductions with a caller owned scratch buffer for the nodata mask (e.g., reused for every pixel in a filter)
+  template<class T> T mymin(const std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> T mymax(const std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> void minmax(const std::vector<T>& v, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end, T& theMin, T& theMax, std::vector<unsigned char>& mask) const;
+  template<class T> T sum(const std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> double mean(const std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> void eraseNoData(std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> unsigned int nvalid(const std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> double var(const std::vector<T>& v, std::vector<unsigned char>& mask) const;
+  template<class T> void meanVar(const std::vector<T>& v, double& m1, double& v1, std::vector<unsigned char>& mask) const;
   template<class T1, class T2> void  scale2byte(const std::vector<T1>& input, std::vector<T2>& output, unsigned char lbound=0, unsigned char ubound=255) const;
   template<class T> void distribution(const std::vector<T>& input, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end,  std::vector<double>& output, int nbin, T &minimum, T &maximum, double sigma=0, const std::string &filename="") const;
   template<class T> void distribution(const std::vector<T>& input,  std::vector<double>& output, int nbin, double sigma=0, const std::string &filename="") const{distribution(input,input.begin(),input.end(),output,nbin,0,0,sigma,filename);};
@@ -185,10 +846,13 @@ public:
   //  template<class T> double gsl_correlation(const std::vector<T>& x, const std::vector<T>& y) const;
   template<class T> double gsl_covariance(const std::vector<T>& x, const std::vector<T>& y) const;
   template<class T> double cross_correlation(const std::vector<T>& x, const std::vector<T>& y, int maxdelay, std::vector<T>& z) const;
+  template<class T> void cross_correlation(const std::vector< std::vector<T> >& x, const std::vector< std::vector<T> >& y, int maxdelay, std::vector< std::vector<T> >& z, std::vector<double>& sumCorrelation) const;
   template<class T> double linear_regression(const std::vector<T>& x, const std::vector<T>& y, double &c0, double &c1) const;
   template<class T> double linear_regression_err(const std::vector<T>& x, const std::vector<T>& y, double &c0, double &c1) const;
   template<class T> void interpolateNoData(const std::vector<double>& wavelengthIn, const std::vector<T>& input, const std::string& type, std::vector<T>& output, bool verbose=false) const;
   template<class T> void interpolateUp(const std::vector<double>& wavelengthIn, const std::vector<T>& input, const std::vector<double>& wavelengthOut, const std::string& type, std::vector<T>& output, bool verbose=false) const;
+  //same with spline (of size wavelengthIn.size()) and accelerator allocated by the caller, e.g., once for all samples
+  template<class T> void interpolateUp(const std::vector<double>& wavelengthIn, const std::vector<T>& input, const std::vector<double>& wavelengthOut, gsl_spline* spline, gsl_interp_accel* acc, std::vector<T>& output) const;
   template<class T> void interpolateUp(const std::vector<double>& wavelengthIn, const std::vector< std::vector<T> >& input, const std::vector<double>& wavelengthOut, const std::string& type, std::vector< std::vector<T> >& output, bool verbose=false) const;
   // template<class T> void interpolateUp(const std::vector< std::vector<T> >& input, std::vector< std::vector<T> >& output, double start, double end, double step, const gsl_interp_type* type);
   // template<class T> void interpolateUp(const std::vector< std::vector<T> >& input, const std::vector<double>& wavelengthIn, std::vector< std::vector<T> >& output, std::vector<double>& wavelengthOut, double start, double end, double step, const gsl_interp_type* type);
@@ -199,6 +863,18 @@ public:
   template<class T> void interpolateDown(double* input, int dim, std::vector<T>& output, int nbin);
 
 private:
+  //the reductions below run plain counted loops over contiguous data, with the nodata values folded
+  //in as a 0/1 mask instead of a branch per element, so that the compiler can vectorise them
+  //(omp simd allows reordering the floating point reductions when built with OpenMP)
+  template<class T> unsigned long int validMask(const T* data, unsigned long int n, std::vector<unsigned char>& mask) const;
+  template<class T> unsigned long int validSums(const T* data, unsigned long int n, double& sum1, double& sum2, bool squares, std::vector<unsigned char>& mask) const;
+  template<class T> bool validMinMax(const T* data, unsigned long int n, T& theMin, T& theMax, std::vector<unsigned char>& mask) const;
+  template<class T> bool validMinMax(const T* data, unsigned long int n, T& theMin, T& theMax, double minConstraint, double maxConstraint, std::vector<unsigned char>& mask) const;
+  template<class InputIterator> unsigned long int copyValid(InputIterator begin, InputIterator end, std::vector<double>& scratch, double minimum, double maximum) const;
+  static double quantileFromSorted(const std::vector<double>& data, double fraction);
+  static double quantileSelect(std::vector<double>& data, double fraction);
+  template<class T> double crossCorrelationFFT(const std::vector<T>& x, const std::vector<T>& y, int maxdelay, std::vector<T>& z, std::vector<double>& work) const;
+  static void crossSpectrumFFT(std::vector<double>& data, int fftSize);
   static void initMap(std::map<std::string, INTERPOLATION_TYPE>& m_interpMap){
     //initialize selMap
     m_interpMap["linear"]=linear;
@@ -217,6 +893,122 @@ private:
 };
 
 
+//sets mask to 1 for valid values and returns their number
+template<class T> unsigned long int StatFactory::validMask(const T* data, unsigned long int n, std::vector<unsigned char>& mask) const
+{
+  mask.assign(n,1);
+  unsigned char* valid=&(mask[0]);
+  for(int inodata=0;inodata<m_noDataValues.size();++inodata){
+    double value=m_noDataValues[inodata];
+    //not representable in T (out of range or not integer for integer types), can not occur
+    if(!(value>=static_cast<double>(std::numeric_limits<T>::lowest())&&value<=static_cast<double>(std::numeric_limits<T>::max())))
+      continue;
+    T theNoData=static_cast<T>(value);
+    if(static_cast<double>(theNoData)!=value)
+      continue;
+    for(unsigned long int i=0;i<n;++i)
+      valid[i]&=(data[i]!=theNoData);
+  }
+  unsigned long int nvalid=0;
+  for(unsigned long int i=0;i<n;++i)
+    nvalid+=valid[i];
+  return nvalid;
+}
+
+//sum (and sum of squares) of the valid values, accumulated in double, returns the number of valid values
+template<class T> unsigned long int StatFactory::validSums(const T* data, unsigned long int n, double& sum1, double& sum2, bool squares, std::vector<unsigned char>& mask) const
+{
+  double s1=0;
+  double s2=0;
+  unsigned long int nvalid=n;
+  if(m_noDataValues.empty()){
+    if(squares){
+#pragma omp simd reduction(+:s1,s2)
+      for(unsigned long int i=0;i<n;++i){
+        double x=data[i];
+        s1+=x;
+        s2+=x*x;
+      }
+    }
+    else{
+#pragma omp simd reduction(+:s1)
+      for(unsigned long int i=0;i<n;++i)
+        s1+=data[i];
+    }
+  }
+  else{
+    nvalid=validMask(data,n,mask);
+    const unsigned char* valid=&(mask[0]);
+#pragma omp simd reduction(+:s1,s2)
+    for(unsigned long int i=0;i<n;++i){
+      double x=(valid[i])? static_cast<double>(data[i]) : 0.0;
+      s1+=x;
+      s2+=x*x;
+    }
+  }
+  sum1=s1;
+  sum2=s2;
+  return nvalid;
+}
+
+template<class T> bool StatFactory::validMinMax(const T* data, unsigned long int n, T& theMin, T& theMax, std::vector<unsigned char>& mask) const
+{
+  const T lowest=(std::numeric_limits<T>::has_infinity)? -std::numeric_limits<T>::infinity() : (std::numeric_limits<T>::is_integer? std::numeric_limits<T>::min() : -std::numeric_limits<T>::max());
+  const T highest=(std::numeric_limits<T>::has_infinity)? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+  T minValue=highest;
+  T maxValue=lowest;
+  unsigned long int nvalid=n;
+  if(m_noDataValues.empty()){
+#pragma omp simd reduction(min:minValue) reduction(max:maxValue)
+    for(unsigned long int i=0;i<n;++i){
+      minValue=(data[i]<minValue)? data[i] : minValue;
+      maxValue=(data[i]>maxValue)? data[i] : maxValue;
+    }
+  }
+  else{
+    nvalid=validMask(data,n,mask);
+    const unsigned char* valid=&(mask[0]);
+#pragma omp simd reduction(min:minValue) reduction(max:maxValue)
+    for(unsigned long int i=0;i<n;++i){
+      T low=(valid[i])? data[i] : highest;
+      T high=(valid[i])? data[i] : lowest;
+      minValue=(low<minValue)? low : minValue;
+      maxValue=(high>maxValue)? high : maxValue;
+    }
+  }
+  if(!nvalid)
+    return false;
+  theMin=minValue;
+  theMax=maxValue;
+  return true;
+}
+
+//only values within [minConstraint,maxConstraint] are considered
+template<class T> bool StatFactory::validMinMax(const T* data, unsigned long int n, T& theMin, T& theMax, double minConstraint, double maxConstraint, std::vector<unsigned char>& mask) const
+{
+  const T lowest=(std::numeric_limits<T>::has_infinity)? -std::numeric_limits<T>::infinity() : (std::numeric_limits<T>::is_integer? std::numeric_limits<T>::min() : -std::numeric_limits<T>::max());
+  const T highest=(std::numeric_limits<T>::has_infinity)? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+  validMask(data,n,mask);
+  unsigned char* valid=&(mask[0]);
+  unsigned long int nvalid=0;
+  T minValue=highest;
+  T maxValue=lowest;
+#pragma omp simd reduction(+:nvalid) reduction(min:minValue) reduction(max:maxValue)
+  for(unsigned long int i=0;i<n;++i){
+    valid[i]&=(data[i]>=minConstraint)&(data[i]<=maxConstraint);
+    nvalid+=valid[i];
+    T low=(valid[i])? data[i] : highest;
+    T high=(valid[i])? data[i] : lowest;
+    minValue=(low<minValue)? low : minValue;
+    maxValue=(high>maxValue)? high : maxValue;
+  }
+  if(!nvalid)
+    return false;
+  theMin=minValue;
+  theMax=maxValue;
+  return true;
+}
+
 template<class T> inline typename std::vector<T>::const_iterator StatFactory::mymin(const std::vector<T>& v, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end) const
 {
   bool isValid=false;
@@ -439,25 +1231,19 @@ template<class T> inline typename std::vector<T>::iterator StatFactory::mymax(co
 
 template<class T> inline T StatFactory::mymin(const std::vector<T>& v) const
 {
-  bool isValid=false;
+  std::vector<unsigned char> mask;
+  return mymin(v,mask);
+}
+
+template<class T> inline T StatFactory::mymin(const std::vector<T>& v, std::vector<unsigned char>& mask) const
+{
   if(v.empty()){
     std::string errorString="Error: vector is empty";
     throw(errorString);
   }
   T minValue;
-  for (typename std::vector<T>::const_iterator it = v.begin(); it!=v.end(); ++it){
-    if(isNoData(*it))
-      continue;
-    if(isValid){
-      if(minValue>*it)
-      minValue=*it;
-    }
-    else{
-      minValue=*it;
-      isValid=true;
-    }
-  }
-  if(isValid)
+  T maxValue;
+  if(validMinMax(&(v[0]),v.size(),minValue,maxValue,mask))
     return minValue;
   else if(m_noDataValues.size())
     return m_noDataValues[0];
@@ -497,25 +1283,19 @@ template<class T> inline T StatFactory::mymin(const std::vector<T>& v) const
 
 template<class T> inline T StatFactory::mymax(const std::vector<T>& v) const
 {
-  bool isValid=false;
+  std::vector<unsigned char> mask;
+  return mymax(v,mask);
+}
+
+template<class T> inline T StatFactory::mymax(const std::vector<T>& v, std::vector<unsigned char>& mask) const
+{
   if(v.empty()){
     std::string errorString="Error: vector is empty";
     throw(errorString);
   }
+  T minValue;
   T maxValue;
-  for (typename std::vector<T>::const_iterator it = v.begin(); it!=v.end(); ++it){
-    if(isNoData(*it))
-      continue;
-    if(isValid){
-      if(maxValue<*it)
-      maxValue=*it;
-    }
-    else{
-      maxValue=*it;
-      isValid=true;
-    }
-  }
-  if(isValid)
+  if(validMinMax(&(v[0]),v.size(),minValue,maxValue,mask))
     return maxValue;
   else if(m_noDataValues.size())
     return m_noDataValues[0];
@@ -630,37 +1410,22 @@ template<class T> inline T StatFactory::absmax(const std::vector<T>& v) const
 }
  
 template<class T> inline void StatFactory::minmax(const std::vector<T>& v, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end, T& theMin, T& theMax) const
+{
+  std::vector<unsigned char> mask;
+  minmax(v,begin,end,theMin,theMax,mask);
+}
+
+template<class T> inline void StatFactory::minmax(const std::vector<T>& v, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end, T& theMin, T& theMax, std::vector<unsigned char>& mask) const
 {
   bool isConstraint=(theMax>theMin);
   double minConstraint=theMin;
   double maxConstraint=theMax;
   bool isValid=false;
-  for (typename std::vector<T>::const_iterator it = begin; it!=end; ++it){
-    if(isNoData(*it))
-      continue;
-    if(isValid){
-      if(isConstraint){
-	if(*it<minConstraint)
-	  continue;
-	if(*it>maxConstraint)
-	  continue;
-      }
-      if(*it<theMin)
-	theMin=*it;
-      if(*it>theMax)
-	theMax=*it;
-    }
-    else{
-      if(isConstraint){
-	if(*it<minConstraint)
-	  continue;
-	if(*it>maxConstraint)
-	  continue;
-      }
-      theMin=*it;
-      theMax=*it;
-      isValid=true;
-    }
+  if(begin!=end){
+    if(isConstraint)
+      isValid=validMinMax(&(*begin),end-begin,theMin,theMax,minConstraint,maxConstraint,mask);
+    else
+      isValid=validMinMax(&(*begin),end-begin,theMin,theMax,mask);
   }
   if(!isValid){
     if(m_noDataValues.size()){
@@ -676,16 +1441,16 @@ template<class T> inline void StatFactory::minmax(const std::vector<T>& v, typen
 
 template<class T> inline T StatFactory::sum(const std::vector<T>& v) const
 {
-  bool isValid=false;
-  typename std::vector<T>::const_iterator it;
-  T tmpSum=0;
-  for (it = v.begin(); it!= v.end(); ++it){
-    if(isNoData(*it))
-      continue;
-    isValid=true;
-    tmpSum+=*it;
-  }
-  if(isValid)
+  std::vector<unsigned char> mask;
+  return sum(v,mask);
+}
+
+template<class T> inline T StatFactory::sum(const std::vector<T>& v, std::vector<unsigned char>& mask) const
+{
+  double tmpSum=0;
+  double tmpSum2=0;
+  unsigned long int validSize=(v.empty())? 0 : validSums(&(v[0]),v.size(),tmpSum,tmpSum2,false,mask);
+  if(validSize)
     return tmpSum;
   else if(m_noDataValues.size())
     return m_noDataValues[0];
@@ -697,17 +1462,17 @@ template<class T> inline T StatFactory::sum(const std::vector<T>& v) const
 
 template<class T> inline double StatFactory::mean(const std::vector<T>& v) const
 {
-  typename std::vector<T>::const_iterator it;
-  T tmpSum=0;
-  unsigned int validSize=0;
-  for (it = v.begin(); it!= v.end(); ++it){
-    if(isNoData(*it))
-      continue;
-    ++validSize;
-    tmpSum+=*it;
-  }
+  std::vector<unsigned char> mask;
+  return mean(v,mask);
+}
+
+template<class T> inline double StatFactory::mean(const std::vector<T>& v, std::vector<unsigned char>& mask) const
+{
+  double tmpSum=0;
+  double tmpSum2=0;
+  unsigned long int validSize=(v.empty())? 0 : validSums(&(v[0]),v.size(),tmpSum,tmpSum2,false,mask);
   if(validSize)
-    return static_cast<double>(tmpSum)/validSize;
+    return tmpSum/validSize;
   else if(m_noDataValues.size())
     return m_noDataValues[0];
   else{
@@ -718,33 +1483,51 @@ template<class T> inline double StatFactory::mean(const std::vector<T>& v) const
 
 template<class T> inline void StatFactory::eraseNoData(std::vector<T>& v) const
 {
-  if(m_noDataValues.size()){
-    typename std::vector<T>::iterator it=v.begin();
-    while(it!=v.end()){
-      if(isNoData(*it))
-	v.erase(it);
-      else
-	++it;
+  std::vector<unsigned char> mask;
+  eraseNoData(v,mask);
+}
+
+template<class T> inline void StatFactory::eraseNoData(std::vector<T>& v, std::vector<unsigned char>& mask) const
+{
+  if(m_noDataValues.size()&&v.size()){
+    validMask(&(v[0]),v.size(),mask);
+    unsigned long int nvalid=0;
+    for(unsigned long int i=0;i<v.size();++i){
+      if(mask[i])
+        v[nvalid++]=v[i];
     }
+    v.resize(nvalid);
   }
 }
 
- template<class T> unsigned int StatFactory::nvalid(const std::vector<T>& v) const{
-  std::vector<T> tmpV=v;
-  eraseNoData(tmpV);
-  return(tmpV.size());
- }
+template<class T> unsigned int StatFactory::nvalid(const std::vector<T>& v) const{
+  std::vector<unsigned char> mask;
+  return(nvalid(v,mask));
+}
+
+template<class T> unsigned int StatFactory::nvalid(const std::vector<T>& v, std::vector<unsigned char>& mask) const{
+  if(v.empty()||m_noDataValues.empty())
+    return(v.size());
+  return(validMask(&(v[0]),v.size(),mask));
+}
 
 template<class T> T StatFactory::median(const std::vector<T>& v) const
 {
-  std::vector<T> tmpV=v;
-  eraseNoData(tmpV);
-  if(tmpV.size()){
-    sort(tmpV.begin(),tmpV.end());
-    if(tmpV.size()%2)
-      return tmpV[tmpV.size()/2];
+  std::vector<double> scratch;
+  return median(v,scratch);
+}
+
+template<class T> T StatFactory::median(const std::vector<T>& v, std::vector<double>& scratch) const
+{
+  unsigned long int nvalid=copyValid(v.begin(),v.end(),scratch,0,0);
+  if(nvalid){
+    //partial selection instead of a full sort
+    typename std::vector<double>::iterator mid=scratch.begin()+nvalid/2;
+    std::nth_element(scratch.begin(),mid,scratch.end());
+    if(nvalid%2)
+      return *mid;
     else
-      return 0.5*(tmpV[tmpV.size()/2-1]+tmpV[tmpV.size()/2]);
+      return 0.5*(*std::max_element(scratch.begin(),mid)+*mid);
   }
   else if(m_noDataValues.size())
     return m_noDataValues[0];
@@ -754,19 +1537,91 @@ template<class T> T StatFactory::median(const std::vector<T>& v) const
   }
 }
 
+template<class T> double StatFactory::percentile(const std::vector<T>& input, double percent, std::vector<double>& scratch, double minimum, double maximum) const
+{
+  if(!copyValid(input.begin(),input.end(),scratch,minimum,maximum)){
+    if(m_noDataValues.size())
+      return m_noDataValues[0];
+    std::string errorString="Error: no valid data found";
+    throw(errorString);
+  }
+  return quantileSelect(scratch,percent/100.0);
+}
+
+//several percentiles with a single sort
+template<class T> void StatFactory::percentiles(const std::vector<T>& input, const std::vector<double>& percent, std::vector<double>& output, std::vector<double>& scratch, double minimum, double maximum) const
+{
+  output.resize(percent.size());
+  if(!copyValid(input.begin(),input.end(),scratch,minimum,maximum)){
+    if(m_noDataValues.size()){
+      output.assign(percent.size(),m_noDataValues[0]);
+      return;
+    }
+    std::string errorString="Error: no valid data found";
+    throw(errorString);
+  }
+  if(percent.size()==1){
+    output[0]=quantileSelect(scratch,percent[0]/100.0);
+    return;
+  }
+  std::sort(scratch.begin(),scratch.end());
+  for(int iperc=0;iperc<percent.size();++iperc)
+    output[iperc]=quantileFromSorted(scratch,percent[iperc]/100.0);
+}
+
+//copies the values that are not nodata (and within [minimum,maximum] if maximum>minimum) in a single pass
+template<class InputIterator> unsigned long int StatFactory::copyValid(InputIterator begin, InputIterator end, std::vector<double>& scratch, double minimum, double maximum) const
+{
+  scratch.clear();
+  bool checkRange=(maximum>minimum);
+  for(InputIterator it=begin;it!=end;++it){
+    double value=*it;
+    if(checkRange&&(value<minimum||value>maximum))
+      continue;
+    if(isNoData(value))
+      continue;
+    scratch.push_back(value);
+  }
+  return scratch.size();
+}
+
+//as gsl_stats_quantile_from_sorted_data
+inline double StatFactory::quantileFromSorted(const std::vector<double>& data, double fraction)
+{
+  double index=fraction*(data.size()-1);
+  unsigned long int lhs=static_cast<unsigned long int>(index);
+  double delta=index-lhs;
+  if(lhs+1>=data.size())
+    return data.back();
+  return (1-delta)*data[lhs]+delta*data[lhs+1];
+}
+
+//as quantileFromSorted, but with a partial selection (introselect) of the (unsorted) data
+inline double StatFactory::quantileSelect(std::vector<double>& data, double fraction)
+{
+  double index=fraction*(data.size()-1);
+  unsigned long int lhs=static_cast<unsigned long int>(index);
+  double delta=index-lhs;
+  if(lhs+1>=data.size())
+    return *std::max_element(data.begin(),data.end());
+  std::nth_element(data.begin(),data.begin()+lhs,data.end());
+  double value=data[lhs];
+  if(delta>0)
+    value=(1-delta)*value+delta*(*std::min_element(data.begin()+lhs+1,data.end()));
+  return value;
+}
+
 template<class T> double StatFactory::var(const std::vector<T>& v) const
 {
-  typename std::vector<T>::const_iterator it;
-  unsigned int validSize=0;
+  std::vector<unsigned char> mask;
+  return var(v,mask);
+}
+
+template<class T> double StatFactory::var(const std::vector<T>& v, std::vector<unsigned char>& mask) const
+{
   double m1=0;
   double m2=0;
-  for (it = v.begin(); it!= v.end(); ++it){
-    if(isNoData(*it))
-      continue;
-    m1+=*it;
-    m2+=(*it)*(*it);
-    ++validSize;
-  }
+  unsigned long int validSize=(v.empty())? 0 : validSums(&(v[0]),v.size(),m1,m2,true,mask);
   if(validSize){
     m2/=validSize;
     m1/=validSize;
@@ -841,18 +1696,16 @@ template<class T> double StatFactory::kurtosis(const std::vector<T>& v) const
 
 template<class T> void StatFactory::meanVar(const std::vector<T>& v, double& m1, double& v1) const
 {
-  typename std::vector<T>::const_iterator it;
-  unsigned int validSize=0;
+  std::vector<unsigned char> mask;
+  meanVar(v,m1,v1,mask);
+}
+
+template<class T> void StatFactory::meanVar(const std::vector<T>& v, double& m1, double& v1, std::vector<unsigned char>& mask) const
+{
   m1=0;
   v1=0;
   double m2=0;
-  for (it = v.begin(); it!= v.end(); ++it){
-    if(isNoData(*it))
-      continue;
-    m1+=*it;
-    m2+=(*it)*(*it);
-    ++validSize;
-  }
+  unsigned long int validSize=(v.empty())? 0 : validSums(&(v[0]),v.size(),m1,m2,true,mask);
   if(validSize){
     m2/=validSize;
     m1/=validSize;
@@ -886,17 +1739,9 @@ template<class T1, class T2> void StatFactory::scale2byte(const std::vector<T1>&
 
 template<class T> void  StatFactory::distribution(const std::vector<T>& input, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end, std::vector<double>& output, int nbin, T &minimum, T &maximum, double sigma, const std::string &filename) const
 {
-  double minValue=0;
-  double maxValue=0;
-  minmax(input,begin,end,minimum,maximum);
-  if(minimum<maximum&&minimum>minValue)
-  minValue=minimum;
-  if(minimum<maximum&&maximum<maxValue)
-  maxValue=maximum;
-
-  //todo: check...
-  minimum=minValue;
-  maximum=maxValue;
+  //bins span [minimum,maximum] if provided, else the range of the valid data
+  if(minimum>=maximum)
+    minmax(input,begin,end,minimum,maximum);
 
   if(maximum<=minimum){
     std::ostringstream s;
@@ -917,6 +1762,11 @@ template<class T> void  StatFactory::distribution(const std::vector<T>& input, t
   }
   bool isValid=false;
   typename std::vector<T>::const_iterator it;
+  //kde: binned estimate, unless the bandwidth is too narrow for the fine grid
+  KernelDensity density(minimum,maximum,nbin);
+  bool binnedKde=(sigma>0)&&density.isAccurate(sigma);
+  double binSize=static_cast<double>(maximum-minimum)/nbin;
+  int window=(sigma>0)? static_cast<int>(ceil(5*sigma/binSize)) : 0;
   for(it=begin;it!=end;++it){
     if(*it<minimum)
       continue;
@@ -925,14 +1775,16 @@ template<class T> void  StatFactory::distribution(const std::vector<T>& input, t
     if(isNoData(*it))
       continue;
     isValid=true;
-    if(sigma>0){
-      // minimum-=2*sigma;
-      // maximum+=2*sigma;
-      //create kde for Gaussian basis function
-      //todo: speed up by calculating first and last bin with non-zero contriubtion...
+    if(binnedKde)
+      density.push(*it);
+    else if(sigma>0){
+      //create kde for Gaussian basis function, truncated at 5 sigma
       //todo: calculate real surface below pdf by using gsl_cdf_gaussian_P(x-mean+binsize,sigma)-gsl_cdf_gaussian_P(x-mean,sigma)
-      for(int ibin=0;ibin<nbin;++ibin){
-        double icenter=minimum+static_cast<double>(maximum-minimum)*(ibin+0.5)/nbin;
+      int theBin=static_cast<int>((*it-minimum)/binSize);
+      int firstBin=(theBin-window<0)? 0 : theBin-window;
+      int lastBin=(theBin+window>=nbin)? nbin-1 : theBin+window;
+      for(int ibin=firstBin;ibin<=lastBin;++ibin){
+        double icenter=minimum+binSize*(ibin+0.5);
         double thePdf=gsl_ran_gaussian_pdf(*it-icenter, sigma);
         output[ibin]+=thePdf;
       }
@@ -950,6 +1802,12 @@ template<class T> void  StatFactory::distribution(const std::vector<T>& input, t
       //   ++output[static_cast<int>(static_cast<double>((*it)-minimum)/(maximum-minimum)*nbin)];
     }
   }
+  if(binnedKde){
+    std::vector<double> kdeOutput;
+    density.density(sigma,kdeOutput);
+    for(int ibin=0;ibin<nbin;++ibin)
+      output[ibin]+=kdeOutput[ibin];
+  }
   if(!isValid){
     std::string errorString="Error: no valid data found";
     throw(errorString);
@@ -1090,7 +1948,6 @@ template<class T> void  StatFactory::distribution2d(const std::vector<T>& inputX
   }
 }
 
-//todo: what with nodata values?
 template<class T> void  StatFactory::percentiles (const std::vector<T>& input, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end, std::vector<T>& output, int nbin, T &minimum, T &maximum, const std::string &filename) const
 {
   if(maximum<=minimum)
@@ -1112,17 +1969,14 @@ template<class T> void  StatFactory::percentiles (const std::vector<T>& input, t
   }
   output.resize(nbin);
   std::vector<T> inputSort;
-  inputSort.assign(begin,end);
-  typename std::vector<T>::iterator vit=inputSort.begin();
-  while(vit!=inputSort.end()){
-    if(*vit<minimum||*vit>maximum)
-      inputSort.erase(vit);
-    else
-      ++vit;
+  inputSort.reserve(end-begin);
+  for(typename std::vector<T>::const_iterator it=begin;it!=end;++it){
+    if(*it<minimum||*it>maximum||isNoData(*it))
+      continue;
+    inputSort.push_back(*it);
   }
-  eraseNoData(inputSort);
   std::sort(inputSort.begin(),inputSort.end());
-  vit=inputSort.begin();
+  typename std::vector<T>::iterator vit=inputSort.begin();
   std::vector<T> inputBin;
   for(int ibin=0;ibin<nbin;++ibin){
     inputBin.clear();
@@ -1148,7 +2002,6 @@ template<class T> void  StatFactory::percentiles (const std::vector<T>& input, t
   }
 }
 
-//todo: what with nodata values?
 template<class T> T  StatFactory::percentile(const std::vector<T>& input, typename std::vector<T>::const_iterator begin, typename std::vector<T>::const_iterator end, double percent, T minimum, T maximum) const
 {
   if(input.empty()){
@@ -1156,20 +2009,12 @@ template<class T> T  StatFactory::percentile(const std::vector<T>& input, typena
     s<<"Error: input is empty";
     throw(s.str());
   }
-  std::vector<double> inputSort;
-  inputSort.assign(begin,end);
-  typename std::vector<double>::iterator vit=inputSort.begin();
-  while(vit!=inputSort.end()){
-    if(maximum>minimum){
-      if(*vit<minimum||*vit>maximum)
-	inputSort.erase(vit);
-    }
-    else
-      ++vit;
+  std::vector<double> scratch;
+  if(!copyValid(begin,end,scratch,minimum,maximum)){
+    std::string errorString="Error: no valid data found";
+    throw(errorString);
   }
-  eraseNoData(inputSort);
-  std::sort(inputSort.begin(),inputSort.end());
-  return gsl_stats_quantile_from_sorted_data(&(inputSort[0]),1,inputSort.size(),percent/100.0);
+  return quantileSelect(scratch,percent/100.0);
 }
 
 template<class T> void StatFactory::signature(const std::vector<T>& input, double&k, double& alpha, double& beta, double e) const
@@ -1344,8 +2189,18 @@ template<class T> double StatFactory::correlation(const std::vector<T>& x, const
     return 0;
 }
 
-//todo: what if no valid data?
+//correlation(x,y,delay) for delay in [-maxdelay,maxdelay[, returns the sum of the correlations
+//Long series are correlated in the frequency domain (O(n log n) instead of O(n*maxdelay))
 template<class T> double StatFactory::cross_correlation(const std::vector<T>& x, const std::vector<T>& y, int maxdelay, std::vector<T>& z) const{
+  int fftSize=16;
+  while(fftSize<((x.size()>y.size())? x.size() : y.size())+maxdelay)
+    fftSize*=2;
+  double directCost=2.0*maxdelay*((x.size()<y.size())? x.size() : y.size());
+  double fftCost=((m_noDataValues.empty())? 2 : 4)*5.0*fftSize*log(fftSize)/log(2.0);
+  if(maxdelay>0&&fftCost<directCost){
+    std::vector<double> work;
+    return crossCorrelationFFT(x,y,maxdelay,z,work);
+  }
   z.clear();
   double sumCorrelation=0;
   for (int delay=-maxdelay;delay<maxdelay;delay++) {
@@ -1355,6 +2210,119 @@ template<class T> double StatFactory::cross_correlation(const std::vector<T>& x,
   return sumCorrelation;
 }
 
+//cross correlation for a batch of series (e.g., the temporal profiles of a block of pixels), in parallel
+template<class T> void StatFactory::cross_correlation(const std::vector< std::vector<T> >& x, const std::vector< std::vector<T> >& y, int maxdelay, std::vector< std::vector<T> >& z, std::vector<double>& sumCorrelation) const{
+  if(x.size()!=y.size()){
+    std::string errorString="Error: number of series in x and y do not match";
+    throw(errorString);
+  }
+  int nseries=x.size();
+  z.resize(nseries);
+  sumCorrelation.assign(nseries,0);
+  std::string errorString;
+#pragma omp parallel
+  {
+    std::vector<double> work;//reused for all series of this thread
+#pragma omp for schedule(dynamic)
+    for(int iseries=0;iseries<nseries;++iseries){
+      try{
+        if(maxdelay>0&&x[iseries].size()&&y[iseries].size())
+          sumCorrelation[iseries]=crossCorrelationFFT(x[iseries],y[iseries],maxdelay,z[iseries],work);
+        else
+          sumCorrelation[iseries]=cross_correlation(x[iseries],y[iseries],maxdelay,z[iseries]);
+      }
+      catch(std::string error){
+#pragma omp critical
+        errorString=error;
+      }
+    }
+  }
+  if(!errorString.empty())
+    throw(errorString);
+}
+
+//same result as correlation(x,y,delay) for all delays: the products of the centred values (0 for nodata)
+//are summed for all delays at once as the inverse FFT of the cross spectrum. With nodata values, the
+//number of valid pairs per delay is obtained in the same way from the validity masks.
+template<class T> double StatFactory::crossCorrelationFFT(const std::vector<T>& x, const std::vector<T>& y, int maxdelay, std::vector<T>& z, std::vector<double>& work) const{
+  z.clear();
+  double meanX=0;
+  double meanY=0;
+  double varX=0;
+  double varY=0;
+  meanVar(x,meanX,varX);
+  meanVar(y,meanY,varY);
+  double denom = sqrt(varX*varY);
+  if(!denom){
+    z.assign(2*maxdelay,0);
+    return 0;
+  }
+  int nx=x.size();
+  int ny=y.size();
+  //no circular overlap for |delay|<=maxdelay
+  int fftSize=16;
+  while(fftSize<((nx>ny)? nx : ny)+maxdelay)
+    fftSize*=2;
+  bool checkNoData=!m_noDataValues.empty();
+  //x in real part, y in imaginary part
+  work.assign(2*fftSize,0);
+  for(int i=0;i<nx;++i)
+    work[2*i]=(isNoData(x[i]))? 0 : x[i]-meanX;
+  for(int j=0;j<ny;++j)
+    work[2*j+1]=(isNoData(y[j]))? 0 : y[j]-meanY;
+  crossSpectrumFFT(work,fftSize);
+  std::vector<double> npair;
+  if(checkNoData){
+    npair.assign(2*fftSize,0);
+    for(int i=0;i<nx;++i)
+      npair[2*i]=!isNoData(x[i]);
+    for(int j=0;j<ny;++j)
+      npair[2*j+1]=!isNoData(y[j]);
+    crossSpectrumFFT(npair,fftSize);
+  }
+  double minSize=(nx<ny)? nx : ny;
+  double sumCorrelation=0;
+  for(int delay=-maxdelay;delay<maxdelay;++delay){
+    int index=(delay<0)? fftSize+delay : delay;
+    bool isValid=(checkNoData)? npair[2*index]>0.5 : (delay<ny&&-delay<nx);
+    if(isValid)
+      z.push_back(work[2*index]/denom/(minSize-1));
+    else if(checkNoData)
+      z.push_back(m_noDataValues[0]);
+    else{
+      std::string errorString="Error: no valid data found";
+      throw(errorString);
+    }
+    sumCorrelation+=z.back();
+  }
+  return sumCorrelation;
+}
+
+//data holds x (real part) and y (imaginary part), zero padded to fftSize (power of 2).
+//On return, the real part holds sum_i x[i]*y[i+delay] at index delay (modulo fftSize).
+inline void StatFactory::crossSpectrumFFT(std::vector<double>& data, int fftSize)
+{
+  gsl_fft_complex_radix2_forward(&(data[0]),1,fftSize);
+  //separate the spectra X and Y of the two real series and store conj(X)*Y
+  std::vector<double> spectrum(2*fftSize);
+  for(int k=0;k<fftSize;++k){
+    int l=(fftSize-k)%fftSize;
+    double zr=data[2*k];
+    double zi=data[2*k+1];
+    double wr=data[2*l];
+    double wi=-data[2*l+1];
+    //X=(Z[k]+conj(Z[N-k]))/2, Y=(Z[k]-conj(Z[N-k]))/(2i)
+    double xr=(zr+wr)/2;
+    double xi=(zi+wi)/2;
+    double yr=(zi-wi)/2;
+    double yi=-(zr-wr)/2;
+    spectrum[2*k]=xr*yr+xi*yi;
+    spectrum[2*k+1]=xr*yi-xi*yr;
+  }
+  data.swap(spectrum);
+  gsl_fft_complex_radix2_inverse(&(data[0]),1,fftSize);
+}
+
 //todo: nodata?
 template<class T> double StatFactory::linear_regression(const std::vector<T>& x, const std::vector<T>& y, double &c0, double &c1) const{
   if(x.size()!=y.size()){
@@ -1404,44 +2372,74 @@ template<class T> void StatFactory::interpolateNoData(const std::vector<double>&
     s<<"Error: wavelengthIn is empty";
     throw(s.str());
   }
-  std::vector<double> wavelengthOut=wavelengthIn;
-  std::vector<T> validIn=input;
   if(input.size()!=wavelengthIn.size()){
     std::ostringstream s;
     s<<"Error: x and y not equal in size";
     throw(s.str());
   }
-  output.clear();
-  //remove nodata from input and corresponding wavelengthIn
-  if(m_noDataValues.size()){
-    typename std::vector<T>::iterator itValue=validIn.begin();
-    typename std::vector<T>::iterator itWavelength=wavelengthOut.begin();
-    while(itValue!=validIn.end()&&itWavelength!=wavelengthOut.end()){
-      if(isNoData(*itValue)){
-	validIn.erase(itValue);
-	wavelengthOut.erase(itWavelength);
-      }
-      else{
-	++itValue;
-	++itWavelength;
-      }
-    }
-    if(validIn.size()>1){
-      try{
-	interpolateUp(wavelengthOut, validIn, wavelengthIn, type, output, verbose);
-      }
-      catch(...){
-	output=input;
-      }
+  output=input;
+  if(m_noDataValues.empty())//no nodata values to interpolate
+    return;
+  std::vector<double> wavelengthValid;
+  std::vector<double> validIn;
+  wavelengthValid.reserve(input.size());
+  validIn.reserve(input.size());
+  for(int index=0;index<input.size();++index){
+    if(isNoData(input[index]))
+      continue;
+    wavelengthValid.push_back(wavelengthIn[index]);
+    validIn.push_back(input[index]);
+  }
+  //nothing to interpolate, or we can not interpolate if no valid data
+  if(validIn.size()==input.size()||validIn.size()<2)
+    return;
+  //the spline passes through the valid data, only evaluate it where input is nodata
+  int nvalid=validIn.size();
+  gsl_interp_accel *acc;
+  allocAcc(acc);
+  gsl_spline *spline;
+  getSpline(type,nvalid,spline);
+  if(!initSpline(spline,&(wavelengthValid[0]),&(validIn[0]),nvalid)){
+    for(int index=0;index<input.size();++index){
+      if(!isNoData(input[index]))
+        continue;
+      if(wavelengthIn[index]<wavelengthValid[0])
+        output[index]=validIn[0];
+      else if(wavelengthIn[index]>wavelengthValid.back())
+        output[index]=validIn.back();
+      else
+        output[index]=evalSpline(spline,wavelengthIn[index],acc);
     }
-    else//we can not interpolate if no valid data
-      output=input;
   }
-  else//no nodata values to interpolate
-    output=input;
+  gsl_spline_free(spline);
+  gsl_interp_accel_free(acc);
 }
 
 template<class T> void StatFactory::interpolateUp(const std::vector<double>& wavelengthIn, const std::vector<T>& input, const std::vector<double>& wavelengthOut, const std::string& type, std::vector<T>& output, bool verbose) const{
+  if(wavelengthIn.empty()){
+    std::ostringstream s;
+    s<<"Error: wavelengthIn is empty";
+    throw(s.str());
+  }
+  int nband=wavelengthIn.size();
+  gsl_interp_accel *acc;
+  allocAcc(acc);
+  gsl_spline *spline;
+  getSpline(type,nband,spline);
+  assert(spline);
+  try{
+    interpolateUp(wavelengthIn,input,wavelengthOut,spline,acc,output);
+  }
+  catch(std::string errorString){
+    gsl_spline_free(spline);
+    gsl_interp_accel_free(acc);
+    throw(errorString);
+  }
+  gsl_spline_free(spline);
+  gsl_interp_accel_free(acc);
+}
+
+template<class T> void StatFactory::interpolateUp(const std::vector<double>& wavelengthIn, const std::vector<T>& input, const std::vector<double>& wavelengthOut, gsl_spline* spline, gsl_interp_accel* acc, std::vector<T>& output) const{
   if(wavelengthIn.empty()){
     std::ostringstream s;
     s<<"Error: wavelengthIn is empty";
@@ -1459,10 +2457,6 @@ template<class T> void StatFactory::interpolateUp(const std::vector<double>& wav
   }
   int nband=wavelengthIn.size();
   output.clear();
-  gsl_interp_accel *acc;
-  allocAcc(acc);
-  gsl_spline *spline;
-  getSpline(type,nband,spline);
   assert(spline);
   assert(&(wavelengthIn[0]));
   assert(&(input[0]));
@@ -1471,6 +2465,7 @@ template<class T> void StatFactory::interpolateUp(const std::vector<double>& wav
     std::string errorString="Could not initialize spline";
     throw(errorString);
   }
+  gsl_interp_accel_reset(acc);
   for(int index=0;index<wavelengthOut.size();++index){
     if(wavelengthOut[index]<*wavelengthIn.begin()){
       output.push_back(*(input.begin()));
@@ -1483,8 +2478,6 @@ template<class T> void StatFactory::interpolateUp(const std::vector<double>& wav
     double dout=evalSpline(spline,wavelengthOut[index],acc);
     output.push_back(dout);
   }
-  gsl_spline_free(spline);
-  gsl_interp_accel_free(acc);
 }
 
 // template<class T> void StatFactory::interpolateUp(const std::vector<double>& wavelengthIn, const std::vector< std::vector<T> >& input, const std::vector<double>& wavelengthOut, const std::string& type, std::vector< std::vector<T> >& output, bool verbose){
@@ -1648,6 +2641,7 @@ template<class T> void StatFactory::interpolateDown(double* input, int dim, std:
     }
   }
 }
+
 }
 
 #endif /* _STATFACTORY_H_ */
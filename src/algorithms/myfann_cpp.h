@@ -89,7 +89,13 @@
 #include <string>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "base/Vector2d.h"
+#include "StatFactory.h"
 
 /* Namespace: FANN
     The FANN namespace groups the C++ wrapper definitions */
@@ -1293,6 +1299,61 @@ public:
             }
         }
 
+        /* Method: init_weights
+
+           As <init_weights>, but with the uniform variates taken from the random stream rng instead of rand(),
+           so networks can be initialized concurrently and reproducibly.
+        */
+        void init_weights(const training_data &data, const statfactory::RandomStream &rng)
+        {
+            if ((ann == NULL) || (data.train_data == NULL) || !data.train_data->num_data)
+                return;
+            const struct fann_train_data *train = data.train_data;
+            fann_type smallest_inp = train->input[0][0];
+            fann_type largest_inp = train->input[0][0];
+            for (unsigned int dat = 0; dat < train->num_data; dat++)
+            {
+                for (unsigned int elem = 0; elem < train->num_input; elem++)
+                {
+                    if (train->input[dat][elem] < smallest_inp)
+                        smallest_inp = train->input[dat][elem];
+                    if (train->input[dat][elem] > largest_inp)
+                        largest_inp = train->input[dat][elem];
+                }
+            }
+            //neurons are numbered layer by layer, each layer followed by its bias neurons
+            unsigned int num_layers = get_num_layers();
+            std::vector<unsigned int> layers(num_layers);
+            std::vector<unsigned int> bias(num_layers);
+            get_layer_array(&layers[0]);
+            get_bias_array(&bias[0]);
+            unsigned int num_hidden_neurons = 0;
+            std::vector<char> is_bias;
+            for (unsigned int layer = 0; layer < num_layers; layer++)
+            {
+                if (layer && layer + 1 < num_layers)
+                    num_hidden_neurons += layers[layer];
+                is_bias.resize(is_bias.size() + layers[layer], 0);
+                is_bias.resize(is_bias.size() + bias[layer], 1);
+            }
+            float scale_factor = (float) (pow((double) (0.7f * (double) num_hidden_neurons),
+                                              (double) (1.0f / (double) get_num_input())) / (double) (largest_inp - smallest_inp));
+            //the connections are listed in the order of the weights
+            std::vector<connection> connections(get_total_connections());
+            if (connections.empty())
+                return;
+            get_connection_array(&connections[0]);
+            for (unsigned int num_connect = 0; num_connect < connections.size(); num_connect++)
+            {
+                double u = rng.uniform(num_connect);
+                unsigned int from_neuron = connections[num_connect].from_neuron;
+                if (from_neuron < is_bias.size() && is_bias[from_neuron])
+                    ann->weights[num_connect] = (fann_type) (-scale_factor + 2 * scale_factor * u);
+                else
+                    ann->weights[num_connect] = (fann_type) (scale_factor * u);
+            }
+        }
+
         /* Method: print_connections
 
 	        Will print the connections of the ann in a compact matrix, for easy viewing of the internals 
@@ -1344,6 +1405,29 @@ public:
             return (ann != NULL);
         }
 
+        /* Method: copy_from
+
+           Constructs a deep copy of another neural network. Running a network changes its
+           internal state, so each thread needs its own copy to run the same network concurrently.
+           The user data (training callback) of the original is not copied.
+
+           See also:
+   	        <fann_copy>
+
+           This function appears in FANN >= 2.2.0.
+         */
+        bool copy_from(const neural_net &other)
+        {
+            destroy();
+            if (other.ann != NULL)
+            {
+                ann = fann_copy(other.ann);
+                if (ann != NULL)
+                    fann_set_user_data(ann, NULL);
+            }
+            return (ann != NULL);
+        }
+
         /* Method: save
 
            Save the entire network to a configuration file.
@@ -1550,6 +1634,7 @@ public:
         }
 
       //cross validation for classification
+      //the runs are trained in parallel, each on a copy of the network
         float cross_validation(std::vector< Vector2d<fann_type> >& trainingFeatures,
                                unsigned int ntraining,
                                unsigned short cv,
@@ -1563,102 +1648,127 @@ public:
           outputVector.clear();
           assert(cv<ntraining);
           int nclass=trainingFeatures.size();
-          std::vector< Vector2d<float> > testFeatures(nclass);
-          int testclass=0;//class to leave out
-          // int testsample=0;//sample to leave out
           int nrun=(cv>1)? cv : ntraining;
           if(nrun>ntraining)
             nrun=ntraining;
-          for(int irun=0;irun<nrun;++irun){
-            if(verbose>1)
-              std::cout << "run " << irun << std::endl;
-            //reset training sample from last run
-            if(verbose>1)
-              std::cout << "reset training sample from last run" << std::endl;
-            for(int iclass=0;iclass<nclass;++iclass){
-              while(testFeatures[iclass].size()){
-                trainingFeatures[iclass].push_back(testFeatures[iclass].back());
-                testFeatures[iclass].pop_back();
+          int ntest=(cv>1)? ntraining/cv : 1; //n-fold cross validation or leave-one-out
+          //test samples are selected on sample indices: samples rotate from training to test set from one run to the next
+          std::vector< std::vector<unsigned int> > trainingIndex(nclass);
+          std::vector< std::vector<unsigned int> > testIndex(nclass);
+          for(int iclass=0;iclass<nclass;++iclass){
+            for(unsigned int isample=0;isample<trainingFeatures[iclass].size();++isample)
+              trainingIndex[iclass].push_back(isample);
+          }
+          //the runs are processed in batches of one run per thread: only the runs of a batch hold their training data and a copy of the network
+          int nbatch=1;
+#ifdef _OPENMP
+          nbatch=(nrun<omp_get_max_threads())? nrun : omp_get_max_threads();
+#endif
+          //the weights of each run are initialized from its own stream, so results do not depend on the number of threads
+          unsigned long int seed=rand();
+          std::vector< std::vector< std::vector<unsigned int> > > runTrainingIndex(nbatch);
+          std::vector< std::vector< std::vector<unsigned int> > > runTestIndex(nbatch);
+          std::vector< std::vector<unsigned short> > runOutput(nbatch);
+          int testclass=0;//class to leave out
+          for(int firstRun=0;firstRun<nrun;firstRun+=nbatch){
+            int nbatchRun=(nrun-firstRun<nbatch)? nrun-firstRun : nbatch;
+            for(int ibatch=0;ibatch<nbatchRun;++ibatch){
+              if(verbose>1)
+                std::cout << "run " << firstRun+ibatch << std::endl;
+              //reset training sample from last run
+              for(int iclass=0;iclass<nclass;++iclass){
+                while(testIndex[iclass].size()){
+                  trainingIndex[iclass].push_back(testIndex[iclass].back());
+                  testIndex[iclass].pop_back();
+                }
+                assert(trainingIndex[iclass].size());
               }
-              if(verbose>1){
-                std::cout << "training size " << iclass << ": " << trainingFeatures[iclass].size() << std::endl;
-                std::cout << "test size " << iclass << ": " << testFeatures[iclass].size() << std::endl;
+              //create test sample
+              unsigned int nsample=0;
+              while(nsample<ntest){
+                testIndex[testclass].push_back(trainingIndex[testclass][0]);
+                trainingIndex[testclass].erase(trainingIndex[testclass].begin());
+                if(!trainingIndex[testclass].size())
+                  std::cout << "Error: testclass " << testclass << " has no training" << std::endl;
+                assert(trainingIndex[testclass].size());
+                ++nsample;
+                if(static_cast<float>(trainingIndex[testclass].size())/static_cast<float>(testIndex[testclass].size())<=(cv-1)){
+                  if(verbose>1){
+                    std::cout << "training size " << testclass << ": " << trainingIndex[testclass].size() << std::endl;
+                    std::cout << "test size " << testclass << ": " << testIndex[testclass].size() << std::endl;
+                  }
+                  testclass=(testclass+1)%nclass;
+                }
               }
-              assert(trainingFeatures[iclass].size());
-            }
-            //create test sample
-            if(verbose>1)
-              std::cout << "create test sample" << std::endl;
-            unsigned int nsample=0;
-            int ntest=(cv>1)? ntraining/cv : 1; //n-fold cross validation or leave-one-out
-            while(nsample<ntest){
-              // if(index>=trainingFeatures[testclass].size()){
-              //   index=0;
-              // }
-              testFeatures[testclass].push_back(trainingFeatures[testclass][0]);
-              trainingFeatures[testclass].erase(trainingFeatures[testclass].begin());
-              if(!trainingFeatures[testclass].size())
-                std::cout << "Error: testclass " << testclass << " has no training" << std::endl;
-              assert(trainingFeatures[testclass].size());
-              ++nsample;
-              if(static_cast<float>(trainingFeatures[testclass].size())/static_cast<float>(testFeatures[testclass].size())<=(cv-1)){
-                if(verbose>1){
-                  std::cout << "training size " << testclass << ": " << trainingFeatures[testclass].size() << std::endl;
-                  std::cout << "test size " << testclass << ": " << testFeatures[testclass].size() << std::endl;
+              assert(nsample==ntest);
+              runTrainingIndex[ibatch]=trainingIndex;
+              runTestIndex[ibatch]=testIndex;
+            }
+#pragma omp parallel for schedule(dynamic)
+            for(int ibatch=0;ibatch<nbatchRun;++ibatch){
+              training_data runData;
+              {
+                std::vector< Vector2d<fann_type> > runFeatures(nclass);
+                for(int iclass=0;iclass<nclass;++iclass){
+                  for(unsigned int isample=0;isample<runTrainingIndex[ibatch][iclass].size();++isample)
+                    runFeatures[iclass].push_back(trainingFeatures[iclass][runTrainingIndex[ibatch][iclass][isample]]);
                 }
-                testclass=(testclass+1)%nclass;
+                runData.set_train_data(runFeatures,ntraining-ntest);
               }
-            }
-            assert(nsample==ntest);
-            //training with left out training set
-            if(verbose>1)
-              std::cout << std::endl << "Set training data" << std::endl;
-            bool initWeights=true;
-            unsigned int epochs_between_reports=0;
-            train_on_data(trainingFeatures,ntraining-ntest,initWeights, max_epochs,
-                          epochs_between_reports, desired_error);
-            //cross validation with testFeatures
-            if(verbose>1)
-              std::cout << std::endl << "Cross validation" << std::endl;
-
-            std::vector<float> result(nclass);
-            int maxClass=-1;
-            for(int iclass=0;iclass<testFeatures.size();++iclass){
-              assert(trainingFeatures[iclass].size());
-              for(int isample=0;isample<testFeatures[iclass].size();++isample){
-                result=run(testFeatures[iclass][isample]);
-                //search class with maximum posterior probability
-                float maxP=-1;
-                for(int ic=0;ic<nclass;++ic){
-                  float pv=(result[ic]+1.0)/2.0;//bring back to scale [0,1]
-                  if(pv>maxP){
-                    maxP=pv;
-                    maxClass=ic;
+              neural_net runNet;
+              runNet.copy_from(*this);
+              runNet.init_weights(runData,statfactory::RandomStream(seed,firstRun+ibatch));
+              unsigned int epochs_between_reports=0;
+              runNet.train_on_data(runData,max_epochs,epochs_between_reports,desired_error);
+              runOutput[ibatch].clear();
+              std::vector<float> result(nclass);
+              for(int iclass=0;iclass<nclass;++iclass){
+                for(unsigned int isample=0;isample<runTestIndex[ibatch][iclass].size();++isample){
+                  result=runNet.run(trainingFeatures[iclass][runTestIndex[ibatch][iclass][isample]]);
+                  //search class with maximum posterior probability
+                  int maxClass=-1;
+                  float maxP=-1;
+                  for(int ic=0;ic<nclass;++ic){
+                    float pv=(result[ic]+1.0)/2.0;//bring back to scale [0,1]
+                    if(pv>maxP){
+                      maxP=pv;
+                      maxClass=ic;
+                    }
                   }
+                  assert(maxP>=0);
+                  runOutput[ibatch].push_back(maxClass);
+                }
+              }
+            }
+            for(int ibatch=0;ibatch<nbatchRun;++ibatch){
+              unsigned int itest=0;
+              for(int iclass=0;iclass<nclass;++iclass){
+                for(unsigned int isample=0;isample<runTestIndex[ibatch][iclass].size();++isample){
+                  referenceVector.push_back(iclass);
+                  outputVector.push_back(runOutput[ibatch][itest++]);
                 }
-                assert(maxP>=0);
-                referenceVector.push_back(iclass);
-                outputVector.push_back(maxClass);
               }
             }
-
-            // rmse+=test_data(testFeatures,ntest);
-            // if(verbose>1)
-            //   std::cout << std::endl << "rmse: " << rmse << std::endl;
           }
-          // rmse/=nrun;
           //reset from very last run
           for(int iclass=0;iclass<nclass;++iclass){
-            while(testFeatures[iclass].size()){
-              trainingFeatures[iclass].push_back(testFeatures[iclass].back());
-              testFeatures[iclass].pop_back();
+            while(testIndex[iclass].size()){
+              trainingIndex[iclass].push_back(testIndex[iclass].back());
+              testIndex[iclass].pop_back();
             }
           }
-          // return(rmse);
+          //leave the training samples in the order of the very last run
+          for(int iclass=0;iclass<nclass;++iclass){
+            Vector2d<fann_type> reordered;
+            for(unsigned int isample=0;isample<trainingIndex[iclass].size();++isample)
+              reordered.push_back(trainingFeatures[iclass][trainingIndex[iclass][isample]]);
+            trainingFeatures[iclass]=reordered;
+          }
           return 0;
         }
 
       //cross validation for regresssion
+      //the runs are trained in parallel, each on a copy of the network
         float cross_validation(std::vector< std::vector<fann_type> >& input,
                                std::vector< std::vector<fann_type> >& output,
                                unsigned short cv,
@@ -1671,81 +1781,89 @@ public:
           assert(input.size());
           assert(output.size()==input.size());
           unsigned int ntraining=input.size();
-          unsigned int noutput=output[0].size();
           referenceVector.clear();
           outputVector.clear();
           assert(cv<ntraining);
-          std::vector< std::vector<fann_type> > testInput;
-          std::vector< std::vector<fann_type> > testOutput;
-          // int testsample=0;//sample to leave out
           int nrun=(cv>1)? cv : ntraining;
           if(nrun>ntraining)
             nrun=ntraining;
-          for(int irun=0;irun<nrun;++irun){
-            if(verbose>1)
-              std::cout << "run " << irun << std::endl;
-            //reset training sample from last run
-            if(verbose>1)
-              std::cout << "reset training sample from last run" << std::endl;
-            while(testInput.size()){
-              input.push_back(testInput.back());
-              testInput.pop_back();
-            }
-            while(testOutput.size()){
-              output.push_back(testOutput.back());
-              testOutput.pop_back();
-            }
-            assert(testInput.size()==testOutput.size());
-            if(verbose>1){
-              std::cout << "training size: " << input.size() << std::endl;
-              std::cout << "test size: " << testInput.size() << std::endl;
-            }
-            assert(input.size());
-            //create test sample
-            if(verbose>1)
-              std::cout << "create test sample" << std::endl;
-            unsigned int nsample=0;
-            int ntest=(cv>1)? ntraining/cv : 1; //n-fold cross validation or leave-one-out
-            while(nsample<ntest){
-              testInput.push_back(input[0]);
-              testOutput.push_back(output[0]);
-              input.erase(input.begin());
-              output.erase(output.begin());
-              assert(input.size());
-              assert(output.size());
-              assert(input.size()==output.size());
-              ++nsample;
-            }
-            assert(nsample==ntest);
-            assert(testInput.size()==testOutput.size());
-            //training with left out training set
-            if(verbose>1)
-              std::cout << std::endl << "Set training data" << std::endl;
-            bool initWeights=true;
-            unsigned int epochs_between_reports=0;
-            
-            train_on_data(input,output,initWeights, max_epochs,
-                          epochs_between_reports, desired_error);
-            //cross validation with testFeatures
-            if(verbose>1)
-              std::cout << std::endl << "Cross validation" << std::endl;
-
-            std::vector<fann_type> result(noutput);
-            for(int isample=0;isample<testInput.size();++isample){
-              result=run(testInput[isample]);
-              referenceVector.push_back(testOutput[isample]);
-              outputVector.push_back(result);
+          int ntest=(cv>1)? ntraining/cv : 1; //n-fold cross validation or leave-one-out
+          //test samples are selected on sample indices: samples rotate from training to test set from one run to the next
+          std::vector<unsigned int> trainingIndex(ntraining);
+          std::vector<unsigned int> testIndex;
+          for(unsigned int isample=0;isample<ntraining;++isample)
+            trainingIndex[isample]=isample;
+          //the runs are processed in batches of one run per thread: only the runs of a batch hold their training data and a copy of the network
+          int nbatch=1;
+#ifdef _OPENMP
+          nbatch=(nrun<omp_get_max_threads())? nrun : omp_get_max_threads();
+#endif
+          //the weights of each run are initialized from its own stream, so results do not depend on the number of threads
+          unsigned long int seed=rand();
+          std::vector< std::vector<unsigned int> > runTrainingIndex(nbatch);
+          std::vector< std::vector<unsigned int> > runTestIndex(nbatch);
+          std::vector< std::vector< std::vector<fann_type> > > runResult(nbatch);
+          for(int firstRun=0;firstRun<nrun;firstRun+=nbatch){
+            int nbatchRun=(nrun-firstRun<nbatch)? nrun-firstRun : nbatch;
+            for(int ibatch=0;ibatch<nbatchRun;++ibatch){
+              if(verbose>1)
+                std::cout << "run " << firstRun+ibatch << std::endl;
+              //reset training sample from last run
+              while(testIndex.size()){
+                trainingIndex.push_back(testIndex.back());
+                testIndex.pop_back();
+              }
+              //create test sample
+              while(testIndex.size()<ntest){
+                testIndex.push_back(trainingIndex[0]);
+                trainingIndex.erase(trainingIndex.begin());
+                assert(trainingIndex.size());
+              }
+              runTrainingIndex[ibatch]=trainingIndex;
+              runTestIndex[ibatch]=testIndex;
+            }
+#pragma omp parallel for schedule(dynamic)
+            for(int ibatch=0;ibatch<nbatchRun;++ibatch){
+              training_data runData;
+              {
+                std::vector< std::vector<fann_type> > runInput;
+                std::vector< std::vector<fann_type> > runOutput;
+                for(unsigned int isample=0;isample<runTrainingIndex[ibatch].size();++isample){
+                  runInput.push_back(input[runTrainingIndex[ibatch][isample]]);
+                  runOutput.push_back(output[runTrainingIndex[ibatch][isample]]);
+                }
+                runData.set_train_data(runInput,runOutput);
+              }
+              neural_net runNet;
+              runNet.copy_from(*this);
+              runNet.init_weights(runData,statfactory::RandomStream(seed,firstRun+ibatch));
+              unsigned int epochs_between_reports=0;
+              runNet.train_on_data(runData,max_epochs,epochs_between_reports,desired_error);
+              runResult[ibatch].clear();
+              for(unsigned int isample=0;isample<runTestIndex[ibatch].size();++isample)
+                runResult[ibatch].push_back(runNet.run(input[runTestIndex[ibatch][isample]]));
+            }
+            for(int ibatch=0;ibatch<nbatchRun;++ibatch){
+              for(unsigned int isample=0;isample<runTestIndex[ibatch].size();++isample){
+                referenceVector.push_back(output[runTestIndex[ibatch][isample]]);
+                outputVector.push_back(runResult[ibatch][isample]);
+              }
             }
           }
           //reset from very last run
-          while(testInput.size()){
-            input.push_back(testInput.back());
-            testInput.pop_back();
+          while(testIndex.size()){
+            trainingIndex.push_back(testIndex.back());
+            testIndex.pop_back();
           }
-          while(testOutput.size()){
-            output.push_back(testOutput.back());
-            testOutput.pop_back();
+          //leave the training samples in the order of the very last run
+          std::vector< std::vector<fann_type> > reorderedInput;
+          std::vector< std::vector<fann_type> > reorderedOutput;
+          for(unsigned int isample=0;isample<trainingIndex.size();++isample){
+            reorderedInput.push_back(input[trainingIndex[isample]]);
+            reorderedOutput.push_back(output[trainingIndex[isample]]);
           }
+          input.swap(reorderedInput);
+          output.swap(reorderedOutput);
           return 0;
         }
 
@@ -7,6 +7,10 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 //test
 // #include <iostream>
 #include "svm.h"
@@ -40,6 +44,15 @@ static inline double powi(double base, int times)
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
 
+// random numbers for shuffling: each call starts its own stream from the seed, so that results
+// do not depend on the thread or on the order in which problems are trained
+static uint64_t svm_random_seed = 1;
+static inline int svm_rand(uint64_t *state)
+{
+	*state = *state*6364136223846793005ULL+1442695040888963407ULL;
+	return (int)(*state>>33);
+}
+
 static void print_string_stdout(const char *s)
 {
 	fputs(s,stdout);
@@ -186,6 +199,51 @@ void Cache::swap_index(int i, int j)
 	}
 }
 
+//
+// State shared by the trainings along a path of increasing C (svm_cross_validation_path)
+//
+struct svm_path_node
+{
+	const svm_node *x;
+	int id;
+};
+
+struct svm_path_state
+{
+	// kernel values over the full problem (NULL if the table does not fit in the cache)
+	const Qfloat *kernel;
+	int l;
+	const svm_path_node *node;	// rows of the full problem, sorted by address
+	// alphas of the C-SVC subproblems of the previous C, in the order they were solved
+	int nr_alpha;
+	double **alpha;
+	int *alpha_l;
+	double *alpha_C;
+	int next;	// next subproblem to be solved for the current C
+	int nr_bounded;	// number of alphas at the upper bound for the current C
+};
+
+static int compare_path_node(const void *a, const void *b)
+{
+	const svm_node *xa = ((const svm_path_node *)a)->x;
+	const svm_node *xb = ((const svm_path_node *)b)->x;
+	return (xa < xb) ? -1 : (xa > xb) ? 1 : 0;
+}
+
+static int path_node_id(const svm_path_state *state, const svm_node *x)
+{
+	int lo = 0, hi = state->l-1;
+	while(lo < hi)
+	{
+		int mid = (lo+hi)/2;
+		if(state->node[mid].x < x)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return state->node[lo].id;
+}
+
 //
 // Kernel evaluation
 //
@@ -203,7 +261,7 @@ public:
 
 class Kernel: public QMatrix {
 public:
-	Kernel(int l, svm_node * const * x, const svm_parameter& param);
+	Kernel(int l, svm_node * const * x, const svm_parameter& param, const svm_path_state *state = NULL);
 	virtual ~Kernel();
 
 	static double k_function(const svm_node *x, const svm_node *y,
@@ -213,7 +271,9 @@ public:
 	virtual void swap_index(int i, int j) const	// no so const...
 	{
 		swap(x[i],x[j]);
+		if(xd) swap(xd[i],xd[j]);
 		if(x_square) swap(x_square[i],x_square[j]);
+		if(id) swap(id[i],id[j]);
 	}
 protected:
 
@@ -223,6 +283,16 @@ private:
 	const svm_node **x;
 	double *x_square;
 
+	// dense copy of x, if all vectors have the feature indices 1..dim
+	int dim;
+	double *x_dense;
+	const double **xd;
+
+	// precomputed kernel values of the full problem, indexed through id
+	const Qfloat *table;
+	int table_l;
+	int *id;
+
 	// svm_parameter
 	const int kernel_type;
 	const int degree;
@@ -250,10 +320,60 @@ private:
 	{
 		return x[i][(int)(x[j][0].value)].value;
 	}
+
+	static double dense_dot(const double *px, const double *py, int n)
+	{
+		double sum = 0;
+#pragma omp simd reduction(+:sum)
+		for(int k=0;k<n;k++)
+			sum += px[k] * py[k];
+		return sum;
+	}
+	double kernel_linear_dense(int i, int j) const
+	{
+		return dense_dot(xd[i],xd[j],dim);
+	}
+	double kernel_poly_dense(int i, int j) const
+	{
+		return powi(gamma*dense_dot(xd[i],xd[j],dim)+coef0,degree);
+	}
+	double kernel_rbf_dense(int i, int j) const
+	{
+		return exp(-gamma*(x_square[i]+x_square[j]-2*dense_dot(xd[i],xd[j],dim)));
+	}
+	double kernel_sigmoid_dense(int i, int j) const
+	{
+		return tanh(gamma*dense_dot(xd[i],xd[j],dim)+coef0);
+	}
+	double kernel_table(int i, int j) const
+	{
+		return table[(size_t)id[i]*table_l+id[j]];
+	}
 };
 
-Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
-:kernel_type(param.kernel_type), degree(param.degree),
+// number of features if all vectors have the feature indices 1..n, -1 otherwise
+static int dense_dimension(int l, const svm_node * const *x)
+{
+	if(l <= 0)
+		return -1;
+	int n = 0;
+	while(x[0][n].index == n+1)
+		++n;
+	if(n == 0 || x[0][n].index != -1)
+		return -1;
+	for(int i=1;i<l;i++)
+	{
+		for(int k=0;k<n;k++)
+			if(x[i][k].index != k+1)
+				return -1;
+		if(x[i][n].index != -1)
+			return -1;
+	}
+	return n;
+}
+
+Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param, const svm_path_state *state)
+:table(0), table_l(0), id(0), kernel_type(param.kernel_type), degree(param.degree),
  gamma(param.gamma), coef0(param.coef0)
 {
 	switch(kernel_type)
@@ -277,20 +397,64 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 
 	clone(x,x_,l);
 
+	dim = (kernel_type == PRECOMPUTED) ? -1 : dense_dimension(l,x_);
+	x_dense = 0;
+	xd = 0;
+	if(dim > 0)
+	{
+		x_dense = new double[(size_t)l*dim];
+		xd = new const double *[l];
+		for(int i=0;i<l;i++)
+		{
+			double *row = x_dense+(size_t)i*dim;
+			for(int k=0;k<dim;k++)
+				row[k] = x_[i][k].value;
+			xd[i] = row;
+		}
+		switch(kernel_type)
+		{
+			case LINEAR:
+				kernel_function = &Kernel::kernel_linear_dense;
+				break;
+			case POLY:
+				kernel_function = &Kernel::kernel_poly_dense;
+				break;
+			case RBF:
+				kernel_function = &Kernel::kernel_rbf_dense;
+				break;
+			case SIGMOID:
+				kernel_function = &Kernel::kernel_sigmoid_dense;
+				break;
+		}
+	}
+
 	if(kernel_type == RBF)
 	{
 		x_square = new double[l];
 		for(int i=0;i<l;i++)
-			x_square[i] = dot(x[i],x[i]);
+			x_square[i] = (dim > 0) ? dense_dot(xd[i],xd[i],dim) : dot(x[i],x[i]);
 	}
 	else
 		x_square = 0;
+
+	if(state && state->kernel)
+	{
+		table = state->kernel;
+		table_l = state->l;
+		id = new int[l];
+		for(int i=0;i<l;i++)
+			id[i] = path_node_id(state,x_[i]);
+		kernel_function = &Kernel::kernel_table;
+	}
 }
 
 Kernel::~Kernel()
 {
 	delete[] x;
 	delete[] x_square;
+	delete[] x_dense;
+	delete[] xd;
+	delete[] id;
 }
 
 double Kernel::dot(const svm_node *px, const svm_node *py)
@@ -1273,8 +1437,8 @@ double Solver_NU::calculate_rho()
 class SVC_Q: public Kernel
 { 
 public:
-	SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_)
-	:Kernel(prob.l, prob.x, param)
+	SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_, const svm_path_state *state = NULL)
+	:Kernel(prob.l, prob.x, param, state)
 	{
 		clone(y,y_,prob.l);
 		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
@@ -1446,7 +1610,8 @@ private:
 //
 static void solve_c_svc(
 	const svm_problem *prob, const svm_parameter* param,
-	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn)
+	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn,
+	svm_path_state *state = NULL)
 {
 	int l = prob->l;
 	double *minus_ones = new double[l];
@@ -1461,10 +1626,49 @@ static void solve_c_svc(
 		if(prob->y[i] > 0) y[i] = +1; else y[i] = -1;
 	}
 
+	// warm start from the solution of the same subproblem for the previous (smaller) C,
+	// which remains feasible for both bounds
+	int slot = -1;
+	if(state && Cp == Cn)
+	{
+		slot = state->next++;
+		if(slot < state->nr_alpha && state->alpha[slot] &&
+		   state->alpha_l[slot] == l && state->alpha_C[slot] <= Cp)
+			for(i=0;i<l;i++)
+				alpha[i] = state->alpha[slot][i];
+	}
+
 	Solver s;
-	s.Solve(l, SVC_Q(*prob,*param,y), minus_ones, y,
+	s.Solve(l, SVC_Q(*prob,*param,y,state), minus_ones, y,
 		alpha, Cp, Cn, param->eps, si, param->shrinking, param->verbose);
 
+	if(slot >= 0)
+	{
+		if(slot >= state->nr_alpha)
+		{
+			int nr_alpha = max(2*state->nr_alpha,slot+1);
+			state->alpha = (double **)realloc(state->alpha,nr_alpha*sizeof(double *));
+			state->alpha_l = (int *)realloc(state->alpha_l,nr_alpha*sizeof(int));
+			state->alpha_C = (double *)realloc(state->alpha_C,nr_alpha*sizeof(double));
+			for(i=state->nr_alpha;i<nr_alpha;i++)
+				state->alpha[i] = NULL;
+			state->nr_alpha = nr_alpha;
+		}
+		if(!state->alpha[slot] || state->alpha_l[slot] != l)
+		{
+			free(state->alpha[slot]);
+			state->alpha[slot] = Malloc(double,l);
+			state->alpha_l[slot] = l;
+		}
+		memcpy(state->alpha[slot],alpha,l*sizeof(double));
+		state->alpha_C[slot] = Cp;
+		for(i=0;i<l;i++)
+			if(alpha[i] >= Cp)
+				++state->nr_bounded;
+	}
+	else if(state)
+		++state->nr_bounded;	// no warm start, never consider the path converged
+
 	double sum_alpha=0;
 	for(i=0;i<l;i++)
 		sum_alpha += alpha[i];
@@ -1657,14 +1861,14 @@ struct decision_function
 
 static decision_function svm_train_one(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn)
+	double Cp, double Cn, svm_path_state *state = NULL)
 {
 	double *alpha = Malloc(double,prob->l);
 	Solver::SolutionInfo si;
 	switch(param->svm_type)
 	{
 		case C_SVC:
-			solve_c_svc(prob,param,alpha,&si,Cp,Cn);
+			solve_c_svc(prob,param,alpha,&si,Cp,Cn,state);
 			break;
 		case NU_SVC:
 			solve_nu_svc(prob,param,alpha,&si);
@@ -1839,28 +2043,26 @@ static double sigmoid_predict(double decision_value, double A, double B)
 }
 
 // Method 2 from the multiclass_prob paper by Wu, Lin, and Weng
-static void multiclass_probability(int k, double **r, double *p)
+// r is the k*k matrix of pairwise probabilities (row major), Q (k*k) and Qp (k) are work space
+static void multiclass_probability(int k, const double *r, double *p, double *Q, double *Qp)
 {
 	int t,j;
 	int iter = 0, max_iter=max(100,k);
-	double **Q=Malloc(double *,k);
-	double *Qp=Malloc(double,k);
 	double pQp, eps=0.005/k;
 	
 	for (t=0;t<k;t++)
 	{
 		p[t]=1.0/k;  // Valid if k = 1
-		Q[t]=Malloc(double,k);
-		Q[t][t]=0;
+		Q[t*k+t]=0;
 		for (j=0;j<t;j++)
 		{
-			Q[t][t]+=r[j][t]*r[j][t];
-			Q[t][j]=Q[j][t];
+			Q[t*k+t]+=r[j*k+t]*r[j*k+t];
+			Q[t*k+j]=Q[j*k+t];
 		}
 		for (j=t+1;j<k;j++)
 		{
-			Q[t][t]+=r[j][t]*r[j][t];
-			Q[t][j]=-r[j][t]*r[t][j];
+			Q[t*k+t]+=r[j*k+t]*r[j*k+t];
+			Q[t*k+j]=-r[j*k+t]*r[t*k+j];
 		}
 	}
 	for (iter=0;iter<max_iter;iter++)
@@ -1871,7 +2073,7 @@ static void multiclass_probability(int k, double **r, double *p)
 		{
 			Qp[t]=0;
 			for (j=0;j<k;j++)
-				Qp[t]+=Q[t][j]*p[j];
+				Qp[t]+=Q[t*k+j]*p[j];
 			pQp+=p[t]*Qp[t];
 		}
 		double max_error=0;
@@ -1885,38 +2087,39 @@ static void multiclass_probability(int k, double **r, double *p)
 		
 		for (t=0;t<k;t++)
 		{
-			double diff=(-Qp[t]+pQp)/Q[t][t];
+			double diff=(-Qp[t]+pQp)/Q[t*k+t];
 			p[t]+=diff;
-			pQp=(pQp+diff*(diff*Q[t][t]+2*Qp[t]))/(1+diff)/(1+diff);
+			pQp=(pQp+diff*(diff*Q[t*k+t]+2*Qp[t]))/(1+diff)/(1+diff);
 			for (j=0;j<k;j++)
 			{
-				Qp[j]=(Qp[j]+diff*Q[t][j])/(1+diff);
+				Qp[j]=(Qp[j]+diff*Q[t*k+j])/(1+diff);
 				p[j]/=(1+diff);
 			}
 		}
 	}
 	if (iter>=max_iter)
 		info("Exceeds max_iter in multiclass_prob\n");
-	for(t=0;t<k;t++) free(Q[t]);
-	free(Q);
-	free(Qp);
 }
 
+static svm_model *svm_train_path(const svm_problem *prob, const svm_parameter *param, svm_path_state *state);
+
 // Cross-validation decision values for probability estimates
 static void svm_binary_svc_probability(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn, double& probA, double& probB)
+	double Cp, double Cn, double& probA, double& probB,
+	svm_path_state *state = NULL)
 {
 	int i;
 	int nr_fold = 5;
 	int *perm = Malloc(int,prob->l);
 	double *dec_values = Malloc(double,prob->l);
+	uint64_t rand_state = svm_random_seed;
 
 	// random shuffle
 	for(i=0;i<prob->l;i++) perm[i]=i;
 	for(i=0;i<prob->l;i++)
 	{
-		int j = i+rand()%(prob->l-i);
+		int j = i+svm_rand(&rand_state)%(prob->l-i);
 		swap(perm[i],perm[j]);
 	}
 	for(i=0;i<nr_fold;i++)
@@ -1971,7 +2174,7 @@ static void svm_binary_svc_probability(
 			subparam.weight_label[1]=-1;
 			subparam.weight[0]=Cp;
 			subparam.weight[1]=Cn;
-			struct svm_model *submodel = svm_train(&subprob,&subparam);
+			struct svm_model *submodel = svm_train_path(&subprob,&subparam,state);
 			for(j=begin;j<end;j++)
 			{
 				svm_predict_values(submodel,prob->x[perm[j]],&(dec_values[perm[j]])); 
@@ -2085,6 +2288,11 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 // Interface functions
 //
 svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
+{
+	return svm_train_path(prob,param,NULL);
+}
+
+static svm_model *svm_train_path(const svm_problem *prob, const svm_parameter *param, svm_path_state *state)
 {
 	svm_model *model = Malloc(svm_model,1);
 	model->param = *param;
@@ -2205,9 +2413,9 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 				}
 
 				if(param->probability)
-					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
+					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p],state);
 
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
+				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j],state);
 				for(k=0;k<ci;k++)
 					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
 						nonzero[si+k] = true;
@@ -2324,14 +2532,13 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 	return model;
 }
 
-// Stratified cross validation
-void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target)
+// Stratified split in folds: fold i holds the samples perm[fold_start[i]..fold_start[i+1]-1]
+static void svm_cross_validation_folds(const svm_problem *prob, const svm_parameter *param, int nr_fold, int *perm, int *fold_start)
 {
 	int i;
-	int *fold_start = Malloc(int,nr_fold+1);
 	int l = prob->l;
-	int *perm = Malloc(int,l);
 	int nr_class;
+	uint64_t rand_state = svm_random_seed;
 
 	// stratified cv may not give leave-one-out rate
 	// Each class to l folds -> some folds may have zero elements
@@ -2352,7 +2559,7 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		for (c=0; c<nr_class; c++) 
 			for(i=0;i<count[c];i++)
 			{
-				int j = i+rand()%(count[c]-i);
+				int j = i+svm_rand(&rand_state)%(count[c]-i);
 				swap(index[start[c]+j],index[start[c]+i]);
 			}
 		for(i=0;i<nr_fold;i++)
@@ -2389,58 +2596,226 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		for(i=0;i<l;i++) perm[i]=i;
 		for(i=0;i<l;i++)
 		{
-			int j = i+rand()%(l-i);
+			int j = i+svm_rand(&rand_state)%(l-i);
 			swap(perm[i],perm[j]);
 		}
 		for(i=0;i<=nr_fold;i++)
 			fold_start[i]=i*l/nr_fold;
 	}
+}
 
-	for(i=0;i<nr_fold;i++)
+// Predict the samples perm[begin..end-1] that were left out of the training of submodel
+static void svm_predict_fold(const svm_model *submodel, const svm_problem *prob, const int *perm, int begin, int end, int dim, double *target)
+{
+	int j,k;
+	bool probability = submodel->param.probability && 
+	   (submodel->param.svm_type == C_SVC || submodel->param.svm_type == NU_SVC);
+	if(dim > 0 && end > begin)
+	{
+		// predict the fold in a single batch
+		svm_dense_model *dense = svm_create_dense_model(submodel,dim);
+		double *x_fold = Malloc(double,(size_t)(end-begin)*dim);
+		double *labels = Malloc(double,end-begin);
+		double *prob_estimates = probability ? Malloc(double,(size_t)(end-begin)*svm_get_nr_class(submodel)) : NULL;
+		double *work = Malloc(double,svm_predict_batch_work_size(dense));
+		for(j=begin;j<end;j++)
+			for(k=0;k<dim;k++)
+				x_fold[(size_t)(j-begin)*dim+k] = prob->x[perm[j]][k].value;
+		svm_predict_batch(dense,x_fold,end-begin,labels,prob_estimates,work);
+		for(j=begin;j<end;j++)
+			target[perm[j]] = labels[j-begin];
+		free(work);
+		free(prob_estimates);
+		free(labels);
+		free(x_fold);
+		svm_free_dense_model(&dense);
+	}
+	else if(probability)
+	{
+		double *prob_estimates=Malloc(double,svm_get_nr_class(submodel));
+		for(j=begin;j<end;j++)
+			target[perm[j]] = svm_predict_probability(submodel,prob->x[perm[j]],prob_estimates);
+		free(prob_estimates);			
+	}
+	else
+		for(j=begin;j<end;j++)
+			target[perm[j]] = svm_predict(submodel,prob->x[perm[j]]);
+}
+
+// Training set of a fold: all samples except perm[begin..end-1]
+static void svm_fold_problem(const svm_problem *prob, const int *perm, int begin, int end, svm_problem *subprob)
+{
+	int j,k;
+	int l = prob->l;
+	subprob->l = l-(end-begin);
+	subprob->x = Malloc(struct svm_node*,subprob->l);
+	subprob->y = Malloc(double,subprob->l);
+
+	k=0;
+	for(j=0;j<begin;j++)
+	{
+		subprob->x[k] = prob->x[perm[j]];
+		subprob->y[k] = prob->y[perm[j]];
+		++k;
+	}
+	for(j=end;j<l;j++)
+	{
+		subprob->x[k] = prob->x[perm[j]];
+		subprob->y[k] = prob->y[perm[j]];
+		++k;
+	}
+}
+
+// number of folds trained concurrently
+static int svm_cross_validation_workers(int nr_fold)
+{
+	int nr_worker = 1;
+#ifdef _OPENMP
+	if(!omp_in_parallel())
+		nr_worker = min(nr_fold,omp_get_max_threads());
+#else
+	(void)nr_fold;
+#endif
+	return nr_worker;
+}
+
+// Stratified cross validation
+void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target)
+{
+	int *fold_start = Malloc(int,nr_fold+1);
+	int l = prob->l;
+	int *perm = Malloc(int,l);
+	int dim = (param->kernel_type == PRECOMPUTED) ? -1 : dense_dimension(l,prob->x);
+	svm_cross_validation_folds(prob,param,nr_fold,perm,fold_start);
+
+	// folds are trained in parallel, the kernel cache is shared out over the concurrent folds
+	struct svm_parameter fold_param = *param;
+	int nr_worker = svm_cross_validation_workers(nr_fold);
+	fold_param.cache_size = param->cache_size/nr_worker;
+#pragma omp parallel for schedule(dynamic) if(nr_worker>1)
+	for(int ifold=0;ifold<nr_fold;ifold++)
 	{
-		int begin = fold_start[i];
-		int end = fold_start[i+1];
-		int j,k;
 		struct svm_problem subprob;
+		svm_fold_problem(prob,perm,fold_start[ifold],fold_start[ifold+1],&subprob);
+		struct svm_model *submodel = svm_train(&subprob,&fold_param);
+		svm_predict_fold(submodel,prob,perm,fold_start[ifold],fold_start[ifold+1],dim,target);
+		svm_free_and_destroy_model(&submodel);
+		free(subprob.x);
+		free(subprob.y);
+	}		
+	free(fold_start);
+	free(perm);	
+}
 
-		subprob.l = l-(end-begin);
-		subprob.x = Malloc(struct svm_node*,subprob.l);
-		subprob.y = Malloc(double,subprob.l);
-			
-		k=0;
-		for(j=0;j<begin;j++)
+// Helper to fill the kernel table of svm_cross_validation_path
+class Kernel_Table: public Kernel
+{
+public:
+	Kernel_Table(const svm_problem& prob, const svm_parameter& param)
+	:Kernel(prob.l, prob.x, param), l(prob.l) {}
+	Qfloat *get_Q(int, int) const { return NULL; }
+	double *get_QD() const { return NULL; }
+	void fill(Qfloat *kernel, bool parallel) const
+	{
+		(void)parallel;	// only used by the OpenMP pragma
+#pragma omp parallel for schedule(dynamic) if(parallel)
+		for(int i=0;i<l;i++)
+			for(int j=0;j<=i;j++)
+				kernel[(size_t)i*l+j] = kernel[(size_t)j*l+i] = (Qfloat)(this->*kernel_function)(i,j);
+	}
+private:
+	int l;
+};
+
+// Cross validation for an increasing sequence of C (C_SVC), target holds nr_C*l predictions.
+// The kernel is evaluated once for all C (if the table fits in the cache) and the subproblems
+// of each fold are warm started from the solution of the previous C. A fold is not trained
+// any further once none of its alphas are bounded, as the solution no longer depends on C.
+void svm_cross_validation_path(const svm_problem *prob, const svm_parameter *param, int nr_fold, int nr_C, const double *C, double *target)
+{
+	int i;
+	int l = prob->l;
+	if(param->svm_type != C_SVC || param->kernel_type == PRECOMPUTED)
+	{
+		struct svm_parameter C_param = *param;
+		for(i=0;i<nr_C;i++)
 		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
+			C_param.C = C[i];
+			svm_cross_validation(prob,&C_param,nr_fold,target+(size_t)i*l);
 		}
-		for(j=end;j<l;j++)
+		return;
+	}
+	int *fold_start = Malloc(int,nr_fold+1);
+	int *perm = Malloc(int,l);
+	int dim = dense_dimension(l,prob->x);
+	svm_cross_validation_folds(prob,param,nr_fold,perm,fold_start);
+
+	int nr_worker = svm_cross_validation_workers(nr_fold);
+	struct svm_parameter fold_param = *param;
+	Qfloat *kernel = NULL;
+	svm_path_node *node = NULL;
+	if((double)l*l*sizeof(Qfloat) <= param->cache_size*(1<<20))
+	{
+		kernel = Malloc(Qfloat,(size_t)l*l);
+		Kernel_Table(*prob,*param).fill(kernel,svm_cross_validation_workers(l)>1);
+		node = Malloc(svm_path_node,l);
+		for(i=0;i<l;i++)
 		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
+			node[i].x = prob->x[i];
+			node[i].id = i;
 		}
-		struct svm_model *submodel = svm_train(&subprob,param);
-		if(param->probability && 
-		   (param->svm_type == C_SVC || param->svm_type == NU_SVC))
+		qsort(node,l,sizeof(svm_path_node),compare_path_node);
+		// the table replaces most of the cache
+		fold_param.cache_size = max(1.0,param->cache_size-(double)l*l*sizeof(Qfloat)/(1<<20));
+	}
+	fold_param.cache_size /= nr_worker;
+
+#pragma omp parallel for schedule(dynamic) if(nr_worker>1)
+	for(int ifold=0;ifold<nr_fold;ifold++)
+	{
+		int begin = fold_start[ifold];
+		int end = fold_start[ifold+1];
+		struct svm_problem subprob;
+		svm_fold_problem(prob,perm,begin,end,&subprob);
+		struct svm_parameter C_param = fold_param;
+		svm_path_state state;
+		state.kernel = kernel;
+		state.l = l;
+		state.node = node;
+		state.nr_alpha = 0;
+		state.alpha = NULL;
+		state.alpha_l = NULL;
+		state.alpha_C = NULL;
+		int iC;
+		for(iC=0;iC<nr_C;iC++)
 		{
-			double *prob_estimates=Malloc(double,svm_get_nr_class(submodel));
-			for(j=begin;j<end;j++)
-				target[perm[j]] = svm_predict_probability(submodel,prob->x[perm[j]],prob_estimates);
-			free(prob_estimates);			
+			C_param.C = C[iC];
+			state.next = 0;
+			state.nr_bounded = 0;
+			struct svm_model *submodel = svm_train_path(&subprob,&C_param,&state);
+			svm_predict_fold(submodel,prob,perm,begin,end,dim,target+(size_t)iC*l);
+			svm_free_and_destroy_model(&submodel);
+			if(!state.nr_bounded && iC+1 < nr_C && C[iC+1] >= C[iC])
+				break;
 		}
-		else
-			for(j=begin;j<end;j++)
-				target[perm[j]] = svm_predict(submodel,prob->x[perm[j]]);
-		svm_free_and_destroy_model(&submodel);
+		// converged: the remaining C give the same prediction
+		for(int jC=iC+1;jC<nr_C;jC++)
+			for(int j=begin;j<end;j++)
+				target[(size_t)jC*l+perm[j]] = target[(size_t)iC*l+perm[j]];
+		for(i=0;i<state.nr_alpha;i++)
+			free(state.alpha[i]);
+		free(state.alpha);
+		free(state.alpha_l);
+		free(state.alpha_C);
 		free(subprob.x);
 		free(subprob.y);
-	}		
+	}
+	free(kernel);
+	free(node);
 	free(fold_start);
-	free(perm);	
+	free(perm);
 }
 
-
 int svm_get_svm_type(const svm_model *model)
 {
 	return model->param.svm_type;
@@ -2573,33 +2948,539 @@ double svm_predict_probability(
 		svm_predict_values(model, x, dec_values);
 
 		double min_prob=1e-7;
-		double **pairwise_prob=Malloc(double *,nr_class);
-		for(i=0;i<nr_class;i++)
-			pairwise_prob[i]=Malloc(double,nr_class);
+		double *pairwise_prob=(double *)calloc(2*nr_class*nr_class+nr_class,sizeof(double));	// diagonal stays 0
 		int k=0;
 		for(i=0;i<nr_class;i++)
 			for(int j=i+1;j<nr_class;j++)
 			{
-				pairwise_prob[i][j]=min(max(sigmoid_predict(dec_values[k],model->probA[k],model->probB[k]),min_prob),1-min_prob);
-				pairwise_prob[j][i]=1-pairwise_prob[i][j];
+				pairwise_prob[i*nr_class+j]=min(max(sigmoid_predict(dec_values[k],model->probA[k],model->probB[k]),min_prob),1-min_prob);
+				pairwise_prob[j*nr_class+i]=1-pairwise_prob[i*nr_class+j];
 				k++;
 			}
-		multiclass_probability(nr_class,pairwise_prob,prob_estimates);
+		multiclass_probability(nr_class,pairwise_prob,prob_estimates,pairwise_prob+nr_class*nr_class,pairwise_prob+2*nr_class*nr_class);
 
 		int prob_max_idx = 0;
 		for(i=1;i<nr_class;i++)
 			if(prob_estimates[i] > prob_estimates[prob_max_idx])
 				prob_max_idx = i;
-		for(i=0;i<nr_class;i++)
-			free(pairwise_prob[i]);
 		free(dec_values);
-		free(pairwise_prob);	     
+		free(pairwise_prob);
 		return model->label[prob_max_idx];
 	}
 	else 
 		return svm_predict(model, x);
 }
 
+// dense batch prediction: number of feature vectors for which kernel values are kept in the work space
+#define SVM_BATCH_SIZE 64
+
+static int dense_nr_decision(const svm_model *model)
+{
+	int svm_type = model->param.svm_type;
+	if(svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR)
+		return 1;
+	return model->nr_class*(model->nr_class-1)/2;
+}
+
+// collapse the decision functions to one weight vector each, given the image of every
+// support vector in a feature space of dimension nr_weight (basis[l*nr_weight])
+static void dense_collapse(svm_dense_model *dense, const double *basis, int nr_weight)
+{
+	const svm_model *model = dense->model;
+	int svm_type = model->param.svm_type;
+	int nr_class = model->nr_class;
+	size_t nr_decision = dense_nr_decision(model);
+	dense->nr_weight = nr_weight;
+	dense->weight = Malloc(double,nr_decision*nr_weight);
+	for(size_t i=0;i<nr_decision*nr_weight;i++)
+		dense->weight[i] = 0;
+	if(svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR)
+	{
+		for(int k=0;k<model->l;k++)
+			for(int c=0;c<nr_weight;c++)
+				dense->weight[c] += model->sv_coef[0][k] * basis[(size_t)k*nr_weight+c];
+		return;
+	}
+	int p=0;
+	int si=0;
+	for(int i=0;i<nr_class;i++)
+	{
+		int sj = si+model->nSV[i];
+		for(int j=i+1;j<nr_class;j++)
+		{
+			double *w = dense->weight+(size_t)p*nr_weight;
+			double *coef1 = model->sv_coef[j-1];
+			double *coef2 = model->sv_coef[i];
+			int k,c;
+			for(k=si;k<si+model->nSV[i];k++)
+				for(c=0;c<nr_weight;c++)
+					w[c] += coef1[k] * basis[(size_t)k*nr_weight+c];
+			for(k=sj;k<sj+model->nSV[j];k++)
+				for(c=0;c<nr_weight;c++)
+					w[c] += coef2[k] * basis[(size_t)k*nr_weight+c];
+			p++;
+			sj += model->nSV[j];
+		}
+		si += model->nSV[i];
+	}
+}
+
+// random Fourier features: z[c] = sqrt(2/D) cos(W[c].x + b[c]), with E[z(x).z(y)] = exp(-gamma*|x-y|^2)
+static void dense_rff_map(const svm_dense_model *dense, int nr_component, const double *x, double *z)
+{
+	int nr_feature = dense->nr_feature;
+	double norm = sqrt(2.0/nr_component);
+	for(int c=0;c<nr_component;c++)
+	{
+		const double *w = dense->rff_W+(size_t)c*nr_feature;
+		double sum = dense->rff_b[c];
+		for(int k=0;k<nr_feature;k++)
+			sum += w[k] * x[k];
+		z[c] = norm*cos(sum);
+	}
+}
+
+svm_dense_model *svm_create_dense_model(const svm_model *model, int nr_feature)
+{
+	if(model->param.kernel_type == PRECOMPUTED || nr_feature < 0)
+		return NULL;
+	int l = model->l;
+	svm_dense_model *dense = Malloc(svm_dense_model,1);
+	dense->model = model;
+	dense->nr_feature = nr_feature;
+	dense->SV = Malloc(double,(size_t)l*nr_feature+1);
+	dense->sv_tail = Malloc(double,l+1);
+	dense->nr_weight = 0;
+	dense->weight = NULL;
+	dense->rff_W = NULL;
+	dense->rff_b = NULL;
+	for(int i=0;i<l;i++)
+	{
+		double *sv = dense->SV+(size_t)i*nr_feature;
+		for(int j=0;j<nr_feature;j++)
+			sv[j] = 0;
+		dense->sv_tail[i] = 0;
+		for(const svm_node *p = model->SV[i];p->index != -1;++p)
+		{
+			if(p->index >= 1 && p->index <= nr_feature)
+				sv[p->index-1] = p->value;
+			else
+				dense->sv_tail[i] += p->value * p->value;
+		}
+	}
+	// a linear decision function is a single weight vector: no need to keep the support vectors
+	if(model->param.kernel_type == LINEAR && l > dense_nr_decision(model))
+	{
+		dense_collapse(dense,dense->SV,nr_feature);
+		free(dense->SV);
+		dense->SV = NULL;
+	}
+	return dense;
+}
+
+svm_dense_model *svm_create_dense_model_rff(const svm_model *model, int nr_feature, int nr_component, const double *W, const double *b)
+{
+	if(model->param.kernel_type != RBF || nr_component <= 0)
+		return NULL;
+	svm_dense_model *dense = svm_create_dense_model(model,nr_feature);
+	if(dense == NULL)
+		return NULL;
+	int l = model->l;
+	int i;
+	for(i=0;i<l;i++)
+		if(dense->sv_tail[i] != 0)
+		{
+			// support vectors with features beyond nr_feature are not in the random projection
+			svm_free_dense_model(&dense);
+			return NULL;
+		}
+	double scale = sqrt(2*model->param.gamma);
+	dense->rff_W = Malloc(double,(size_t)nr_component*nr_feature+1);
+	dense->rff_b = Malloc(double,nr_component);
+	for(size_t k=0;k<(size_t)nr_component*nr_feature;k++)
+		dense->rff_W[k] = scale*W[k];
+	for(i=0;i<nr_component;i++)
+		dense->rff_b[i] = b[i];
+	double *basis = Malloc(double,(size_t)l*nr_component);
+	for(i=0;i<l;i++)
+		dense_rff_map(dense,nr_component,dense->SV+(size_t)i*nr_feature,basis+(size_t)i*nr_component);
+	dense_collapse(dense,basis,nr_component);
+	free(basis);
+	free(dense->SV);
+	dense->SV = NULL;
+	return dense;
+}
+
+void svm_free_dense_model(svm_dense_model **dense_ptr_ptr)
+{
+	if(dense_ptr_ptr != NULL && *dense_ptr_ptr != NULL)
+	{
+		free((*dense_ptr_ptr)->SV);
+		free((*dense_ptr_ptr)->sv_tail);
+		free((*dense_ptr_ptr)->weight);
+		free((*dense_ptr_ptr)->rff_W);
+		free((*dense_ptr_ptr)->rff_b);
+		free(*dense_ptr_ptr);
+		*dense_ptr_ptr = NULL;
+	}
+}
+
+size_t svm_predict_batch_work_size(const svm_dense_model *dense)
+{
+	size_t l = dense->model->l;
+	size_t nr_class = dense->model->nr_class;
+	// kernel values (or feature map), decision values, votes, pairwise probabilities, Q and Qp
+	size_t nr_kvalue = (dense->nr_weight)? dense->nr_weight : SVM_BATCH_SIZE*l;
+	return nr_kvalue + nr_class*(nr_class-1)/2 + 1 + nr_class + 2*nr_class*nr_class + nr_class;
+}
+
+// kernel values of n feature vectors x (row major, nr_feature values each) with all support vectors
+// (sv_tail can be NULL if no support vector has features beyond nr_feature)
+static void dense_kernel_values(const svm_parameter& param, int l, const double *SV, const double *sv_tail, int nr_feature,
+	const double *x, int n, double *kvalue)
+{
+	// support vector in the outer loop: it stays in cache while the batch is processed
+	for(int j=0;j<l;j++)
+	{
+		const double *sv = SV+(size_t)j*nr_feature;
+		for(int i=0;i<n;i++)
+		{
+			const double *xi = x+(size_t)i*nr_feature;
+			double sum = 0;
+			int k;
+			switch(param.kernel_type)
+			{
+				case RBF:
+					for(k=0;k<nr_feature;k++)
+					{
+						double d = xi[k] - sv[k];
+						sum += d*d;
+					}
+					if(sv_tail != NULL)
+						sum += sv_tail[j];
+					kvalue[(size_t)i*l+j] = exp(-param.gamma*sum);
+					break;
+				case POLY:
+					for(k=0;k<nr_feature;k++)
+						sum += xi[k] * sv[k];
+					kvalue[(size_t)i*l+j] = powi(param.gamma*sum+param.coef0,param.degree);
+					break;
+				case SIGMOID:
+					for(k=0;k<nr_feature;k++)
+						sum += xi[k] * sv[k];
+					kvalue[(size_t)i*l+j] = tanh(param.gamma*sum+param.coef0);
+					break;
+				default:
+					for(k=0;k<nr_feature;k++)
+						sum += xi[k] * sv[k];
+					kvalue[(size_t)i*l+j] = sum;
+					break;
+			}
+		}
+	}
+}
+
+// decision values from the kernel values with all support vectors, same order of summation as svm_predict_values
+static void dense_kernel_decision_values(const svm_model *model, const double *kv, double *dec_values)
+{
+	int svm_type = model->param.svm_type;
+	int nr_class = model->nr_class;
+	if(svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR)
+	{
+		double *sv_coef = model->sv_coef[0];
+		double sum = 0;
+		for(int i=0;i<model->l;i++)
+			sum += sv_coef[i] * kv[i];
+		dec_values[0] = sum - model->rho[0];
+		return;
+	}
+	int p=0;
+	int si=0;
+	for(int i=0;i<nr_class;i++)
+	{
+		int sj = si+model->nSV[i];
+		for(int j=i+1;j<nr_class;j++)
+		{
+			double sum = 0;
+			int ci = model->nSV[i];
+			int cj = model->nSV[j];
+			int k;
+			double *coef1 = model->sv_coef[j-1];
+			double *coef2 = model->sv_coef[i];
+			for(k=0;k<ci;k++)
+				sum += coef1[si+k] * kv[si+k];
+			for(k=0;k<cj;k++)
+				sum += coef2[sj+k] * kv[sj+k];
+			sum -= model->rho[p];
+			dec_values[p] = sum;
+			p++;
+			sj += cj;
+		}
+		si += model->nSV[i];
+	}
+}
+
+// decision values from the collapsed weight vectors (z: work space for the random Fourier features)
+static void dense_weight_decision_values(const svm_dense_model *dense, const double *x, double *z, double *dec_values)
+{
+	int nr_weight = dense->nr_weight;
+	int nr_decision = dense_nr_decision(dense->model);
+	const double *feature = x;
+	if(dense->rff_W != NULL)
+	{
+		dense_rff_map(dense,nr_weight,x,z);
+		feature = z;
+	}
+	for(int p=0;p<nr_decision;p++)
+	{
+		const double *w = dense->weight+(size_t)p*nr_weight;
+		double sum = 0;
+		for(int k=0;k<nr_weight;k++)
+			sum += w[k] * feature[k];
+		dec_values[p] = sum - dense->model->rho[p];
+	}
+}
+
+// label (and probability estimates if prob is not NULL) from the decision values of a classification model
+static void dense_decide(const svm_model *model, const double *dec_values, double *vote,
+	double *pairwise_prob, double *Q, double *Qp, double *label, double *prob)
+{
+	int nr_class = model->nr_class;
+	const double min_prob=1e-7;
+	for(int i=0;i<nr_class;i++)
+		vote[i] = 0;
+	int p=0;
+	for(int i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			if(dec_values[p] > 0)
+				++vote[i];
+			else
+				++vote[j];
+			p++;
+		}
+	int max_idx = 0;
+	if(prob != NULL)
+	{
+		int k=0;
+		for(int i=0;i<nr_class;i++)
+			for(int j=i+1;j<nr_class;j++)
+			{
+				pairwise_prob[i*nr_class+j]=min(max(sigmoid_predict(dec_values[k],model->probA[k],model->probB[k]),min_prob),1-min_prob);
+				pairwise_prob[j*nr_class+i]=1-pairwise_prob[i*nr_class+j];
+				k++;
+			}
+		multiclass_probability(nr_class,pairwise_prob,prob,Q,Qp);
+		for(int i=1;i<nr_class;i++)
+			if(prob[i] > prob[max_idx])
+				max_idx = i;
+	}
+	else
+	{
+		for(int i=1;i<nr_class;i++)
+			if(vote[i] > vote[max_idx])
+				max_idx = i;
+	}
+	*label = model->label[max_idx];
+}
+
+static bool dense_probability(const svm_model *model)
+{
+	int svm_type = model->param.svm_type;
+	return (svm_type == C_SVC || svm_type == NU_SVC) && model->probA != NULL && model->probB != NULL;
+}
+
+void svm_predict_batch(const svm_dense_model *dense, const double *x, int n,
+	double *labels, double *prob_estimates, double *work)
+{
+	const svm_model *model = dense->model;
+	int svm_type = model->param.svm_type;
+	int nr_class = model->nr_class;
+	int l = model->l;
+	int m = nr_class*(nr_class-1)/2;
+	bool probability = prob_estimates != NULL && dense_probability(model);
+
+	double *kvalue = work;
+	double *dec_values = kvalue + ((dense->nr_weight)? (size_t)dense->nr_weight : (size_t)SVM_BATCH_SIZE*l);
+	double *vote = dec_values + m + 1;
+	double *pairwise_prob = vote + nr_class;
+	double *Q = pairwise_prob + nr_class*nr_class;
+	double *Qp = Q + nr_class*nr_class;
+
+	for(int first=0;first<n;first+=SVM_BATCH_SIZE)
+	{
+		int nbatch = min(SVM_BATCH_SIZE,n-first);
+		if(!dense->nr_weight)
+			dense_kernel_values(model->param,l,dense->SV,dense->sv_tail,dense->nr_feature,x+(size_t)first*dense->nr_feature,nbatch,kvalue);
+		for(int b=0;b<nbatch;b++)
+		{
+			double *label = labels+first+b;
+			if(dense->nr_weight)
+				dense_weight_decision_values(dense,x+(size_t)(first+b)*dense->nr_feature,kvalue,dec_values);
+			else
+				dense_kernel_decision_values(model,kvalue+(size_t)b*l,dec_values);
+			if(svm_type == ONE_CLASS)
+				*label = (dec_values[0]>0)?1:-1;
+			else if(svm_type == EPSILON_SVR || svm_type == NU_SVR)
+				*label = dec_values[0];
+			else
+				dense_decide(model,dec_values,vote,pairwise_prob,Q,Qp,label,probability ? prob_estimates+(size_t)(first+b)*nr_class : NULL);
+		}
+	}
+}
+
+// row hash for the union of support vectors
+static unsigned long dense_row_hash(const double *row, int n)
+{
+	const unsigned char *byte = (const unsigned char *)row;
+	unsigned long hash = 2166136261UL;
+	for(size_t i=0;i<(size_t)n*sizeof(double);i++)
+		hash = (hash ^ byte[i]) * 16777619UL;
+	return hash;
+}
+
+svm_dense_ensemble *svm_create_dense_ensemble(const svm_model *const *model, int nr_model, int nr_feature)
+{
+	if(nr_model < 1 || nr_feature < 1)
+		return NULL;
+	const svm_parameter& param = model[0]->param;
+	if(param.kernel_type == PRECOMPUTED)
+		return NULL;
+	int total = 0;
+	int m,i;
+	for(m=0;m<nr_model;m++)
+	{
+		const svm_parameter& mparam = model[m]->param;
+		if(mparam.kernel_type != param.kernel_type || mparam.gamma != param.gamma ||
+			mparam.coef0 != param.coef0 || mparam.degree != param.degree)
+			return NULL;
+		for(i=0;i<model[m]->l;i++)
+			for(const svm_node *p = model[m]->SV[i];p->index != -1;++p)
+				if(p->index < 1 || p->index > nr_feature)
+					return NULL;
+		total += model[m]->l;
+	}
+
+	svm_dense_ensemble *ensemble = Malloc(svm_dense_ensemble,1);
+	ensemble->nr_model = nr_model;
+	ensemble->model = Malloc(const svm_model *,nr_model);
+	ensemble->nr_feature = nr_feature;
+	ensemble->l = 0;
+	ensemble->SV = Malloc(double,(size_t)total*nr_feature+1);
+	ensemble->sv_index = Malloc(int *,nr_model);
+
+	// open addressing hash table of positions in SV
+	int table_size = 1;
+	while(table_size < 2*total)
+		table_size *= 2;
+	int *table = Malloc(int,table_size);
+	for(i=0;i<table_size;i++)
+		table[i] = -1;
+	double *row = Malloc(double,nr_feature);
+	for(m=0;m<nr_model;m++)
+	{
+		ensemble->model[m] = model[m];
+		ensemble->sv_index[m] = Malloc(int,model[m]->l+1);
+		for(i=0;i<model[m]->l;i++)
+		{
+			int k;
+			for(k=0;k<nr_feature;k++)
+				row[k] = 0;
+			for(const svm_node *p = model[m]->SV[i];p->index != -1;++p)
+				row[p->index-1] = p->value;
+			unsigned long slot = dense_row_hash(row,nr_feature) & (table_size-1);
+			while(table[slot] >= 0 && memcmp(ensemble->SV+(size_t)table[slot]*nr_feature,row,nr_feature*sizeof(double)))
+				slot = (slot+1) & (table_size-1);
+			if(table[slot] < 0)
+			{
+				table[slot] = ensemble->l++;
+				memcpy(ensemble->SV+(size_t)table[slot]*nr_feature,row,nr_feature*sizeof(double));
+			}
+			ensemble->sv_index[m][i] = table[slot];
+		}
+	}
+	free(row);
+	free(table);
+	return ensemble;
+}
+
+void svm_free_dense_ensemble(svm_dense_ensemble **ensemble_ptr_ptr)
+{
+	if(ensemble_ptr_ptr != NULL && *ensemble_ptr_ptr != NULL)
+	{
+		svm_dense_ensemble *ensemble = *ensemble_ptr_ptr;
+		for(int m=0;m<ensemble->nr_model;m++)
+			free(ensemble->sv_index[m]);
+		free(ensemble->sv_index);
+		free(ensemble->SV);
+		free(ensemble->model);
+		free(ensemble);
+		*ensemble_ptr_ptr = NULL;
+	}
+}
+
+size_t svm_predict_ensemble_work_size(const svm_dense_ensemble *ensemble)
+{
+	size_t max_l = 0;
+	size_t max_class = 0;
+	for(int m=0;m<ensemble->nr_model;m++)
+	{
+		max_l = max(max_l,(size_t)ensemble->model[m]->l);
+		max_class = max(max_class,(size_t)ensemble->model[m]->nr_class);
+	}
+	// kernel values with the union, kernel values per model, decision values, votes, pairwise probabilities, Q and Qp
+	return SVM_BATCH_SIZE*(size_t)ensemble->l + max_l + max_class*(max_class-1)/2 + 1 + max_class + 2*max_class*max_class + max_class;
+}
+
+void svm_predict_ensemble(const svm_dense_ensemble *ensemble, const double *x, int n,
+	double **labels, double **prob_estimates, double *work)
+{
+	int l = ensemble->l;
+	size_t max_l = 0;
+	size_t max_class = 0;
+	int m;
+	for(m=0;m<ensemble->nr_model;m++)
+	{
+		max_l = max(max_l,(size_t)ensemble->model[m]->l);
+		max_class = max(max_class,(size_t)ensemble->model[m]->nr_class);
+	}
+	double *kvalue = work;
+	double *kv = kvalue + (size_t)SVM_BATCH_SIZE*l;
+	double *dec_values = kv + max_l;
+	double *vote = dec_values + max_class*(max_class-1)/2 + 1;
+	double *pairwise_prob = vote + max_class;
+	double *Q = pairwise_prob + max_class*max_class;
+	double *Qp = Q + max_class*max_class;
+
+	for(int first=0;first<n;first+=SVM_BATCH_SIZE)
+	{
+		int nbatch = min(SVM_BATCH_SIZE,n-first);
+		// kernel values with the union of the support vectors, computed once for all models
+		dense_kernel_values(ensemble->model[0]->param,l,ensemble->SV,NULL,ensemble->nr_feature,x+(size_t)first*ensemble->nr_feature,nbatch,kvalue);
+		for(m=0;m<ensemble->nr_model;m++)
+		{
+			const svm_model *model = ensemble->model[m];
+			int svm_type = model->param.svm_type;
+			bool probability = prob_estimates != NULL && prob_estimates[m] != NULL && dense_probability(model);
+			const int *sv_index = ensemble->sv_index[m];
+			for(int b=0;b<nbatch;b++)
+			{
+				const double *kunion = kvalue+(size_t)b*l;
+				for(int i=0;i<model->l;i++)
+					kv[i] = kunion[sv_index[i]];
+				dense_kernel_decision_values(model,kv,dec_values);
+				double *label = labels[m]+first+b;
+				if(svm_type == ONE_CLASS)
+					*label = (dec_values[0]>0)?1:-1;
+				else if(svm_type == EPSILON_SVR || svm_type == NU_SVR)
+					*label = dec_values[0];
+				else
+					dense_decide(model,dec_values,vote,pairwise_prob,Q,Qp,label,probability ? prob_estimates[m]+(size_t)(first+b)*model->nr_class : NULL);
+			}
+		}
+	}
+}
+
 static const char *svm_type_table[] =
 {
 	"c_svc","nu_svc","one_class","epsilon_svr","nu_svr",NULL
@@ -2940,8 +3821,204 @@ svm_model *svm_load_model(const char *model_file_name)
 	return model;
 }
 
+// binary model block (native byte order, all arrays aligned to 8 bytes), used for model files
+// that are mapped in memory: svm_load_model_binary does not copy the data arrays
+static void write_padding(FILE *fp, size_t size)
+{
+	static const char zeros[8] = {0,0,0,0,0,0,0,0};
+	if(size % 8)
+		fwrite(zeros,1,8 - size % 8,fp);
+}
+
+static void write_padded(FILE *fp, const void *data, size_t size)
+{
+	if(size > 0)
+		fwrite(data,1,size,fp);
+	write_padding(fp,size);
+}
+
+static size_t padded_size(size_t size)
+{
+	return (size + 7) / 8 * 8;
+}
+
+int svm_save_model_binary(FILE *fp, const svm_model *model)
+{
+	int nr_class = model->nr_class;
+	int l = model->l;
+	int m = nr_class*(nr_class-1)/2;
+	const svm_parameter& param = model->param;
+
+	int64_t nnode = 0;
+	for(int i=0;i<l;i++)
+	{
+		const svm_node *p = model->SV[i];
+		while(p->index != -1)
+		{
+			++nnode;
+			++p;
+		}
+		++nnode;
+	}
+
+	int header[8];
+	header[0] = (int) sizeof(svm_node);
+	header[1] = param.svm_type;
+	header[2] = param.kernel_type;
+	header[3] = param.degree;
+	header[4] = nr_class;
+	header[5] = l;
+	header[6] = (model->label ? 1 : 0) | (model->probA ? 2 : 0) | (model->probB ? 4 : 0) | (model->nSV ? 8 : 0);
+	header[7] = 0;
+	write_padded(fp,header,sizeof(header));
+	double kernel[2];
+	kernel[0] = param.gamma;
+	kernel[1] = param.coef0;
+	write_padded(fp,kernel,sizeof(kernel));
+	write_padded(fp,&nnode,sizeof(nnode));
+
+	write_padded(fp,model->rho,m*sizeof(double));
+	if(model->probA)
+		write_padded(fp,model->probA,m*sizeof(double));
+	if(model->probB)
+		write_padded(fp,model->probB,m*sizeof(double));
+	if(model->label)
+		write_padded(fp,model->label,nr_class*sizeof(int));
+	if(model->nSV)
+		write_padded(fp,model->nSV,nr_class*sizeof(int));
+	for(int j=0;j<nr_class-1;j++)
+		write_padded(fp,model->sv_coef[j],l*sizeof(double));
+	for(int i=0;i<l;i++)
+	{
+		const svm_node *p = model->SV[i];
+		while(p->index != -1)
+			++p;
+		fwrite(model->SV[i],sizeof(svm_node),p - model->SV[i] + 1,fp);
+	}
+	write_padding(fp,nnode*sizeof(svm_node));
+
+	return (ferror(fp) != 0) ? -1 : 0;
+}
+
+svm_model *svm_load_model_binary(const char *buffer, size_t size, size_t *used)
+{
+	const char *p = buffer;
+	const char *end = buffer + size;
+	if(size < 8*sizeof(int) + 2*sizeof(double) + sizeof(int64_t))
+		return NULL;
+
+	const int *header = (const int *) p;
+	p += padded_size(8*sizeof(int));
+	if(header[0] != (int) sizeof(svm_node))
+		return NULL;
+	const double *kernel = (const double *) p;
+	p += padded_size(2*sizeof(double));
+	int64_t nnode = *(const int64_t *) p;
+	p += padded_size(sizeof(int64_t));
+
+	int nr_class = header[4];
+	int l = header[5];
+	int flags = header[6];
+	// check the counts against the remaining bytes before any size is computed from them
+	size_t available = end - p;
+	if(nr_class < 1 || l < 0 || nnode < l)
+		return NULL;
+	if((size_t)(nr_class-1) > 2*(available/sizeof(double))/nr_class
+		|| (nr_class > 1 && (size_t)l > available/sizeof(double)/(nr_class-1))
+		|| (uint64_t)nnode > available/sizeof(svm_node))
+		return NULL;
+	size_t m = (size_t)nr_class*(nr_class-1)/2;
+	size_t needed = padded_size(m*sizeof(double)) * (1 + ((flags & 2) ? 1 : 0) + ((flags & 4) ? 1 : 0))
+		+ padded_size(nr_class*sizeof(int)) * (((flags & 1) ? 1 : 0) + ((flags & 8) ? 1 : 0))
+		+ padded_size(l*sizeof(double)) * (nr_class-1)
+		+ padded_size(nnode*sizeof(svm_node));
+	if(needed > available)
+		return NULL;
+
+	svm_model *model = Malloc(svm_model,1);
+	svm_parameter& param = model->param;
+	memset(&param,0,sizeof(svm_parameter));
+	param.svm_type = header[1];
+	param.kernel_type = header[2];
+	param.degree = header[3];
+	param.gamma = kernel[0];
+	param.coef0 = kernel[1];
+	param.probability = (flags & 2) ? 1 : 0;
+	model->nr_class = nr_class;
+	model->l = l;
+
+	// the arrays point into the buffer, which must outlive the model
+	model->rho = (double *) p;
+	p += padded_size(m*sizeof(double));
+	model->probA = NULL;
+	model->probB = NULL;
+	model->label = NULL;
+	model->nSV = NULL;
+	if(flags & 2)
+	{
+		model->probA = (double *) p;
+		p += padded_size(m*sizeof(double));
+	}
+	if(flags & 4)
+	{
+		model->probB = (double *) p;
+		p += padded_size(m*sizeof(double));
+	}
+	if(flags & 1)
+	{
+		model->label = (int *) p;
+		p += padded_size(nr_class*sizeof(int));
+	}
+	if(flags & 8)
+	{
+		model->nSV = (int *) p;
+		p += padded_size(nr_class*sizeof(int));
+	}
+	model->sv_coef = Malloc(double *,nr_class-1 > 0 ? nr_class-1 : 1);
+	for(int j=0;j<nr_class-1;j++)
+	{
+		model->sv_coef[j] = (double *) p;
+		p += padded_size(l*sizeof(double));
+	}
+	svm_node *x_space = (svm_node *) p;
+	p += padded_size(nnode*sizeof(svm_node));
+	model->SV = Malloc(svm_node *,l > 0 ? l : 1);
+	int64_t j = 0;
+	model->free_sv = 2;
+	for(int i=0;i<l;i++)
+	{
+		model->SV[i] = &x_space[j];
+		while(j < nnode && x_space[j].index != -1)
+			++j;
+		if(j == nnode)
+		{
+			// support vector without terminator
+			svm_free_and_destroy_model(&model);
+			return NULL;
+		}
+		++j;
+	}
+	if(used)
+		*used = p - buffer;
+	return model;
+}
+
 void svm_free_model_content(svm_model* model_ptr)
 {
+	if(model_ptr->free_sv == 2)
+	{
+		// created by svm_load_model_binary: only the pointer arrays are owned by the model
+		free(model_ptr->SV);
+		model_ptr->SV = NULL;
+		free(model_ptr->sv_coef);
+		model_ptr->sv_coef = NULL;
+		model_ptr->rho = NULL;
+		model_ptr->label = NULL;
+		model_ptr->probA = NULL;
+		model_ptr->probB = NULL;
+		model_ptr->nSV = NULL;
+		return;
+	}
 	if(model_ptr->free_sv && model_ptr->l > 0 && model_ptr->SV != NULL)
 		free((void *)(model_ptr->SV[0]));
 	if(model_ptr->sv_coef)
@@ -3117,6 +4194,11 @@ int svm_check_probability_model(const svm_model *model)
 		 model->probA!=NULL);
 }
 
+void svm_set_random_seed(unsigned long seed)
+{
+	svm_random_seed = seed;
+}
+
 void svm_set_print_string_function(void (*print_func)(const char *))
 {
 	if(print_func == NULL)
@@ -1,6 +1,8 @@
 #ifndef _LIBSVM_H
 #define _LIBSVM_H
 
+#include <stdio.h>
+
 #define LIBSVM_VERSION 312
 
 #ifdef __cplusplus
@@ -69,13 +71,42 @@ struct svm_model
 	/* XXX */
 	int free_sv;		/* 1 if svm_model is created by svm_load_model*/
 				/* 0 if svm_model is created by svm_train */
+				/* 2 if svm_model is created by svm_load_model_binary */
+};
+
+/* support vectors as dense rows, for batch prediction of dense feature vectors */
+struct svm_dense_model
+{
+	const struct svm_model *model;
+	int nr_feature;		/* number of features (indices 1..nr_feature) */
+	double *SV;		/* SV[l*nr_feature] (NULL if the decision functions are collapsed) */
+	double *sv_tail;	/* squared norm of SV values with index > nr_feature (sv_tail[l]) */
+	int nr_weight;		/* length of the collapsed weight vectors (0: predict with the support vectors) */
+	double *weight;		/* one weight vector per decision function (linear kernel or random Fourier features) */
+	double *rff_W;		/* random Fourier features approximating an RBF kernel: rff_W[nr_weight*nr_feature] */
+	double *rff_b;		/* rff_b[nr_weight] */
+};
+
+/* bagged models sharing the kernel values with the union of their support vectors */
+struct svm_dense_ensemble
+{
+	int nr_model;
+	const struct svm_model **model;
+	int nr_feature;		/* number of features (indices 1..nr_feature) */
+	int l;			/* number of distinct support vectors over all models */
+	double *SV;		/* SV[l*nr_feature] */
+	int **sv_index;		/* sv_index[m][i]: row in SV of support vector i of model m */
 };
 
 struct svm_model *svm_train(const struct svm_problem *prob, const struct svm_parameter *param);
 void svm_cross_validation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, double *target);
+/* target[nr_C*l]: cross validation for each C (in increasing order for C_SVC, which shares the kernel and warm starts along the path) */
+void svm_cross_validation_path(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, int nr_C, const double *C, double *target);
 
 int svm_save_model(const char *model_file_name, const struct svm_model *model);
 struct svm_model *svm_load_model(const char *model_file_name);
+int svm_save_model_binary(FILE *fp, const struct svm_model *model);
+struct svm_model *svm_load_model_binary(const char *buffer, size_t size, size_t *used);
 
 int svm_get_svm_type(const struct svm_model *model);
 int svm_get_nr_class(const struct svm_model *model);
@@ -86,6 +117,20 @@ double svm_predict_values(const struct svm_model *model, const struct svm_node *
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
 
+struct svm_dense_model *svm_create_dense_model(const struct svm_model *model, int nr_feature);
+/* approximate RBF model: W[nr_component*nr_feature] standard normal, b[nr_component] uniform in [0,2pi[ */
+struct svm_dense_model *svm_create_dense_model_rff(const struct svm_model *model, int nr_feature, int nr_component, const double *W, const double *b);
+void svm_free_dense_model(struct svm_dense_model **dense_ptr_ptr);
+size_t svm_predict_batch_work_size(const struct svm_dense_model *dense);
+void svm_predict_batch(const struct svm_dense_model *dense, const double *x, int n, double *labels, double *prob_estimates, double *work);
+
+/* NULL if the models do not share the kernel parameters */
+struct svm_dense_ensemble *svm_create_dense_ensemble(const struct svm_model *const *model, int nr_model, int nr_feature);
+void svm_free_dense_ensemble(struct svm_dense_ensemble **ensemble_ptr_ptr);
+size_t svm_predict_ensemble_work_size(const struct svm_dense_ensemble *ensemble);
+/* labels[m][n] and prob_estimates[m][n*nr_class] per model (prob_estimates or prob_estimates[m] can be NULL) */
+void svm_predict_ensemble(const struct svm_dense_ensemble *ensemble, const double *x, int n, double **labels, double **prob_estimates, double *work);
+
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
 void svm_destroy_param(struct svm_parameter *param);
@@ -94,6 +139,8 @@ const char *svm_check_parameter(const struct svm_problem *prob, const struct svm
 int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
+/* seed for the shuffles in cross validation and probability estimates (default 1) */
+void svm_set_random_seed(unsigned long seed);
 
 #ifdef __cplusplus
 }
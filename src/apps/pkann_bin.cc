@@ -32,7 +32,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 ## SYNOPSIS
 
 <code>
-  Usage: pkann -t training [-i input -o output] [-cv value]
+  Usage: pkann -t training|-model file [-i input -o output] [-cv value]
 </code>
 
 <code>
@@ -55,6 +55,7 @@ The utility pkann implements an artificial neural network (ANN) to solve a super
 |-----|----|----|-------|-----------|
  | i      | input                | std::string |       |input image | 
  | t      | training             | std::string |       |training vector file. A single vector file contains all training features (must be set as: B0, B1, B2,...) for all classes (class numbers identified by label option). Use multiple training files for bootstrap aggregation (alternative to the bag and bsize options, where a random subset is taken from a single training file) | 
+ | model  | model                | std::string |       |Model file. With training, the trained networks (all bags, scaling, classes and priors) are saved to this file. Without training, the networks are read from this file and no training is done | 
  | tln    | tln                  | std::string |       |training layer name(s) | 
  | label  | label                | std::string | label |identifier for class label in training vector file. | 
  | bal    | balance              | unsigned int | 0     |balance the input data to this number of samples for each class | 
@@ -92,7 +93,7 @@ The utility pkann implements an artificial neural network (ANN) to solve a super
  | c      | class                | std::string |       |list of class names. | 
  | r      | reclass              | short |       |list of class values (use same order as in class opt). | 
 
-Usage: pkann -t training [-i input -o output] [-cv value]
+Usage: pkann -t training|-model file [-i input -o output] [-cv value]
 
 
 Examples
@@ -142,7 +143,7 @@ int main(int argc, char *argv[])
   }
   catch(string helpString){
     cerr << helpString << endl;
-    cout << "Usage: pkann -t training [-i input [-o output]] [-cv value]" << endl;
+    cout << "Usage: pkann -t training|-model file [-i input [-o output]] [-cv value]" << endl;
     return(1);
   }
   return(0);
@@ -198,6 +198,8 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   | wout   | wavelengthOut        | double |       |list of wavelengths in output spectrum (-wout band1 -wout band2 ...) | 
   | d      | down                 | short | 1     |down sampling factor. Use value 1 for no downsampling). Use value n>1 for downsampling (aggregation) | 
   | beta   | beta                 | std::string |       |ASCII file with beta for each class transition in Markov Random Field | 
+  | iter   | iter                 | unsigned short | 0     |maximum number of iterated conditional modes updates in Markov Random Field (0: no update) | 
+  | minchange | minchange         | double | 0     |stop iterating Markov Random Field when proportion of changed pixels is below this value (evaluated per strip of 1024 rows) | 
   | interp | interp               | std::string | akima |type of interpolation for spectral filtering (see http://www.gnu.org/software/gsl/manual/html_node/Interpolation-Types.html) | 
   | ot     | otype                | std::string |       |Data type for output image ({Byte/Int16/UInt16/UInt32/Int32/Float32/Float64/CInt16/CInt32/CFloat32/CFloat64}). Empty string: inherit type from input image | 
   | of     | oformat              | std::string | GTiff |Output image format (see also gdal_translate).| 
@@ -38,7 +38,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   
   Options: [-f filter] [-dim maxsize]
 
-  Advanced options: [-ot type] [-of format] [-ct colortable] [-nodata value] [-circ] [-st threshold] [-ht threshold] [-minchange value]
+  Advanced options: [-ot type] [-of format] [-ct colortable] [-nodata value] [-circ] [-st threshold] [-ht threshold] [-minchange value] [-tile size] [-overlap size]
 
 </code>
 
@@ -58,6 +58,8 @@ The utility pkfilterdem can be used to filter digital elevation models. It is ty
  | st     | st                   | double | 0     |slope threshold used for morphological filtering. Use a low values to remove more height objects in flat terrains | 
  | ht     | ht                   | double | 0.2   |initial height threshold for progressive morphological filtering. Use low values to remove more height objects. Optionally, a maximum height threshold can be set via a second argument (e.g., -ht 0.2 -ht 2.5 sets an initial threshold at 0.2 m and caps the threshold at 2.5 m). | 
  | minchange | minchange            | short | 0     |Stop iterations when no more pixels are changed than this threshold. | 
+ | tile   | tile                 | int  | 1024  |tile size (in pixels) for vito filter. Tiles are filtered in parallel | 
+ | overlap | overlap             | int  | 64    |overlap (in pixels) between tiles for vito filter | 
  | ot     | otype                | std::string |       |Data type for output image ({Byte/Int16/UInt16/UInt32/Int32/Float32/Float64/CInt16/CInt32/CFloat32/CFloat64}). Empty string: inherit type from input image | 
  | of     | oformat              | std::string | GTiff |Output image format (see also gdal_translate).| 
  | ct     | ct                   | std::string |       |color table (file with 5 columns: id R G B ALFA (0: transparent, 255: solid). Use none to omit color table | 
@@ -82,6 +84,8 @@ int main(int argc,char **argv) {
   Optionpk<double> maxSlope_opt("st", "st", "slope threshold used for morphological filtering. Use a low values to remove more height objects in flat terrains", 0.0);
   Optionpk<double> hThreshold_opt("ht", "ht", "initial height threshold for progressive morphological filtering. Use low values to remove more height objects. Optionally, a maximum height threshold can be set via a second argument (e.g., -ht 0.2 -ht 2.5 sets an initial threshold at 0.2 m and caps the threshold at 2.5 m).", 0.2);
   Optionpk<short> minChange_opt("minchange", "minchange", "Stop iterations when no more pixels are changed than this threshold.", 0);
+  Optionpk<int> tile_opt("tile", "tile", "tile size (in pixels) for vito filter. Tiles are filtered in parallel", 1024);
+  Optionpk<int> overlap_opt("overlap", "overlap", "overlap (in pixels) between tiles for vito filter", 64);
   Optionpk<std::string>  otype_opt("ot", "otype", "Data type for output image ({Byte/Int16/UInt16/UInt32/Int32/Float32/Float64/CInt16/CInt32/CFloat32/CFloat64}). Empty string: inherit type from input image","");
   Optionpk<string>  oformat_opt("of", "oformat", "Output image format (see also gdal_translate).","GTiff");
   Optionpk<string>  colorTable_opt("ct", "ct", "color table (file with 5 columns: id R G B ALFA (0: transparent, 255: solid). Use none to omit color table");
@@ -93,6 +97,8 @@ int main(int argc,char **argv) {
   maxSlope_opt.setHide(1);
   hThreshold_opt.setHide(1);
   minChange_opt.setHide(1);
+  tile_opt.setHide(1);
+  overlap_opt.setHide(1);
   otype_opt.setHide(1);
   oformat_opt.setHide(1);
   colorTable_opt.setHide(1);
@@ -109,6 +115,8 @@ int main(int argc,char **argv) {
     maxSlope_opt.retrieveOption(argc,argv);
     hThreshold_opt.retrieveOption(argc,argv);
     minChange_opt.retrieveOption(argc,argv);
+    tile_opt.retrieveOption(argc,argv);
+    overlap_opt.retrieveOption(argc,argv);
     otype_opt.retrieveOption(argc,argv);
     oformat_opt.retrieveOption(argc,argv);
     colorTable_opt.retrieveOption(argc,argv);
@@ -184,10 +192,16 @@ int main(int argc,char **argv) {
 	outputWriter.GDALSetNoDataValue(nodata_opt[0],iband);
   }
 
-  Vector2d<double> inputData(input.nrOfRow(),input.nrOfCol());
-  Vector2d<double> outputData(outputWriter.nrOfRow(),outputWriter.nrOfCol());
-  Vector2d<double> tmpData(outputWriter.nrOfRow(),outputWriter.nrOfCol());
-  input.readDataBlock(inputData,0,inputData.nCols()-1,0,inputData.nRows()-1);
+  Vector2d<double> inputData;
+  Vector2d<double> outputData;
+  Vector2d<double> tmpData;
+  //vito filter is processed in tiles, other filters need the entire image in memory
+  if(postFilter_opt[0]!="vito"){
+    inputData.resize(input.nrOfRow(),input.nrOfCol());
+    outputData.resize(outputWriter.nrOfRow(),outputWriter.nrOfCol());
+    tmpData.resize(outputWriter.nrOfRow(),outputWriter.nrOfCol());
+    input.readDataBlock(inputData,0,inputData.nCols()-1,0,inputData.nRows()-1);
+  }
 
   //apply post filter
   std::cout << "Applying post processing filter: " << postFilter_opt[0] << std::endl;
@@ -225,127 +239,10 @@ int main(int argc,char **argv) {
     nlimit[1]=3;
     nlimit[2]=4;
     nlimit[2]=2;
-    //init finalMask
-    for(int irow=0;irow<tmpData.nRows();++irow)
-      for(int icol=0;icol<tmpData.nCols();++icol)
-	tmpData[irow][icol]=1;
-    for(int iheight=0;iheight<hThreshold_opt.size();++iheight){
-      if(verbose_opt[0])
-	cout << "height: " << hThreshold_opt[iheight] << endl;
-      //todo:replace with binary mask (or short) -> adapt template with T1,T2 in Filter2d
-      Vector2d<double> tmpMask(input.nrOfRow(),input.nrOfCol());
-      for(int irow=0;irow<tmpMask.nRows();++irow)
-	for(int icol=0;icol<tmpMask.nCols();++icol)
-	  tmpMask[irow][icol]=1;//1=surface, 0=terrain
-      if(verbose_opt[0])
-	cout << "filtering NWSE" << endl;
-      //from here
-      // Vector2d<double> tmpDSM(inputData);
-      // int dimX=dim_opt[0];
-      // int dimY=dim_opt[0];
-      // assert(dimX);
-      // assert(dimY);
-      // statfactory::StatFactory stat;
-      // Vector2d<double> inBuffer(dimY,inputData.nCols());
-      // if(tmpData.size()!=inputData.nRows())
-      // 	tmpData.resize(inputData.nRows());
-      // int indexI=0;
-      // int indexJ=inputData.nRows()-1;
-      // // int indexJ=0;
-      // //initialize last half of inBuffer
-      // for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-      // 	for(int i=0;i<inputData.nCols();++i)
-      // 	  inBuffer[indexJ][i]=tmpDSM[abs(j)][i];
-      // 	--indexJ;
-      // 	// ++indexJ;
-      // }
-      // for(int y=tmpDSM.nRows()-1;y>=0;--y){
-      // 	if(y){//inBuffer already initialized for y=0
-      // 	  //erase first line from inBuffer
-      // 	  inBuffer.erase(inBuffer.end()-1);
-      // 	  // inBuffer.erase(inBuffer.begin());
-      // 	  //read extra line and push back to inBuffer if not out of bounds
-      // 	  if(y+dimY/2<tmpDSM.nRows()){
-      // 	    //allocate buffer
-      // 	    // inBuffer.push_back(inBuffer.back());
-      // 	    inBuffer.insert(inBuffer.begin(),*(inBuffer.begin()));
-      // 	    for(int i=0;i<tmpDSM.nCols();++i) 
-      // 	      inBuffer[0][i]=tmpDSM[y-dimY/2][i];
-      // 	      // inBuffer[inBuffer.size()-1][i]=tmpDSM[y+dimY/2][i];
-      // 	  }
-      // 	  else{
-      // 	    int over=y+dimY/2-tmpDSM.nRows();
-      // 	    int index=(inBuffer.size()-1)-over;
-      // 	    assert(index>=0);
-      // 	    assert(index<inBuffer.size());
-      // 	    inBuffer.push_back(inBuffer[index]);
-      // 	  }
-      // 	}
-      // 	for(int x=tmpDSM.nCols()-1;x>=0;--x){
-      // 	  double centerValue=inBuffer[(dimY-1)/2][x];
-      // 	  //test
-      // 	  cout << "pixel ("  << x << "," << y << "): " << centerValue << endl;
-      // 	  short nmasked=0;
-      // 	  std::vector<double> neighbors;
-      // 	  for(int j=-(dimY-1)/2;j<=dimY/2;++j){
-      // 	    for(int i=-(dimX-1)/2;i<=dimX/2;++i){
-      // 	      indexI=x+i;
-      // 	      //check if out of bounds
-      // 	      if(indexI<0)
-      // 		indexI=-indexI;
-      // 	      else if(indexI>=tmpDSM.nCols())
-      // 		indexI=tmpDSM.nCols()-i;
-      // 	      if(y+j<0)
-      // 		indexJ=-j;
-      // 	      else if(y+j>=tmpDSM.nRows())
-      // 		indexJ=(dimY>2) ? (dimY-1)/2-j : 0;
-      // 	      else
-      // 		indexJ=(dimY-1)/2+j;
-      // 	      double difference=(centerValue-inBuffer[indexJ][indexI]);
-      // 	      //test
-      // 	      cout << "centerValue-inBuffer[" << indexJ << "][" << indexI << "]=" << centerValue << " - " << inBuffer[indexJ][indexI] << " = " << difference << endl;
-      // 	      if(i||j)//skip centerValue
-      // 		neighbors.push_back(inBuffer[indexJ][indexI]);
-      // 	      if(difference>hThreshold_opt[iheight])
-      // 		++nmasked;
-      // 	    }
-      // 	  }
-      // 	  //test
-      // 	  cout << "pixel " << x << ", " << y << ": nmasked is " << nmasked << endl;
-      // 	  if(nmasked<=nlimit[iheight]){
-      // 	    ++nchange;
-      // 	    //reset pixel in outputMask
-      // 	    tmpData[y][x]=0;
-      // 	    //test
-      // 	    cout << "pixel " << x << ", " << y << " is ground" << endl;
-      // 	  }
-      // 	  else{
-      // 	    //reset pixel height in tmpDSM
-      // 	    sort(neighbors.begin(),neighbors.end());
-      // 	    assert(neighbors.size()>1);
-      // 	    inBuffer[(dimY-1)/2][x]=neighbors[1];
-      // 	    //test
-      // 	    cout << "pixel " << x << ", " << y << " is surface, reset DSM to " << neighbors[1] << endl;
-      // 	    /* inBuffer[(dimY-1)/2][x]=stat.mymin(neighbors); */
-      // 	  }
-      // 	}
-      // }
-      //to here
-
-      theFilter.dsm2dtm_nwse(inputData,tmpData,hThreshold_opt[iheight],nlimit[iheight],dim_opt[0]);
-      if(verbose_opt[0])
-      	cout << "filtering NESW" << endl;
-      theFilter.dsm2dtm_nesw(inputData,tmpData,hThreshold_opt[iheight],nlimit[iheight],dim_opt[0]);
-      if(verbose_opt[0])
-      	cout << "filtering SENW" << endl;
-      theFilter.dsm2dtm_senw(inputData,tmpData,hThreshold_opt[iheight],nlimit[iheight],dim_opt[0]);
-      if(verbose_opt[0])
-      	cout << "filtering SWNE" << endl;
-      theFilter.dsm2dtm_swne(inputData,tmpData,hThreshold_opt[iheight],nlimit[iheight],dim_opt[0]);
-    }
-    outputData=tmpData;
-    //todo: interpolate
-    //outputData.setMask(tmpData,1,0);
+    //fused NWSE, NESW, SENW and SWNE passes for all height thresholds
+    nchange=theFilter.dsm2dtm(input,outputWriter,hThreshold_opt,nlimit,dim_opt[0],tile_opt[0],overlap_opt[0]);
+    if(verbose_opt[0])
+      cout << nchange << " terrain pixels found" << endl;
   }    
   else if(postFilter_opt[0]=="etew_min"){
     //Elevation Threshold with Expand Window (ETEW) Filter (p.73 from Airborne LIDAR Data Processing and Analysis Tools ALDPAT 1.0)
@@ -415,8 +312,9 @@ int main(int argc,char **argv) {
       exit(1);
     }
   }
-  //write outputData to outputWriter
-  outputWriter.writeDataBlock(outputData,0,outputData.nCols()-1,0,outputData.nRows()-1);
+  //write outputData to outputWriter (vito filter writes directly)
+  if(postFilter_opt[0]!="vito")
+    outputWriter.writeDataBlock(outputData,0,outputData.nCols()-1,0,outputData.nRows()-1);
 
   // progress=1;
   // pfnProgress(progress,pszMessage,pProgressArg);
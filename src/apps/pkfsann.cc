@@ -26,6 +26,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include "imageclasses/ImgReaderOgr.h"
 #include "algorithms/ConfusionMatrix.h"
 #include "algorithms/CostFactory.h"
+#include "algorithms/CostFactorySeparability.h"
 #include "algorithms/FeatureSelector.h"
 #include "floatfann.h"
 #include "algorithms/myfann_cpp.h"
@@ -77,6 +78,8 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   | a      | aggreg               | unsigned short | 0     |how to combine aggregated classifiers, see also rc option (0: no aggregation, 1: sum rule, 2: max rule). |
   | sm     | sm                   | std::string | sffs  |feature selection method (sffs=sequential floating forward search,sfs=sequential forward search, sbs, sequential backward search ,bfs=brute force search) |
   | ecost  | ecost                | float | 0.001 |epsilon for stopping criterion in cost function to determine optimal number of features |
+  | pf     | prefilter            | unsigned short | 0     |number of features to preselect with a separability measure (see sep option), before the classifier based selection (0: no preselection) |
+  | sep    | separability         | std::string | jm    |separability measure for the preselection (jm: Jeffries-Matusita, bhattacharyya, mahalanobis) |
   | cv     | cv                   | unsigned short | 2     |n-fold cross validation mode |
   | c      | class                | std::string |       |list of class names. |
   | r      | reclass              | short |       |list of class values (use same order as in classname opt. |
@@ -103,6 +106,15 @@ CostFactoryANN::~CostFactoryANN(){
 
 double CostFactoryANN::getCost(const vector<Vector2d<float> > &trainingFeatures)
 {
+  list<int> cols;
+  for(int ifeature=0;ifeature<trainingFeatures[0][0].size();++ifeature)
+    cols.push_back(ifeature);
+  return(getCost(trainingFeatures,cols));
+}
+
+double CostFactoryANN::getCost(const vector<Vector2d<float> > &trainingFeatures, const list<int>& cols)
+{
+  vector<int> col(cols.begin(),cols.end());
   unsigned short nclass=trainingFeatures.size();
   unsigned int ntraining=0;
   unsigned int ntest=0;
@@ -114,7 +126,7 @@ double CostFactoryANN::getCost(const vector<Vector2d<float> > &trainingFeatures)
     assert(!m_cv);
   if(!m_cv)
     assert(ntest);
-  unsigned short nFeatures=trainingFeatures[0][0].size();
+  unsigned short nFeatures=col.size();
 
   FANN::neural_net net;//the neural network
   const unsigned int num_layers = m_nneuron.size()+2;
@@ -163,7 +175,7 @@ double CostFactoryANN::getCost(const vector<Vector2d<float> > &trainingFeatures)
     tmpFeatures[iclass].resize(trainingFeatures[iclass].size(),nFeatures);
     for(unsigned int isample=0;isample<m_nctraining[iclass];++isample){
       for(int ifeature=0;ifeature<nFeatures;++ifeature){
-        tmpFeatures[iclass][isample][ifeature]=trainingFeatures[iclass][isample][ifeature];
+        tmpFeatures[iclass][isample][ifeature]=trainingFeatures[iclass][isample][col[ifeature]];
       }
     }
   }
@@ -198,7 +210,7 @@ double CostFactoryANN::getCost(const vector<Vector2d<float> > &trainingFeatures)
       testFeatures.resize(m_nctest[iclass],nFeatures);
       for(unsigned int isample=0;isample<m_nctraining[iclass];++isample){
         for(int ifeature=0;ifeature<nFeatures;++ifeature){
-          testFeatures[iclass][isample][ifeature]=trainingFeatures[iclass][m_nctraining[iclass]+isample][ifeature];
+          testFeatures[iclass][isample][ifeature]=trainingFeatures[iclass][m_nctraining[iclass]+isample][col[ifeature]];
         }
         result=net.run(testFeatures[iclass][isample]);
         string refClassName=m_nameVector[iclass];
@@ -244,6 +256,8 @@ int main(int argc, char *argv[])
   // Optionpk<double> priors_opt("p", "prior", "prior probabilities for each class (e.g., -p 0.3 -p 0.3 -p 0.2 )", 0.0);
   Optionpk<string> selector_opt("sm", "sm", "feature selection method (sffs=sequential floating forward search,sfs=sequential forward search, sbs, sequential backward search ,bfs=brute force search)","sffs");
   Optionpk<float> epsilon_cost_opt("ecost", "ecost", "epsilon for stopping criterion in cost function to determine optimal number of features",0.001);
+  Optionpk<unsigned short> prefilter_opt("pf", "prefilter", "number of features to preselect with a separability measure (see sep option), before the classifier based selection (0: no preselection)",0);
+  Optionpk<string> separability_opt("sep", "separability", "separability measure for the preselection (jm: Jeffries-Matusita, bhattacharyya, mahalanobis)","jm");
   Optionpk<unsigned short> cv_opt("cv", "cv", "n-fold cross validation mode",2);
   Optionpk<string> classname_opt("c", "class", "list of class names.");
   Optionpk<short> classvalue_opt("r", "reclass", "list of class values (use same order as in classname opt.");
@@ -268,6 +282,8 @@ int main(int argc, char *argv[])
   // priors_opt.setHide(1);
   selector_opt.setHide(1);
   epsilon_cost_opt.setHide(1);
+  prefilter_opt.setHide(1);
+  separability_opt.setHide(1);
   cv_opt.setHide(1);
   classname_opt.setHide(1);
   classvalue_opt.setHide(1);
@@ -296,6 +312,8 @@ int main(int argc, char *argv[])
     // priors_opt.retrieveOption(argc,argv);
     selector_opt.retrieveOption(argc,argv);
     epsilon_cost_opt.retrieveOption(argc,argv);
+    prefilter_opt.retrieveOption(argc,argv);
+    separability_opt.retrieveOption(argc,argv);
     cv_opt.retrieveOption(argc,argv);
     classname_opt.retrieveOption(argc,argv);
     classvalue_opt.retrieveOption(argc,argv);
@@ -648,6 +666,28 @@ int main(int argc, char *argv[])
 
   costfactory.setNcTraining(nctraining);
   costfactory.setNcTest(nctest);
+  //preselect features with a separability measure, the classifier based selection continues on the preselected features
+  vector<int> preselection;
+  if(prefilter_opt[0]&&prefilter_opt[0]<trainingFeatures[0][0].size()){
+    list<int> preset;
+    try{
+      CostFactorySeparability sepfactory(separability_opt[0],verbose_opt[0]);
+      sepfactory.setNcTraining(nctraining);
+      sepfactory.setNcTest(nctest);
+      sepfactory.setStatistics(trainingFeatures);
+      double sepcost=FeatureSelector().floating(trainingFeatures,sepfactory,preset,prefilter_opt[0],epsilon_cost_opt[0],verbose_opt[0]);
+      if(verbose_opt[0])
+        std::cout << "separability of preselected features: " << sepcost << std::endl;
+    }
+    catch(string error){
+      cerr << error << std::endl;
+      exit(1);
+    }
+    preset.sort();
+    for(int iclass=0;iclass<trainingFeatures.size();++iclass)
+      trainingFeatures[iclass].selectCols(preset);
+    preselection.assign(preset.begin(),preset.end());
+  }
   int nFeatures=trainingFeatures[0][0].size();
   int maxFeatures=(maxFeatures_opt[0])? maxFeatures_opt[0] : 1;
   double previousCost=-1;
@@ -705,7 +745,7 @@ int main(int argc, char *argv[])
     cout <<"cost: " << cost << endl;
   subset.sort();
   for(list<int>::const_iterator lit=subset.begin();lit!=subset.end();++lit)
-    std::cout << " -b " << *lit;
+    std::cout << " -b " << (preselection.empty()? *lit : preselection[*lit]);
   std::cout << std::endl;
   // if((*(lit))!=subset.back())
   // else
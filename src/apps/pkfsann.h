@@ -19,6 +19,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 #include <string>
 #include <vector>
+#include <list>
 #include "base/Vector2d.h"
 
 #ifndef _PKFSANNH_H_
@@ -33,6 +34,9 @@ class CostFactoryANN : public CostFactory
   CostFactoryANN(const std::vector<unsigned int>& nneuron, float connection, const std::vector<float> weights, float learning, unsigned int maxit, unsigned short cv, bool verbose);
   ~CostFactoryANN();
   double getCost(const std::vector<Vector2d<float> > &trainingFeatures);
+  double getCost(const std::vector<Vector2d<float> > &trainingFeatures, const std::list<int>& cols);
+  //fann draws its random weights from the global rand(): candidates are evaluated serially (runs of the cross validation are parallel)
+  CostFactory* clone(int) const{return NULL;};
   
  private:
   std::vector<unsigned int> m_nneuron;
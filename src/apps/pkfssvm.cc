@@ -25,6 +25,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include "base/Optionpk.h"
 #include "algorithms/ConfusionMatrix.h"
 #include "algorithms/CostFactorySVM.h"
+#include "algorithms/CostFactorySeparability.h"
 #include "algorithms/FeatureSelector.h"
 #include "algorithms/svm.h"
 #include "imageclasses/ImgReaderOgr.h"
@@ -80,12 +81,14 @@ The SVM classifier has been shown to be more robust to this type of problem than
  | cc     | ccost                | float | 1000  |the parameter C of C-SVC, epsilon-SVR, and nu-SVR | 
  | nu     | nu                   | float | 0.5   |the parameter nu of nu-SVC, one-class SVM, and nu-SVR | 
  | eloss  | eloss                | float | 0.1   |the epsilon in loss function of epsilon-SVR | 
- | cache  | cache                | int  | 100   |cache memory size in MB | 
+ | cache  | cache                | int  | 100   |cache memory size in MB (shared by the threads that evaluate candidate subsets) | 
  | etol   | etol                 | float | 0.001 |the tolerance of termination criterion | 
  | shrink | shrink               | bool | false |whether to use the shrinking heuristics | 
  | pe     | probest              | bool | true  |whether to train a SVC or SVR model for probability estimates | 
  | sm     | sm                   | std::string | sffs  |feature selection method (sffs=sequential floating forward search,sfs=sequential forward search, sbs, sequential backward search ,bfs=brute force search) | 
  | ecost  | ecost                | float | 0.001 |epsilon for stopping criterion in cost function to determine optimal number of features | 
+ | pf     | prefilter            | unsigned short | 0     |number of features to preselect with a separability measure (see sep option), before the classifier based selection (0: no preselection) | 
+ | sep    | separability         | std::string | jm    |separability measure for the preselection (jm: Jeffries-Matusita, bhattacharyya, mahalanobis) | 
  | cv     | cv                   | unsigned short | 2     |n-fold cross validation mode | 
  | c      | class                | std::string |       |list of class names. | 
  | r      | reclass              | short |       |list of class values (use same order as in classname opt. | 
@@ -274,6 +277,8 @@ int main(int argc, char *argv[])
   Optionpk<double> scale_opt("scale", "scale", "scale value for each spectral band input features: refl=(DN[band]-offset[band])/scale[band] (use 0 if scale min and max in each band to -1.0 and 1.0)", 0.0);
   Optionpk<string> selector_opt("sm", "sm", "feature selection method (sffs=sequential floating forward search,sfs=sequential forward search, sbs, sequential backward search ,bfs=brute force search)","sffs"); 
   Optionpk<float> epsilon_cost_opt("ecost", "ecost", "epsilon for stopping criterion in cost function to determine optimal number of features",0.001);
+  Optionpk<unsigned short> prefilter_opt("pf", "prefilter", "number of features to preselect with a separability measure (see sep option), before the classifier based selection (0: no preselection)",0);
+  Optionpk<string> separability_opt("sep", "separability", "separability measure for the preselection (jm: Jeffries-Matusita, bhattacharyya, mahalanobis)","jm");
 
   Optionpk<std::string> svm_type_opt("svmt", "svmtype", "type of SVM (C_SVC, nu_SVC,one_class, epsilon_SVR, nu_SVR)","C_SVC");
   Optionpk<std::string> kernel_type_opt("kt", "kerneltype", "type of kernel function (linear,polynomial,radial,sigmoid) ","radial");
@@ -283,7 +288,7 @@ int main(int argc, char *argv[])
   Optionpk<float> ccost_opt("cc", "ccost", "the parameter C of C-SVC, epsilon-SVR, and nu-SVR",1000);
   Optionpk<float> nu_opt("nu", "nu", "the parameter nu of nu-SVC, one-class SVM, and nu-SVR",0.5);
   Optionpk<float> epsilon_loss_opt("eloss", "eloss", "the epsilon in loss function of epsilon-SVR",0.1);
-  Optionpk<int> cache_opt("cache", "cache", "cache memory size in MB",100);
+  Optionpk<int> cache_opt("cache", "cache", "cache memory size in MB (shared by the threads that evaluate candidate subsets)",100);
   Optionpk<float> epsilon_tol_opt("etol", "etol", "the tolerance of termination criterion",0.001);
   Optionpk<bool> shrinking_opt("shrink", "shrink", "whether to use the shrinking heuristics",false);
   Optionpk<bool> prob_est_opt("pe", "probest", "whether to train a SVC or SVR model for probability estimates",true,2);
@@ -316,6 +321,8 @@ int main(int argc, char *argv[])
   prob_est_opt.setHide(1);
   selector_opt.setHide(1);
   epsilon_cost_opt.setHide(1);
+  prefilter_opt.setHide(1);
+  separability_opt.setHide(1);
   cv_opt.setHide(1);
   classname_opt.setHide(1);
   classvalue_opt.setHide(1);
@@ -349,6 +356,8 @@ int main(int argc, char *argv[])
     prob_est_opt.retrieveOption(argc,argv);
     selector_opt.retrieveOption(argc,argv);
     epsilon_cost_opt.retrieveOption(argc,argv);
+    prefilter_opt.retrieveOption(argc,argv);
+    separability_opt.retrieveOption(argc,argv);
     cv_opt.retrieveOption(argc,argv);
     classname_opt.retrieveOption(argc,argv);
     classvalue_opt.retrieveOption(argc,argv);
@@ -687,6 +696,28 @@ int main(int argc, char *argv[])
 
   costfactory.setNcTraining(nctraining);
   costfactory.setNcTest(nctest);
+  //preselect features with a separability measure, the classifier based selection continues on the preselected features
+  vector<int> preselection;
+  if(prefilter_opt[0]&&prefilter_opt[0]<trainingFeatures[0][0].size()){
+    list<int> preset;
+    try{
+      CostFactorySeparability sepfactory(separability_opt[0],verbose_opt[0]);
+      sepfactory.setNcTraining(nctraining);
+      sepfactory.setNcTest(nctest);
+      sepfactory.setStatistics(trainingFeatures);
+      double sepcost=FeatureSelector().floating(trainingFeatures,sepfactory,preset,prefilter_opt[0],epsilon_cost_opt[0],verbose_opt[0]);
+      if(verbose_opt[0])
+        std::cout << "separability of preselected features: " << sepcost << std::endl;
+    }
+    catch(string error){
+      cerr << error << std::endl;
+      exit(1);
+    }
+    preset.sort();
+    for(int iclass=0;iclass<trainingFeatures.size();++iclass)
+      trainingFeatures[iclass].selectCols(preset);
+    preselection.assign(preset.begin(),preset.end());
+  }
   int nFeatures=trainingFeatures[0][0].size();
   int maxFeatures=(maxFeatures_opt[0])? maxFeatures_opt[0] : 1;
   double previousCost=-1;
@@ -744,7 +775,7 @@ int main(int argc, char *argv[])
     cout <<"cost: " << cost << endl;
   subset.sort();
   for(list<int>::const_iterator lit=subset.begin();lit!=subset.end();++lit)
-    std::cout << " -b " << *lit;
+    std::cout << " -b " << (preselection.empty()? *lit : preselection[*lit]);
   std::cout << std::endl;
     // if((*(lit))!=subset.back())
     // else
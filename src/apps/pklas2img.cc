@@ -291,8 +291,18 @@ int main(int argc,char **argv) {
   if(colorTable_opt.size())
     outputWriter.setColorTable(colorTable_opt[0]);
 
+  //composite rules that only need running statistics do not keep the points of each cell in memory
+  bool streamMoments=(composite_opt[0]=="mean"||composite_opt[0]=="var"||composite_opt[0]=="stdev"||composite_opt[0]=="sum");
+  bool streamMinMax=(composite_opt[0]=="min"||composite_opt[0]=="max");
+  Vector2d<statfactory::Moments> momentData;
+  Vector2d<statfactory::MinMax> minmaxData;
   inputData.clear();
-  inputData.resize(nrow,ncol);
+  if(streamMoments)
+    momentData.resize(nrow,ncol);
+  else if(streamMinMax)
+    minmaxData.resize(nrow,ncol);
+  else
+    inputData.resize(nrow,ncol);
   Vector2d<double> outputData(nrow,ncol);
   for(int irow=0;irow<nrow;++irow)
     for(int icol=0;icol<ncol;++icol)
@@ -412,18 +422,22 @@ int main(int argc,char **argv) {
       assert(irow<nrow);
       assert(icol>=0);
       assert(icol<ncol);
-      if(composite_opt[0]=="number")
+      if(composite_opt[0]=="number"){
         outputData[irow][icol]+=1;
-      else if(attribute_opt[0]=="z")
-        inputData[irow][icol].push_back(thePoint.GetZ());
+        ++ipoint;
+        continue;
+      }
+      double theValue=0;
+      if(attribute_opt[0]=="z")
+        theValue=thePoint.GetZ();
       else if(attribute_opt[0]=="intensity")
-        inputData[irow][icol].push_back(thePoint.GetIntensity());
+        theValue=thePoint.GetIntensity();
       else if(attribute_opt[0]=="angle")
-        inputData[irow][icol].push_back(thePoint.GetScanAngleRank());
+        theValue=thePoint.GetScanAngleRank();
       else if(attribute_opt[0]=="return")
-        inputData[irow][icol].push_back(thePoint.GetReturnNumber());
+        theValue=thePoint.GetReturnNumber();
       else if(attribute_opt[0]=="nreturn")
-        inputData[irow][icol].push_back(thePoint.GetNumberOfReturns());
+        theValue=thePoint.GetNumberOfReturns();
       else if(attribute_opt[0]=="spacing"){
 	ogrPoint.setX(theX);
 	ogrPoint.setY(theY);
@@ -432,12 +446,18 @@ int main(int argc,char **argv) {
 	outputWriter.image2geo(icol,irow,centerX,centerY);
 	ogrCenter.setX(centerX);
 	ogrCenter.setY(centerY);
-	inputData[irow][icol].push_back(ogrPoint.Distance(&ogrCenter));
+	theValue=ogrPoint.Distance(&ogrCenter);
       }
       else{
         std::string errorString="attribute not supported";
         throw(errorString);
       }
+      if(streamMoments)
+        momentData[irow][icol].push(theValue);
+      else if(streamMinMax)
+        minmaxData[irow][icol].push(theValue);
+      else
+        inputData[irow][icol].push_back(theValue);
       ++ipoint;
     }
     if(verbose_opt[0])
@@ -451,6 +471,7 @@ int main(int argc,char **argv) {
   progress=0;
   pfnProgress(progress,pszMessage,pProgressArg);
   statfactory::StatFactory stat;
+  std::vector<double> scratch;//reused by the order statistics
   //fill inputData in outputData
   // if(composite_opt[0]=="profile"){
     // assert(postFilter_opt[0]=="none");
@@ -463,7 +484,29 @@ int main(int argc,char **argv) {
     Vector2d<double> outputProfile(nband,ncol);
     for(int icol=0;icol<ncol;++icol){
       std::vector<double> profile;
-      if(!inputData[irow][icol].size())
+      if(streamMoments){
+        const statfactory::Moments& moments=momentData[irow][icol];
+        if(!moments.size())
+          outputData[irow][icol]=(static_cast<double>((nodata_opt[0])));
+        else if(composite_opt[0]=="mean")
+          outputData[irow][icol]=moments.mean();
+        else if(composite_opt[0]=="var")
+          outputData[irow][icol]=moments.var();
+        else if(composite_opt[0]=="stdev")
+          outputData[irow][icol]=moments.stdev();
+        else
+          outputData[irow][icol]=moments.sum();
+      }
+      else if(streamMinMax){
+        const statfactory::MinMax& minmax=minmaxData[irow][icol];
+        if(!minmax.size())
+          outputData[irow][icol]=(static_cast<double>((nodata_opt[0])));
+        else if(composite_opt[0]=="min")
+          outputData[irow][icol]=minmax.min();
+        else
+          outputData[irow][icol]=minmax.max();
+      }
+      else if(!inputData[irow][icol].size())
         outputData[irow][icol]=(static_cast<double>((nodata_opt[0])));
       else{
         statfactory::StatFactory stat;
@@ -476,9 +519,9 @@ int main(int argc,char **argv) {
         else if(composite_opt[0]=="absmax")
           outputData[irow][icol]=stat.absmax(inputData[irow][icol]);
         else if(composite_opt[0]=="median")
-          outputData[irow][icol]=stat.median(inputData[irow][icol]);
+          outputData[irow][icol]=stat.median(inputData[irow][icol],scratch);
         else if(composite_opt[0]=="percentile")
-          outputData[irow][icol]=stat.percentile(inputData[irow][icol],inputData[irow][icol].begin(),inputData[irow][icol].end(),percentile_opt[0]);
+          outputData[irow][icol]=stat.percentile(inputData[irow][icol],percentile_opt[0],scratch);
         else if(composite_opt[0]=="mean")
           outputData[irow][icol]=stat.mean(inputData[irow][icol]);
         else if(composite_opt[0]=="var")
@@ -538,6 +581,8 @@ int main(int argc,char **argv) {
   progress=1;
   pfnProgress(progress,pszMessage,pProgressArg);
   inputData.clear();//clean up memory
+  momentData.clear();
+  minmaxData.clear();
   //apply post filter
   // std::cout << "Applying post processing filter: " << postFilter_opt[0] << std::endl;
   // if(postFilter_opt[0]=="etew_min"){
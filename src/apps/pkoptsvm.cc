@@ -30,6 +30,9 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include "algorithms/CostFactorySVM.h"
 #include "algorithms/svm.h"
 #include "imageclasses/ImgReaderOgr.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -55,7 +58,9 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 
 The support vector machine depends on several parameters. Ideally, these parameters should be optimized for each classification problem. In case of a radial basis kernel function, two important parameters are \em{cost} and \em{gamma}. The utility pkoptsvm can optimize these two parameters, based on an accuracy assessment (the Kappa value). If an input test set (-i) is provided, it is used for the accuracy assessment. If not, the accuracy assessment is based on a cross validation (-cv) of the training sample.
 
-The optimization routine uses a grid search. The initial and final values of the parameters can be set with -cc startvalue -cc endvalue and -g startvalue -g endvalue for cost and gamma respectively. The search uses a multiplicative step for iterating the parameters (set with the options -stepcc and -stepg). An often used approach is to define a relatively large multiplicative step first (e.g 10) to obtain an initial estimate for both parameters. The estimate can then be optimized by defining a smaller step (>1) with constrained start and end values for the parameters cost and gamma.
+The optimization routine uses a grid search. The initial and final values of the parameters can be set with -cc startvalue -cc endvalue and -g startvalue -g endvalue for cost and gamma respectively. The search uses a multiplicative step for iterating the parameters (set with the options -stepcc and -stepg). A relatively large multiplicative step (e.g 10) can be used to obtain an initial estimate for both parameters. With the option -refine, the estimate is then optimized automatically: each refinement repeats the search in the neighbourhood of the best point, using the square root of the previous steps.
+
+The values of gamma are evaluated in parallel. For a given gamma, the values of cost are evaluated in increasing order along a single cross validation path: the kernel is shared and the support vector machine is warm started from the previous cost.
 
 \section pkoptsvm_options Options
  - use either `-short` or `--long` options (both `--long=value` and `--long value` are supported)
@@ -67,6 +72,7 @@ The optimization routine uses a grid search. The initial and final values of the
  | g      | gamma                | float | 0     |min max boundaries for gamma in kernel function (optional: initial value) | 
  | stepcc | stepcc               | double | 2     |multiplicative step for ccost in GRID search | 
  | stepg  | stepg                | double | 2     |multiplicative step for gamma in GRID search | 
+ | refine | refine               | unsigned short | 0     |number of refinements of the GRID search around the best point (using the square root of the previous steps) | 
  | i      | input                | std::string |       |input test vector file | 
  | tln    | tln                  | std::string |       |training layer name(s) | 
  | label  | label                | std::string | label |identifier for class label in training vector file. | 
@@ -105,6 +111,7 @@ using namespace std;
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
                                     //declare objective function
 double objFunction(const std::vector<double> &x, std::vector<double> &grad, void *my_func_data);
+vector<double> objRow(float gamma, const vector<float>& ccost, vector<Vector2d<float> >& tf, int cache);
 
 //global parameters used in objective function
 map<string,short> classValueMap;
@@ -134,13 +141,14 @@ double objFunction(const std::vector<double> &x, std::vector<double> &grad, void
   vector<Vector2d<float> > *tf=reinterpret_cast<vector<Vector2d<float> >*> (my_func_data);
   float ccost=x[0];
   float gamma=x[1];
-  // double error=1.0/epsilon_tol_opt[0];
-  double kappa=1.0;
-  // double oa=1.0;
+  return(objRow(gamma,vector<float>(1,ccost),*tf,cache_opt[0])[0]);
+}
 
-  CostFactorySVM costfactory(svm_type_opt[0], kernel_type_opt[0], kernel_degree_opt[0], gamma, coef0_opt[0], ccost, nu_opt[0],  epsilon_loss_opt[0], cache_opt[0], epsilon_tol_opt[0], shrinking_opt[0], prob_est_opt[0], cv_opt[0], verbose_opt[0]);
+//kappa for each ccost (in increasing order) at a single gamma
+vector<double> objRow(float gamma, const vector<float>& ccost, vector<Vector2d<float> >& tf, int cache){
+  CostFactorySVM costfactory(svm_type_opt[0], kernel_type_opt[0], kernel_degree_opt[0], gamma, coef0_opt[0], ccost[0], nu_opt[0],  epsilon_loss_opt[0], cache, epsilon_tol_opt[0], shrinking_opt[0], prob_est_opt[0], cv_opt[0], verbose_opt[0]);
 
-  assert(tf->size());
+  assert(tf.size());
   // if(nctest>0)
   //   costfactory.setCv(0);
 
@@ -166,8 +174,7 @@ double objFunction(const std::vector<double> &x, std::vector<double> &grad, void
   costfactory.setNcTraining(nctraining);
   costfactory.setNcTest(nctest);
 
-  kappa=costfactory.getCost(*tf);
-  return(kappa);
+  return(costfactory.getCost(tf,ccost));
 }
 
 int main(int argc, char *argv[])
@@ -179,6 +186,7 @@ int main(int argc, char *argv[])
   Optionpk<float> gamma_opt("g", "gamma", "min max boundaries for gamma in kernel function (optional: initial value)",0);
   Optionpk<double> stepcc_opt("stepcc","stepcc","multiplicative step for ccost in GRID search",2);
   Optionpk<double> stepg_opt("stepg","stepg","multiplicative step for gamma in GRID search",2);
+  Optionpk<unsigned short> refine_opt("refine","refine","number of refinements of the GRID search around the best point (using the square root of the previous steps)",0);
   Optionpk<string> input_opt("i", "input", "input test vector file"); 
   Optionpk<string> tlayer_opt("tln", "tln", "training layer name(s)");
   Optionpk<string> label_opt("label", "label", "identifier for class label in training vector file.","label"); 
@@ -231,6 +239,7 @@ int main(int argc, char *argv[])
     gamma_opt.retrieveOption(argc,argv);
     stepcc_opt.retrieveOption(argc,argv);
     stepg_opt.retrieveOption(argc,argv);
+    refine_opt.retrieveOption(argc,argv);
     input_opt.retrieveOption(argc,argv);
     tlayer_opt.retrieveOption(argc,argv);
     label_opt.retrieveOption(argc,argv);
@@ -612,25 +621,77 @@ int main(int argc, char *argv[])
     double progress=0;
     if(!verbose_opt[0])
       pfnProgress(progress,pszMessage,pProgressArg);
-    double ncost=log(ccost_opt[1])/log(stepcc_opt[0])-log(ccost_opt[0])/log(stepcc_opt[0]);
-    double ngamma=log(gamma_opt[1])/log(stepg_opt[0])-log(gamma_opt[0])/log(stepg_opt[0]);
-    for(double ccost=ccost_opt[0];ccost<=ccost_opt[1];ccost*=stepcc_opt[0]){
-      for(double gamma=gamma_opt[0];gamma<=gamma_opt[1];gamma*=stepg_opt[0]){
-	x[0]=ccost;
-	x[1]=gamma;
-	std::vector<double> theGrad;
-	double kappa=0;
-	kappa=objFunction(x,theGrad,&trainingFeatures);
-	if(kappa>maxKappa){
-	  maxKappa=kappa;
-	  maxCost=ccost;
-	  maxGamma=gamma;
-	}
-	if(verbose_opt[0])
-	  std::cout << ccost << " " << gamma << " " << kappa<< std::endl;
-	progress+=1.0/ncost/ngamma;
-	if(!verbose_opt[0])
-	  pfnProgress(progress,pszMessage,pProgressArg);
+    vector<double> ccost;
+    vector<double> gamma;
+    for(double cc=ccost_opt[0];cc<=ccost_opt[1];cc*=stepcc_opt[0])
+      ccost.push_back(cc);
+    for(double g=gamma_opt[0];g<=gamma_opt[1];g*=stepg_opt[0])
+      gamma.push_back(g);
+    double stepcc=stepcc_opt[0];
+    double stepg=stepg_opt[0];
+    for(int irefine=0;irefine<=refine_opt[0];++irefine){
+      //position of the best point of the previous pass in the refined grid (its kappa is reused)
+      int centreCost=-1;
+      int centreGamma=-1;
+      if(irefine){
+        //refine the grid around the best point
+        stepcc=sqrt(stepcc);
+        stepg=sqrt(stepg);
+        ccost.clear();
+        gamma.clear();
+        for(int istep=-2;istep<=2;++istep){
+          double cc=maxCost*pow(stepcc,istep);
+          double g=maxGamma*pow(stepg,istep);
+          if(cc>=ccost_opt[0]&&cc<=ccost_opt[1]){
+            if(!istep)
+              centreCost=ccost.size();
+            ccost.push_back(cc);
+          }
+          if(g>=gamma_opt[0]&&g<=gamma_opt[1]){
+            if(!istep)
+              centreGamma=gamma.size();
+            gamma.push_back(g);
+          }
+        }
+        if(ccost.empty()||gamma.empty())
+          break;
+      }
+      vector<float> ccostPath(ccost.begin(),ccost.end());
+      vector< vector<double> > kappa(gamma.size());
+      int nthread=1;
+#ifdef _OPENMP
+      if(verbose_opt[0]<2)
+        nthread=std::min<int>(gamma.size(),omp_get_max_threads());
+#endif
+      //rows of constant gamma are evaluated in parallel (each with its share of the cache)
+#pragma omp parallel for schedule(dynamic) if(nthread>1)
+      for(int igamma=0;igamma<gamma.size();++igamma){
+        if(igamma==centreGamma&&centreCost>=0){
+          vector<float> path(ccostPath);
+          path.erase(path.begin()+centreCost);
+          if(path.size())
+            kappa[igamma]=objRow(gamma[igamma],path,trainingFeatures,cache_opt[0]/nthread);
+          kappa[igamma].insert(kappa[igamma].begin()+centreCost,maxKappa);
+        }
+        else
+          kappa[igamma]=objRow(gamma[igamma],ccostPath,trainingFeatures,cache_opt[0]/nthread);
+#pragma omp critical
+        {
+          progress+=1.0/gamma.size()/(refine_opt[0]+1);
+          if(!verbose_opt[0])
+            pfnProgress(progress,pszMessage,pProgressArg);
+        }
+      }
+      for(int icost=0;icost<ccost.size();++icost){
+        for(int igamma=0;igamma<gamma.size();++igamma){
+          if(kappa[igamma][icost]>maxKappa){
+            maxKappa=kappa[igamma][icost];
+            maxCost=ccost[icost];
+            maxGamma=gamma[igamma];
+          }
+          if(verbose_opt[0])
+            std::cout << ccost[icost] << " " << gamma[igamma] << " " << kappa[igamma][icost] << std::endl;
+        }
       }
     }
     progress=1.0;
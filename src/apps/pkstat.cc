@@ -45,7 +45,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   | stats  | statistics           | bool | false |Shows basic statistics (min,max, mean and stdDev of the raster datasets) |
   | nodata | nodata               | double |       |Set nodata value(s) |
   | mean   | mean                 | bool | false |calculate mean |
-  | median | median               | bool | false |calculate median |
+  | median | median               | bool | false |calculate median (approximated by a quantile sketch for more than 4096 valid values) |
   | var    | var                  | bool | false |calculate variance |
   | stdev  | stdev                | bool | false |calculate standard deviation |
   | mm     | minmax               | bool | false |calculate minimum and maximum value |
@@ -103,7 +103,7 @@ int main(int argc, char *argv[])
   // Optionpk<double> randa_opt("rnda", "rnda", "first parameter for random distribution (mean value in case of Gaussian)", 0);
   // Optionpk<double> randb_opt("rndb", "rndb", "second parameter for random distribution (standard deviation in case of Gaussian)", 1);
   Optionpk<bool> mean_opt("mean","mean","calculate mean",false);
-  Optionpk<bool> median_opt("median","median","calculate median",false);
+  Optionpk<bool> median_opt("median","median","calculate median (approximated by a quantile sketch for more than 4096 valid values)",false);
   Optionpk<bool> var_opt("var","var","calculate variance",false);
   Optionpk<bool> skewness_opt("skew","skewness","calculate skewness",false);
   Optionpk<bool> kurtosis_opt("kurt","kurtosis","calculate kurtosis",false);
@@ -267,15 +267,44 @@ int main(int argc, char *argv[])
         cout << "--nvalid " << imgReader.getNvalid(band_opt[0]) << endl;
       if(invalid_opt[0])
         cout << "--ninvalid " << imgReader.getNinvalid(band_opt[0]) << endl;
-      if(!histogram_opt[0]&&(stat_opt[0]||mean_opt[0]||median_opt[0]||var_opt[0]||stdev_opt[0])){//the hard way (in memory)
+      if(!histogram_opt[0]&&(stat_opt[0]||mean_opt[0]||median_opt[0]||var_opt[0]||stdev_opt[0])){//single pass in bounded memory
         statfactory::StatFactory stat;
-        vector<double> readBuffer;
-        double varValue;
-        imgReader.readDataBlock(readBuffer,  0, imgReader.nrOfCol()-1, 0, imgReader.nrOfRow()-1, band_opt[0]);
         stat.setNoDataValues(nodata_opt);
-        stat.meanVar(readBuffer,meanValue,varValue);
-        medianValue=stat.median(readBuffer);
-        stat.minmax(readBuffer,readBuffer.begin(),readBuffer.end(),minValue,maxValue);
+        //single pass over the lines, the median is approximated by a quantile sketch (exact up to 4096 valid values)
+        statfactory::Moments moments;
+        statfactory::MinMax minmax;
+        statfactory::QuantileSketch sketch;
+        vector<double> lineBuffer;
+        for(int irow=0;irow<imgReader.nrOfRow();++irow){
+          imgReader.readData(lineBuffer,irow,band_opt[iband]);
+          for(int icol=0;icol<lineBuffer.size();++icol){
+            if(stat.isNoData(lineBuffer[icol]))
+              continue;
+            moments.push(lineBuffer[icol]);
+            minmax.push(lineBuffer[icol]);
+            if(median_opt[0])
+              sketch.push(lineBuffer[icol]);
+          }
+        }
+        double varValue;
+        if(moments.size()){
+          meanValue=moments.mean();
+          varValue=moments.var();
+          minValue=minmax.min();
+          maxValue=minmax.max();
+        }
+        else if(nodata_opt.size()){
+          meanValue=nodata_opt[0];
+          varValue=nodata_opt[0];
+          minValue=nodata_opt[0];
+          maxValue=nodata_opt[0];
+        }
+        else{
+          std::string errorString="Error: no valid data found";
+          throw(errorString);
+        }
+        if(median_opt[0])
+          medianValue=(sketch.size())? sketch.median() : nodata_opt[0];
         if(mean_opt[0])
           std::cout << "--mean " << meanValue << " ";
         if(median_opt[0])
@@ -580,10 +609,10 @@ int main(int argc, char *argv[])
       double mse=0;
       double nValid=0;
       double nPixel=imgReader.nrOfCol()/down_opt[0]*imgReader.nrOfRow()/down_opt[0];
-      for(unsigned int irow;irow<imgReader.nrOfRow();irow+=down_opt[0]){
+      for(unsigned int irow=0;irow<imgReader.nrOfRow();irow+=down_opt[0]){
         imgReader.readData(xBuffer,irow,band_opt[0]);
         imgReader.readData(yBuffer,irow,band_opt[1]);
-        for(unsigned int icol;icol<imgReader.nrOfCol();icol+=down_opt[0]){
+        for(unsigned int icol=0;icol<imgReader.nrOfCol();icol+=down_opt[0]){
           double xValue=xBuffer[icol];
           double yValue=yBuffer[icol];
           if(imgReader.isNoData(xValue)||imgReader.isNoData(yValue)){
@@ -662,7 +691,7 @@ int main(int argc, char *argv[])
   //     irow2=static_cast<int>(irow2);
   //     imgReader1.readData(xBuffer,irow1,band_opt[0]);
   //     imgReader2.readData(yBuffer,irow2,band_opt[1]);
-  //     for(unsigned int icol;icol<imgReader.nrOfCol();icol+=down_opt[0]){
+  //     for(unsigned int icol=0;icol<imgReader.nrOfCol();icol+=down_opt[0]){
   //  icol1=icol;
   //  imgReader1.image2geo(icol1,irow1,geoX,geoY);
   //  imgReader2.geo2image(geoX,geoY,icol2,irow2);
@@ -685,11 +714,10 @@ int main(int argc, char *argv[])
   //   mse/=correctNorm;
   //   std::cout << " -rmse " << sqrt(mse) << std::endl;
   // }
-  if(reg_opt[0]&&(input_opt.size()>1)){
+  if((reg_opt[0]||preg_opt[0]||regerr_opt[0]||rmse_opt[0]||histogram2d_opt[0])&&(input_opt.size()>1)){
+    //all two input statistics are calculated in a single pass
     imgreg.setDown(down_opt[0]);
     imgreg.setThreshold(random_opt[0]);
-    double c0=0;//offset
-    double c1=1;//scale
     while(band_opt.size()<input_opt.size())
       band_opt.push_back(band_opt[0]);
     if(src_min_opt.size()){
@@ -715,364 +743,158 @@ int main(int argc, char *argv[])
     for(int inodata=0;inodata<nodata_opt.size();++inodata){
       if(!inodata){
         imgReader1.GDALSetNoDataValue(nodata_opt[0],band_opt[0]);//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
-        imgReader2.GDALSetNoDataValue(nodata_opt[0]),band_opt[1];//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
+        imgReader2.GDALSetNoDataValue(nodata_opt[0],band_opt[1]);//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
       }
       imgReader1.pushNoDataValue(nodata_opt[inodata]);
       imgReader2.pushNoDataValue(nodata_opt[inodata]);
     }
 
-    double r2=imgreg.getR2(imgReader1,imgReader2,c0,c1,band_opt[0],band_opt[1],verbose_opt[0]);
-    std::cout << "-c0 " << c0 << " -c1 " << c1 << " -r2 " << r2 << std::endl;
-    imgReader1.close();
-    imgReader2.close();
-  }
-  if(preg_opt[0]&&(input_opt.size()>1)){
-    imgreg.setDown(down_opt[0]);
-    imgreg.setThreshold(random_opt[0]);
-    double c0=0;//offset
-    double c1=1;//scale
-    while(band_opt.size()<input_opt.size())
-      band_opt.push_back(band_opt[0]);
-    if(src_min_opt.size()){
-      while(src_min_opt.size()<input_opt.size())
-        src_min_opt.push_back(src_min_opt[0]);
-    }
-    if(src_max_opt.size()){
-      while(src_max_opt.size()<input_opt.size())
-        src_max_opt.push_back(src_max_opt[0]);
-    }
-    ImgRasterGdal imgReader1(input_opt[0]);
-    ImgRasterGdal imgReader2(input_opt[1]);
-
-    if(offset_opt.size())
-      imgReader1.setOffset(offset_opt[0],band_opt[0]);
-    if(scale_opt.size())
-      imgReader1.setScale(scale_opt[0],band_opt[0]);
-    if(offset_opt.size()>1)
-      imgReader2.setOffset(offset_opt[1],band_opt[1]);
-    if(scale_opt.size()>1)
-      imgReader2.setScale(scale_opt[1],band_opt[1]);
+    statfactory::Histogram2d* histogram2d=0;
+    double sigma=0;
+    if(histogram2d_opt[0]){
+      imgReader1.getMinMax(minX,maxX,band_opt[0]);
+      imgReader2.getMinMax(minY,maxY,band_opt[1]);
 
-    for(int inodata=0;inodata<nodata_opt.size();++inodata){
-      if(!inodata){
-        imgReader1.GDALSetNoDataValue(nodata_opt[0],band_opt[0]);//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
-        imgReader2.GDALSetNoDataValue(nodata_opt[0]),band_opt[1];//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
+      if(verbose_opt[0]){
+        cout << "minX: " << minX << endl;
+        cout << "maxX: " << maxX << endl;
+        cout << "minY: " << minY << endl;
+        cout << "maxY: " << maxY << endl;
       }
-      imgReader1.pushNoDataValue(nodata_opt[inodata]);
-      imgReader2.pushNoDataValue(nodata_opt[inodata]);
-    }
-
-    double r2=imgreg.pgetR2(imgReader1,imgReader2,c0,c1,band_opt[0],band_opt[1],verbose_opt[0]);
-    std::cout << "-c0 " << c0 << " -c1 " << c1 << " -r2 " << r2 << std::endl;
-    imgReader1.close();
-    imgReader2.close();
-  }
-  if(regerr_opt[0]&&(input_opt.size()>1)){
-    imgreg.setDown(down_opt[0]);
-    imgreg.setThreshold(random_opt[0]);
-    double c0=0;//offset
-    double c1=1;//scale
-    while(band_opt.size()<input_opt.size())
-      band_opt.push_back(band_opt[0]);
-    if(src_min_opt.size()){
-      while(src_min_opt.size()<input_opt.size())
-        src_min_opt.push_back(src_min_opt[0]);
-    }
-    if(src_max_opt.size()){
-      while(src_max_opt.size()<input_opt.size())
-        src_max_opt.push_back(src_max_opt[0]);
-    }
-    ImgRasterGdal imgReader1(input_opt[0]);
-    ImgRasterGdal imgReader2(input_opt[1]);
 
-    if(offset_opt.size())
-      imgReader1.setOffset(offset_opt[0],band_opt[0]);
-    if(scale_opt.size())
-      imgReader1.setScale(scale_opt[0],band_opt[0]);
-    if(offset_opt.size()>1)
-      imgReader2.setOffset(offset_opt[1],band_opt[1]);
-    if(scale_opt.size()>1)
-      imgReader2.setScale(scale_opt[1],band_opt[1]);
-
-    for(int inodata=0;inodata<nodata_opt.size();++inodata){
-      if(!inodata){
-        imgReader1.GDALSetNoDataValue(nodata_opt[0],band_opt[0]);//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
-        imgReader2.GDALSetNoDataValue(nodata_opt[0]),band_opt[1];//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
+      if(src_min_opt.size()){
+        minX=src_min_opt[0];
+        minY=src_min_opt[1];
       }
-      imgReader1.pushNoDataValue(nodata_opt[inodata]);
-      imgReader2.pushNoDataValue(nodata_opt[inodata]);
-    }
-
-    double err=imgreg.getRMSE(imgReader1,imgReader2,c0,c1,band_opt[0],band_opt[1],verbose_opt[0]);
-    std::cout << "-c0 " << c0 << " -c1 " << c1 << " -rmse " << err << std::endl;
-    imgReader1.close();
-    imgReader2.close();
-  }
-  if(rmse_opt[0]&&(input_opt.size()>1)){
-    imgreg.setDown(down_opt[0]);
-    imgreg.setThreshold(random_opt[0]);
-    double c0=0;//offset
-    double c1=1;//scale
-    while(band_opt.size()<input_opt.size())
-      band_opt.push_back(band_opt[0]);
-    if(src_min_opt.size()){
-      while(src_min_opt.size()<input_opt.size())
-        src_min_opt.push_back(src_min_opt[0]);
-    }
-    if(src_max_opt.size()){
-      while(src_max_opt.size()<input_opt.size())
-        src_max_opt.push_back(src_max_opt[0]);
-    }
-    ImgRasterGdal imgReader1(input_opt[0]);
-    ImgRasterGdal imgReader2(input_opt[1]);
-
-    if(offset_opt.size())
-      imgReader1.setOffset(offset_opt[0],band_opt[0]);
-    if(scale_opt.size())
-      imgReader1.setScale(scale_opt[0],band_opt[0]);
-    if(offset_opt.size()>1)
-      imgReader2.setOffset(offset_opt[1],band_opt[1]);
-    if(scale_opt.size()>1)
-      imgReader2.setScale(scale_opt[1],band_opt[1]);
-
-    for(int inodata=0;inodata<nodata_opt.size();++inodata){
-      if(!inodata){
-        imgReader1.GDALSetNoDataValue(nodata_opt[0],band_opt[0]);//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
-        imgReader2.GDALSetNoDataValue(nodata_opt[0]),band_opt[1];//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
+      if(src_max_opt.size()){
+        maxX=src_max_opt[0];
+        maxY=src_max_opt[1];
       }
-      imgReader1.pushNoDataValue(nodata_opt[inodata]);
-      imgReader2.pushNoDataValue(nodata_opt[inodata]);
-    }
 
-    double err=imgreg.getRMSE(imgReader1,imgReader2,c0,c1,band_opt[0],band_opt[1],verbose_opt[0]);
-    std::cout << "-rmse " << err << std::endl;
-    imgReader1.close();
-    imgReader2.close();
-  }
-  if(histogram2d_opt[0]&&(input_opt.size()>1)){
-    while(band_opt.size()<input_opt.size())
-      band_opt.push_back(band_opt[0]);
-    if(src_min_opt.size()){
-      while(src_min_opt.size()<input_opt.size())
-        src_min_opt.push_back(src_min_opt[0]);
-    }
-    if(src_max_opt.size()){
-      while(src_max_opt.size()<input_opt.size())
-        src_max_opt.push_back(src_max_opt[0]);
-    }
-    ImgRasterGdal imgReader1(input_opt[0]);
-    ImgRasterGdal imgReader2(input_opt[1]);
-
-    if(offset_opt.size())
-      imgReader1.setOffset(offset_opt[0],band_opt[0]);
-    if(scale_opt.size())
-      imgReader1.setScale(scale_opt[0],band_opt[0]);
-    if(offset_opt.size()>1)
-      imgReader2.setOffset(offset_opt[1],band_opt[1]);
-    if(scale_opt.size()>1)
-      imgReader2.setScale(scale_opt[1],band_opt[1]);
+      nbin=(nbin_opt.size())? nbin_opt[0]:0;
+      if(nbin<=1){
+        std::cerr << "Warning: number of bins not defined, calculating bins from min and max value" << std::endl;
+        if(minX>=maxX)
+          imgReader1.getMinMax(minX,maxX,band_opt[0]);
+        if(minY>=maxY)
+          imgReader2.getMinMax(minY,maxY,band_opt[1]);
 
-    for(int inodata=0;inodata<nodata_opt.size();++inodata){
-      if(!inodata){
-        imgReader1.GDALSetNoDataValue(nodata_opt[0],band_opt[0]);//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
-        imgReader2.GDALSetNoDataValue(nodata_opt[0]),band_opt[1];//only single no data can be set in GDALRasterBand (used for ComputeStatistics)
+        minValue=(minX<minY)? minX:minY;
+        maxValue=(maxX>maxY)? maxX:maxY;
+        if(verbose_opt[0])
+          std::cout << "min and max values: " << minValue << ", " << maxValue << std::endl;
+        nbin=maxValue-minValue+1;
+      }
+      assert(nbin>1);
+      //kernel density estimation as in http://en.wikipedia.org/wiki/Kernel_density_estimation
+      int refine=0;
+      if(kde_opt[0]){
+        //bandwidth from the moments of the selected valid pixels (offset, scale, nodata, down and random applied)
+        statfactory::Bivariate kdeMoments;
+        imgreg.getMoments(imgReader1,imgReader2,kdeMoments,band_opt[0],band_opt[1],0,verbose_opt[0]);
+        double estimatedSize=kdeMoments.size();
+        if(estimatedSize>0)
+          sigma=1.06*sqrt(sqrt(kdeMoments.varX()*kdeMoments.varY()))*pow(estimatedSize,-0.2);
+        //bin the values on a grid fine enough for the kernel (about four cells per sigma)
+        if(sigma>0){
+          double binWidth=(maxX-minX>maxY-minY)? (maxX-minX)/nbin : (maxY-minY)/nbin;
+          refine=static_cast<int>(ceil(4*binWidth/sigma))|1;
+          if(refine<3)
+            refine=3;
+          if(refine>15)
+            refine=15;
+        }
+      }
+      if(verbose_opt[0]){
+        if(sigma>0)
+          std::cout << "calculating 2d kernel density estimate with sigma " << sigma << " for datasets " << input_opt[0] << " and " << input_opt[1] << std::endl;
+        else
+          std::cout << "calculating 2d histogram for datasets " << input_opt[0] << " and " << input_opt[1] << std::endl;
+        std::cout << "nbin: " << nbin << std::endl;
       }
-      imgReader1.pushNoDataValue(nodata_opt[inodata]);
-      imgReader2.pushNoDataValue(nodata_opt[inodata]);
-    }
-
-    imgReader1.getMinMax(minX,maxX,band_opt[0]);
-    imgReader2.getMinMax(minY,maxY,band_opt[1]);
-
-    if(verbose_opt[0]){
-      cout << "minX: " << minX << endl;
-      cout << "maxX: " << maxX << endl;
-      cout << "minY: " << minY << endl;
-      cout << "maxY: " << maxY << endl;
-    }
-
-    if(src_min_opt.size()){
-      minX=src_min_opt[0];
-      minY=src_min_opt[1];
-    }
-    if(src_max_opt.size()){
-      maxX=src_max_opt[0];
-      maxY=src_max_opt[1];
-    }
 
-    nbin=(nbin_opt.size())? nbin_opt[0]:0;
-    if(nbin<=1){
-      std::cerr << "Warning: number of bins not defined, calculating bins from min and max value" << std::endl;
-      // imgReader1.getMinMax(minX,maxX,band_opt[0]);
-      // imgReader2.getMinMax(minY,maxY,band_opt[0]);
-      if(minX>=maxX)
+      if(maxX<=minX)
         imgReader1.getMinMax(minX,maxX,band_opt[0]);
-      if(minY>=maxY)
+      if(maxY<=minY)
         imgReader2.getMinMax(minY,maxY,band_opt[1]);
-
-      minValue=(minX<minY)? minX:minY;
-      maxValue=(maxX>maxY)? maxX:maxY;
-      if(verbose_opt[0])
-        std::cout << "min and max values: " << minValue << ", " << maxValue << std::endl;
-      nbin=maxValue-minValue+1;
-    }
-    assert(nbin>1);
-    double sigma=0;
-    //kernel density estimation as in http://en.wikipedia.org/wiki/Kernel_density_estimation
-    if(kde_opt[0]){
-      GDALProgressFunc pfnProgress;
-      void* pProgressData;
-      GDALRasterBand* rasterBand;
-      double stdDev1=0;
-      double stdDev2=0;
-      rasterBand=imgReader1.getRasterBand(band_opt[0]);
-      rasterBand->ComputeStatistics(0,&minValue,&maxValue,&meanValue,&stdDev1,pfnProgress,pProgressData);
-      rasterBand=imgReader2.getRasterBand(band_opt[0]);
-      rasterBand->ComputeStatistics(0,&minValue,&maxValue,&meanValue,&stdDev2,pfnProgress,pProgressData);
-
-      //todo: think of smarter way how to estimate size (nodata!)
-      double estimatedSize=1.0*imgReader.getNvalid(band_opt[0])/down_opt[0]/down_opt[0];
-      if(random_opt[0]>0)
-        estimatedSize*=random_opt[0]/100.0;
-      sigma=1.06*sqrt(stdDev1*stdDev2)*pow(estimatedSize,-0.2);
-    }
-    assert(nbin);
-    if(verbose_opt[0]){
-      if(sigma>0)
-        std::cout << "calculating 2d kernel density estimate with sigma " << sigma << " for datasets " << input_opt[0] << " and " << input_opt[1] << std::endl;
-      else
-        std::cout << "calculating 2d histogram for datasets " << input_opt[0] << " and " << input_opt[1] << std::endl;
-      std::cout << "nbin: " << nbin << std::endl;
+      if(verbose_opt[0]){
+        cout << "minX: " << minX << endl;
+        cout << "maxX: " << maxX << endl;
+        cout << "minY: " << minY << endl;
+        cout << "maxY: " << maxY << endl;
+      }
+      histogram2d=new statfactory::Histogram2d(minX,maxX,minY,maxY,nbin,refine);
     }
 
-    vector< vector<double> > output;
-
-    if(maxX<=minX)
-      imgReader1.getMinMax(minX,maxX,band_opt[0]);
-    if(maxY<=minY)
-      imgReader2.getMinMax(minY,maxY,band_opt[1]);
+    statfactory::Bivariate moments;
+    imgreg.getMoments(imgReader1,imgReader2,moments,band_opt[0],band_opt[1],histogram2d,verbose_opt[0]);
+    if(verbose_opt[0])
+      cout << "number of valid pixels: " << moments.size() << endl;
 
-    if(maxX<=minX){
-      std::ostringstream s;
-      s<<"Error: could not calculate distribution (minX>=maxX)";
-      throw(s.str());
+    if(reg_opt[0]){
+      double c0=0;//offset
+      double c1=1;//scale
+      double r2=moments.linearRegression(c0,c1);
+      std::cout << "-c0 " << c0 << " -c1 " << c1 << " -r2 " << r2 << std::endl;
     }
-    if(maxY<=minY){
-      std::ostringstream s;
-      s<<"Error: could not calculate distribution (minY>=maxY)";
-      throw(s.str());
+    if(preg_opt[0]){
+      double c0=0;//offset
+      double c1=1;//scale
+      double r2=imgreg.pgetR2(moments,c0,c1);
+      std::cout << "-c0 " << c0 << " -c1 " << c1 << " -r2 " << r2 << std::endl;
     }
-    if(verbose_opt[0]){
-      cout << "minX: " << minX << endl;
-      cout << "maxX: " << maxX << endl;
-      cout << "minY: " << minY << endl;
-      cout << "maxY: " << maxY << endl;
+    if(regerr_opt[0]){
+      double c0=0;//offset
+      double c1=1;//scale
+      double err=moments.regressionError(c0,c1);
+      std::cout << "-c0 " << c0 << " -c1 " << c1 << " -rmse " << err << std::endl;
     }
-    output.resize(nbin);
-    for(int i=0;i<nbin;++i){
-      output[i].resize(nbin);
-      for(int j=0;j<nbin;++j)
-        output[i][j]=0;
+    if(rmse_opt[0]){
+      //as before: rmse of the linear regression of the second on the first input (see -regerr)
+      double c0=0;//offset
+      double c1=1;//scale
+      std::cout << "-rmse " << moments.regressionError(c0,c1) << std::endl;
     }
-    int binX=0;
-    int binY=0;
-    vector<double> inputX(imgReader1.nrOfCol());
-    vector<double> inputY(imgReader2.nrOfCol());
-    double nvalid=0;
-    double geoX=0;
-    double geoY=0;
-    double icol1=0;
-    double irow1=0;
-    double icol2=0;
-    double irow2=0;
-    for(unsigned int irow=0;irow<imgReader1.nrOfRow();++irow){
-      if(irow%down_opt[0])
-        continue;
-      irow1=irow;
-      imgReader1.image2geo(icol1,irow1,geoX,geoY);
-      imgReader2.geo2image(geoX,geoY,icol2,irow2);
-      irow2=static_cast<int>(irow2);
-      imgReader1.readData(inputX,irow1,band_opt[0]);
-      imgReader2.readData(inputY,irow2,band_opt[1]);
-      for(unsigned int icol=0;icol<imgReader.nrOfCol();++icol){
-        if(icol%down_opt[0])
-          continue;
-        icol1=icol;
-        if(random_opt[0]>0){
-          double p=static_cast<double>(rand())/(RAND_MAX);
-          p*=100.0;
-          if(p>random_opt[0])
-            continue;//do not select for now, go to next column
-        }
-        if(imgReader1.isNoData(inputX[icol]))
-          continue;
-        imgReader1.image2geo(icol1,irow1,geoX,geoY);
-        imgReader2.geo2image(geoX,geoY,icol2,irow2);
-        icol2=static_cast<int>(icol2);
-        if(imgReader2.isNoData(inputY[icol2]))
-          continue;
-        // ++nvalid;
-        if(inputX[icol1]>=maxX)
-          binX=nbin-1;
-        else if(inputX[icol]<=minX)
-          binX=0;
-        else
-          binX=static_cast<int>(static_cast<double>(inputX[icol1]-minX)/(maxX-minX)*nbin);
-        if(inputY[icol2]>=maxY)
-          binY=nbin-1;
-        else if(inputY[icol2]<=minY)
-          binY=0;
-        else
-          binY=static_cast<int>(static_cast<double>(inputY[icol2]-minY)/(maxY-minY)*nbin);
-        assert(binX>=0);
-        assert(binX<output.size());
-        assert(binY>=0);
-        assert(binY<output[binX].size());
-        if(sigma>0){
-          //create kde for Gaussian basis function
-          //todo: speed up by calculating first and last bin with non-zero contriubtion...
-          for(int ibinX=0;ibinX<nbin;++ibinX){
-            double centerX=minX+static_cast<double>(maxX-minX)*ibinX/nbin;
-            double pdfX=gsl_ran_gaussian_pdf(inputX[icol1]-centerX, sigma);
-            for(int ibinY=0;ibinY<nbin;++ibinY){
-              //calculate  \integral_ibinX^(ibinX+1)
-              double centerY=minY+static_cast<double>(maxY-minY)*ibinY/nbin;
-              double pdfY=gsl_ran_gaussian_pdf(inputY[icol2]-centerY, sigma);
-              output[ibinX][binY]+=pdfX*pdfY;
-              nvalid+=pdfX*pdfY;
-            }
-          }
+    if(histogram2d){
+      vector< vector<double> > output;
+      double nvalid=histogram2d->size();
+      if(sigma>0){
+        histogram2d->density(sigma,output);
+        nvalid=0;
+        for(int binX=0;binX<nbin;++binX){
+          for(int binY=0;binY<nbin;++binY)
+            nvalid+=output[binX][binY];
         }
-        else{
-          ++output[binX][binY];
-          ++nvalid;
+      }
+      else{
+        output.assign(nbin,vector<double>(nbin,0));
+        for(int binX=0;binX<nbin;++binX){
+          for(int binY=0;binY<nbin;++binY)
+            output[binX][binY]=histogram2d->count(binX,binY);
         }
       }
-    }
-    if(verbose_opt[0])
-      cout << "number of valid pixels: " << nvalid << endl;
-    for(int binX=0;binX<nbin;++binX){
-      cout << endl;
-      for(int binY=0;binY<nbin;++binY){
-        double binValueX=0;
-        if(nbin==maxX-minX+1)
-          binValueX=minX+binX;
-        else
-          binValueX=minX+static_cast<double>(maxX-minX)*(binX+0.5)/nbin;
-        double binValueY=0;
-        if(nbin==maxY-minY+1)
-          binValueY=minY+binY;
-        else
-          binValueY=minY+static_cast<double>(maxY-minY)*(binY+0.5)/nbin;
-        double value=static_cast<double>(output[binX][binY]);
+      for(int binX=0;binX<nbin;++binX){
+        cout << endl;
+        for(int binY=0;binY<nbin;++binY){
+          double binValueX=0;
+          if(nbin==maxX-minX+1)
+            binValueX=minX+binX;
+          else
+            binValueX=minX+static_cast<double>(maxX-minX)*(binX+0.5)/nbin;
+          double binValueY=0;
+          if(nbin==maxY-minY+1)
+            binValueY=minY+binY;
+          else
+            binValueY=minY+static_cast<double>(maxY-minY)*(binY+0.5)/nbin;
+          double value=output[binX][binY];
 
-        if(relative_opt[0]||kde_opt[0])
-          value*=100.0/nvalid;
+          if((relative_opt[0]||kde_opt[0])&&nvalid>0)
+            value*=100.0/nvalid;
 
-        cout << binValueX << " " << binValueY << " " << value << std::endl;
-        // double value=static_cast<double>(output[binX][binY])/nvalid;
-        // cout << (maxX-minX)*bin/(nbin-1)+minX << " " << (maxY-minY)*bin/(nbin-1)+minY << " " << value << std::endl;
+          cout << binValueX << " " << binValueY << " " << value << std::endl;
+        }
       }
+      delete histogram2d;
     }
     imgReader1.close();
     imgReader2.close();
@@ -32,7 +32,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   ## SYNOPSIS
 
   <code>
-  Usage: pksvm -t training [-i input -o output] [-cv value]
+  Usage: pksvm -t training|-model file [-i input -o output] [-cv value]
   </code>
 
   <code>
@@ -54,6 +54,7 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   |short|long|type|default|description|
   |-----|----|----|-------|-----------|
   | t      | training             | std::string |       |Training vector file. A single vector file contains all training features (must be set as: b0, b1, b2,...) for all classes (class numbers identified by label option). Use multiple training files for bootstrap aggregation (alternative to the bag and bsize options, where a random subset is taken from a single training file) |
+  | model  | model                | std::string |       |Model file. With training, the trained model (all bags, scaling, classes and priors) is saved to this file. Without training, the model is read from this file and no training is done |
   | i      | input                | std::string |       |input image |
   | o      | output               | std::string |       |Output classification image |
   | cv     | cv                   | unsigned short | 0     |N-fold cross validation mode |
@@ -97,12 +98,13 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
   | etol   | etol                 | float | 0.001 |The tolerance of termination criterion |
   | shrink | shrink               | bool | false |Whether to use the shrinking heuristics |
   | pe     | probest              | bool | true  |Whether to train a SVC or SVR model for probability estimates |
+  | rff    | rff                  | unsigned int | 0 |Number of random Fourier features to approximate a radial kernel for the classification of the image (0: exact). Agreement with the exact model is reported on the training set |
   | entropy | entropy              | std::string |       |Entropy image (measure for uncertainty of classifier output |
   | active | active               | std::string |       |Ogr output for active training sample. |
   | na     | nactive              | unsigned int | 1     |Number of active training points |
   | random | random               | bool | true  |Randomize training data for balancing and bagging |
 
-  Usage: pksvm -t training [-i input -o output] [-cv value]
+  Usage: pksvm -t training|-model file [-i input -o output] [-cv value]
 
 
   Examples
@@ -152,7 +154,7 @@ int main(int argc, char *argv[])
   }
   catch(string helpString){
     cerr << helpString << endl;
-    cout << "Usage: pksvm -t training [-i input [-o output]] [-cv value]" << endl;
+    cout << "Usage: pksvm -t training|-model file [-i input [-o output]] [-cv value]" << endl;
     return(1);
   }
   return(0);
@@ -825,19 +825,26 @@ ImgRasterGdal::ImgRasterGdal(const app::AppFactory &app) {
     setGeoTransform(gt);
     if(assignSRS_opt.size())
       setProjectionProj4(assignSRS_opt[0]);
-    statfactory::StatFactory stat;
-    gsl_rng* rndgen=stat.getRandomGenerator(seed_opt[0]);
-    std::vector<double> lineBuffer(nrOfCol());
-    double value=stat.getRandomValue(rndgen,"gaussian",mean_opt[0],sigma_opt[0]);
+    //each row has its own random stream: blocks of rows are generated in parallel and written sequentially
+    const int nblock=256;
+    int ncol=nrOfCol();
+    int nrow=nrOfRow();
+    Vector2d<double> blockBuffer;
     for(unsigned int iband=0;iband<nrOfBand();++iband){
-      for(unsigned int irow=0;irow<nrOfRow();++irow){
-        for(unsigned int icol=0;icol<nrOfCol();++icol){
-          if(sigma_opt[0]>0||(!irow&&!iband)){
-            value=stat.getRandomValue(rndgen,"gaussian",mean_opt[0],sigma_opt[0]);
-            lineBuffer[icol]=value;
+      for(int firstRow=0;firstRow<nrow;firstRow+=nblock){
+        int nrowBlock=(firstRow+nblock<nrow)? nblock : nrow-firstRow;
+        blockBuffer.resize(nrowBlock,ncol);
+#pragma omp parallel for
+        for(int iblock=0;iblock<nrowBlock;++iblock){
+          if(sigma_opt[0]>0){
+            statfactory::RandomStream rowStream(seed_opt[0],static_cast<unsigned long int>(iband)*nrow+firstRow+iblock);
+            rowStream.gaussian(&(blockBuffer[iblock][0]),ncol,mean_opt[0],sigma_opt[0]);
           }
+          else
+            blockBuffer[iblock].assign(ncol,mean_opt[0]);
         }
-        writeData(lineBuffer,irow,iband);
+        for(int iblock=0;iblock<nrowBlock;++iblock)
+          writeData(blockBuffer[iblock],firstRow+iblock,iband);
       }
     }
   }
@@ -1090,25 +1097,6 @@ double ImgRasterGdal::getHistogram(std::vector<double>& histvector, double& min,
   min=minValue;
   max=maxValue;
 
-  double sigma=0;
-  if(kde){
-    double meanValue=0;
-    double stdDev=0;
-    GDALProgressFunc pfnProgress;
-    void* pProgressData;
-    GDALRasterBand* rasterBand;
-    rasterBand=getRasterBand(theBand);
-    rasterBand->ComputeStatistics(0,&minValue,&maxValue,&meanValue,&stdDev,pfnProgress,pProgressData);
-    //rest minvalue and MaxValue as ComputeStatistics does not account for nodata, scale and offset
-    minValue=min;
-    maxValue=max;
-
-    if(m_scale.size()>theBand){
-      stdDev*=m_scale[theBand];
-    }
-    sigma=1.06*stdDev*pow(getNvalid(theBand),-0.2);
-  }
-
   double scale=0;
   if(maxValue>minValue){
     if(nbin==0)
@@ -1123,6 +1111,12 @@ double ImgRasterGdal::getHistogram(std::vector<double>& histvector, double& min,
     histvector.resize(nbin);
     for(int i=0;i<nbin;histvector[i++]=0);
   }
+  //kde: bin the values on a fine grid and collect the moments for the bandwidth in the same pass
+  kde=kde&&(nbin>1);
+  statfactory::Moments moments;
+  statfactory::KernelDensity* density=0;
+  if(kde)
+    density=new statfactory::KernelDensity(minValue,maxValue,nbin);
   double nvalid=0;
   unsigned long int ninvalid=0;
   std::vector<double> lineBuffer(nrOfCol());
@@ -1131,6 +1125,10 @@ double ImgRasterGdal::getHistogram(std::vector<double>& histvector, double& min,
     for(int icol=0;icol<nrOfCol();++icol){
       if(isNoData(lineBuffer[icol]))
         ++ninvalid;
+      else if(kde){
+        moments.push(lineBuffer[icol]);
+        density->push(lineBuffer[icol]);
+      }
       else if(lineBuffer[icol]>maxValue)
         ++ninvalid;
       else if(lineBuffer[icol]<minValue)
@@ -1138,31 +1136,64 @@ double ImgRasterGdal::getHistogram(std::vector<double>& histvector, double& min,
       else if(nbin==1)
         ++histvector[0];
       else{//scale to [0:nbin]
-        if(sigma>0){
-          //create kde for Gaussian basis function
-          //todo: speed up by calculating first and last bin with non-zero contriubtion...
-          //todo: calculate real surface below pdf by using gsl_cdf_gaussian_P(x-mean+binsize,sigma)-gsl_cdf_gaussian_P(x-mean,sigma)
-          for(int ibin=0;ibin<nbin;++ibin){
-            double icenter=minValue+static_cast<double>(maxValue-minValue)*(ibin+0.5)/nbin;
+        int theBin=static_cast<unsigned long int>(scale*(lineBuffer[icol]-minValue));
+        //todo: replace assert with exception
+        assert(theBin>=0);
+        assert(theBin<nbin);
+        ++histvector[theBin];
+        ++nvalid;
+      }
+    }
+  }
+  if(kde){
+    //Silverman's rule of thumb
+    double sigma=1.06*moments.stdev()*pow(moments.size(),-0.2);
+    if(density->isAccurate(sigma)){
+      std::vector<double> kdeOutput;
+      density->density(sigma,kdeOutput);
+      for(int ibin=0;ibin<nbin;++ibin){
+        histvector[ibin]+=kdeOutput[ibin];
+        nvalid+=kdeOutput[ibin];
+      }
+    }
+    else if(sigma>0){
+      //bandwidth is too narrow for the binned estimate, evaluate the truncated kernel directly
+      double binSize=static_cast<double>(maxValue-minValue)/nbin;
+      int window=static_cast<int>(ceil(5*sigma/binSize));
+      for(int irow=0;irow<nrOfRow();++irow){
+        readData(lineBuffer,irow,theBand);
+        for(int icol=0;icol<nrOfCol();++icol){
+          if(isNoData(lineBuffer[icol]))
+            continue;
+          if(lineBuffer[icol]<minValue||lineBuffer[icol]>maxValue)
+            continue;
+          int theBin=static_cast<int>((lineBuffer[icol]-minValue)/binSize);
+          int firstBin=(theBin-window<0)? 0 : theBin-window;
+          int lastBin=(theBin+window>=nbin)? nbin-1 : theBin+window;
+          for(int ibin=firstBin;ibin<=lastBin;++ibin){
+            double icenter=minValue+binSize*(ibin+0.5);
             double thePdf=gsl_ran_gaussian_pdf(lineBuffer[icol]-icenter, sigma);
             histvector[ibin]+=thePdf;
             nvalid+=thePdf;
           }
         }
-        else{
-          int theBin=static_cast<unsigned long int>(scale*(lineBuffer[icol]-minValue));
-          //todo: replace assert with exception
-          assert(theBin>=0);
-          assert(theBin<nbin);
-          ++histvector[theBin];
+      }
+    }
+    else{
+      //constant data: plain histogram
+      for(int irow=0;irow<nrOfRow();++irow){
+        readData(lineBuffer,irow,theBand);
+        for(int icol=0;icol<nrOfCol();++icol){
+          if(isNoData(lineBuffer[icol]))
+            continue;
+          if(lineBuffer[icol]<minValue||lineBuffer[icol]>maxValue)
+            continue;
+          ++histvector[static_cast<int>(scale*(lineBuffer[icol]-minValue))];
           ++nvalid;
         }
-        // else if(lineBuffer[icol]==maxValue)
-        //   ++histvector[nbin-1];
-        // else
-        //   ++histvector[static_cast<int>(static_cast<double>(lineBuffer[icol]-minValue)/(maxValue-minValue)*(nbin-1))];
       }
     }
+    delete density;
   }
   // unsigned long int nvalid=nrOfCol()*nrOfRow()-ninvalid;
   return nvalid;
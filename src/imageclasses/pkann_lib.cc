@@ -30,7 +30,11 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include "algorithms/ConfusionMatrix.h"
 #include "floatfann.h"
 #include "algorithms/myfann_cpp.h"
+#include "algorithms/ModelFile.h"
 #include "apps/AppFactory.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace ann{
   enum ANN_TYPE {C_SVC=0, nu_SVC=1,one_class=2, epsilon_SVR=3, nu_SVR=4};
@@ -70,6 +74,7 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
   //--------------------------- command line options ------------------------------------
   Optionpk<string> input_opt("i", "input", "input image");
   Optionpk<string> training_opt("t", "training", "training vector file. A single vector file contains all training features (must be set as: B0, B1, B2,...) for all classes (class numbers identified by label option). Use multiple training files for bootstrap aggregation (alternative to the bag and bsize options, where a random subset is taken from a single training file)");
+  Optionpk<string> model_opt("model", "model", "model file. With training, the trained networks (all bags, scaling, classes and priors) are saved to this file. Without training, the networks are read from this file and no training is done");
   Optionpk<string> tlayer_opt("tln", "tln", "training layer name(s)");
   Optionpk<string> label_opt("label", "label", "identifier for class label in training vector file.","label");
   Optionpk<unsigned int> balance_opt("bal", "balance", "balance the input data to this number of samples for each class", 0);
@@ -138,6 +143,7 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
   try{
     doProcess=input_opt.retrieveOption(app.getArgc(),app.getArgv());
     training_opt.retrieveOption(app.getArgc(),app.getArgv());
+    model_opt.retrieveOption(app.getArgc(),app.getArgv());
     tlayer_opt.retrieveOption(app.getArgc(),app.getArgv());
     label_opt.retrieveOption(app.getArgc(),app.getArgv());
     balance_opt.retrieveOption(app.getArgc(),app.getArgv());
@@ -191,8 +197,8 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
       throw(helpStream.str());//help was invoked, stop processing
     }
 
-    if(training_opt.empty()){
-      string errorString="Error: no training provided";
+    if(training_opt.empty()&&model_opt.empty()){
+      string errorString="Error: no training or model provided";
       throw(errorString);
     }
 
@@ -254,6 +260,10 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
 
     ImgWriterOgr activeWriter;
     if(active_opt.size()){
+      if(training_opt.empty()){
+        string errorString="Error: active learning requires training";
+        throw(errorString);
+      }
       ImgReaderOgr trainingReader(training_opt[0]);
       activeWriter.open(active_opt[0],ogrformat_opt[0]);
       activeWriter.createLayer(active_opt[0],trainingReader.getProjection(),wkbPoint,NULL);
@@ -326,7 +336,58 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
     map<string,Vector2d<float> > trainingMap;
     vector< Vector2d<float> > trainingPixels;//[class][sample][band]
     vector<string> fields;
-    for(unsigned int ibag=0;ibag<nbag;++ibag){
+
+    //read trained networks instead of training
+    modelfile::ModelReader modelReader;
+    if(training_opt.empty()){
+      if(verbose_opt[0]>=1)
+        cout << "reading model file " << model_opt[0] << endl;
+      modelReader.open(model_opt[0],"pkann");
+      nbag=modelReader.readValue<unsigned short>();
+      nclass=modelReader.readValue<unsigned int>();
+      nband=modelReader.readValue<unsigned int>();
+      modelReader.read(band_opt);
+      modelReader.read(nameVector);
+      modelReader.read(classValueMap);
+      modelReader.read(priors);
+      net.clear();//networks are not copyable: construct new ones
+      net.resize(nbag);
+      offset.resize(nbag);
+      scale.resize(nbag);
+      for(unsigned int ibag=0;ibag<nbag;++ibag){
+        modelReader.read(offset[ibag]);
+        modelReader.read(scale[ibag]);
+        vector<unsigned int> layers;
+        vector<fann_connection> convector;
+        modelReader.read(layers);
+        modelReader.read(convector);
+        if(layers.size()<3){
+          string errorString="Error: could not read neural network from ";
+          errorString+=model_opt[0];
+          throw(errorString);
+        }
+        //sparse networks are restored as fully connected networks with zero weight for the missing connections
+        net[ibag].create_standard_array(layers.size(),&(layers[0]));
+        if(convector.size()<net[ibag].get_total_connections()){
+          vector<fann_connection> zeroWeights;
+          net[ibag].get_connection_array(zeroWeights);
+          for(unsigned int i_connection=0;i_connection<zeroWeights.size();++i_connection)
+            zeroWeights[i_connection].weight=0;
+          net[ibag].set_weight_array(zeroWeights);
+        }
+        net[ibag].set_weight_array(convector);
+        net[ibag].set_activation_function_hidden(FANN::SIGMOID_SYMMETRIC_STEPWISE);
+        net[ibag].set_activation_function_output(FANN::SIGMOID_SYMMETRIC_STEPWISE);
+      }
+      modelReader.close();
+      if(verbose_opt[0]>=1)
+        cout << "number of bootstrap aggregations, classes and bands in model: " << nbag << ", " << nclass << ", " << nband << endl;
+    }
+
+    const float desired_error = 0.0003;
+    const unsigned int iterations_between_reports = (verbose_opt[0])? maxit_opt[0]+1:0;
+    vector<FANN::training_data> bagData(nbag);//training data for the networks that are trained in parallel
+    for(unsigned int ibag=0;ibag<nbag&&training_opt.size();++ibag){
       //organize training data
       if(ibag<training_opt.size()){//if bag contains new training pixels
         trainingMap.clear();
@@ -541,8 +602,6 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
         ntraining+=trainingFeatures[iclass].size();
 
       const unsigned int num_layers = nneuron_opt.size()+2;
-      const float desired_error = 0.0003;
-      const unsigned int iterations_between_reports = (verbose_opt[0])? maxit_opt[0]+1:0;
       if(verbose_opt[0]>=1){
         cout << "number of features: " << nFeatures << endl;
         cout << "creating artificial neural network with " << nneuron_opt.size() << " hidden layer, having " << endl;
@@ -657,22 +716,24 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
         net[ibag].set_weight_array(convector);
       }
       else{
-        bool initWeights=true;
-        net[ibag].train_on_data(trainingFeatures,ntraining,initWeights, maxit_opt[0],
-                                iterations_between_reports, desired_error);
-      }
-
-
-      if(verbose_opt[0]>=2){
-        net[ibag].print_connections();
-        vector<fann_connection> convector;
-        net[ibag].get_connection_array(convector);
-        for(unsigned int i_connection=0;i_connection<net[ibag].get_total_connections();++i_connection)
-          cout << "connection " << i_connection << ": " << convector[i_connection].weight << endl;
-
+        //weights are initialized at random in order of the bags, the networks are trained in parallel below
+        bagData[ibag].set_train_data(trainingFeatures,ntraining);
+        net[ibag].init_weights(bagData[ibag]);
       }
     }//for ibag
-    if(cv_opt[0]>1){
+    //FANN reports (verbose mode) are printed sequentially
+#pragma omp parallel for schedule(dynamic) if(!verbose_opt[0])
+    for(int ibag=0;ibag<nbag;++ibag)
+      net[ibag].train_on_data(bagData[ibag],maxit_opt[0],iterations_between_reports,desired_error);
+    bagData.clear();
+    for(unsigned int ibag=0;ibag<nbag&&training_opt.size()&&verbose_opt[0]>=2;++ibag){
+      net[ibag].print_connections();
+      vector<fann_connection> convector;
+      net[ibag].get_connection_array(convector);
+      for(unsigned int i_connection=0;i_connection<net[ibag].get_total_connections();++i_connection)
+        cout << "connection " << i_connection << ": " << convector[i_connection].weight << endl;
+    }
+    if(cv_opt[0]>1&&training_opt.size()){
       assert(cm.nReference());
       cm.setFormat(cmformat_opt[0]);
       cm.reportSE95(false);
@@ -693,6 +754,31 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
       doa=cm.oa_pct(&se95_oa);
       std::cout << "Overall Accuracy: " << doa << " (" << se95_oa << ")"  << std::endl;
     }
+    if(model_opt.size()&&training_opt.size()){
+      if(verbose_opt[0]>=1)
+        cout << "writing model file " << model_opt[0] << endl;
+      modelfile::ModelWriter modelWriter(model_opt[0],"pkann");
+      modelWriter.writeValue<unsigned short>(nbag);
+      modelWriter.writeValue<unsigned int>(nclass);
+      modelWriter.writeValue<unsigned int>(nband);
+      modelWriter.write(band_opt);
+      modelWriter.write(nameVector);
+      modelWriter.write(classValueMap);
+      modelWriter.write(priors);
+      vector<unsigned int> layers;
+      layers.push_back(nband);
+      layers.insert(layers.end(),nneuron_opt.begin(),nneuron_opt.end());
+      layers.push_back(nclass);
+      for(unsigned int ibag=0;ibag<nbag;++ibag){
+        vector<fann_connection> convector;
+        net[ibag].get_connection_array(convector);
+        modelWriter.write(offset[ibag]);
+        modelWriter.write(scale[ibag]);
+        modelWriter.write(layers);
+        modelWriter.write(convector);
+      }
+      modelWriter.close();
+    }
     //--------------------------------- end of training -----------------------------------
     if(input_opt.empty())
       exit(0);
@@ -835,6 +921,21 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
         }
       }
 
+      const unsigned int blockSize=64;//number of pixels classified per thread at a time
+      vector<short> classValue(nclass);
+      for(short iclass=0;iclass<nclass;++iclass)
+        classValue[iclass]=classValueMap[nameVector[iclass]];
+      vector<unsigned int> classifyCol;//columns of the pixels to classify
+      //running a network changes its neuron values: each extra thread gets its own copy of the networks, thread 0 runs the originals
+      int nthread=1;
+#ifdef _OPENMP
+      nthread=omp_get_max_threads();
+#endif
+      vector<FANN::neural_net> threadNet((nthread-1)*nbag);
+      for(int ithread=1;ithread<nthread;++ithread)
+        for(unsigned int ibag=0;ibag<nbag;++ibag)
+          threadNet[(ithread-1)*nbag+ibag].copy_from(net[ibag]);
+
       for(unsigned int iline=0;iline<nrow;++iline){
         vector<float> buffer(ncol);
         vector<short> lineMask;
@@ -844,7 +945,6 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
         if(priorimg_opt.size())
           linePrior.resize(nclass,ncol);//prior prob for each class
         Vector2d<float> hpixel(ncol);
-        Vector2d<float> fpixel(ncol);
         Vector2d<float> probOut(nclass,ncol);//posterior prob for each (internal) class
         vector<float> entropy(ncol);
         Vector2d<char> classBag;//classified line for writing to image file
@@ -905,6 +1005,7 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
           }
         }
         double oldRowMask=-1;//keep track of row mask to optimize number of line readings
+        classifyCol.clear();
         //process per pixel
         for(unsigned int icol=0;icol<ncol;++icol){
           assert(hpixel[icol].size()==nband);
@@ -994,90 +1095,107 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
             classOut[icol]=nodata_opt[0];
             continue;//next column
           }
-          if(verbose_opt[0]>1)
-            std::cout << "begin classification " << std::endl;
-          //----------------------------------- classification -------------------
-          for(unsigned int ibag=0;ibag<nbag;++ibag){
-            //calculate image features
-            fpixel[icol].clear();
-            for(unsigned int iband=0;iband<nband;++iband)
-              fpixel[icol].push_back((hpixel[icol][iband]-offset[ibag][iband])/scale[ibag][iband]);
-            vector<float> result(nclass);
-            result=net[ibag].run(fpixel[icol]);
-            vector<float> prValues(nclass);
-            float maxP=0;
-
-            //calculate posterior prob of bag
-            if(classBag_opt.size()){
-              //search for max prob within bag
-              maxP=0;
-              classBag[ibag][icol]=0;
-            }
-            double normPrior=0;
-            if(priorimg_opt.size()){
-              for(short iclass=0;iclass<nclass;++iclass)
-                normPrior+=linePrior[iclass][icol];
-            }
-            for(unsigned int iclass=0;iclass<nclass;++iclass){
-              result[iclass]=(result[iclass]+1.0)/2.0;//bring back to scale [0,1]
-              if(priorimg_opt.size())
-                priors[iclass]=linePrior[iclass][icol]/normPrior;//todo: check if correct for all cases... (automatic classValueMap and manual input for names and values)
-              switch(comb_opt[0]){
-              default:
-              case(0)://sum rule
-                probOut[iclass][icol]+=result[iclass]*priors[iclass];//add probabilities for each bag
-              break;
-              case(1)://product rule
-                probOut[iclass][icol]*=pow(static_cast<float>(priors[iclass]),static_cast<float>(1.0-nbag)/nbag)*result[iclass];//multiply probabilities for each bag
-                break;
-              case(2)://max rule
-                if(priors[iclass]*result[iclass]>probOut[iclass][icol])
-                  probOut[iclass][icol]=priors[iclass]*result[iclass];
-                break;
-              }
-              if(classBag_opt.size()){
-                //search for max prob within bag
-                // if(prValues[iclass]>maxP){
-                //   maxP=prValues[iclass];
-                //   classBag[ibag][icol]=vcode[iclass];
-                // }
-                if(result[iclass]>maxP){
-                  maxP=result[iclass];
-                  classBag[ibag][icol]=iclass;
+          classifyCol.push_back(icol);
+        }//icol
+        if(verbose_opt[0]>1)
+          std::cout << "begin classification " << std::endl;
+        //----------------------------------- classification -------------------
+        //blocks of pixels are distributed over the threads
+        unsigned int nclassify=classifyCol.size();
+        int nblock=(nclassify+blockSize-1)/blockSize;
+#pragma omp parallel if(nblock>1)
+        {
+          FANN::neural_net* bagNet=&(net[0]);
+#ifdef _OPENMP
+          if(omp_get_thread_num())
+            bagNet=&(threadNet[(omp_get_thread_num()-1)*nbag]);
+#endif
+          vector<float> fpixel(nband);//scaled features of the pixel
+          vector<float> result(nclass);
+          vector<double> pixelPrior(priors);
+#pragma omp for schedule(dynamic)
+          for(int iblock=0;iblock<nblock;++iblock){
+            unsigned int firstPixel=iblock*blockSize;
+            unsigned int lastPixel=(nclassify-firstPixel<blockSize)? nclassify : firstPixel+blockSize;
+            for(unsigned int ipixel=firstPixel;ipixel<lastPixel;++ipixel){
+              unsigned int icol=classifyCol[ipixel];
+              for(unsigned int ibag=0;ibag<nbag;++ibag){
+                //calculate image features
+                for(unsigned int iband=0;iband<nband;++iband)
+                  fpixel[iband]=(hpixel[icol][iband]-offset[ibag][iband])/scale[ibag][iband];
+                result=bagNet[ibag].run(fpixel);
+                float maxP=0;
+
+                //calculate posterior prob of bag
+                if(classBag_opt.size()){
+                  //search for max prob within bag
+                  maxP=0;
+                  classBag[ibag][icol]=0;
                 }
+                double normPrior=0;
+                if(priorimg_opt.size()){
+                  for(short iclass=0;iclass<nclass;++iclass)
+                    normPrior+=linePrior[iclass][icol];
+                }
+                for(unsigned int iclass=0;iclass<nclass;++iclass){
+                  result[iclass]=(result[iclass]+1.0)/2.0;//bring back to scale [0,1]
+                  if(priorimg_opt.size())
+                    pixelPrior[iclass]=linePrior[iclass][icol]/normPrior;//todo: check if correct for all cases... (automatic classValueMap and manual input for names and values)
+                  switch(comb_opt[0]){
+                  default:
+                  case(0)://sum rule
+                    probOut[iclass][icol]+=result[iclass]*pixelPrior[iclass];//add probabilities for each bag
+                  break;
+                  case(1)://product rule
+                    probOut[iclass][icol]*=pow(static_cast<float>(pixelPrior[iclass]),static_cast<float>(1.0-nbag)/nbag)*result[iclass];//multiply probabilities for each bag
+                    break;
+                  case(2)://max rule
+                    if(pixelPrior[iclass]*result[iclass]>probOut[iclass][icol])
+                      probOut[iclass][icol]=pixelPrior[iclass]*result[iclass];
+                    break;
+                  }
+                  if(classBag_opt.size()){
+                    //search for max prob within bag
+                    if(result[iclass]>maxP){
+                      maxP=result[iclass];
+                      classBag[ibag][icol]=iclass;
+                    }
+                  }
+                }
+              }//ibag
+
+              //search for max class prob
+              float maxBag1=0;//max probability
+              float maxBag2=0;//second max probability
+              float normBag=0;
+              for(short iclass=0;iclass<nclass;++iclass){
+                if(probOut[iclass][icol]>maxBag1){
+                  maxBag1=probOut[iclass][icol];
+                  classOut[icol]=classValue[iclass];
+                }
+                else if(probOut[iclass][icol]>maxBag2)
+                  maxBag2=probOut[iclass][icol];
+                normBag+=probOut[iclass][icol];
               }
-            }
-          }//ibag
-
-          //search for max class prob
-          float maxBag1=0;//max probability
-          float maxBag2=0;//second max probability
-          float normBag=0;
-          for(short iclass=0;iclass<nclass;++iclass){
-            if(probOut[iclass][icol]>maxBag1){
-              maxBag1=probOut[iclass][icol];
-              classOut[icol]=classValueMap[nameVector[iclass]];
-            }
-            else if(probOut[iclass][icol]>maxBag2)
-              maxBag2=probOut[iclass][icol];
-            normBag+=probOut[iclass][icol];
-          }
-          //normalize probOut and convert to percentage
-          entropy[icol]=0;
-          for(short iclass=0;iclass<nclass;++iclass){
-            float prv=probOut[iclass][icol];
-            prv/=normBag;
-            entropy[icol]-=prv*log(prv)/log(2.0);
-            prv*=100.0;
-
-            probOut[iclass][icol]=static_cast<short>(prv+0.5);
-            // assert(classValueMap[nameVector[iclass]]<probOut.size());
-            // assert(classValueMap[nameVector[iclass]]>=0);
-            // probOut[classValueMap[nameVector[iclass]]][icol]=static_cast<short>(prv+0.5);
-          }
-          entropy[icol]/=log(static_cast<double>(nclass))/log(2.0);
-          entropy[icol]=static_cast<short>(100*entropy[icol]+0.5);
-          if(active_opt.size()){
+              //normalize probOut and convert to percentage
+              entropy[icol]=0;
+              for(short iclass=0;iclass<nclass;++iclass){
+                float prv=probOut[iclass][icol];
+                prv/=normBag;
+                entropy[icol]-=prv*log(prv)/log(2.0);
+                prv*=100.0;
+
+                probOut[iclass][icol]=static_cast<short>(prv+0.5);
+              }
+              entropy[icol]/=log(static_cast<double>(nclass))/log(2.0);
+              entropy[icol]=static_cast<short>(100*entropy[icol]+0.5);
+            }//ipixel
+          }//iblock
+        }
+        //merge active learning candidates in column order, as in a sequential run
+        if(active_opt.size()){
+          for(unsigned int ipixel=0;ipixel<nclassify;++ipixel){
+            unsigned int icol=classifyCol[ipixel];
             if(entropy[icol]>activePoints.back().value){
               activePoints.back().value=entropy[icol];//replace largest value (last)
               activePoints.back().posx=icol;
@@ -1087,7 +1205,7 @@ CPLErr ImgRasterGdal::ann(ImgRasterGdal& imgWriter, const AppFactory& app){
                 std::cout << activePoints.back().posx << " " << activePoints.back().posy << " " << activePoints.back().value << std::endl;
             }
           }
-        }//icol
+        }
         //----------------------------------- write output ------------------------------------------
         if(classBag_opt.size())
           for(unsigned int ibag=0;ibag<nbag;++ibag)
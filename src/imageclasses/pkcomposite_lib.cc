@@ -594,6 +594,7 @@ CPLErr ImgCollection::composite(ImgRasterGdal& imgWriter, const AppFactory& app)
       readBuffer[ifile].resize((this->at(ifile))->nrOfBand());
 
     statfactory::StatFactory stat;
+    std::vector<double> scratch;//reused by the order statistics
     if(cruleMap[crule_opt[0]]==maxndvi)//ndvi
       assert(ruleBand_opt.size()==2);
     if(cruleMap[crule_opt[0]]==mode){//max voting
@@ -1112,7 +1113,7 @@ CPLErr ImgCollection::composite(ImgRasterGdal& imgWriter, const AppFactory& app)
                 break;
               case(median):
                 // writeBuffer[iband][icol]=stat.median(storeBuffer[bands[iband]][icol]);
-                writeBuffer[iband][icol]=stat.median(storeBuffer[iband][icol]);
+                writeBuffer[iband][icol]=stat.median(storeBuffer[iband][icol],scratch);
                 break;
               case(sum):
                 // writeBuffer[iband][icol]=stat.sum(storeBuffer[bands[iband]][icol]);
@@ -243,11 +243,12 @@ CPLErr ImgRasterGdal::extractOgr(const AppFactory& app){
           sampleWriterOgr.createLayer("points", this->getProjection(), wkbPoint, papszOptions);
         OGRPoint pt;
         unsigned int ipoint;
+        statfactory::RandomStream rng(time(NULL));
         for(ipoint=0;ipoint<random_opt[0];++ipoint){
           OGRFeature *pointFeature;
           pointFeature=sampleWriterOgr.createFeature();
-          double theX=ulx+static_cast<double>(rand())/(RAND_MAX)*(lrx-ulx);
-          double theY=uly-static_cast<double>(rand())/(RAND_MAX)*(uly-lry);
+          double theX=ulx+rng.uniform(2*ipoint)*(lrx-ulx);
+          double theY=uly-rng.uniform(2*ipoint+1)*(uly-lry);
           pt.setX(theX);
           pt.setY(theY);
           pointFeature->SetGeometry( &pt ); 
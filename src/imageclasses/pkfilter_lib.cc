@@ -88,6 +88,8 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
   Optionpk<string>  colorTable_opt("ct", "ct", "color table (file with 5 columns: id R G B ALFA (0: transparent, 255: solid). Use none to omit color table");
   Optionpk<short> down_opt("d", "down", "down sampling factor. Use value 1 for no downsampling). Use value n>1 for downsampling (aggregation)", 1);
   Optionpk<string> beta_opt("beta", "beta", "ASCII file with beta for each class transition in Markov Random Field");
+  Optionpk<unsigned short> iter_opt("iter", "iter", "maximum number of iterated conditional modes updates in Markov Random Field (0: no update)", 0);
+  Optionpk<double> minchange_opt("minchange", "minchange", "stop iterating Markov Random Field when proportion of changed pixels is below this value (evaluated per strip of 1024 rows)", 0);
   // Optionpk<double> eps_opt("eps","eps", "error marging for linear feature",0);
   // Optionpk<bool> l1_opt("l1","l1", "obtain longest object length for linear feature",false);
   // Optionpk<bool> l2_opt("l2","l2", "obtain shortest object length for linear feature",false,2);
@@ -111,6 +113,8 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
   wavelengthOut_opt.setHide(1);
   down_opt.setHide(1);
   beta_opt.setHide(1);
+  iter_opt.setHide(1);
+  minchange_opt.setHide(1);
   // eps_opt.setHide(1);
   // l1_opt.setHide(1);
   // l2_opt.setHide(1);
@@ -147,6 +151,8 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
     wavelengthOut_opt.retrieveOption(app.getArgc(),app.getArgv());
     down_opt.retrieveOption(app.getArgc(),app.getArgv());
     beta_opt.retrieveOption(app.getArgc(),app.getArgv());
+    iter_opt.retrieveOption(app.getArgc(),app.getArgv());
+    minchange_opt.retrieveOption(app.getArgc(),app.getArgv());
     // eps_opt.retrieveOption(app.getArgc(),app.getArgv());
     // l1_opt.retrieveOption(app.getArgc(),app.getArgv());
     // l2_opt.retrieveOption(app.getArgc(),app.getArgv());
@@ -399,6 +405,9 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
 
       Vector2d<double> lineInput(this->nrOfBand(),this->nrOfCol());
       Vector2d<double> lineOutput(wavelengthOut_opt.size(),this->nrOfCol());
+      //wavelengths are fixed for the entire image: compile the convolution only once
+      filter::ResampleMatrix fwhmMatrix;
+      bool useMatrix=filter1d.getFwhmMatrix(wavelengthIn_opt,wavelengthOut_opt,fwhm_opt,interpolationType_opt[0],fwhmMatrix,verbose_opt[0]);
       const char* pszMessage;
       void* pProgressArg=NULL;
       GDALProgressFunc pfnProgress=GDALTermProgress;
@@ -409,7 +418,10 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
           continue;
         for(unsigned int iband=0;iband<this->nrOfBand();++iband)
           this->readData(lineInput[iband],y,iband);
-        filter1d.applyFwhm<double>(wavelengthIn_opt,lineInput,wavelengthOut_opt,fwhm_opt, interpolationType_opt[0], lineOutput, down_opt[0], verbose_opt[0]);
+        if(useMatrix)
+          filter1d.resample(fwhmMatrix,lineInput,lineOutput,down_opt[0]);
+        else
+          filter1d.applyFwhm<double>(wavelengthIn_opt,lineInput,wavelengthOut_opt,fwhm_opt, interpolationType_opt[0], lineOutput, down_opt[0], verbose_opt[0]);
         for(unsigned int iband=0;iband<imgWriter.nrOfBand();++iband){
           imgWriter.writeData(lineOutput[iband],y/down_opt[0],iband);
         }
@@ -448,7 +460,19 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
       }
       assert(imgWriter.nrOfBand()==srf.size());
       double centreWavelength=0;
+      double delta=1.0;
+      bool normalize=true;
       Vector2d<double> lineInput(this->nrOfBand(),this->nrOfCol());
+      Vector2d<double> lineOutput(srf.size(),imgWriter.nrOfCol());
+      //wavelengths are fixed for the entire image: compile the convolution only once
+      filter::ResampleMatrix srfMatrix;
+      bool useMatrix=filter1d.getSrfMatrix(wavelengthIn_opt,srf,interpolationType_opt[0],srfMatrix,delta,normalize,verbose_opt[0]);
+      if(useMatrix&&verbose_opt[0]){
+        for(unsigned int isrf=0;isrf<srf.size();++isrf){
+          centreWavelength=filter1d.getCentreWavelength(wavelengthIn_opt,srf[isrf],interpolationType_opt[0],delta);
+          std::cout << "centre wavelength srf " << isrf << ": " << centreWavelength << std::endl;
+        }
+      }
       const char* pszMessage;
       void* pProgressArg=NULL;
       GDALProgressFunc pfnProgress=GDALTermProgress;
@@ -459,14 +483,19 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
           continue;
         for(unsigned int iband=0;iband<this->nrOfBand();++iband)
           this->readData(lineInput[iband],y,iband);
-        for(unsigned int isrf=0;isrf<srf.size();++isrf){
-          vector<double> lineOutput(imgWriter.nrOfCol());
-          double delta=1.0;
-          bool normalize=true;
-          centreWavelength=filter1d.applySrf<double>(wavelengthIn_opt,lineInput,srf[isrf], interpolationType_opt[0], lineOutput, delta, normalize);
-          if(verbose_opt[0])
-            std::cout << "centre wavelength srf " << isrf << ": " << centreWavelength << std::endl;
-          imgWriter.writeData(lineOutput,y/down_opt[0],isrf);
+        if(useMatrix){
+          filter1d.resample(srfMatrix,lineInput,lineOutput,down_opt[0]);
+          for(unsigned int isrf=0;isrf<srf.size();++isrf)
+            imgWriter.writeData(lineOutput[isrf],y/down_opt[0],isrf);
+        }
+        else{
+          for(unsigned int isrf=0;isrf<srf.size();++isrf){
+            vector<double> lineOutput(imgWriter.nrOfCol());
+            centreWavelength=filter1d.applySrf<double>(wavelengthIn_opt,lineInput,srf[isrf], interpolationType_opt[0], lineOutput, delta, normalize, down_opt[0]);
+            if(verbose_opt[0])
+              std::cout << "centre wavelength srf " << isrf << ": " << centreWavelength << std::endl;
+            imgWriter.writeData(lineOutput,y/down_opt[0],isrf);
+          }
         }
         progress=(1.0+y)/imgWriter.nrOfRow();
         pfnProgress(progress,pszMessage,pProgressArg);
@@ -639,11 +668,11 @@ CPLErr ImgRasterGdal::filter(ImgRasterGdal& imgWriter, const AppFactory& app){
               std::cout << std::endl;
             }
           }
-          filter2d.mrf(*this, imgWriter, dimX_opt[0], dimY_opt[0], beta, true, down_opt[0], verbose_opt[0]);
+          filter2d.mrf(*this, imgWriter, dimX_opt[0], dimY_opt[0], beta, true, down_opt[0], verbose_opt[0], iter_opt[0], minchange_opt[0]);
           //filter2d.mrf(input, output, dimX_opt[0], dimY_opt[0], beta, true, down_opt[0], verbose_opt[0]);
         }
         else
-          filter2d.mrf(*this, imgWriter, dimX_opt[0], dimY_opt[0], 1, true, down_opt[0], verbose_opt[0]);
+          filter2d.mrf(*this, imgWriter, dimX_opt[0], dimY_opt[0], 1, true, down_opt[0], verbose_opt[0], iter_opt[0], minchange_opt[0]);
         // filter2d.mrf(input, output, dimX_opt[0], dimY_opt[0], 1, true, down_opt[0], verbose_opt[0]);
         break;
       }
@@ -130,65 +130,30 @@ CPLErr ImgCollection::statProfile(ImgRasterGdal& imgWriter, const AppFactory& ap
   Vector2d<double> lineInput(this->size(),this->front()->nrOfCol());
   assert(imgWriter.nrOfCol()==this->front()->nrOfCol());
   Vector2d<double> lineOutput(function_opt.size(),imgWriter.nrOfCol());
-  statfactory::StatFactory stat;
-  stat.setNoDataValues(nodata_opt);
+  //all statistics of a pixel profile are obtained in a single pass
+  filter::Filter filter1d;
+  filter1d.setNoDataValues(nodata_opt);
+  filter1d.setThresholds(percentile_opt);
+  vector<filter::FILTER_TYPE> methods(function_opt.size());
+  for(int imethod=0;imethod<function_opt.size();++imethod)
+    methods[imethod]=filter::Filter::getFilterType(function_opt[imethod]);
   const char* pszMessage;
   void* pProgressArg=NULL;
   GDALProgressFunc pfnProgress=GDALTermProgress;
   double progress=0;
   pfnProgress(progress,pszMessage,pProgressArg);
+  vector<double> pixelInput(this->size());
+  vector<double> pixelOutput(function_opt.size());
+  vector<double> buffer;
   for(unsigned int y=0;y<this->front()->nrOfRow();++y){
-    std::vector<std::shared_ptr<ImgRasterGdal> >::const_iterator imit=begin();
     for(int ifile=0;ifile<size();++ifile)
       at(ifile)->readData(lineInput[ifile],y);
-    vector<double> pixelInput(this->size());
     for(unsigned int x=0;x<this->front()->nrOfCol();++x){
-      pixelInput=lineInput.selectCol(x);
-      int ithreshold=0;//threshold to use for percentiles
-      for(int imethod=0;imethod<function_opt.size();++imethod){
-        switch(filter::Filter::getFilterType(function_opt[imethod])){
-        case(filter::first):
-          lineOutput[imethod][x]=lineInput[0][x];
-          break;
-        case(filter::last):
-          lineOutput[imethod][x]=lineInput.back()[x];
-          break;
-        case(filter::nvalid):
-          lineOutput[imethod][x]=stat.nvalid(pixelInput);
-          break;
-        case(filter::median):
-          lineOutput[imethod][x]=stat.median(pixelInput);
-          break;
-        case(filter::min):
-          lineOutput[imethod][x]=stat.mymin(pixelInput);
-          break;
-        case(filter::max):
-          lineOutput[imethod][x]=stat.mymax(pixelInput);
-          break;
-        case(filter::sum):
-          lineOutput[imethod][x]=stat.sum(pixelInput);
-          break;
-        case(filter::var):
-          lineOutput[imethod][x]=stat.var(pixelInput);
-          break;
-        case(filter::stdev):
-          lineOutput[imethod][x]=sqrt(stat.var(pixelInput));
-          break;
-        case(filter::mean):
-          lineOutput[imethod][x]=stat.mean(pixelInput);
-          break;
-        case(filter::percentile):{
-          double threshold=(ithreshold<percentile_opt.size())? percentile_opt[ithreshold] : percentile_opt[0];
-          lineOutput[imethod][x]=stat.percentile(pixelInput,pixelInput.begin(),pixelInput.end(),threshold);
-          ++ithreshold;
-          break;
-        }
-        default:
-          std::string errorString="method not supported";
-          throw(errorString);
-          break;
-        }
-      }
+      for(int ifile=0;ifile<size();++ifile)
+        pixelInput[ifile]=lineInput[ifile][x];
+      filter1d.stats(pixelInput,methods,pixelOutput,buffer);
+      for(int imethod=0;imethod<function_opt.size();++imethod)
+        lineOutput[imethod][x]=pixelOutput[imethod];
     }
     for(int imethod=0;imethod<function_opt.size();++imethod){
       imgWriter.writeData(lineOutput[imethod],y,imethod);
@@ -296,64 +261,30 @@ CPLErr ImgRasterGdal::statProfile(ImgRasterGdal& imgWriter, const AppFactory& ap
     Vector2d<double> lineInput(this->nrOfBand(),this->nrOfCol());
     assert(imgWriter.nrOfCol()==this->nrOfCol());
     Vector2d<double> lineOutput(function_opt.size(),imgWriter.nrOfCol());
-    statfactory::StatFactory stat;
-    stat.setNoDataValues(nodata_opt);
+    //all statistics of a pixel profile are obtained in a single pass
+    filter::Filter filter1d;
+    filter1d.setNoDataValues(nodata_opt);
+    filter1d.setThresholds(percentile_opt);
+    vector<filter::FILTER_TYPE> methods(function_opt.size());
+    for(int imethod=0;imethod<function_opt.size();++imethod)
+      methods[imethod]=filter::Filter::getFilterType(function_opt[imethod]);
     const char* pszMessage;
     void* pProgressArg=NULL;
     GDALProgressFunc pfnProgress=GDALTermProgress;
     double progress=0;
     pfnProgress(progress,pszMessage,pProgressArg);
+    vector<double> pixelInput(this->nrOfBand());
+    vector<double> pixelOutput(function_opt.size());
+    vector<double> buffer;
     for(unsigned int y=0;y<this->nrOfRow();++y){
       for(unsigned int iband=0;iband<this->nrOfBand();++iband)
         this->readData(lineInput[iband],y,iband);
-      vector<double> pixelInput(this->nrOfBand());
       for(unsigned int x=0;x<this->nrOfCol();++x){
-        pixelInput=lineInput.selectCol(x);
-        int ithreshold=0;//threshold to use for percentiles
-        for(int imethod=0;imethod<function_opt.size();++imethod){
-          switch(filter::Filter::getFilterType(function_opt[imethod])){
-          case(filter::first):
-            lineOutput[imethod][x]=lineInput[0][x];
-            break;
-          case(filter::last):
-            lineOutput[imethod][x]=lineInput.back()[x];
-            break;
-          case(filter::nvalid):
-            lineOutput[imethod][x]=stat.nvalid(pixelInput);
-            break;
-          case(filter::median):
-            lineOutput[imethod][x]=stat.median(pixelInput);
-            break;
-          case(filter::min):
-            lineOutput[imethod][x]=stat.mymin(pixelInput);
-            break;
-          case(filter::max):
-            lineOutput[imethod][x]=stat.mymax(pixelInput);
-            break;
-          case(filter::sum):
-            lineOutput[imethod][x]=stat.sum(pixelInput);
-            break;
-          case(filter::var):
-            lineOutput[imethod][x]=stat.var(pixelInput);
-            break;
-          case(filter::stdev):
-            lineOutput[imethod][x]=sqrt(stat.var(pixelInput));
-            break;
-          case(filter::mean):
-            lineOutput[imethod][x]=stat.mean(pixelInput);
-            break;
-          case(filter::percentile):{
-            double threshold=(ithreshold<percentile_opt.size())? percentile_opt[ithreshold] : percentile_opt[0];
-            lineOutput[imethod][x]=stat.percentile(pixelInput,pixelInput.begin(),pixelInput.end(),threshold);
-            ++ithreshold;
-            break;
-          }
-          default:
-            std::string errorString="method not supported";
-            throw(errorString);
-            break;
-          }
-        }
+        for(unsigned int iband=0;iband<this->nrOfBand();++iband)
+          pixelInput[iband]=lineInput[iband][x];
+        filter1d.stats(pixelInput,methods,pixelOutput,buffer);
+        for(int imethod=0;imethod<function_opt.size();++imethod)
+          lineOutput[imethod][x]=pixelOutput[imethod];
       }
       for(int imethod=0;imethod<function_opt.size();++imethod){
         imgWriter.writeData(lineOutput[imethod],y,imethod);
@@ -29,7 +29,11 @@ along with pktools.  If not, see <http://www.gnu.org/licenses/>.
 #include "base/PosValue.h"
 #include "algorithms/ConfusionMatrix.h"
 #include "algorithms/svm.h"
+#include "algorithms/ModelFile.h"
 #include "apps/AppFactory.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace svm{
   enum SVM_TYPE {C_SVC=0, nu_SVC=1,one_class=2, epsilon_SVR=3, nu_SVR=4};
@@ -68,6 +72,7 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
 
   //--------------------------- command line options ------------------------------------
   Optionpk<string> training_opt("t", "training", "Training vector file. A single vector file contains all training features (must be set as: b0, b1, b2,...) for all classes (class numbers identified by label option). Use multiple training files for bootstrap aggregation (alternative to the bag and bsize options, where a random subset is taken from a single training file)");
+  Optionpk<string> model_opt("model", "model", "Model file. With training, the trained model (all bags, scaling, classes and priors) is saved to this file. Without training, the model is read from this file and no training is done");
   Optionpk<string> tlayer_opt("tln", "tln", "Training layer name(s)");
   Optionpk<string> label_opt("label", "label", "Attribute name for class label in training vector file.","label");
   Optionpk<unsigned int> balance_opt("bal", "balance", "Balance the input data to this number of samples for each class", 0);
@@ -94,6 +99,7 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
   Optionpk<float> epsilon_tol_opt("etol", "etol", "The tolerance of termination criterion",0.001);
   Optionpk<bool> shrinking_opt("shrink", "shrink", "Whether to use the shrinking heuristics",false);
   Optionpk<bool> prob_est_opt("pe", "probest", "Whether to train a SVC or SVR model for probability estimates",true,2);
+  Optionpk<unsigned int> rff_opt("rff", "rff", "Number of random Fourier features to approximate a radial kernel for the classification of the image (0: exact). Agreement with the exact model is reported on the training set", 0, 2);
   // Optionpk<bool> weight_opt("wi", "wi", "Set the parameter C of class i to weight*C, for C_SVC",true);
   Optionpk<unsigned short> comb_opt("comb", "comb", "How to combine bootstrap aggregation classifiers (0: sum rule, 1: product rule, 2: max rule). Also used to aggregate classes with rc option.",0);
   Optionpk<unsigned short> bag_opt("bag", "bag", "Number of bootstrap aggregations", 1);
@@ -150,6 +156,7 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
   bool doProcess;//stop process when program was invoked with help option (-h --help)
   try{
     doProcess=training_opt.retrieveOption(app.getArgc(),app.getArgv());
+    model_opt.retrieveOption(app.getArgc(),app.getArgv());
     cv_opt.retrieveOption(app.getArgc(),app.getArgv());
     cmformat_opt.retrieveOption(app.getArgc(),app.getArgv());
     tlayer_opt.retrieveOption(app.getArgc(),app.getArgv());
@@ -190,6 +197,7 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
     epsilon_tol_opt.retrieveOption(app.getArgc(),app.getArgv());
     shrinking_opt.retrieveOption(app.getArgc(),app.getArgv());
     prob_est_opt.retrieveOption(app.getArgc(),app.getArgv());
+    rff_opt.retrieveOption(app.getArgc(),app.getArgv());
     entropy_opt.retrieveOption(app.getArgc(),app.getArgv());
     active_opt.retrieveOption(app.getArgc(),app.getArgv());
     nactive_opt.retrieveOption(app.getArgc(),app.getArgv());
@@ -208,8 +216,8 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
       throw(helpStream.str());//help was invoked, stop processing
     }
 
-    if(training_opt.empty()){
-      string errorString="Error: no training provided";
+    if(training_opt.empty()&&model_opt.empty()){
+      string errorString="Error: no training or model provided";
       throw(errorString);
     }
 
@@ -282,6 +290,10 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
 
     ImgWriterOgr activeWriter;
     if(active_opt.size()){
+      if(training_opt.empty()){
+        string errorString="Error: active learning requires training";
+        throw(errorString);
+      }
       prob_est_opt[0]=true;
       ImgReaderOgr trainingReader(training_opt[0]);
       activeWriter.open(active_opt[0],ogrformat_opt[0]);
@@ -356,8 +368,46 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
 
     vector<struct svm_problem> prob(nbag);
     vector<struct svm_node *> x_space(nbag);
+    //seed for the bagging streams (one per bag and class)
+    unsigned long int seed=(random_opt[0])? time(NULL) : 0;
 
-    for(int ibag=0;ibag<nbag;++ibag){
+    //read trained model instead of training
+    modelfile::ModelReader modelReader;//svm models point into the mapped file: keep open until models are destroyed
+    if(training_opt.empty()){
+      if(verbose_opt[0]>=1)
+        std::cout << "reading model file " << model_opt[0] << std::endl;
+      modelReader.open(model_opt[0],"pksvm");
+      nbag=modelReader.readValue<unsigned short>();
+      nclass=modelReader.readValue<unsigned int>();
+      nband=modelReader.readValue<unsigned int>();
+      modelReader.read(band_opt);
+      modelReader.read(nameVector);
+      modelReader.read(classValueMap);
+      modelReader.read(priors);
+      prob_est_opt[0]=modelReader.readValue<bool>();
+      svm.resize(nbag);
+      param.resize(nbag);
+      offset.resize(nbag);
+      scale.resize(nbag);
+      prob.resize(nbag);
+      x_space.resize(nbag);
+      for(int ibag=0;ibag<nbag;++ibag){
+        modelReader.read(offset[ibag]);
+        modelReader.read(scale[ibag]);
+        size_t used=0;
+        svm[ibag]=svm_load_model_binary(modelReader.getData(),modelReader.remaining(),&used);
+        if(!svm[ibag]){
+          string errorString="Error: could not read svm model from ";
+          errorString+=model_opt[0];
+          throw(errorString);
+        }
+        modelReader.skip(used);
+      }
+      if(verbose_opt[0]>=1)
+        std::cout << "number of bootstrap aggregations, classes and bands in model: " << nbag << ", " << nclass << ", " << nband << std::endl;
+    }
+
+    for(int ibag=0;ibag<nbag&&!modelReader.isOpen();++ibag){
       //organize training data
       if(ibag<training_opt.size()){//if bag contains new training pixels
         trainingMap.clear();
@@ -535,21 +585,25 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
         int nctraining=0;
         if(verbose_opt[0]>=1)
           std::cout << "calculating features for class " << iclass << std::endl;
-        if(random_opt[0])
-          srand(time(NULL));
         nctraining=(bagSize_opt[iclass]<100)? trainingPixels[iclass].size()/100.0*bagSize_opt[iclass] : trainingPixels[iclass].size();//bagSize_opt[iclass] given in % of training size
         if(nctraining<=0)
           nctraining=1;
         assert(nctraining<=trainingPixels[iclass].size());
-        if(bagSize_opt[iclass]<100)
-          random_shuffle(trainingPixels[iclass].begin(),trainingPixels[iclass].end());
+        //bag selection depends on the bag's own stream only (training pixels are not reordered)
+        vector<unsigned long int> sampleIndex(trainingPixels[iclass].size());
+        for(unsigned long int isample=0;isample<sampleIndex.size();++isample)
+          sampleIndex[isample]=isample;
+        if(bagSize_opt[iclass]<100){
+          statfactory::RandomStream rng(seed,static_cast<unsigned long int>(ibag)*nclass+iclass);
+          rng.shuffle(sampleIndex.begin(),sampleIndex.end());
+        }
         if(verbose_opt[0]>1)
           std::cout << "nctraining (class " << iclass << "): " << nctraining << std::endl;
         trainingFeatures[iclass].resize(nctraining);
         for(int isample=0;isample<nctraining;++isample){
           //scale pixel values according to scale and offset!!!
           for(int iband=0;iband<nband;++iband){
-            float value=trainingPixels[iclass][isample][iband+startBand];
+            float value=trainingPixels[iclass][sampleIndex[isample]][iband+startBand];
             trainingFeatures[iclass][isample].push_back((value-offset[ibag][iband])/scale[ibag][iband]);
           }
         }
@@ -607,33 +661,44 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
       if(verbose_opt[0]>1)
         std::cout << "checking parameters" << std::endl;
       svm_check_parameter(&prob[ibag],&param[ibag]);
+      // *NOTE* Because svm_model contains pointers to svm_problem, you can
+      // not free the memory used by svm_problem if you are still using the
+      // svm_model produced by svm_train().
+    }//for ibag
+    //train the bags (and cross validate) in parallel, each with its share of the kernel cache
+    if(!modelReader.isOpen()){
+      int nworker=1;
+#ifdef _OPENMP
+      nworker=(nbag<omp_get_max_threads())? nbag : omp_get_max_threads();
+#endif
       if(verbose_opt[0])
-        std::cout << "parameters ok, training" << std::endl;
-      svm[ibag]=svm_train(&prob[ibag],&param[ibag]);
+        std::cout << "parameters ok, training " << nbag << " bag(s) on " << nworker << " thread(s)" << std::endl;
+      svm_set_random_seed(seed);
+      vector< vector<double> > target(nbag);
+#pragma omp parallel for schedule(dynamic) if(nworker>1)
+      for(int ibag=0;ibag<nbag;++ibag){
+        param[ibag].cache_size=cache_opt[0]/nworker;
+        svm[ibag]=svm_train(&prob[ibag],&param[ibag]);
+        if(cv_opt[0]>1){
+          target[ibag].resize(prob[ibag].l);
+          svm_cross_validation(&prob[ibag],&param[ibag],cv_opt[0],&(target[ibag][0]));
+        }
+      }
       if(verbose_opt[0]>1)
         std::cout << "SVM is now trained" << std::endl;
-      if(cv_opt[0]>1){
-        if(verbose_opt[0]>1)
-          std::cout << "Cross validating" << std::endl;
-        double *target = Malloc(double,prob[ibag].l);
-        svm_cross_validation(&prob[ibag],&param[ibag],cv_opt[0],target);
+      for(int ibag=0;ibag<nbag&&cv_opt[0]>1;++ibag){
         assert(param[ibag].svm_type != EPSILON_SVR&&param[ibag].svm_type != NU_SVR);//only for regression
-
         for(int i=0;i<prob[ibag].l;i++){
           string refClassName=nameVector[prob[ibag].y[i]];
-          string className=nameVector[target[i]];
+          string className=nameVector[target[ibag][i]];
           if(classValueMap.size())
             cm.incrementResult(type2string<short>(classValueMap[refClassName]),type2string<short>(classValueMap[className]),1.0/nbag);
           else
-            cm.incrementResult(cm.getClass(prob[ibag].y[i]),cm.getClass(target[i]),1.0/nbag);
+            cm.incrementResult(cm.getClass(prob[ibag].y[i]),cm.getClass(target[ibag][i]),1.0/nbag);
         }
-        free(target);
       }
-      // *NOTE* Because svm_model contains pointers to svm_problem, you can
-      // not free the memory used by svm_problem if you are still using the
-      // svm_model produced by svm_train().
-    }//for ibag
-    if(cv_opt[0]>1){
+    }
+    if(cv_opt[0]>1&&!modelReader.isOpen()){
       assert(cm.nReference());
       cm.setFormat(cmformat_opt[0]);
       cm.reportSE95(false);
@@ -655,6 +720,29 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
       // std::cout << "Overall Accuracy: " << 100*doa << " (" << 100*se95_oa << ")"  << std::endl;
     }
 
+    if(model_opt.size()&&!modelReader.isOpen()){
+      if(verbose_opt[0]>=1)
+        std::cout << "writing model file " << model_opt[0] << std::endl;
+      modelfile::ModelWriter modelWriter(model_opt[0],"pksvm");
+      modelWriter.writeValue<unsigned short>(nbag);
+      modelWriter.writeValue<unsigned int>(nclass);
+      modelWriter.writeValue<unsigned int>(nband);
+      modelWriter.write(band_opt);
+      modelWriter.write(nameVector);
+      modelWriter.write(classValueMap);
+      modelWriter.write(priors);
+      modelWriter.writeValue<bool>(prob_est_opt[0]);
+      for(int ibag=0;ibag<nbag;++ibag){
+        modelWriter.write(offset[ibag]);
+        modelWriter.write(scale[ibag]);
+        if(svm_save_model_binary(modelWriter.getFile(),svm[ibag])){
+          string errorString="Error: could not write svm model to ";
+          errorString+=model_opt[0];
+          throw(errorString);
+        }
+      }
+      modelWriter.close();
+    }
     //--------------------------------- end of training -----------------------------------
 
     const char* pszMessage;
@@ -743,6 +831,74 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
         maskReader.open(mask_opt[0]);
       }
 
+      //dense support vectors to predict all pixels of a line in a single batch per bag
+      vector<struct svm_dense_model*> svmDense(nbag);
+      size_t workSize=0;
+      for(int ibag=0;ibag<nbag;++ibag){
+        if(prob_est_opt[0]&&!svm_check_probability_model(svm[ibag])){
+          string errorString="Error: check probability model failed";
+          throw(errorString);
+        }
+        svmDense[ibag]=svm_create_dense_model(svm[ibag],nband);
+        if(rff_opt[0]&&svm[ibag]->param.kernel_type==RBF){
+          //approximate the radial kernel with random Fourier features (separate random stream per bag)
+          vector<double> rffW(rff_opt[0]*nband);
+          vector<double> rffB(rff_opt[0]);
+          statfactory::RandomStream rng(seed,static_cast<unsigned long int>(nbag)*nclass+ibag);
+          rng.gaussian(&(rffW[0]),rffW.size());
+          rng.uniform(&(rffB[0]),rffB.size(),0,2*M_PI,rffW.size());
+          struct svm_dense_model* approxDense=svm_create_dense_model_rff(svm[ibag],nband,rff_opt[0],&(rffW[0]),&(rffB[0]));
+          if(!approxDense)
+            std::cerr << "Warning: could not approximate model of bag " << ibag << ", using exact model" << std::endl;
+          else{
+            if(training_opt.size()){
+              //agreement with the exact model on the training set
+              vector<double> trainingFeatures(prob[ibag].l*nband);
+              for(int isample=0;isample<prob[ibag].l;++isample){
+                for(const struct svm_node* node=prob[ibag].x[isample];node->index!=-1;++node)
+                  trainingFeatures[isample*nband+node->index-1]=node->value;
+              }
+              vector<double> exactLabels(prob[ibag].l);
+              vector<double> approxLabels(prob[ibag].l);
+              vector<double> exactWork(svm_predict_batch_work_size(svmDense[ibag]));
+              vector<double> approxWork(svm_predict_batch_work_size(approxDense));
+              svm_predict_batch(svmDense[ibag],&(trainingFeatures[0]),prob[ibag].l,&(exactLabels[0]),NULL,&(exactWork[0]));
+              svm_predict_batch(approxDense,&(trainingFeatures[0]),prob[ibag].l,&(approxLabels[0]),NULL,&(approxWork[0]));
+              unsigned int nagree=0;
+              for(int isample=0;isample<prob[ibag].l;++isample){
+                if(exactLabels[isample]==approxLabels[isample])
+                  ++nagree;
+              }
+              std::cout << "agreement of approximate (" << rff_opt[0] << " random Fourier features) with exact model for bag " << ibag << ": " << 100.0*nagree/prob[ibag].l << "%" << std::endl;
+            }
+            svm_free_dense_model(&(svmDense[ibag]));
+            svmDense[ibag]=approxDense;
+          }
+        }
+        if(svm_predict_batch_work_size(svmDense[ibag])>workSize)
+          workSize=svm_predict_batch_work_size(svmDense[ibag]);
+      }
+      //bags with the same scaling share the kernel values with the union of their support vectors
+      struct svm_dense_ensemble* svmEnsemble=NULL;
+      bool shareKernel=(nbag>1);
+      for(int ibag=0;ibag<nbag&&shareKernel;++ibag){
+        if(!svmDense[ibag]||svmDense[ibag]->nr_weight||offset[ibag]!=offset[0]||scale[ibag]!=scale[0])
+          shareKernel=false;
+      }
+      if(shareKernel)
+        svmEnsemble=svm_create_dense_ensemble(&(svm[0]),nbag,nband);
+      if(svmEnsemble){
+        if(verbose_opt[0])
+          std::cout << "support vectors shared by " << nbag << " bags: " << svmEnsemble->l << std::endl;
+        if(svm_predict_ensemble_work_size(svmEnsemble)>workSize)
+          workSize=svm_predict_ensemble_work_size(svmEnsemble);
+      }
+      const unsigned int blockSize=64;//number of pixels classified per thread at a time
+      vector<short> classValue(nclass);
+      for(short iclass=0;iclass<nclass;++iclass)
+        classValue[iclass]=classValueMap[nameVector[iclass]];
+      vector<unsigned int> classifyCol;//columns of the pixels to classify
+
       for(unsigned int iline=0;iline<nrow;++iline){
         vector<float> buffer(ncol);
         vector<short> lineMask;
@@ -789,6 +945,7 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
           }
         }
         double oldRowMask=-1;//keep track of row mask to optimize number of line readings
+        classifyCol.clear();
         //process per pixel
         for(int icol=0;icol<ncol;++icol){
           assert(hpixel[icol].size()==nband);
@@ -859,108 +1016,128 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
             classOut[icol]=nodata_opt[0];
             continue;//next column
           }
-          if(verbose_opt[0]>1)
-            std::cout << "begin classification " << std::endl;
-          //----------------------------------- classification -------------------
+          classifyCol.push_back(icol);
+        }//icol
+        if(verbose_opt[0]>1)
+          std::cout << "begin classification " << std::endl;
+        //----------------------------------- classification -------------------
+        //blocks of pixels are distributed over the threads, models are shared (read only)
+        unsigned int nclassify=classifyCol.size();
+        int nblock=(nclassify+blockSize-1)/blockSize;
+#pragma omp parallel if(nblock>1)
+        {
+          vector<double> svmWork(workSize);
+          vector<double> features(blockSize*nband);//scaled features of the pixels in block [pixel][band]
+          vector<double> labels(nbag*blockSize);//[bag][pixel]
+          vector<double> result(nbag*blockSize*nclass);//[bag][pixel][class]
+          vector<double*> bagLabels(nbag);
+          vector<double*> bagResult(nbag);
           for(int ibag=0;ibag<nbag;++ibag){
-            vector<double> result(nclass);
-            struct svm_node *x;
-            x = (struct svm_node *) malloc((nband+1)*sizeof(struct svm_node));
-            for(int iband=0;iband<nband;++iband){
-              x[iband].index=iband+1;
-              x[iband].value=(hpixel[icol][iband]-offset[ibag][iband])/scale[ibag][iband];
-            }
-            x[nband].index=-1;//to end svm feature vector
-            double predict_label=0;
-            vector<float> prValues(nclass);
-            float maxP=0;
-            if(!prob_est_opt[0]){
-              predict_label = svm_predict(svm[ibag],x);
-              for(short iclass=0;iclass<nclass;++iclass){
-                if(iclass==static_cast<short>(predict_label))
-                  result[iclass]=1;
-                else
-                  result[iclass]=0;
+            bagLabels[ibag]=&(labels[ibag*blockSize]);
+            bagResult[ibag]=&(result[ibag*blockSize*nclass]);
+          }
+          vector<double> pixelPrior(priors);
+#pragma omp for schedule(dynamic)
+          for(int iblock=0;iblock<nblock;++iblock){
+            unsigned int firstPixel=iblock*blockSize;
+            unsigned int npixel=(nclassify-firstPixel<blockSize)? nclassify-firstPixel : blockSize;
+            for(int ibag=0;ibag<nbag;++ibag){
+              if(ibag&&svmEnsemble)//features and predictions of all bags are obtained with the first bag
+                continue;
+              for(unsigned int ipixel=0;ipixel<npixel;++ipixel){
+                for(unsigned int iband=0;iband<nband;++iband)
+                  features[ipixel*nband+iband]=(hpixel[classifyCol[firstPixel+ipixel]][iband]-offset[ibag][iband])/scale[ibag][iband];
               }
+              if(svmEnsemble)
+                svm_predict_ensemble(svmEnsemble,&(features[0]),npixel,&(bagLabels[0]),(prob_est_opt[0])? &(bagResult[0]) : NULL,&(svmWork[0]));
+              else
+                svm_predict_batch(svmDense[ibag],&(features[0]),npixel,bagLabels[ibag],(prob_est_opt[0])? bagResult[ibag] : NULL,&(svmWork[0]));
             }
-            else{
-              if(!svm_check_probability_model(svm[ibag])){
-                string errorString="Error: check probability model failed";
-                throw(errorString);
+            for(int ibag=0;ibag<nbag;++ibag){
+              if(!prob_est_opt[0]){
+                for(unsigned int ipixel=0;ipixel<npixel;++ipixel){
+                  for(short iclass=0;iclass<nclass;++iclass)
+                    bagResult[ibag][ipixel*nclass+iclass]=(iclass==static_cast<short>(bagLabels[ibag][ipixel]))? 1 : 0;
+                }
               }
-              predict_label = svm_predict_probability(svm[ibag],x,&(result[0]));
-            }
-            //calculate posterior prob of bag
-            if(classBag_opt.size()){
-              //search for max prob within bag
-              maxP=0;
-              classBag[ibag][icol]=0;
-            }
-            double normPrior=0;
-            if(priorimg_opt.size()){
-              for(short iclass=0;iclass<nclass;++iclass)
-                normPrior+=linePrior[iclass][icol];
-            }
-            for(short iclass=0;iclass<nclass;++iclass){
-              if(priorimg_opt.size())
-                priors[iclass]=linePrior[iclass][icol]/normPrior;//todo: check if correct for all cases... (automatic classValueMap and manual input for names and values)
-              switch(comb_opt[0]){
-              default:
-              case(0)://sum rule
-                probOut[iclass][icol]+=result[iclass]*priors[iclass];//add probabilities for each bag
-              break;
-              case(1)://product rule
-                probOut[iclass][icol]*=pow(static_cast<float>(priors[iclass]),static_cast<float>(1.0-nbag)/nbag)*result[iclass];//multiply probabilities for each bag
-                break;
-              case(2)://max rule
-                if(priors[iclass]*result[iclass]>probOut[iclass][icol])
-                  probOut[iclass][icol]=priors[iclass]*result[iclass];
-                break;
+              for(unsigned int ipixel=0;ipixel<npixel;++ipixel){
+                int icol=classifyCol[firstPixel+ipixel];
+                float maxP=0;
+                //calculate posterior prob of bag
+                if(classBag_opt.size()){
+                  //search for max prob within bag
+                  maxP=0;
+                  classBag[ibag][icol]=0;
+                }
+                double normPrior=0;
+                if(priorimg_opt.size()){
+                  for(short iclass=0;iclass<nclass;++iclass)
+                    normPrior+=linePrior[iclass][icol];
+                }
+                for(short iclass=0;iclass<nclass;++iclass){
+                  double pixelResult=bagResult[ibag][ipixel*nclass+iclass];
+                  if(priorimg_opt.size())
+                    pixelPrior[iclass]=linePrior[iclass][icol]/normPrior;//todo: check if correct for all cases... (automatic classValueMap and manual input for names and values)
+                  switch(comb_opt[0]){
+                  default:
+                  case(0)://sum rule
+                    probOut[iclass][icol]+=pixelResult*pixelPrior[iclass];//add probabilities for each bag
+                  break;
+                  case(1)://product rule
+                    probOut[iclass][icol]*=pow(static_cast<float>(pixelPrior[iclass]),static_cast<float>(1.0-nbag)/nbag)*pixelResult;//multiply probabilities for each bag
+                    break;
+                  case(2)://max rule
+                    if(pixelPrior[iclass]*pixelResult>probOut[iclass][icol])
+                      probOut[iclass][icol]=pixelPrior[iclass]*pixelResult;
+                    break;
+                  }
+                  if(classBag_opt.size()){
+                    //search for max prob within bag
+                    if(pixelResult>maxP){
+                      maxP=pixelResult;
+                      classBag[ibag][icol]=iclass;
+                    }
+                  }
+                }
               }
-              if(classBag_opt.size()){
-                //search for max prob within bag
-                // if(prValues[iclass]>maxP){
-                //   maxP=prValues[iclass];
-                //   classBag[ibag][icol]=iclass;
-                // }
-                if(result[iclass]>maxP){
-                  maxP=result[iclass];
-                  classBag[ibag][icol]=iclass;
+            }//ibag
+            for(unsigned int ipixel=0;ipixel<npixel;++ipixel){
+              int icol=classifyCol[firstPixel+ipixel];
+              //search for max class prob
+              float maxBag1=0;//max probability
+              float maxBag2=0;//second max probability
+              float normBag=0;
+              for(short iclass=0;iclass<nclass;++iclass){
+                if(probOut[iclass][icol]>maxBag1){
+                  maxBag1=probOut[iclass][icol];
+                  classOut[icol]=classValue[iclass];
                 }
+                else if(probOut[iclass][icol]>maxBag2)
+                  maxBag2=probOut[iclass][icol];
+                normBag+=probOut[iclass][icol];
               }
-            }
-            free(x);
-          }//ibag
-
-          //search for max class prob
-          float maxBag1=0;//max probability
-          float maxBag2=0;//second max probability
-          float normBag=0;
-          for(short iclass=0;iclass<nclass;++iclass){
-            if(probOut[iclass][icol]>maxBag1){
-              maxBag1=probOut[iclass][icol];
-              classOut[icol]=classValueMap[nameVector[iclass]];
-            }
-            else if(probOut[iclass][icol]>maxBag2)
-              maxBag2=probOut[iclass][icol];
-            normBag+=probOut[iclass][icol];
-          }
-          //normalize probOut and convert to percentage
-          entropy[icol]=0;
-          for(short iclass=0;iclass<nclass;++iclass){
-            float prv=probOut[iclass][icol];
-            prv/=normBag;
-            entropy[icol]-=prv*log(prv)/log(2.0);
-            prv*=100.0;
+              //normalize probOut and convert to percentage
+              entropy[icol]=0;
+              for(short iclass=0;iclass<nclass;++iclass){
+                float prv=probOut[iclass][icol];
+                prv/=normBag;
+                entropy[icol]-=prv*log(prv)/log(2.0);
+                prv*=100.0;
 
-            probOut[iclass][icol]=static_cast<short>(prv+0.5);
-            // assert(classValueMap[nameVector[iclass]]<probOut.size());
-            // assert(classValueMap[nameVector[iclass]]>=0);
-            // probOut[classValueMap[nameVector[iclass]]][icol]=static_cast<short>(prv+0.5);
-          }
-          entropy[icol]/=log(static_cast<double>(nclass))/log(2.0);
-          entropy[icol]=static_cast<short>(100*entropy[icol]+0.5);
-          if(active_opt.size()){
+                probOut[iclass][icol]=static_cast<short>(prv+0.5);
+                // assert(classValueMap[nameVector[iclass]]<probOut.size());
+                // assert(classValueMap[nameVector[iclass]]>=0);
+                // probOut[classValueMap[nameVector[iclass]]][icol]=static_cast<short>(prv+0.5);
+              }
+              entropy[icol]/=log(static_cast<double>(nclass))/log(2.0);
+              entropy[icol]=static_cast<short>(100*entropy[icol]+0.5);
+            }//ipixel
+          }//iblock
+        }
+        //merge active learning candidates in column order, as in a sequential run
+        if(active_opt.size()){
+          for(unsigned int ipixel=0;ipixel<nclassify;++ipixel){
+            int icol=classifyCol[ipixel];
             if(entropy[icol]>activePoints.back().value){
               activePoints.back().value=entropy[icol];//replace largest value (last)
               activePoints.back().posx=icol;
@@ -970,7 +1147,7 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
                 std::cout << activePoints.back().posx << " " << activePoints.back().posy << " " << activePoints.back().value << std::endl;
             }
           }
-        }//icol
+        }
         //----------------------------------- write output ------------------------------------------
         if(classBag_opt.size())
           for(int ibag=0;ibag<nbag;++ibag)
@@ -1018,6 +1195,9 @@ CPLErr ImgRasterGdal::svm(ImgRasterGdal& imgWriter, const AppFactory& app){
         entropyImage.close();
       if(classBag_opt.size())
         classImageBag.close();
+      for(int ibag=0;ibag<nbag;++ibag)
+        svm_free_dense_model(&(svmDense[ibag]));
+      svm_free_dense_ensemble(&svmEnsemble);
       // imgWriter.close();
     }
     // else{//classify vector file
@@ -592,6 +592,21 @@ CPLErr ImgReaderOgr::svm(shared_ptr<ImgWriterOgr> imgWriter, const AppFactory& a
     if(!verbose_opt[0])
       pfnProgress(progress,pszMessage,pProgressArg);
 
+    //dense support vectors to predict a chunk of features in a single batch per bag
+    const unsigned int featureBlockSize=4096;//number of features read before classification
+    const unsigned int chunkSize=64;//number of features classified per thread at a time
+    vector<struct svm_dense_model*> svmDense(nbag);
+    size_t workSize=0;
+    for(int ibag=0;ibag<nbag;++ibag){
+      if(prob_est_opt[0]&&!svm_check_probability_model(svm[ibag])){
+        string errorString="Error: check probability model failed";
+        throw(errorString);
+      }
+      svmDense[ibag]=svm_create_dense_model(svm[ibag],nband);
+      if(svm_predict_batch_work_size(svmDense[ibag])>workSize)
+        workSize=svm_predict_batch_work_size(svmDense[ibag]);
+    }
+
     cm.clearResults();
     //notice that fields have already been set by readDataImageOgr (taking into account appropriate bands)
     for(int ivalidation=0;ivalidation<vectorCollection.size();++ivalidation){
@@ -625,145 +640,163 @@ CPLErr ImgReaderOgr::svm(shared_ptr<ImgWriterOgr> imgWriter, const AppFactory& a
         progress=0;
         pfnProgress(progress,pszMessage,pProgressArg);
         OGRFeature *poFeature;
-        while( (poFeature = imgReaderOgr.getLayer(ilayer)->GetNextFeature()) != NULL ){
-          if(verbose_opt[0]>1)
-            std::cout << "feature " << ifeature << std::endl;
-          if( poFeature == NULL ){
-            cout << "Warning: could not read feature " << ifeature << " in layer " << imgReaderOgr.getLayerName(ilayer) << endl;
-            continue;
-          }
-          OGRFeature *poDstFeature = NULL;
-          if(output_opt.size()){
-            poDstFeature=imgWriterOgr.createFeature(ilayer);
-            if( poDstFeature->SetFrom( poFeature, TRUE ) != OGRERR_NONE ){
-              CPLError( CE_Failure, CPLE_AppDefined,
-                        "Unable to translate feature %d from layer %s.\n",
-                        poFeature->GetFID(), imgWriterOgr.getLayerName(ilayer).c_str() );
-              OGRFeature::DestroyFeature( poFeature );
-              OGRFeature::DestroyFeature( poDstFeature );
+        vector<OGRFeature*> blockFeature;//features are read, classified and written in blocks
+        vector< vector<float> > blockPixel;
+        vector<short> blockClass;//index in nameVector of the class with max prob (-1 if unclassified)
+        bool lastBlock=false;
+        while(!lastBlock){
+          //read features (sequential)
+          blockFeature.clear();
+          blockPixel.clear();
+          while(blockFeature.size()<featureBlockSize){
+            if((poFeature = imgReaderOgr.getLayer(ilayer)->GetNextFeature()) == NULL){
+              lastBlock=true;
+              break;
             }
+            vector<float> validationPixel;
+            imgReaderOgr.readData(validationPixel,OFTReal,fields,poFeature,ilayer);
+            assert(validationPixel.size()==nband);
+            blockFeature.push_back(poFeature);
+            blockPixel.push_back(validationPixel);
           }
-          vector<float> validationPixel;
-          vector<float> validationFeature;
-
-          imgReaderOgr.readData(validationPixel,OFTReal,fields,poFeature,ilayer);
-          assert(validationPixel.size()==nband);
-          vector<float> probOut(nclass);//posterior prob for each class
-          for(short iclass=0;iclass<nclass;++iclass)
-            probOut[iclass]=0;
-          for(int ibag=0;ibag<nbag;++ibag){
-            for(int iband=0;iband<nband;++iband){
-              validationFeature.push_back((validationPixel[iband]-offset[ibag][iband])/scale[ibag][iband]);
-              if(verbose_opt[0]==2)
-                std::cout << " " << validationFeature.back();
-            }
-            if(verbose_opt[0]==2)
-              std::cout << std::endl;
-            vector<double> result(nclass);
-            struct svm_node *x;
-            x = (struct svm_node *) malloc((validationFeature.size()+1)*sizeof(struct svm_node));
-            for(int i=0;i<validationFeature.size();++i){
-              x[i].index=i+1;
-              x[i].value=validationFeature[i];
-            }
-
-            x[validationFeature.size()].index=-1;//to end svm feature vector
-            double predict_label=0;
-            if(!prob_est_opt[0]){
-              predict_label = svm_predict(svm[ibag],x);
-              for(short iclass=0;iclass<nclass;++iclass){
-                if(iclass==static_cast<short>(predict_label))
-                  result[iclass]=1;
-                else
-                  result[iclass]=0;
+          unsigned int nblockFeature=blockFeature.size();
+          blockClass.assign(nblockFeature,-1);
+          //classify chunks of features in parallel (detailed verbose output is sequential)
+          int nchunk=(nblockFeature+chunkSize-1)/chunkSize;
+#pragma omp parallel if(nchunk>1&&verbose_opt[0]<2)
+          {
+            vector<double> svmWork(workSize);
+            vector<double> features(chunkSize*nband);//scaled features [feature][band]
+            vector<double> labels(chunkSize);
+            vector<double> result(chunkSize*nclass);//[feature][class]
+            vector<float> probOut(chunkSize*nclass);//posterior prob for each class [feature][class]
+#pragma omp for schedule(dynamic)
+            for(int ichunk=0;ichunk<nchunk;++ichunk){
+              unsigned int firstFeature=ichunk*chunkSize;
+              unsigned int nchunkFeature=(nblockFeature-firstFeature<chunkSize)? nblockFeature-firstFeature : chunkSize;
+              probOut.assign(chunkSize*nclass,0);
+              for(int ibag=0;ibag<nbag;++ibag){
+                for(unsigned int ichunkFeature=0;ichunkFeature<nchunkFeature;++ichunkFeature){
+                  for(int iband=0;iband<nband;++iband){
+                    features[ichunkFeature*nband+iband]=(blockPixel[firstFeature+ichunkFeature][iband]-offset[ibag][iband])/scale[ibag][iband];
+                    if(verbose_opt[0]==2)
+                      std::cout << " " << features[ichunkFeature*nband+iband];
+                  }
+                  if(verbose_opt[0]==2)
+                    std::cout << std::endl;
+                }
+                if(prob_est_opt[0])
+                  svm_predict_batch(svmDense[ibag],&(features[0]),nchunkFeature,&(labels[0]),&(result[0]),&(svmWork[0]));
+                else{
+                  svm_predict_batch(svmDense[ibag],&(features[0]),nchunkFeature,&(labels[0]),NULL,&(svmWork[0]));
+                  for(unsigned int ichunkFeature=0;ichunkFeature<nchunkFeature;++ichunkFeature){
+                    for(short iclass=0;iclass<nclass;++iclass)
+                      result[ichunkFeature*nclass+iclass]=(iclass==static_cast<short>(labels[ichunkFeature]))? 1 : 0;
+                  }
+                }
+                for(unsigned int ichunkFeature=0;ichunkFeature<nchunkFeature;++ichunkFeature){
+                  const double* featureResult=&(result[ichunkFeature*nclass]);
+                  float* featureProb=&(probOut[ichunkFeature*nclass]);
+                  if(verbose_opt[0]>1){
+                    std::cout << "predict_label: " << labels[ichunkFeature] << std::endl;
+                    for(int iclass=0;iclass<nclass;++iclass)
+                      std::cout << featureResult[iclass] << " ";
+                    std::cout << std::endl;
+                  }
+                  //calculate posterior prob of bag
+                  for(short iclass=0;iclass<nclass;++iclass){
+                    switch(comb_opt[0]){
+                    default:
+                    case(0)://sum rule
+                      featureProb[iclass]+=featureResult[iclass]*priors[iclass];//add probabilities for each bag
+                    break;
+                    case(1)://product rule
+                      featureProb[iclass]*=pow(static_cast<float>(priors[iclass]),static_cast<float>(1.0-nbag)/nbag)*featureResult[iclass];//multiply probabilities for each bag
+                      break;
+                    case(2)://max rule
+                      if(priors[iclass]*featureResult[iclass]>featureProb[iclass])
+                        featureProb[iclass]=priors[iclass]*featureResult[iclass];
+                      break;
+                    }
+                  }
+                }
+              }//for ibag
+              //search for max class prob
+              for(unsigned int ichunkFeature=0;ichunkFeature<nchunkFeature;++ichunkFeature){
+                float maxBag=0;
+                for(short iclass=0;iclass<nclass;++iclass){
+                  if(verbose_opt[0]>1)
+                    std::cout << probOut[ichunkFeature*nclass+iclass] << " ";
+                  if(probOut[ichunkFeature*nclass+iclass]>maxBag){
+                    maxBag=probOut[ichunkFeature*nclass+iclass];
+                    blockClass[firstFeature+ichunkFeature]=iclass;
+                  }
+                }
               }
-            }
-            else{
-              if(!svm_check_probability_model(svm[ibag])){
-              string errorString="Error: check probability model failed";
-              throw(errorString);
-            }
-              predict_label = svm_predict_probability(svm[ibag],x,&(result[0]));
-            }
-            if(verbose_opt[0]>1){
-              std::cout << "predict_label: " << predict_label << std::endl;
-              for(int iclass=0;iclass<result.size();++iclass)
-                std::cout << result[iclass] << " ";
-              std::cout << std::endl;
-            }
-
-            //calculate posterior prob of bag
-            for(short iclass=0;iclass<nclass;++iclass){
-              switch(comb_opt[0]){
-              default:
-              case(0)://sum rule
-                probOut[iclass]+=result[iclass]*priors[iclass];//add probabilities for each bag
-              break;
-              case(1)://product rule
-                probOut[iclass]*=pow(static_cast<float>(priors[iclass]),static_cast<float>(1.0-nbag)/nbag)*result[iclass];//multiply probabilities for each bag
-                break;
-              case(2)://max rule
-                if(priors[iclass]*result[iclass]>probOut[iclass])
-                  probOut[iclass]=priors[iclass]*result[iclass];
-                break;
+            }//ichunk
+          }
+          //write features in the order they were read (sequential)
+          for(unsigned int iblockFeature=0;iblockFeature<nblockFeature;++iblockFeature){
+            poFeature=blockFeature[iblockFeature];
+            if(verbose_opt[0]>1)
+              std::cout << "feature " << ifeature << std::endl;
+            OGRFeature *poDstFeature = NULL;
+            if(output_opt.size()){
+              poDstFeature=imgWriterOgr.createFeature(ilayer);
+              if( poDstFeature->SetFrom( poFeature, TRUE ) != OGRERR_NONE ){
+                CPLError( CE_Failure, CPLE_AppDefined,
+                          "Unable to translate feature %d from layer %s.\n",
+                          poFeature->GetFID(), imgWriterOgr.getLayerName(ilayer).c_str() );
+                OGRFeature::DestroyFeature( poFeature );
+                OGRFeature::DestroyFeature( poDstFeature );
               }
             }
-            free(x);
-          }//for ibag
-
-          //search for max class prob
-          float maxBag=0;
-          string classOut="Unclassified";
-          for(short iclass=0;iclass<nclass;++iclass){
-            if(verbose_opt[0]>1)
-              std::cout << probOut[iclass] << " ";
-            if(probOut[iclass]>maxBag){
-              maxBag=probOut[iclass];
-              classOut=nameVector[iclass];
+            string classOut="Unclassified";
+            if(blockClass[iblockFeature]>=0)
+              classOut=nameVector[blockClass[iblockFeature]];
+            //look for class name
+            if(verbose_opt[0]>1){
+              if(classValueMap.size())
+                std::cout << "->" << classValueMap[classOut] << std::endl;
+              else
+                std::cout << "->" << classOut << std::endl;
             }
-          }
-          //look for class name
-          if(verbose_opt[0]>1){
-            if(classValueMap.size())
-              std::cout << "->" << classValueMap[classOut] << std::endl;
-            else
-              std::cout << "->" << classOut << std::endl;
-          }
-          if(output_opt.size()){
-            if(classValueMap.size())
-              poDstFeature->SetField("class",classValueMap[classOut]);
-            else
-              poDstFeature->SetField("class",classOut.c_str());
-            poDstFeature->SetFID( poFeature->GetFID() );
-          }
-          int labelIndex=poFeature->GetFieldIndex(label_opt[0].c_str());
-          if(labelIndex>=0){
-            string classRef=poFeature->GetFieldAsString(labelIndex);
-            if(classRef!="0"){
+            if(output_opt.size()){
               if(classValueMap.size())
-                cm.incrementResult(type2string<short>(classValueMap[classRef]),type2string<short>(classValueMap[classOut]),1);
+                poDstFeature->SetField("class",classValueMap[classOut]);
               else
-                cm.incrementResult(classRef,classOut,1);
+                poDstFeature->SetField("class",classOut.c_str());
+              poDstFeature->SetFID( poFeature->GetFID() );
             }
-          }
-          CPLErrorReset();
-          if(output_opt.size()){
-            if(imgWriterOgr.createFeature(poDstFeature,ilayer) != OGRERR_NONE){
-              CPLError( CE_Failure, CPLE_AppDefined,
-                        "Unable to translate feature %d from layer %s.\n",
-                        poFeature->GetFID(), imgWriterOgr.getLayerName(ilayer).c_str() );
-              OGRFeature::DestroyFeature( poDstFeature );
-              OGRFeature::DestroyFeature( poDstFeature );
+            int labelIndex=poFeature->GetFieldIndex(label_opt[0].c_str());
+            if(labelIndex>=0){
+              string classRef=poFeature->GetFieldAsString(labelIndex);
+              if(classRef!="0"){
+                if(classValueMap.size())
+                  cm.incrementResult(type2string<short>(classValueMap[classRef]),type2string<short>(classValueMap[classOut]),1);
+                else
+                  cm.incrementResult(classRef,classOut,1);
+              }
             }
-          }
-          ++ifeature;
-          if(!verbose_opt[0]){
-            progress=static_cast<float>(ifeature+1.0)/nFeatures;
-            pfnProgress(progress,pszMessage,pProgressArg);
-          }
-          OGRFeature::DestroyFeature( poFeature );
-          OGRFeature::DestroyFeature( poDstFeature );
-        }//get next feature
+            CPLErrorReset();
+            if(output_opt.size()){
+              if(imgWriterOgr.createFeature(poDstFeature,ilayer) != OGRERR_NONE){
+                CPLError( CE_Failure, CPLE_AppDefined,
+                          "Unable to translate feature %d from layer %s.\n",
+                          poFeature->GetFID(), imgWriterOgr.getLayerName(ilayer).c_str() );
+                OGRFeature::DestroyFeature( poDstFeature );
+                OGRFeature::DestroyFeature( poDstFeature );
+              }
+            }
+            ++ifeature;
+            if(!verbose_opt[0]){
+              progress=static_cast<float>(ifeature+1.0)/nFeatures;
+              pfnProgress(progress,pszMessage,pProgressArg);
+            }
+            OGRFeature::DestroyFeature( poFeature );
+            OGRFeature::DestroyFeature( poDstFeature );
+          }//iblockFeature
+        }//next block of features
       }//next layer
       // imgReaderOgr.close();
       // if(output_opt.size())
@@ -796,6 +829,7 @@ CPLErr ImgReaderOgr::svm(shared_ptr<ImgWriterOgr> imgWriter, const AppFactory& a
         free(prob[ibag].y);
         free(prob[ibag].x);
         free(x_space[ibag]);
+        svm_free_dense_model(&(svmDense[ibag]));
         svm_free_and_destroy_model(&(svm[ibag]));
       }
       return(CE_None);
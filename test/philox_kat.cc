@@ -0,0 +1,54 @@
+/**********************************************************************
+philox_kat.cc: known answer test for the Philox4x32-10 generator of StatFactory
+Copyright (C) 2008-2016 Pieter Kempeneers
+
+This file is part of pktools
+
+pktools is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+pktools is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with pktools.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <stdint.h>
+#include "algorithms/StatFactory.h"
+
+//philox4x32 10 vectors from kat_vectors of Random123: counter (4 words), key (2 words), expected output (4 words)
+static const uint32_t katVectors[3][10]={
+  {0x00000000,0x00000000,0x00000000,0x00000000,0x00000000,0x00000000,0x6627e8d5,0xe169c58d,0xbc57ac4c,0x9b00dbd8},
+  {0xffffffff,0xffffffff,0xffffffff,0xffffffff,0xffffffff,0xffffffff,0x408f276d,0x41c83b0e,0xa20bc7c6,0x6d5451fd},
+  {0x243f6a88,0x85a308d3,0x13198a2e,0x03707344,0xa4093822,0x299f31d0,0xd16cfe09,0x94fdcceb,0x5001e420,0x24126ea1}
+};
+
+int main(int argc, char *argv[])
+{
+  int nfail=0;
+  for(int ikat=0;ikat<3;++ikat){
+    const uint32_t* kat=katVectors[ikat];
+    unsigned long int counter=(static_cast<uint64_t>(kat[1])<<32)|kat[0];
+    unsigned long int stream=(static_cast<uint64_t>(kat[3])<<32)|kat[2];
+    unsigned long int seed=(static_cast<uint64_t>(kat[5])<<32)|kat[4];
+    statfactory::RandomStream rng(seed,stream);
+    uint32_t output[4];
+    rng.block(counter,output);
+    for(int iword=0;iword<4;++iword){
+      if(output[iword]!=kat[6+iword]){
+        std::cerr << "Error: philox4x32-10 vector " << ikat << " word " << iword << ": " << std::hex << output[iword] << " instead of " << kat[6+iword] << std::dec << std::endl;
+        ++nfail;
+      }
+    }
+  }
+  if(nfail)
+    return(1);
+  std::cout << "philox4x32-10 known answer test passed" << std::endl;
+  return(0);
+}